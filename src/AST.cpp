@@ -21,6 +21,44 @@ namespace llast {
                 return "Block";
             case NodeKind::LiteralInt32:
                 return "LiteralInt";
+            case NodeKind::While:
+                return "While";
+            case NodeKind::For:
+                return "For";
+            case NodeKind::Break:
+                return "Break";
+            case NodeKind::Continue:
+                return "Continue";
+            case NodeKind::Load:
+                return "Load";
+            case NodeKind::Store:
+                return "Store";
+            case NodeKind::Index:
+                return "Index";
+            case NodeKind::Splat:
+                return "Splat";
+            case NodeKind::ExtractLane:
+                return "ExtractLane";
+            case NodeKind::InsertLane:
+                return "InsertLane";
+            case NodeKind::Shuffle:
+                return "Shuffle";
+            case NodeKind::Reduce:
+                return "Reduce";
+            case NodeKind::Map:
+                return "Map";
+            case NodeKind::Fold:
+                return "Fold";
+            case NodeKind::Not:
+                return "Not";
+            case NodeKind::LiteralInt64:
+                return "LiteralInt64";
+            case NodeKind::LiteralDouble:
+                return "LiteralDouble";
+            case NodeKind::Convert:
+                return "Convert";
+            case NodeKind::CheckedBinary:
+                return "CheckedBinary";
             default:
                 throw UnhandledSwitchCase();
         }
@@ -36,11 +74,77 @@ namespace llast {
                 return "Mul";
             case OperationKind::Div:
                 return "Div";
+            case OperationKind::Min:
+                return "Min";
+            case OperationKind::Max:
+                return "Max";
+            case OperationKind::Eq:
+                return "Eq";
+            case OperationKind::Ne:
+                return "Ne";
+            case OperationKind::Lt:
+                return "Lt";
+            case OperationKind::Le:
+                return "Le";
+            case OperationKind::Gt:
+                return "Gt";
+            case OperationKind::Ge:
+                return "Ge";
+            case OperationKind::And:
+                return "And";
+            case OperationKind::Or:
+                return "Or";
             default:
                 throw UnhandledSwitchCase();
         }
     }
+
+    bool isComparison(OperationKind operation) {
+        switch(operation) {
+            case OperationKind::Eq:
+            case OperationKind::Ne:
+            case OperationKind::Lt:
+            case OperationKind::Le:
+            case OperationKind::Gt:
+            case OperationKind::Ge:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool isLogical(OperationKind operation) {
+        return operation == OperationKind::And || operation == OperationKind::Or;
+    }
     
+    std::string to_string(BranchHint hint) {
+        switch(hint) {
+            case BranchHint::None:
+                return "None";
+            case BranchHint::Likely:
+                return "Likely";
+            case BranchHint::Unlikely:
+                return "Unlikely";
+            default:
+                throw UnhandledSwitchCase();
+        }
+    }
+
+    std::string to_string(FloatSemantics semantics) {
+        switch(semantics) {
+            case FloatSemantics::Strict:
+                return "Strict";
+            case FloatSemantics::Contract:
+                return "Contract";
+            case FloatSemantics::Reassociate:
+                return "Reassociate";
+            case FloatSemantics::Fast:
+                return "Fast";
+            default:
+                throw UnhandledSwitchCase();
+        }
+    }
+
     std::string to_string(DataType dataType) {
         switch (dataType) {
             case DataType::Void:
@@ -51,11 +155,120 @@ namespace llast {
                 return "Int32";
             case DataType::Float:
                 return "Float";
+            case DataType::Double:
+                return "Double";
             case DataType::Pointer:
                 return "Pointer";
+            case DataType::Float32x4:
+                return "Float32x4";
+            case DataType::Float32x8:
+                return "Float32x8";
+            case DataType::Int32x4:
+                return "Int32x4";
+            case DataType::Int32x8:
+                return "Int32x8";
+            case DataType::Int64:
+                return "Int64";
+            case DataType::UInt32:
+                return "UInt32";
+            case DataType::UInt64:
+                return "UInt64";
             default:
                 throw UnhandledSwitchCase();
         }
     }
 
+    bool isInteger(DataType dataType) {
+        switch(laneType(dataType)) {
+            case DataType::Int32:
+            case DataType::Int64:
+            case DataType::UInt32:
+            case DataType::UInt64:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool isUnsigned(DataType dataType) {
+        return dataType == DataType::UInt32 || dataType == DataType::UInt64;
+    }
+
+    bool isFloatingPoint(DataType dataType) {
+        DataType lane = laneType(dataType);
+        return lane == DataType::Float || lane == DataType::Double;
+    }
+
+    unsigned laneCount(DataType dataType) {
+        switch(dataType) {
+            case DataType::Float32x4:
+            case DataType::Int32x4:
+                return 4;
+            case DataType::Float32x8:
+            case DataType::Int32x8:
+                return 8;
+            default:
+                return 1;
+        }
+    }
+
+    DataType laneType(DataType dataType) {
+        switch(dataType) {
+            case DataType::Float32x4:
+            case DataType::Float32x8:
+                return DataType::Float;
+            case DataType::Int32x4:
+            case DataType::Int32x8:
+                return DataType::Int32;
+            default:
+                return dataType;
+        }
+    }
+
+    DataType vectorType(DataType lane, unsigned count) {
+        for(DataType type : { DataType::Float32x4, DataType::Float32x8, DataType::Int32x4, DataType::Int32x8 }) {
+            if(laneType(type) == lane && laneCount(type) == count) {
+                return type;
+            }
+        }
+        return DataType::Void;
+    }
+
+    void *ArenaAllocatable::operator new(size_t size) {
+        return initializeHeader(::operator new(size + HEADER_SIZE), Allocation::Heap);
+    }
+
+    void ArenaAllocatable::operator delete(void *object) {
+        if(allocationOf(object) == Allocation::Heap) {
+            ::operator delete(static_cast<unsigned char*>(object) - HEADER_SIZE);
+        }
+    }
+
+    void ChildDeleter::destroy(const ArenaAllocatable *object) {
+        thread_local std::vector<const ArenaAllocatable*> pending;
+        thread_local bool destroying = false;
+
+        if(destroying) {
+            pending.push_back(object);
+            return;
+        }
+
+        destroying = true;
+        delete object;
+        while(!pending.empty()) {
+            const ArenaAllocatable *next = pending.back();
+            pending.pop_back();
+            delete next;
+        }
+        destroying = false;
+    }
+
+    std::shared_ptr<const Variable> AstContext::makeVariable(std::string_view name, DataType dataType, bool noAlias) {
+        return makeVariable(intern(name), dataType, noAlias);
+    }
+
+    std::shared_ptr<const Variable> AstContext::makeVariable(Symbol name, DataType dataType, bool noAlias) {
+        return std::allocate_shared<Variable>(std::pmr::polymorphic_allocator<Variable>(&resource_),
+                                              name, dataType, noAlias);
+    }
 }
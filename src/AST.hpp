@@ -2,14 +2,19 @@
 
 #include <string>
 #include <vector>
+#include <algorithm>
 #include <unordered_map>
 #include <functional>
 #include <memory>
+#include <memory_resource>
 
 #include "Exception.hpp"
+#include "Symbol.hpp"
+#include "AstContext.hpp"
 
 /** Rules for AST nodes:
  *      - Every node shall "own" its child nodes so that when a node is deleted, all of its children are also deleted.
+ *        (Nodes allocated in an AstContext are instead all deleted together with the context.)
  *      - Thou shalt not modify any AST node after it has been created.
  */
 
@@ -21,6 +26,7 @@ namespace llast {
     using std::shared_ptr;
     using std::move;
     using std::string;
+    using std::string_view;
 
     enum class NodeKind {
         Binary,
@@ -34,7 +40,26 @@ namespace llast {
         AssignVariable,
         Return,
         Module,
-        Function
+        Function,
+        While,
+        For,
+        Break,
+        Continue,
+        Load,
+        Store,
+        Index,
+        Splat,
+        ExtractLane,
+        InsertLane,
+        Shuffle,
+        Reduce,
+        Map,
+        Fold,
+        Not,
+        LiteralInt64,
+        LiteralDouble,
+        Convert,
+        CheckedBinary
     };
     string to_string(NodeKind nodeKind);
 
@@ -42,29 +67,103 @@ namespace llast {
         Add,
         Sub,
         Mul,
-        Div
+        Div,
+        Min,
+        Max,
+        Eq,
+        Ne,
+        Lt,
+        Le,
+        Gt,
+        Ge,
+        And,
+        Or
     };
     string to_string(OperationKind type);
 
+    /** Whether operation compares its operands, giving a Bool.  Integers are compared as signed and floating point
+     * values are ordered, i.e. a comparison involving NaN is false, except that Ne is true. */
+    bool isComparison(OperationKind operation);
+
+    /** Whether operation is And or Or, which take and give Bools and evaluate their rValue only if the lValue does
+     * not already determine the result. */
+    bool isLogical(OperationKind operation);
+
+    /** Whether the condition of a Conditional is expected to be true or false, when that is known in advance. */
+    enum class BranchHint {
+        None,
+        Likely,
+        Unlikely
+    };
+    string to_string(BranchHint hint);
+
+    /** Which IEEE rules the floating point operations of a Function may break to be faster, each level allowing
+     * what the previous one does.  Contract allows a multiplication and an addition to be fused, rounding only once,
+     * Reassociate allows operations to be regrouped as if they were associative, i.e. so that a sum is vectorized,
+     * and Fast also assumes that no value is NaN or infinite and ignores the sign of zero.  The LLVM version this
+     * library targets cannot allow reassociation alone, so code generation currently treats Reassociate as Fast. */
+    enum class FloatSemantics {
+        Strict,
+        Contract,
+        Reassociate,
+        Fast
+    };
+    string to_string(FloatSemantics semantics);
+
     enum class DataType {
         Void,
         Bool,
         Int32,
         Pointer,
         Float,
-        Double
+        Double,
+        Float32x4,
+        Float32x8,
+        Int32x4,
+        Int32x8,
+        Int64,
+        UInt32,
+        UInt64
     };
     string to_string(DataType dataType);
 
+    /** Whether the lanes of dataType are integers, which are signed unless dataType is UInt32 or UInt64. */
+    bool isInteger(DataType dataType);
+
+    /** Whether dataType is UInt32 or UInt64. */
+    bool isUnsigned(DataType dataType);
+
+    /** Whether the lanes of dataType are Floats or Doubles. */
+    bool isFloatingPoint(DataType dataType);
+
+    /** The largest number of lanes of a vector DataType. */
+    const unsigned MAX_LANES = 8;
+
+    /** The number of lanes of a vector DataType, or 1 for a scalar DataType. */
+    unsigned laneCount(DataType dataType);
+
+    /** The DataType of each lane of a vector DataType, or dataType itself for a scalar DataType. */
+    DataType laneType(DataType dataType);
+
+    /** The vector DataType with count lanes of type lane, or Void if there is no such DataType. */
+    DataType vectorType(DataType lane, unsigned count);
+
     /** Base class for all nodes */
-    class Node {
+    class Node : public ArenaAllocatable {
+        const NodeKind nodeKind_;
+    protected:
+        Node(NodeKind nodeKind) : nodeKind_{nodeKind} { }
     public:
         virtual ~Node() { }
-        virtual NodeKind nodeKind() const = 0;
+
+        /** Stored rather than virtual so that walkers can dispatch on it without an indirect call. */
+        NodeKind nodeKind() const { return nodeKind_; }
     };
 
     /** Base class for all expressions. */
     class Expr : public Node {
+    protected:
+        Expr(NodeKind nodeKind) : Node{nodeKind} { }
     public:
         virtual ~Expr() { }
 
@@ -75,11 +174,10 @@ namespace llast {
     class LiteralInt32 : public Expr {
         int const value_;
     public:
-        LiteralInt32(const int value) : value_(value) { }
+        LiteralInt32(const int value) : Expr{NodeKind::LiteralInt32}, value_(value) { }
 
         virtual ~LiteralInt32() { }
 
-        NodeKind nodeKind() const override { return NodeKind::LiteralInt32; }
 
         DataType dataType() const override {
             return DataType::Int32;
@@ -92,6 +190,10 @@ namespace llast {
         static std::unique_ptr<LiteralInt32> make(int value) {
             return std::make_unique<LiteralInt32>(value);
         }
+
+        static std::unique_ptr<LiteralInt32> make(AstContext &context, int value) {
+            return context.make<LiteralInt32>(value);
+        }
     };
 
 
@@ -99,13 +201,10 @@ namespace llast {
     class LiteralFloat : public Expr {
         float const value_;
     public:
-        LiteralFloat(const float value) : value_(value) { }
+        LiteralFloat(const float value) : Expr{NodeKind::LiteralFloat}, value_(value) { }
 
         virtual ~LiteralFloat() { }
 
-        NodeKind nodeKind() const override {
-            return NodeKind::LiteralFloat;
-        }
 
         DataType dataType() const override {
             return DataType::Float;
@@ -118,29 +217,77 @@ namespace llast {
         static std::unique_ptr<LiteralFloat> make(float value) {
             return std::make_unique<LiteralFloat>(value);
         }
+
+        static std::unique_ptr<LiteralFloat> make(AstContext &context, float value) {
+            return context.make<LiteralFloat>(value);
+        }
+    };
+
+    /** Represents an expression that is a literal 64 bit integer. */
+    class LiteralInt64 : public Expr {
+        int64_t const value_;
+    public:
+        LiteralInt64(const int64_t value) : Expr{NodeKind::LiteralInt64}, value_(value) { }
+
+        DataType dataType() const override {
+            return DataType::Int64;
+        }
+
+        int64_t value() const {
+            return value_;
+        }
+
+        static std::unique_ptr<LiteralInt64> make(int64_t value) {
+            return std::make_unique<LiteralInt64>(value);
+        }
+
+        static std::unique_ptr<LiteralInt64> make(AstContext &context, int64_t value) {
+            return context.make<LiteralInt64>(value);
+        }
+    };
+
+    /** Represents an expression that is a literal double. */
+    class LiteralDouble : public Expr {
+        double const value_;
+    public:
+        LiteralDouble(const double value) : Expr{NodeKind::LiteralDouble}, value_(value) { }
+
+        DataType dataType() const override {
+            return DataType::Double;
+        }
+
+        double value() const {
+            return value_;
+        }
+
+        static std::unique_ptr<LiteralDouble> make(double value) {
+            return std::make_unique<LiteralDouble>(value);
+        }
+
+        static std::unique_ptr<LiteralDouble> make(AstContext &context, double value) {
+            return context.make<LiteralDouble>(value);
+        }
     };
 
-    /** Represents a binary expression, i.e. 1 + 2 or foo + bar */
+    /** Represents a binary expression, i.e. 1 + 2 or foo + bar.  The operation of a vector Binary is applied to
+     * each pair of corresponding lanes;  comparisons and logical operations only apply to scalars. */
     class Binary : public Expr {
-        const unique_ptr<const Expr> lValue_;
+        const ChildPtr<const Expr> lValue_;
         const OperationKind operation_;
-        const unique_ptr<const Expr> rValue_;
+        const ChildPtr<const Expr> rValue_;
     public:
 
         /** Constructs a new Binary expression.  Note: assumes ownership of lValue and rValue */
-        Binary(unique_ptr<const Expr> lValue, OperationKind operation, unique_ptr<const Expr> rValue)
-                : lValue_(move(lValue)), operation_(operation), rValue_(move(rValue)) {
+        Binary(ChildPtr<const Expr> lValue, OperationKind operation, ChildPtr<const Expr> rValue)
+                : Expr{NodeKind::Binary}, lValue_(move(lValue)), operation_(operation), rValue_(move(rValue)) {
         }
 
         virtual ~Binary() { }
 
-        NodeKind nodeKind() const override {
-            return NodeKind::Binary;
-        }
 
-        /** The data type of an rValue expression is always the same as the rValue's data type. */
+        /** A comparison is a Bool, otherwise the data type of a Binary is the same as the rValue's data type. */
         DataType dataType() const override {
-            return rValue_->dataType();
+            return isComparison(operation_) ? DataType::Bool : rValue_->dataType();
         }
 
         const Expr *lValue() const {
@@ -161,55 +308,185 @@ namespace llast {
 
             return std::make_unique<Binary>(move(lvalue), operation, move(rvalue));
         }
+
+        static std::unique_ptr<Binary> make(AstContext &context,
+                                            std::unique_ptr<const Expr> lvalue,
+                                            OperationKind operation,
+                                            std::unique_ptr<const Expr> rvalue) {
+
+            return context.make<Binary>(move(lvalue), operation, move(rvalue));
+        }
+    };
+
+    /** Evaluates to true if operand, which must be a Bool, is false and to false if it is true. */
+    class Not : public Expr {
+        const ChildPtr<const Expr> operand_;
+    public:
+        /** Note: assumes ownership of operand. */
+        Not(ChildPtr<const Expr> operand) : Expr{NodeKind::Not}, operand_{move(operand)} {
+            ARG_NOT_NULL(operand_);
+        }
+
+        DataType dataType() const override { return DataType::Bool; }
+
+        const Expr *operand() const { return operand_.get(); }
+
+        static std::unique_ptr<Not> make(unique_ptr<const Expr> operand) {
+            return std::make_unique<Not>(move(operand));
+        }
+
+        static std::unique_ptr<Not> make(AstContext &context, unique_ptr<const Expr> operand) {
+            return context.make<Not>(move(operand));
+        }
+    };
+
+    /** Converts the value of operand to dataType.  Both must be scalar integers, Floats or Doubles, except that
+     * operand may also be a Bool, which converts to 1 or 0.  Integers are truncated, or extended according to the
+     * signedness of operand's type.  Floating point values are rounded toward zero when converted to integers, and the
+     * result is undefined if it is out of range. */
+    class Convert : public Expr {
+        const ChildPtr<const Expr> operand_;
+        const DataType dataType_;
+    public:
+        /** Note: assumes ownership of operand. */
+        Convert(ChildPtr<const Expr> operand, DataType dataType)
+                : Expr{NodeKind::Convert}, operand_{move(operand)}, dataType_{dataType} {
+            ARG_NOT_NULL(operand_);
+        }
+
+        DataType dataType() const override { return dataType_; }
+
+        const Expr *operand() const { return operand_.get(); }
+
+        static std::unique_ptr<Convert> make(unique_ptr<const Expr> operand, DataType dataType) {
+            return std::make_unique<Convert>(move(operand), dataType);
+        }
+
+        static std::unique_ptr<Convert> make(AstContext &context, unique_ptr<const Expr> operand, DataType dataType) {
+            return context.make<Convert>(move(operand), dataType);
+        }
+    };
+
+    /** An Add, Sub or Mul of two scalar integers which detects overflow instead of wrapping around.  Its value is the
+     * result of operation unless that does not fit the operands' type, in which case overflow is evaluated instead
+     * and its value, if any, is the value of the CheckedBinary.  Typically overflow is a Return or Break, or a
+     * saturated value.  Overflow is expected to be rare, so testing for it costs little more than the operation. */
+    class CheckedBinary : public Expr {
+        const ChildPtr<const Expr> lValue_;
+        const OperationKind operation_;
+        const ChildPtr<const Expr> rValue_;
+        const ChildPtr<const Expr> overflow_;
+    public:
+        /** Note: assumes ownership of lValue, rValue and overflow. */
+        CheckedBinary(ChildPtr<const Expr> lValue,
+                      OperationKind operation,
+                      ChildPtr<const Expr> rValue,
+                      ChildPtr<const Expr> overflow)
+                : Expr{NodeKind::CheckedBinary}, lValue_{move(lValue)}, operation_{operation}, rValue_{move(rValue)},
+                  overflow_{move(overflow)} {
+            ARG_NOT_NULL(lValue_);
+            ARG_NOT_NULL(rValue_);
+            ARG_NOT_NULL(overflow_);
+        }
+
+        DataType dataType() const override { return rValue_->dataType(); }
+
+        const Expr *lValue() const { return lValue_.get(); }
+
+        OperationKind operation() const { return operation_; }
+
+        const Expr *rValue() const { return rValue_.get(); }
+
+        const Expr *overflow() const { return overflow_.get(); }
+
+        static std::unique_ptr<CheckedBinary> make(unique_ptr<const Expr> lValue,
+                                                   OperationKind operation,
+                                                   unique_ptr<const Expr> rValue,
+                                                   unique_ptr<const Expr> overflow) {
+            return std::make_unique<CheckedBinary>(move(lValue), operation, move(rValue), move(overflow));
+        }
+
+        static std::unique_ptr<CheckedBinary> make(AstContext &context,
+                                                   unique_ptr<const Expr> lValue,
+                                                   OperationKind operation,
+                                                   unique_ptr<const Expr> rValue,
+                                                   unique_ptr<const Expr> overflow) {
+            return context.make<CheckedBinary>(move(lValue), operation, move(rValue), move(overflow));
+        }
     };
 
 
     /** Defines a variable or a variable reference. */
+    /** A variable of type Pointer which is noAlias is like a restrict pointer in C:  for as long as it is in scope,
+     * memory accessed through it is not accessed through any pointer other than one derived from it.  This only
+     * affects code generation for function parameters. */
     class Variable {
-        const string name_;
+        const Symbol name_;
         const DataType dataType_;
+        const bool noAlias_;
 
     public:
-        Variable(const string &name_, const DataType dataType) : name_(name_), dataType_(dataType) { }
+        Variable(Symbol name, const DataType dataType, bool noAlias = false)
+                : name_(name), dataType_(dataType), noAlias_(noAlias) { }
+
+        /** Interns name in SymbolTable::global(). */
+        Variable(string_view name, const DataType dataType, bool noAlias = false)
+                : name_(SymbolTable::global().intern(name)), dataType_(dataType), noAlias_(noAlias) { }
 
         DataType dataType() const { return dataType_; }
 
-        string name() const { return name_;}
+        bool noAlias() const { return noAlias_; }
+
+        Symbol symbol() const { return name_; }
+
+        string_view name() const { return name_.str(); }
 
         string toString() const {
-            return name_ + ":" + to_string(dataType_);
+            return string(name_.str()) + ":" + to_string(dataType_) + (noAlias_ ? " noalias" : "");
         }
     };
 
     class VariableRef : public Expr {
         shared_ptr<const Variable> variable_;
     public:
-        VariableRef(shared_ptr<const Variable> variable) : variable_{variable} {
+        VariableRef(shared_ptr<const Variable> variable) : Expr{NodeKind::VariableRef}, variable_{variable} {
 
         }
 
-        NodeKind nodeKind() const override { return NodeKind::VariableRef; }
+        static std::unique_ptr<VariableRef> make(shared_ptr<const Variable> variable) {
+            return std::make_unique<VariableRef>(move(variable));
+        }
+
+        static std::unique_ptr<VariableRef> make(AstContext &context, shared_ptr<const Variable> variable) {
+            return context.make<VariableRef>(move(variable));
+        }
+
 
         DataType dataType() const override { return variable_->dataType(); }
 
-        string name() const { return variable_->name(); }
+        Symbol symbol() const { return variable_->symbol(); }
+
+        string_view name() const { return variable_->name(); }
+
+        const shared_ptr<const Variable> &variable() const { return variable_; }
 
         string toString() const {
-            return variable_->name() + ":" + to_string(variable_->dataType());
+            return variable_->toString();
         }
     };
 
     class AssignVariable : public Expr {
         shared_ptr<const Variable> variable_;  //Note:  variables are owned by llast::Scope.
-        const unique_ptr<const Expr> valueExpr_;
+        const ChildPtr<const Expr> valueExpr_;
     public:
-        AssignVariable(shared_ptr<const Variable> variable, unique_ptr<const Expr> valueExpr)
-                : variable_(variable), valueExpr_(move(valueExpr)) { }
+        AssignVariable(shared_ptr<const Variable> variable, ChildPtr<const Expr> valueExpr)
+                : Expr{NodeKind::AssignVariable}, variable_(variable), valueExpr_(move(valueExpr)) { }
 
-        NodeKind nodeKind() const override { return NodeKind::AssignVariable; }
         DataType dataType() const override { return variable_->dataType(); }
 
-        string name() const { return variable_->name(); }
+        Symbol symbol() const { return variable_->symbol(); }
+        string_view name() const { return variable_->name(); }
+        const shared_ptr<const Variable> &variable() const { return variable_; }
         const Expr* valueExpr() const { return valueExpr_.get(); }
 
         static std::unique_ptr<AssignVariable> make(shared_ptr<const Variable> variable,
@@ -217,14 +494,20 @@ namespace llast {
 
             return std::make_unique<AssignVariable>(move(variable), move(valueExpr));
         }
+
+        static std::unique_ptr<AssignVariable> make(AstContext &context,
+                                                    shared_ptr<const Variable> variable,
+                                                    unique_ptr<const Expr> valueExpr) {
+
+            return context.make<AssignVariable>(move(variable), move(valueExpr));
+        }
     };
 
     class Return : public Expr {
-        const unique_ptr<const Expr> valueExpr_;
+        const ChildPtr<const Expr> valueExpr_;
     public:
-        Return(unique_ptr<const Expr> valueExpr) : valueExpr_(move(valueExpr)) { }
+        Return(ChildPtr<const Expr> valueExpr) : Expr{NodeKind::Return}, valueExpr_(move(valueExpr)) { }
 
-        NodeKind nodeKind() const override { return NodeKind::Return; }
         DataType dataType() const override { return valueExpr_->dataType(); }
 
         const Expr* valueExpr() const { return valueExpr_.get(); }
@@ -232,70 +515,430 @@ namespace llast {
         static std::unique_ptr<Return> make(unique_ptr<const Expr> valueExpr) {
             return std::make_unique<Return>(move(valueExpr));
         }
+
+        static std::unique_ptr<Return> make(AstContext &context, unique_ptr<const Expr> valueExpr) {
+            return context.make<Return>(move(valueExpr));
+        }
+    };
+
+    /** Calls the Function named functionName with the values of arguments, which are passed by value.  The callee
+     * is not resolved until the tree is compiled, when it may be a function of the same Module or of a Module added
+     * previously, so the return type it is expected to have is part of the node. */
+    class Invoke : public Expr {
+        const Symbol functionName_;
+        const DataType returnType_;
+        const std::pmr::vector<ChildPtr<const Expr>> arguments_;
+    public:
+        /** Note:  assumes ownership of the contents of the vector argument. */
+        Invoke(Symbol functionName, DataType returnType, std::pmr::vector<ChildPtr<const Expr>> arguments)
+                : Expr{NodeKind::Invoke},
+                  functionName_{functionName},
+                  returnType_{returnType},
+                  arguments_{move(arguments)} { }
+
+        DataType dataType() const override { return returnType_; }
+
+        Symbol functionSymbol() const { return functionName_; }
+
+        string_view functionName() const { return functionName_.str(); }
+
+        size_t argumentCount() const { return arguments_.size(); }
+
+        const Expr *argument(size_t index) const { return arguments_[index].get(); }
+
+        template<typename TFunc>
+        void forEachArgument(TFunc func) const {
+            for(auto const &arg : arguments_) {
+                func(arg.get());
+            }
+        }
+
+        /** Interns functionName in SymbolTable::global(). */
+        static std::unique_ptr<Invoke> make(string_view functionName,
+                                            DataType returnType,
+                                            std::vector<unique_ptr<const Expr>> arguments) {
+            std::pmr::vector<ChildPtr<const Expr>> args;
+            for(auto &arg : arguments) {
+                args.emplace_back(move(arg));
+            }
+            return std::make_unique<Invoke>(SymbolTable::global().intern(functionName), returnType, move(args));
+        }
+
+        static std::unique_ptr<Invoke> make(AstContext &context,
+                                            string_view functionName,
+                                            DataType returnType,
+                                            std::vector<unique_ptr<const Expr>> arguments) {
+            std::pmr::vector<ChildPtr<const Expr>> args{context.resource()};
+            for(auto &arg : arguments) {
+                args.emplace_back(move(arg));
+            }
+            return context.make<Invoke>(context.intern(functionName), returnType, move(args));
+        }
+    };
+
+    /** Reads a value of type elementType from the address given by pointer, which must be a multiple of alignment.
+     * An alignment of 0 is the natural alignment of elementType. */
+    class Load : public Expr {
+        const DataType elementType_;
+        const unsigned alignment_;
+        const ChildPtr<const Expr> pointer_;
+    public:
+        Load(DataType elementType, ChildPtr<const Expr> pointer, unsigned alignment = 0)
+                : Expr{NodeKind::Load}, elementType_{elementType}, alignment_{alignment}, pointer_{move(pointer)} {
+            ARG_NOT_NULL(pointer_);
+        }
+
+        DataType dataType() const override { return elementType_; }
+
+        unsigned alignment() const { return alignment_; }
+
+        const Expr *pointer() const { return pointer_.get(); }
+
+        static std::unique_ptr<Load> make(DataType elementType,
+                                          unique_ptr<const Expr> pointer,
+                                          unsigned alignment = 0) {
+            return std::make_unique<Load>(elementType, move(pointer), alignment);
+        }
+
+        static std::unique_ptr<Load> make(AstContext &context,
+                                          DataType elementType,
+                                          unique_ptr<const Expr> pointer,
+                                          unsigned alignment = 0) {
+            return context.make<Load>(elementType, move(pointer), alignment);
+        }
     };
 
-    class Scope {
-        const std::unordered_map<string, shared_ptr<const Variable>> variables_;
+    /** Writes the value of valueExpr to the address given by pointer, which must be a multiple of alignment.  An
+     * alignment of 0 is the natural alignment of the value's type.  The value of a Store is the value written. */
+    class Store : public Expr {
+        const unsigned alignment_;
+        const ChildPtr<const Expr> pointer_;
+        const ChildPtr<const Expr> valueExpr_;
     public:
-        Scope(std::unordered_map<string, shared_ptr<const Variable>> variables)
-                : variables_{move(variables)} { }
+        Store(ChildPtr<const Expr> pointer, ChildPtr<const Expr> valueExpr, unsigned alignment = 0)
+                : Expr{NodeKind::Store}, alignment_{alignment}, pointer_{move(pointer)}, valueExpr_{move(valueExpr)} {
+            ARG_NOT_NULL(pointer_);
+            ARG_NOT_NULL(valueExpr_);
+        }
+
+        DataType dataType() const override { return valueExpr_->dataType(); }
+
+        unsigned alignment() const { return alignment_; }
+
+        const Expr *pointer() const { return pointer_.get(); }
+
+        const Expr *valueExpr() const { return valueExpr_.get(); }
+
+        static std::unique_ptr<Store> make(unique_ptr<const Expr> pointer,
+                                           unique_ptr<const Expr> valueExpr,
+                                           unsigned alignment = 0) {
+            return std::make_unique<Store>(move(pointer), move(valueExpr), alignment);
+        }
+
+        static std::unique_ptr<Store> make(AstContext &context,
+                                           unique_ptr<const Expr> pointer,
+                                           unique_ptr<const Expr> valueExpr,
+                                           unsigned alignment = 0) {
+            return context.make<Store>(move(pointer), move(valueExpr), alignment);
+        }
+    };
+
+    /** The address of element index (an Int32) of the array of elementType starting at pointer.  The address must
+     * lie within the same buffer as pointer, or just past its end. */
+    class Index : public Expr {
+        const DataType elementType_;
+        const ChildPtr<const Expr> pointer_;
+        const ChildPtr<const Expr> index_;
+    public:
+        Index(DataType elementType, ChildPtr<const Expr> pointer, ChildPtr<const Expr> index)
+                : Expr{NodeKind::Index}, elementType_{elementType}, pointer_{move(pointer)}, index_{move(index)} {
+            ARG_NOT_NULL(pointer_);
+            ARG_NOT_NULL(index_);
+        }
+
+        DataType dataType() const override { return DataType::Pointer; }
+
+        DataType elementType() const { return elementType_; }
+
+        const Expr *pointer() const { return pointer_.get(); }
+
+        const Expr *index() const { return index_.get(); }
+
+        static std::unique_ptr<Index> make(DataType elementType,
+                                           unique_ptr<const Expr> pointer,
+                                           unique_ptr<const Expr> index) {
+            return std::make_unique<Index>(elementType, move(pointer), move(index));
+        }
+
+        static std::unique_ptr<Index> make(AstContext &context,
+                                           DataType elementType,
+                                           unique_ptr<const Expr> pointer,
+                                           unique_ptr<const Expr> index) {
+            return context.make<Index>(elementType, move(pointer), move(index));
+        }
+    };
+
+    /** A vector of type vectorType with each lane set to the value of scalar. */
+    class Splat : public Expr {
+        const DataType vectorType_;
+        const ChildPtr<const Expr> scalar_;
+    public:
+        Splat(DataType vectorType, ChildPtr<const Expr> scalar)
+                : Expr{NodeKind::Splat}, vectorType_{vectorType}, scalar_{move(scalar)} {
+            ARG_NOT_NULL(scalar_);
+        }
+
+        DataType dataType() const override { return vectorType_; }
+
+        const Expr *scalar() const { return scalar_.get(); }
+
+        static std::unique_ptr<Splat> make(DataType vectorType, unique_ptr<const Expr> scalar) {
+            return std::make_unique<Splat>(vectorType, move(scalar));
+        }
+
+        static std::unique_ptr<Splat> make(AstContext &context, DataType vectorType, unique_ptr<const Expr> scalar) {
+            return context.make<Splat>(vectorType, move(scalar));
+        }
+    };
+
+    /** The value of lane number lane of vector. */
+    class ExtractLane : public Expr {
+        const unsigned lane_;
+        const ChildPtr<const Expr> vector_;
+    public:
+        ExtractLane(ChildPtr<const Expr> vector, unsigned lane)
+                : Expr{NodeKind::ExtractLane}, lane_{lane}, vector_{move(vector)} {
+            ARG_NOT_NULL(vector_);
+        }
+
+        DataType dataType() const override { return laneType(vector_->dataType()); }
+
+        unsigned lane() const { return lane_; }
+
+        const Expr *vector() const { return vector_.get(); }
+
+        static std::unique_ptr<ExtractLane> make(unique_ptr<const Expr> vector, unsigned lane) {
+            return std::make_unique<ExtractLane>(move(vector), lane);
+        }
+
+        static std::unique_ptr<ExtractLane> make(AstContext &context, unique_ptr<const Expr> vector, unsigned lane) {
+            return context.make<ExtractLane>(move(vector), lane);
+        }
+    };
+
+    /** A copy of vector with lane number lane replaced by the value of scalar. */
+    class InsertLane : public Expr {
+        const unsigned lane_;
+        const ChildPtr<const Expr> vector_;
+        const ChildPtr<const Expr> scalar_;
+    public:
+        InsertLane(ChildPtr<const Expr> vector, unsigned lane, ChildPtr<const Expr> scalar)
+                : Expr{NodeKind::InsertLane}, lane_{lane}, vector_{move(vector)}, scalar_{move(scalar)} {
+            ARG_NOT_NULL(vector_);
+            ARG_NOT_NULL(scalar_);
+        }
+
+        DataType dataType() const override { return vector_->dataType(); }
+
+        unsigned lane() const { return lane_; }
+
+        const Expr *vector() const { return vector_.get(); }
+
+        const Expr *scalar() const { return scalar_.get(); }
+
+        static std::unique_ptr<InsertLane> make(unique_ptr<const Expr> vector,
+                                                unsigned lane,
+                                                unique_ptr<const Expr> scalar) {
+            return std::make_unique<InsertLane>(move(vector), lane, move(scalar));
+        }
+
+        static std::unique_ptr<InsertLane> make(AstContext &context,
+                                                unique_ptr<const Expr> vector,
+                                                unsigned lane,
+                                                unique_ptr<const Expr> scalar) {
+            return context.make<InsertLane>(move(vector), lane, move(scalar));
+        }
+    };
+
+    /** Selects lanes from the concatenation of the lanes of first and second, which have the same vector type:  lane
+     * i of the result is lane mask[i] of the concatenation, so the result has as many lanes as the mask.  A mask may
+     * have at most MAX_LANES lanes, each less than 2 * MAX_LANES. */
+    class Shuffle : public Expr {
+        const std::pmr::vector<unsigned> mask_;
+        const ChildPtr<const Expr> first_;
+        const ChildPtr<const Expr> second_;
+    public:
+        Shuffle(ChildPtr<const Expr> first, ChildPtr<const Expr> second, std::pmr::vector<unsigned> mask)
+                : Expr{NodeKind::Shuffle}, mask_{move(mask)}, first_{move(first)}, second_{move(second)} {
+            ARG_NOT_NULL(first_);
+            ARG_NOT_NULL(second_);
+            if(mask_.size() > MAX_LANES) {
+                throw InvalidArgumentException("mask");
+            }
+            for(unsigned lane : mask_) {
+                if(lane >= 2 * MAX_LANES) {
+                    throw InvalidArgumentException("mask");
+                }
+            }
+        }
+
+        /** Void if there is no vector type with the mask's number of lanes. */
+        DataType dataType() const override {
+            return vectorType(laneType(first_->dataType()), static_cast<unsigned>(mask_.size()));
+        }
+
+        const std::pmr::vector<unsigned> &mask() const { return mask_; }
+
+        const Expr *first() const { return first_.get(); }
+
+        const Expr *second() const { return second_.get(); }
+
+        static std::unique_ptr<Shuffle> make(unique_ptr<const Expr> first,
+                                             unique_ptr<const Expr> second,
+                                             const std::vector<unsigned> &mask) {
+            return std::make_unique<Shuffle>(move(first), move(second),
+                                             std::pmr::vector<unsigned>{mask.begin(), mask.end()});
+        }
+
+        static std::unique_ptr<Shuffle> make(AstContext &context,
+                                             unique_ptr<const Expr> first,
+                                             unique_ptr<const Expr> second,
+                                             const std::vector<unsigned> &mask) {
+            return context.make<Shuffle>(move(first), move(second),
+                                         std::pmr::vector<unsigned>{mask.begin(), mask.end(), context.resource()});
+        }
+    };
+
+    /** Combines the lanes of vector into a single value of its lane type with operation, which must be Add, Mul, Min
+     * or Max.
+     * Lanes are combined pairwise, halving the width of the vector at each step, so Float lanes are not added in
+     * order from first to last. */
+    class Reduce : public Expr {
+        const OperationKind operation_;
+        const ChildPtr<const Expr> vector_;
+    public:
+        Reduce(OperationKind operation, ChildPtr<const Expr> vector)
+                : Expr{NodeKind::Reduce}, operation_{operation}, vector_{move(vector)} {
+            ARG_NOT_NULL(vector_);
+        }
+
+        DataType dataType() const override { return laneType(vector_->dataType()); }
+
+        OperationKind operation() const { return operation_; }
+
+        const Expr *vector() const { return vector_.get(); }
+
+        static std::unique_ptr<Reduce> make(OperationKind operation, unique_ptr<const Expr> vector) {
+            return std::make_unique<Reduce>(operation, move(vector));
+        }
+
+        static std::unique_ptr<Reduce> make(AstContext &context,
+                                            OperationKind operation,
+                                            unique_ptr<const Expr> vector) {
+            return context.make<Reduce>(operation, move(vector));
+        }
+    };
+
+    /** The variables declared by a Block or the parameters of a Function.  Each variable has a slot, which is its
+     * index in the order in which it was added to the ScopeBuilder. */
+    class Scope : public ArenaAllocatable {
+        const std::pmr::vector<shared_ptr<const Variable>> variables_;
+        const std::pmr::unordered_map<Symbol, size_t> slots_;
+    public:
+        Scope(std::pmr::vector<shared_ptr<const Variable>> variables, std::pmr::unordered_map<Symbol, size_t> slots)
+                : variables_{move(variables)}, slots_{move(slots)} { }
 
         virtual ~Scope() {}
 
-        const Variable *findVariable(string &name) const {
-            auto found = variables_.find(name);
-            if(found == variables_.end()) {
+        const Variable *findVariable(Symbol name) const {
+            int slot = findSlot(name);
+            if(slot < 0) {
                 return nullptr;
             }
-            return (*found).second.get();
+            return variables_[slot].get();
         }
 
+        /** Returns the slot of the variable with the specified name or -1 if there is no such variable. */
+        int findSlot(Symbol name) const {
+            auto found = slots_.find(name);
+            if(found == slots_.end()) {
+                return -1;
+            }
+            return static_cast<int>(found->second);
+        }
+
+        size_t size() const { return variables_.size(); }
+
+        const Variable *variable(size_t slot) const { return variables_[slot].get(); }
+
         std::vector<const Variable*> variables() const {
             std::vector<const Variable*> vars;
 
             for(auto &v : variables_) {
-                vars.push_back(v.second.get());
+                vars.push_back(v.get());
             }
 
             return vars;
         }
+
+        template<typename TFunc>
+        void forEachVariable(TFunc func) const {
+            for(auto &v : variables_) {
+                func(v);
+            }
+        }
     };
 
     class ScopeBuilder {
-        std::unordered_map<string, shared_ptr<const Variable>> variables_;
+        AstContext *context_;
+        std::pmr::vector<shared_ptr<const Variable>> variables_;
+        std::pmr::unordered_map<Symbol, size_t> slots_;
     public:
+        ScopeBuilder() : context_{nullptr} { }
+
+        /** The scope will be allocated in context. */
+        ScopeBuilder(AstContext &context)
+            : context_{&context}, variables_{context.resource()}, slots_{context.resource()} { }
 
+        /** Adds a variable to the scope unless a variable of the same name has already been added. */
         ScopeBuilder &addVariable(shared_ptr<const Variable> varDecl) {
-            variables_.emplace(varDecl->name(), varDecl);
+            if(slots_.emplace(varDecl->symbol(), variables_.size()).second) {
+                variables_.emplace_back(move(varDecl));
+            }
             return *this;
         }
 
         unique_ptr<const Scope> build() {
-            return make_unique<Scope>(move(variables_));
+            return makeIn<const Scope>(context_, move(variables_), move(slots_));
         }
     };
 
     /** Contains a series of expressions. */
     class Block : public Expr {
-        const std::vector<unique_ptr<const Expr>> expressions_;
-        unique_ptr<const Scope> scope_;
+        const std::pmr::vector<ChildPtr<const Expr>> expressions_;
+        ChildPtr<const Scope> scope_;
     public:
         virtual ~Block() {}
 
         /** Note:  assumes ownership of the contents of the vector arguments. */
-        Block(unique_ptr<const Scope> scope, std::vector<unique_ptr<const Expr>> expressions)
-                : expressions_{move(expressions)}, scope_{move(scope)} { }
+        Block(unique_ptr<const Scope> scope, std::pmr::vector<ChildPtr<const Expr>> expressions)
+                : Expr{NodeKind::Block}, expressions_{move(expressions)}, scope_{move(scope)} { }
 
-        NodeKind nodeKind() const override { return NodeKind::Block; }
 
-        /** The data type of a block expression is always the data type of the last expression in the block. */
+        /** The data type of a block expression is always the data type of the last expression in the block, or Void
+         * if the block is empty. */
         DataType dataType() const override {
-            return expressions_.back()->dataType();
+            return expressions_.empty() ? DataType::Void : expressions_.back()->dataType();
         }
 
         const Scope *scope() const { return scope_.get(); }
 
-        void forEach(std::function<void(const Expr*)> func) const {
+        size_t size() const { return expressions_.size(); }
+
+        const Expr *expression(size_t index) const { return expressions_[index].get(); }
+
+        template<typename TFunc>
+        void forEach(TFunc func) const {
             for(auto const &expr : expressions_) {
                 func(expr.get());
             }
@@ -304,9 +947,16 @@ namespace llast {
 
     /** Helper class which makes creating Block expression instances much easier. */
     class BlockBuilder {
-        std::vector<unique_ptr<const Expr>> expressions_;
+        AstContext *context_;
+        std::pmr::vector<ChildPtr<const Expr>> expressions_;
         ScopeBuilder scopeBuilder_;
     public:
+        BlockBuilder() : context_{nullptr} { }
+
+        /** The block and its scope will be allocated in context. */
+        BlockBuilder(AstContext &context)
+            : context_{&context}, expressions_{context.resource()}, scopeBuilder_{context} { }
+
         virtual ~BlockBuilder() {
         }
 
@@ -315,38 +965,39 @@ namespace llast {
             return *this;
         }
 
-        BlockBuilder &addExpression(unique_ptr<const Expr> newExpr) {
+        BlockBuilder &addExpression(ChildPtr<const Expr> newExpr) {
             expressions_.emplace_back(move(newExpr));
             return *this;
         }
 
         unique_ptr<const Block> build() {
-            return make_unique<const Block>(scopeBuilder_.build(), move(expressions_));
+            return makeIn<const Block>(context_, scopeBuilder_.build(), move(expressions_));
         }
     };
 
 
     /** Can be the basis of an if-then-else or ternary operator. */
     class Conditional : public Expr {
-        unique_ptr<const Expr> condition_;
-        unique_ptr<const Expr> truePart_;
-        unique_ptr<const Expr> falsePart_;
+        ChildPtr<const Expr> condition_;
+        ChildPtr<const Expr> truePart_;
+        ChildPtr<const Expr> falsePart_;
+        const BranchHint branchHint_;
     public:
 
         /** Note:  assumes ownership of condition, truePart and falsePart.  */
-        Conditional(unique_ptr<const Expr> condition,
-                    unique_ptr<const Expr> truePart,
-                    unique_ptr<const Expr> falsePart)
-                : condition_{move(condition)},
+        Conditional(ChildPtr<const Expr> condition,
+                    ChildPtr<const Expr> truePart,
+                    ChildPtr<const Expr> falsePart,
+                    BranchHint branchHint = BranchHint::None)
+                : Expr{NodeKind::Conditional},
+                  condition_{move(condition)},
                   truePart_{move(truePart)},
-                  falsePart_{move(falsePart)}
+                  falsePart_{move(falsePart)},
+                  branchHint_{branchHint}
         {
             ARG_NOT_NULL(condition_);
         }
 
-        NodeKind nodeKind() const override {
-            return NodeKind::Conditional;
-        }
 
         DataType dataType() const override {
             if(truePart_ != nullptr) {
@@ -371,28 +1022,348 @@ namespace llast {
         const Expr *falsePart() const {
             return falsePart_.get();
         }
+
+        /** A hint given by the author, which the compiler uses to lay out the branch.  A Conditional without a hint
+         * whose parts are cheap and have no side effects may be compiled without a branch at all. */
+        BranchHint branchHint() const {
+            return branchHint_;
+        }
+
+        static std::unique_ptr<Conditional> make(unique_ptr<const Expr> condition,
+                                                 unique_ptr<const Expr> truePart,
+                                                 unique_ptr<const Expr> falsePart,
+                                                 BranchHint branchHint = BranchHint::None) {
+
+            return std::make_unique<Conditional>(move(condition), move(truePart), move(falsePart), branchHint);
+        }
+
+        static std::unique_ptr<Conditional> make(AstContext &context,
+                                                 unique_ptr<const Expr> condition,
+                                                 unique_ptr<const Expr> truePart,
+                                                 unique_ptr<const Expr> falsePart,
+                                                 BranchHint branchHint = BranchHint::None) {
+
+            return context.make<Conditional>(move(condition), move(truePart), move(falsePart), branchHint);
+        }
+    };
+
+    /** Evaluates the case whose value equals discriminant, which must be an Int32, or else defaultCase, which may be
+     * absent.  The case values must be distinct.  As for a Conditional, the value of a Switch is the value of the
+     * part evaluated, undefined if none is, and its type is that of the first case, or of defaultCase if there are
+     * no cases. */
+    class Switch : public Expr {
+        ChildPtr<const Expr> discriminant_;
+        const std::pmr::vector<int32_t> caseValues_;
+        const std::pmr::vector<ChildPtr<const Expr>> cases_;
+        ChildPtr<const Expr> defaultCase_;
+    public:
+        /** Note:  assumes ownership of discriminant, defaultCase and the contents of cases. */
+        Switch(ChildPtr<const Expr> discriminant,
+               std::pmr::vector<int32_t> caseValues,
+               std::pmr::vector<ChildPtr<const Expr>> cases,
+               ChildPtr<const Expr> defaultCase)
+                : Expr{NodeKind::Switch},
+                  discriminant_{move(discriminant)},
+                  caseValues_{move(caseValues)},
+                  cases_{move(cases)},
+                  defaultCase_{move(defaultCase)} {
+            ARG_NOT_NULL(discriminant_);
+            if(caseValues_.size() != cases_.size()) {
+                throw InvalidArgumentException("cases");
+            }
+            for(auto &caseExpr : cases_) {
+                ARG_NOT_NULL(caseExpr);
+            }
+            std::vector<int32_t> sorted{caseValues_.begin(), caseValues_.end()};
+            std::sort(sorted.begin(), sorted.end());
+            if(std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) {
+                throw InvalidArgumentException("caseValues");
+            }
+        }
+
+        DataType dataType() const override {
+            if(!cases_.empty()) {
+                return cases_.front()->dataType();
+            }
+            return defaultCase_ ? defaultCase_->dataType() : DataType::Void;
+        }
+
+        const Expr *discriminant() const { return discriminant_.get(); }
+
+        size_t caseCount() const { return cases_.size(); }
+
+        int32_t caseValue(size_t index) const { return caseValues_[index]; }
+
+        const std::pmr::vector<int32_t> &caseValues() const { return caseValues_; }
+
+        const Expr *caseExpr(size_t index) const { return cases_[index].get(); }
+
+        const Expr *defaultCase() const { return defaultCase_.get(); }
+
+        static std::unique_ptr<Switch> make(unique_ptr<const Expr> discriminant,
+                                            const std::vector<int32_t> &caseValues,
+                                            std::vector<unique_ptr<const Expr>> cases,
+                                            unique_ptr<const Expr> defaultCase) {
+            std::pmr::vector<ChildPtr<const Expr>> caseExprs;
+            for(auto &caseExpr : cases) {
+                caseExprs.emplace_back(move(caseExpr));
+            }
+            return std::make_unique<Switch>(move(discriminant),
+                                            std::pmr::vector<int32_t>{caseValues.begin(), caseValues.end()},
+                                            move(caseExprs),
+                                            move(defaultCase));
+        }
+
+        static std::unique_ptr<Switch> make(AstContext &context,
+                                            unique_ptr<const Expr> discriminant,
+                                            const std::vector<int32_t> &caseValues,
+                                            std::vector<unique_ptr<const Expr>> cases,
+                                            unique_ptr<const Expr> defaultCase) {
+            std::pmr::vector<ChildPtr<const Expr>> caseExprs{context.resource()};
+            for(auto &caseExpr : cases) {
+                caseExprs.emplace_back(move(caseExpr));
+            }
+            return context.make<Switch>(move(discriminant),
+                                        std::pmr::vector<int32_t>{caseValues.begin(), caseValues.end(),
+                                                                  context.resource()},
+                                        move(caseExprs),
+                                        move(defaultCase));
+        }
+    };
+
+    /** Evaluates body for as long as condition is non-zero.  The value of a loop is Void. */
+    class While : public Expr {
+        ChildPtr<const Expr> condition_;
+        ChildPtr<const Expr> body_;
+    public:
+        While(ChildPtr<const Expr> condition, ChildPtr<const Expr> body)
+                : Expr{NodeKind::While}, condition_{move(condition)}, body_{move(body)} {
+            ARG_NOT_NULL(condition_);
+            ARG_NOT_NULL(body_);
+        }
+
+        const Expr *condition() const { return condition_.get(); }
+
+        const Expr *body() const { return body_.get(); }
+
+        static std::unique_ptr<While> make(unique_ptr<const Expr> condition, unique_ptr<const Expr> body) {
+            return std::make_unique<While>(move(condition), move(body));
+        }
+
+        static std::unique_ptr<While> make(AstContext &context,
+                                           unique_ptr<const Expr> condition,
+                                           unique_ptr<const Expr> body) {
+            return context.make<While>(move(condition), move(body));
+        }
+    };
+
+    /** Evaluates init once, then body followed by update for as long as condition is non-zero.  init, condition and
+     * update are optional; a loop without a condition repeats until it is left with a Break or a Return.  Continue
+     * proceeds with update.  The value of a loop is Void.
+     *
+     * Note:  the parts are walked in the order they are evaluated the first time around the loop, which is init,
+     * condition, body and then update. */
+    class For : public Expr {
+        ChildPtr<const Expr> init_;
+        ChildPtr<const Expr> condition_;
+        ChildPtr<const Expr> update_;
+        ChildPtr<const Expr> body_;
+    public:
+        For(ChildPtr<const Expr> init,
+            ChildPtr<const Expr> condition,
+            ChildPtr<const Expr> update,
+            ChildPtr<const Expr> body)
+                : Expr{NodeKind::For},
+                  init_{move(init)},
+                  condition_{move(condition)},
+                  update_{move(update)},
+                  body_{move(body)} {
+            ARG_NOT_NULL(body_);
+        }
+
+        const Expr *init() const { return init_.get(); }
+
+        const Expr *condition() const { return condition_.get(); }
+
+        const Expr *update() const { return update_.get(); }
+
+        const Expr *body() const { return body_.get(); }
+
+        static std::unique_ptr<For> make(unique_ptr<const Expr> init,
+                                         unique_ptr<const Expr> condition,
+                                         unique_ptr<const Expr> update,
+                                         unique_ptr<const Expr> body) {
+            return std::make_unique<For>(move(init), move(condition), move(update), move(body));
+        }
+
+        static std::unique_ptr<For> make(AstContext &context,
+                                         unique_ptr<const Expr> init,
+                                         unique_ptr<const Expr> condition,
+                                         unique_ptr<const Expr> update,
+                                         unique_ptr<const Expr> body) {
+            return context.make<For>(move(init), move(condition), move(update), move(body));
+        }
+    };
+
+    /** Evaluates body once for each value of the Int32 variable index from 0 to count - 1 and writes each value to
+     * element index of the array of body's type at output, as if by (store 0 (index TYPE output index) body).  Unlike
+     * a For, the iterations must be independent of each other, so that they may be executed in SIMD lanes:  no
+     * iteration may read an element which another writes, and no variable may be assigned in one iteration and read
+     * in a later one.  body may not Break or Continue out of the Map.  index is left with the value max(count, 0)
+     * and the value of a Map is Void. */
+    class Map : public Expr {
+        shared_ptr<const Variable> index_;  //Note:  variables are owned by llast::Scope.
+        ChildPtr<const Expr> output_;
+        ChildPtr<const Expr> count_;
+        ChildPtr<const Expr> body_;
+    public:
+        Map(shared_ptr<const Variable> index,
+            ChildPtr<const Expr> output,
+            ChildPtr<const Expr> count,
+            ChildPtr<const Expr> body)
+                : Expr{NodeKind::Map},
+                  index_{move(index)},
+                  output_{move(output)},
+                  count_{move(count)},
+                  body_{move(body)} {
+            ARG_NOT_NULL(index_);
+            ARG_NOT_NULL(output_);
+            ARG_NOT_NULL(count_);
+            ARG_NOT_NULL(body_);
+        }
+
+        const shared_ptr<const Variable> &index() const { return index_; }
+
+        Symbol indexSymbol() const { return index_->symbol(); }
+
+        const Expr *output() const { return output_.get(); }
+
+        const Expr *count() const { return count_.get(); }
+
+        const Expr *body() const { return body_.get(); }
+
+        static std::unique_ptr<Map> make(shared_ptr<const Variable> index,
+                                         unique_ptr<const Expr> output,
+                                         unique_ptr<const Expr> count,
+                                         unique_ptr<const Expr> body) {
+            return std::make_unique<Map>(move(index), move(output), move(count), move(body));
+        }
+
+        static std::unique_ptr<Map> make(AstContext &context,
+                                         shared_ptr<const Variable> index,
+                                         unique_ptr<const Expr> output,
+                                         unique_ptr<const Expr> count,
+                                         unique_ptr<const Expr> body) {
+            return context.make<Map>(move(index), move(output), move(count), move(body));
+        }
+    };
+
+    /** Combines the values of body for each value of the Int32 variable index from 0 to count - 1 with operation,
+     * which must be Add, Mul, Min or Max, i.e. a sum when operation is Add.  The iterations must be independent as
+     * for a Map, and the values may be combined in any order, so a Float sum may differ from a sequential one in
+     * its rounding.  If count is not positive the value is the identity of operation, i.e. 0 for Add or the largest
+     * value of the type for Min.  index is left with the value max(count, 0). */
+    class Fold : public Expr {
+        const OperationKind operation_;
+        shared_ptr<const Variable> index_;  //Note:  variables are owned by llast::Scope.
+        ChildPtr<const Expr> count_;
+        ChildPtr<const Expr> body_;
+    public:
+        Fold(OperationKind operation,
+             shared_ptr<const Variable> index,
+             ChildPtr<const Expr> count,
+             ChildPtr<const Expr> body)
+                : Expr{NodeKind::Fold},
+                  operation_{operation},
+                  index_{move(index)},
+                  count_{move(count)},
+                  body_{move(body)} {
+            ARG_NOT_NULL(index_);
+            ARG_NOT_NULL(count_);
+            ARG_NOT_NULL(body_);
+        }
+
+        DataType dataType() const override { return body_->dataType(); }
+
+        OperationKind operation() const { return operation_; }
+
+        const shared_ptr<const Variable> &index() const { return index_; }
+
+        Symbol indexSymbol() const { return index_->symbol(); }
+
+        const Expr *count() const { return count_.get(); }
+
+        const Expr *body() const { return body_.get(); }
+
+        static std::unique_ptr<Fold> make(OperationKind operation,
+                                          shared_ptr<const Variable> index,
+                                          unique_ptr<const Expr> count,
+                                          unique_ptr<const Expr> body) {
+            return std::make_unique<Fold>(operation, move(index), move(count), move(body));
+        }
+
+        static std::unique_ptr<Fold> make(AstContext &context,
+                                          OperationKind operation,
+                                          shared_ptr<const Variable> index,
+                                          unique_ptr<const Expr> count,
+                                          unique_ptr<const Expr> body) {
+            return context.make<Fold>(operation, move(index), move(count), move(body));
+        }
+    };
+
+    /** Leaves the innermost enclosing While or For. */
+    class Break : public Expr {
+    public:
+        Break() : Expr{NodeKind::Break} { }
+
+        static std::unique_ptr<Break> make() {
+            return std::make_unique<Break>();
+        }
+
+        static std::unique_ptr<Break> make(AstContext &context) {
+            return context.make<Break>();
+        }
+    };
+
+    /** Proceeds with the next iteration of the innermost enclosing While or For. */
+    class Continue : public Expr {
+    public:
+        Continue() : Expr{NodeKind::Continue} { }
+
+        static std::unique_ptr<Continue> make() {
+            return std::make_unique<Continue>();
+        }
+
+        static std::unique_ptr<Continue> make(AstContext &context) {
+            return context.make<Continue>();
+        }
     };
 
     class Function : public Node {
-        const string name_;
+        const Symbol name_;
         const DataType returnType_;
-        unique_ptr<const Scope> parameterScope_;
-        unique_ptr<const Expr> body_;
+        ChildPtr<const Scope> parameterScope_;
+        ChildPtr<const Expr> body_;
+        const FloatSemantics floatSemantics_;
 
     public:
-        Function(string name,
+        Function(Symbol name,
                  DataType returnType,
                  unique_ptr<const Scope> parameterScope,
-                 unique_ptr<const Expr> body)
-                : name_{name},
+                 ChildPtr<const Expr> body,
+                 FloatSemantics floatSemantics = FloatSemantics::Strict)
+                : Node{NodeKind::Function},
+                  name_{name},
                   returnType_{returnType},
                   parameterScope_{move(parameterScope)},
-                  body_{move(body)} {
+                  body_{move(body)},
+                  floatSemantics_{floatSemantics} {
         }
 
-        NodeKind nodeKind() const override { return NodeKind::Function; }
 
-        string name() const { return name_; }
+        Symbol symbol() const { return name_; }
+
+        string_view name() const { return name_.str(); }
 
         DataType returnType() const { return returnType_; }
 
@@ -400,17 +1371,33 @@ namespace llast {
 
         const Expr *body() const { return body_.get(); }
 
+        /** How strictly the floating point operations of the body are compiled. */
+        FloatSemantics floatSemantics() const { return floatSemantics_; }
     };
 
     class FunctionBuilder {
-        const string name_;
+        AstContext *context_;
+        const Symbol name_;
         const DataType returnType_;
+        FloatSemantics floatSemantics_ = FloatSemantics::Strict;
 
         BlockBuilder blockBuilder_;
         ScopeBuilder parameterScopeBuilder_;
     public:
-        FunctionBuilder(string name, DataType returnType)
-            : name_{name}, returnType_{returnType} { }
+        FunctionBuilder(Symbol name, DataType returnType)
+            : context_{nullptr}, name_{name}, returnType_{returnType} { }
+
+        /** Interns name in SymbolTable::global(). */
+        FunctionBuilder(string_view name, DataType returnType)
+            : FunctionBuilder(SymbolTable::global().intern(name), returnType) { }
+
+        /** The function, its parameter scope and its body will be allocated in context. */
+        FunctionBuilder(AstContext &context, string_view name, DataType returnType)
+            : context_{&context},
+              name_{context.intern(name)},
+              returnType_{returnType},
+              blockBuilder_{context},
+              parameterScopeBuilder_{context} { }
 
         BlockBuilder &blockBuilder() {
             return blockBuilder_;
@@ -422,26 +1409,39 @@ namespace llast {
             return *this;
         };
 
+        FunctionBuilder &setFloatSemantics(FloatSemantics floatSemantics) {
+            floatSemantics_ = floatSemantics;
+            return *this;
+        }
+
         unique_ptr<const Function> build() {
-            return make_unique<Function>(name_,
+            return makeIn<const Function>(context_,
+                                         name_,
                                          returnType_,
                                          parameterScopeBuilder_.build(),
-                                         blockBuilder_.build());
+                                         blockBuilder_.build(),
+                                         floatSemantics_);
         }
     };
 
     class Module : public Node {
-        const string name_;
-        const std::vector<unique_ptr<const Function>> functions_;
+        const Symbol name_;
+        const std::pmr::vector<ChildPtr<const Function>> functions_;
     public:
-        Module(string name, std::vector<unique_ptr<const Function>> functions)
-             : name_{name}, functions_{move(functions)}  { }
+        Module(Symbol name, std::pmr::vector<ChildPtr<const Function>> functions)
+             : Node{NodeKind::Module}, name_{name}, functions_{move(functions)}  { }
+
+
+        Symbol symbol() const { return name_; }
 
-        NodeKind nodeKind() const override { return NodeKind::Module; }
+        string_view name() const { return name_.str(); }
 
-        string name() const { return name_; }
+        size_t functionCount() const { return functions_.size(); }
 
-        void forEachFunction(std::function<void(const Function *)> func) const {
+        const Function *function(size_t index) const { return functions_[index].get(); }
+
+        template<typename TFunc>
+        void forEachFunction(TFunc func) const {
             for(const auto &f : functions_) {
                 func(f.get());
             }
@@ -449,14 +1449,25 @@ namespace llast {
     };
 
     class ModuleBuilder {
-        const string name_;
-        std::vector<unique_ptr<const Function>> functions_;
+        AstContext *context_;
+        const Symbol name_;
+        std::pmr::vector<ChildPtr<const Function>> functions_;
     public:
-        ModuleBuilder(string name)
-            : name_{name}
+        ModuleBuilder(Symbol name)
+            : context_{nullptr}, name_{name}
+        { }
+
+        /** Interns name in SymbolTable::global(). */
+        ModuleBuilder(string_view name)
+            : ModuleBuilder(SymbolTable::global().intern(name))
+        { }
+
+        /** The module will be allocated in context. */
+        ModuleBuilder(AstContext &context, string_view name)
+            : context_{&context}, name_{context.intern(name)}, functions_{context.resource()}
         { }
 
-        ModuleBuilder &addFunction(unique_ptr<const Function> function) {
+        ModuleBuilder &addFunction(ChildPtr<const Function> function) {
             functions_.emplace_back(move(function));
             return *this;
         }
@@ -467,7 +1478,7 @@ namespace llast {
         }
 
         unique_ptr<const Module> build() {
-            return make_unique<const Module>(name_, move(functions_));
+            return makeIn<const Module>(context_, name_, move(functions_));
         }
     };
 }
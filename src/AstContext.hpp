@@ -0,0 +1,116 @@
+#pragma once
+
+#include "Symbol.hpp"
+
+#include <memory>
+#include <memory_resource>
+#include <cstddef>
+
+namespace llast {
+
+    class Variable;
+    enum class DataType;
+
+    /** Base class for objects owned by an AST (nodes and scopes).  Such objects are allocated either individually on
+     * the heap (when created with new or std::make_unique) or in the arena of an AstContext.  A small header
+     * preceding each object records which. */
+    class ArenaAllocatable {
+    public:
+        enum class Allocation : unsigned char {
+            Heap,
+            Arena
+        };
+
+        /** The size of the header which precedes every object.  This preserves the alignment of the object. */
+        static constexpr size_t HEADER_SIZE = alignof(std::max_align_t);
+
+        virtual ~ArenaAllocatable() { }
+
+        /** Defined out of line, as is operator delete, so that the compiler cannot inline the global allocation
+         * functions into callers and then mistake the offset pointer for a mismatched new and delete. */
+        static void *operator new(size_t size);
+
+        /** Objects allocated in an AstContext are freed with the context, so deleting one only runs its destructor. */
+        static void operator delete(void *object);
+
+        static Allocation allocationOf(const void *object) {
+            return *reinterpret_cast<const Allocation*>(static_cast<const unsigned char*>(object) - HEADER_SIZE);
+        }
+
+        static void *initializeHeader(void *memory, Allocation allocation) {
+            *static_cast<Allocation*>(memory) = allocation;
+            return static_cast<unsigned char*>(memory) + HEADER_SIZE;
+        }
+    };
+
+    /** Used by every pointer from a node to an object it owns.  Objects in an AstContext are not destroyed
+     * individually, which is what makes freeing an arena-allocated tree a single operation regardless of its size
+     * or depth.  Heap-allocated objects are destroyed iteratively:  objects released while another is being
+     * destroyed are queued and destroyed by the outermost call, so destroying a deep tree does not recurse. */
+    struct ChildDeleter {
+        ChildDeleter() { }
+
+        /** Allows std::unique_ptr<T> to be converted to ChildPtr<T>. */
+        template<typename T>
+        ChildDeleter(const std::default_delete<T> &) { }
+
+        template<typename T>
+        void operator()(T *object) const {
+            if(ArenaAllocatable::allocationOf(object) == ArenaAllocatable::Allocation::Heap) {
+                destroy(object);
+            }
+        }
+
+    private:
+        static void destroy(const ArenaAllocatable *object);
+    };
+
+    template<typename T>
+    using ChildPtr = std::unique_ptr<T, ChildDeleter>;
+
+    /** Owns an arena from which nodes, scopes and variables may be allocated, and the SymbolTable for their names.
+     *
+     * Nodes created by AstContext::make, by the make factories and by builders which were given a context are
+     * allocated contiguously in the arena.  All of them are freed at once when the context is destroyed; destroying
+     * the std::unique_ptr returned for the root of such a tree runs the destructor of the root alone.  The context
+     * must therefore outlive every tree and variable allocated in it.
+     *
+     * Heap-allocated and arena-allocated nodes may be mixed, but a heap-allocated node or variable referenced from an
+     * arena-allocated node is never freed, so trees built in a context should be built from it entirely.
+     */
+    class AstContext {
+        std::pmr::monotonic_buffer_resource resource_;
+        SymbolTable symbols_;
+    public:
+        AstContext(size_t initialSize = 64 * 1024) : resource_{initialSize} { }
+        AstContext(const AstContext &) = delete;
+        AstContext &operator=(const AstContext &) = delete;
+
+        SymbolTable &symbols() { return symbols_; }
+
+        Symbol intern(std::string_view text) { return symbols_.intern(text); }
+
+        std::pmr::memory_resource *resource() { return &resource_; }
+
+        template<typename T, typename... Args>
+        std::unique_ptr<T> make(Args&&... args) {
+            void *memory = resource_.allocate(sizeof(T) + ArenaAllocatable::HEADER_SIZE, ArenaAllocatable::HEADER_SIZE);
+            memory = ArenaAllocatable::initializeHeader(memory, ArenaAllocatable::Allocation::Arena);
+            return std::unique_ptr<T>(::new (memory) T(std::forward<Args>(args)...));
+        }
+
+        std::shared_ptr<const Variable> makeVariable(std::string_view name, DataType dataType, bool noAlias = false);
+
+        /** name must have been interned in this context. */
+        std::shared_ptr<const Variable> makeVariable(Symbol name, DataType dataType, bool noAlias = false);
+    };
+
+    /** Allocates a T in context or, when context is null, on the heap. */
+    template<typename T, typename... Args>
+    std::unique_ptr<T> makeIn(AstContext *context, Args&&... args) {
+        if(context) {
+            return context->make<T>(std::forward<Args>(args)...);
+        }
+        return std::make_unique<T>(std::forward<Args>(args)...);
+    }
+}
@@ -0,0 +1,850 @@
+
+#include "BinaryAst.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace llast {
+
+    namespace {
+        const uint8_t MAGIC[4] = { 'L', 'L', 'A', 'B' };
+        const size_t HEADER_SIZE = 32;
+
+        void writeVarint(std::vector<uint8_t> &out, uint64_t value) {
+            while(value >= 0x80) {
+                out.push_back(static_cast<uint8_t>(value | 0x80));
+                value >>= 7;
+            }
+            out.push_back(static_cast<uint8_t>(value));
+        }
+
+        void writeUInt32At(std::vector<uint8_t> &out, size_t position, uint32_t value) {
+            for(int i = 0; i < 4; ++i) {
+                out[position + i] = static_cast<uint8_t>(value >> (8 * i));
+            }
+        }
+
+        uint32_t checkedOffset(size_t offset) {
+            if(offset > UINT32_MAX) {
+                throw InvalidStateException("Tree is too large for the binary format.");
+            }
+            return static_cast<uint32_t>(offset);
+        }
+
+        uint32_t readUInt32At(const uint8_t *data, size_t position) {
+            uint32_t value = 0;
+            for(int i = 0; i < 4; ++i) {
+                value |= static_cast<uint32_t>(data[position + i]) << (8 * i);
+            }
+            return value;
+        }
+
+        const uint8_t NO_ALIAS = 0x80;
+        const uint8_t LAST_DATA_TYPE = static_cast<uint8_t>(DataType::UInt64);
+        const uint8_t LAST_OPERATION = static_cast<uint8_t>(OperationKind::Or);
+
+        /** The number of children of nodes of each kind, except Invoke, Block, Module and Switch, whose count is
+         * stored. */
+        uint32_t fixedChildCount(NodeKind kind, size_t offset) {
+            switch(kind) {
+                case NodeKind::LiteralInt32:
+                case NodeKind::LiteralFloat:
+                case NodeKind::LiteralInt64:
+                case NodeKind::LiteralDouble:
+                case NodeKind::VariableRef:
+                case NodeKind::Break:
+                case NodeKind::Continue:
+                    return 0;
+                case NodeKind::AssignVariable:
+                case NodeKind::Return:
+                case NodeKind::Not:
+                case NodeKind::Convert:
+                case NodeKind::Function:
+                case NodeKind::Load:
+                case NodeKind::Splat:
+                case NodeKind::ExtractLane:
+                case NodeKind::Reduce:
+                    return 1;
+                case NodeKind::Binary:
+                case NodeKind::While:
+                case NodeKind::Store:
+                case NodeKind::Index:
+                case NodeKind::InsertLane:
+                case NodeKind::Shuffle:
+                case NodeKind::Fold:
+                    return 2;
+                case NodeKind::Conditional:
+                case NodeKind::Map:
+                case NodeKind::CheckedBinary:
+                    return 3;
+                case NodeKind::For:
+                    return 4;
+                default:
+                    throw FormatException("Unknown node kind", offset);
+            }
+        }
+    }
+
+    std::vector<uint8_t> BinaryAstWriter::write(const Module *module) {
+        return write(FlatAst::fromModule(module));
+    }
+
+    std::vector<uint8_t> BinaryAstWriter::write(const Expr *expr) {
+        return write(FlatAst::fromExpr(expr));
+    }
+
+    std::vector<uint8_t> BinaryAstWriter::write(const FlatAst &ast) {
+        std::vector<uint8_t> out(HEADER_SIZE, 0);
+
+        std::vector<Symbol> strings;
+        std::unordered_map<Symbol, uint32_t> stringIndexes;
+        auto stringIndex = [&](Symbol name) {
+            auto inserted = stringIndexes.emplace(name, static_cast<uint32_t>(strings.size()));
+            if(inserted.second) {
+                strings.push_back(name);
+            }
+            return inserted.first->second;
+        };
+
+        std::unordered_map<const Variable*, uint32_t> variableIndexes;
+        for(const auto &variable : ast.variables()) {
+            stringIndex(variable->symbol());
+            variableIndexes.emplace(variable.get(), static_cast<uint32_t>(variableIndexes.size()));
+        }
+        for(FlatAst::Index node = 0; node < ast.size(); ++node) {
+            NodeKind kind = ast.kind(node);
+            if(kind == NodeKind::Invoke || kind == NodeKind::Function || kind == NodeKind::Module) {
+                stringIndex(ast.name(node));
+            }
+        }
+
+        size_t stringsOffset = out.size();
+        writeVarint(out, strings.size());
+        for(Symbol name : strings) {
+            writeVarint(out, name.str().size());
+            out.insert(out.end(), name.str().begin(), name.str().end());
+        }
+
+        size_t variablesOffset = out.size();
+        writeVarint(out, ast.variables().size());
+        for(const auto &variable : ast.variables()) {
+            writeVarint(out, stringIndex(variable->symbol()));
+            out.push_back(static_cast<uint8_t>(variable->dataType()) | (variable->noAlias() ? NO_ALIAS : 0));
+        }
+
+        size_t scopesOffset = out.size();
+        writeVarint(out, ast.scopeCount());
+        for(uint32_t scope = 0; scope < ast.scopeCount(); ++scope) {
+            writeVarint(out, ast.scopeSize(scope));
+            for(uint32_t slot = 0; slot < ast.scopeSize(scope); ++slot) {
+                writeVarint(out, variableIndexes[ast.scopeVariable(scope, slot)]);
+            }
+        }
+
+        size_t nodesOffset = out.size();
+        std::vector<size_t> offsets(ast.size());
+        for(FlatAst::Index node = 0; node < ast.size(); ++node) {
+            offsets[node] = out.size();
+            NodeKind kind = ast.kind(node);
+            out.push_back(static_cast<uint8_t>(kind));
+            out.push_back(static_cast<uint8_t>(ast.dataType(node)));
+
+            switch(kind) {
+                case NodeKind::LiteralInt32: {
+                    int32_t value = ast.int32Value(node);
+                    writeVarint(out, (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31));
+                    break;
+                }
+                case NodeKind::LiteralFloat: {
+                    uint32_t bits = static_cast<uint32_t>(ast.payload(node));
+                    for(int i = 0; i < 4; ++i) {
+                        out.push_back(static_cast<uint8_t>(bits >> (8 * i)));
+                    }
+                    break;
+                }
+                case NodeKind::LiteralInt64: {
+                    int64_t value = ast.int64Value(node);
+                    writeVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+                    break;
+                }
+                case NodeKind::LiteralDouble:
+                    for(int i = 0; i < 8; ++i) {
+                        out.push_back(static_cast<uint8_t>(ast.payload(node) >> (8 * i)));
+                    }
+                    break;
+                case NodeKind::Binary:
+                case NodeKind::CheckedBinary:
+                case NodeKind::Reduce:
+                    out.push_back(static_cast<uint8_t>(ast.operation(node)));
+                    break;
+                case NodeKind::VariableRef:
+                case NodeKind::AssignVariable:
+                case NodeKind::Map:
+                    writeVarint(out, variableIndexes[ast.variable(node)]);
+                    break;
+                case NodeKind::Fold:
+                    out.push_back(static_cast<uint8_t>(ast.operation(node)));
+                    writeVarint(out, variableIndexes[ast.variable(node)]);
+                    break;
+                case NodeKind::Block:
+                    writeVarint(out, ast.scopeOf(node));
+                    writeVarint(out, ast.childCount(node));
+                    break;
+                case NodeKind::Function:
+                    writeVarint(out, stringIndex(ast.name(node)));
+                    writeVarint(out, ast.scopeOf(node));
+                    out.push_back(static_cast<uint8_t>(ast.floatSemantics(node)));
+                    break;
+                case NodeKind::Invoke:
+                case NodeKind::Module:
+                    writeVarint(out, stringIndex(ast.name(node)));
+                    writeVarint(out, ast.childCount(node));
+                    break;
+                case NodeKind::Load:
+                case NodeKind::Store:
+                case NodeKind::ExtractLane:
+                case NodeKind::InsertLane:
+                case NodeKind::Shuffle:
+                    writeVarint(out, ast.payload(node));
+                    break;
+                case NodeKind::Index:
+                case NodeKind::Conditional:
+                    out.push_back(static_cast<uint8_t>(ast.payload(node)));
+                    break;
+                case NodeKind::Switch:
+                    writeVarint(out, ast.caseCount(node));
+                    for(uint32_t i = 0; i < ast.caseCount(node); ++i) {
+                        int32_t value = ast.caseValue(node, i);
+                        writeVarint(out, (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31));
+                    }
+                    break;
+                case NodeKind::Return:
+                case NodeKind::Not:
+                case NodeKind::Convert:
+                case NodeKind::Splat:
+                case NodeKind::While:
+                case NodeKind::For:
+                case NodeKind::Break:
+                case NodeKind::Continue:
+                    break;
+                default:
+                    throw UnhandledSwitchCase();
+            }
+
+            for(uint32_t i = 0; i < ast.childCount(node); ++i) {
+                FlatAst::Index child = ast.child(node, i);
+                writeVarint(out, child == FlatAst::NONE ? 0 : offsets[node] - offsets[child]);
+            }
+        }
+
+        std::memcpy(out.data(), MAGIC, sizeof(MAGIC));
+        out[4] = static_cast<uint8_t>(BinaryAstView::VERSION);
+        out[5] = static_cast<uint8_t>(BinaryAstView::VERSION >> 8);
+        writeUInt32At(out, 8, checkedOffset(stringsOffset));
+        writeUInt32At(out, 12, checkedOffset(variablesOffset));
+        writeUInt32At(out, 16, checkedOffset(scopesOffset));
+        writeUInt32At(out, 20, checkedOffset(nodesOffset));
+        writeUInt32At(out, 24, checkedOffset(offsets.empty() ? nodesOffset : offsets.back()));
+        writeUInt32At(out, 28, checkedOffset(out.size()));
+        return out;
+    }
+
+    BinaryAstView::BinaryAstView(const uint8_t *data, size_t size) : data_{data}, size_{size} {
+        if(size < HEADER_SIZE || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+            throw FormatException("Not llast binary data", 0);
+        }
+
+        uint16_t version = static_cast<uint16_t>(data[4] | (data[5] << 8));
+        if(version != VERSION) {
+            throw FormatException("Unsupported version " + std::to_string(version), 4);
+        }
+
+        size_t stringsOffset = readUInt32At(data, 8);
+        size_t variablesOffset = readUInt32At(data, 12);
+        size_t scopesOffset = readUInt32At(data, 16);
+        nodesOffset_ = readUInt32At(data, 20);
+        rootOffset_ = readUInt32At(data, 24);
+        size_t end = readUInt32At(data, 28);
+        if(end > size || stringsOffset != HEADER_SIZE || variablesOffset < stringsOffset
+           || scopesOffset < variablesOffset || nodesOffset_ < scopesOffset || rootOffset_ < nodesOffset_
+           || rootOffset_ >= end) {
+            throw FormatException("Invalid header", 8);
+        }
+        size_ = end;
+
+        size_t position = stringsOffset;
+        uint64_t count = readVarint(position);
+        if(count > size_ - position) {
+            throw FormatException("Invalid string count", stringsOffset);
+        }
+        strings_.reserve(count);
+        for(uint64_t i = 0; i < count; ++i) {
+            uint64_t length = readVarint(position);
+            if(length > size_ - position) {
+                throw FormatException("String extends past the end of the data", position);
+            }
+            strings_.emplace_back(reinterpret_cast<const char*>(data_ + position), length);
+            position += length;
+        }
+
+        position = variablesOffset;
+        count = readVarint(position);
+        if(count > size_ - position) {
+            throw FormatException("Invalid variable count", variablesOffset);
+        }
+        variables_.reserve(count);
+        for(uint64_t i = 0; i < count; ++i) {
+            uint64_t name = readVarint(position);
+            uint8_t dataType = readByte(position);
+            bool noAlias = (dataType & NO_ALIAS) != 0;
+            dataType &= ~NO_ALIAS;
+            if(name >= strings_.size() || dataType > LAST_DATA_TYPE) {
+                throw FormatException("Invalid variable", position);
+            }
+            variables_.push_back(VariableEntry{static_cast<uint32_t>(name), static_cast<DataType>(dataType), noAlias});
+        }
+
+        position = scopesOffset;
+        count = readVarint(position);
+        if(count > size_ - position) {
+            throw FormatException("Invalid scope count", scopesOffset);
+        }
+        scopeOffsets_.reserve(count);
+        for(uint64_t i = 0; i < count; ++i) {
+            scopeOffsets_.push_back(position);
+            uint64_t variableCount = readVarint(position);
+            for(uint64_t v = 0; v < variableCount; ++v) {
+                if(readVarint(position) >= variables_.size()) {
+                    throw FormatException("Invalid variable index", position);
+                }
+            }
+        }
+    }
+
+    uint8_t BinaryAstView::readByte(size_t &position) const {
+        if(position >= size_) {
+            throw FormatException("Unexpected end of data", position);
+        }
+        return data_[position++];
+    }
+
+    uint64_t BinaryAstView::readVarint(size_t &position) const {
+        uint64_t value = 0;
+        for(unsigned shift = 0; shift < 64; shift += 7) {
+            uint8_t byte = readByte(position);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+        throw FormatException("Varint is too long", position);
+    }
+
+    BinaryAstView::Node BinaryAstView::node(size_t offset) const {
+        if(offset < nodesOffset_ || offset >= size_) {
+            throw FormatException("Node offset is out of range", offset);
+        }
+
+        Node node;
+        node.offset = offset;
+        size_t position = offset;
+        node.kind = static_cast<NodeKind>(readByte(position));
+        uint8_t dataType = readByte(position);
+        if(dataType > LAST_DATA_TYPE) {
+            throw FormatException("Invalid data type", offset + 1);
+        }
+        node.dataType = static_cast<DataType>(dataType);
+        node.payload = 0;
+
+        switch(node.kind) {
+            case NodeKind::LiteralInt32: {
+                uint32_t zigzag = static_cast<uint32_t>(readVarint(position));
+                node.payload = (zigzag >> 1) ^ (0u - (zigzag & 1));
+                break;
+            }
+            case NodeKind::LiteralFloat:
+                for(int i = 0; i < 4; ++i) {
+                    node.payload |= static_cast<uint64_t>(readByte(position)) << (8 * i);
+                }
+                break;
+            case NodeKind::LiteralInt64: {
+                uint64_t zigzag = readVarint(position);
+                node.payload = (zigzag >> 1) ^ (0 - (zigzag & 1));
+                break;
+            }
+            case NodeKind::LiteralDouble:
+                for(int i = 0; i < 8; ++i) {
+                    node.payload |= static_cast<uint64_t>(readByte(position)) << (8 * i);
+                }
+                break;
+            case NodeKind::Binary:
+            case NodeKind::CheckedBinary:
+            case NodeKind::Reduce:
+                node.payload = readByte(position);
+                if(node.payload > LAST_OPERATION) {
+                    throw FormatException("Invalid operation", position - 1);
+                }
+                break;
+            case NodeKind::VariableRef:
+            case NodeKind::AssignVariable:
+            case NodeKind::Map:
+                node.payload = readVarint(position);
+                if(node.payload >= variables_.size()) {
+                    throw FormatException("Invalid variable index", position);
+                }
+                break;
+            case NodeKind::Fold: {
+                uint64_t operation = readByte(position);
+                if(operation > LAST_OPERATION) {
+                    throw FormatException("Invalid operation", position - 1);
+                }
+                uint64_t variable = readVarint(position);
+                if(variable >= variables_.size()) {
+                    throw FormatException("Invalid variable index", position);
+                }
+                node.payload = operation << 32 | variable;
+                break;
+            }
+            case NodeKind::Invoke:
+            case NodeKind::Block:
+            case NodeKind::Module:
+                node.payload = readVarint(position);
+                if(node.payload >= (node.kind == NodeKind::Block ? scopeOffsets_.size() : strings_.size())) {
+                    throw FormatException("Invalid index", position);
+                }
+                break;
+            case NodeKind::Load:
+            case NodeKind::Store:
+                node.payload = readVarint(position);
+                if(node.payload > UINT32_MAX) {
+                    throw FormatException("Invalid alignment", position);
+                }
+                break;
+            case NodeKind::ExtractLane:
+            case NodeKind::InsertLane:
+                node.payload = readVarint(position);
+                if(node.payload > UINT32_MAX) {
+                    throw FormatException("Invalid lane", position);
+                }
+                break;
+            case NodeKind::Shuffle: {
+                node.payload = readVarint(position);
+                uint64_t lanes = node.payload & 0xf;
+                if(lanes > MAX_LANES || node.payload >> (4 * (lanes + 1)) != 0) {
+                    throw FormatException("Invalid shuffle mask", position);
+                }
+                break;
+            }
+            case NodeKind::Index:
+                node.payload = readByte(position);
+                if(node.payload > LAST_DATA_TYPE) {
+                    throw FormatException("Invalid data type", position - 1);
+                }
+                break;
+            case NodeKind::Conditional:
+                node.payload = readByte(position);
+                if(node.payload > static_cast<uint8_t>(BranchHint::Unlikely)) {
+                    throw FormatException("Invalid branch hint", position - 1);
+                }
+                break;
+            case NodeKind::Function: {
+                uint64_t name = readVarint(position);
+                uint64_t scope = readVarint(position);
+                if(name >= strings_.size() || scope >= scopeOffsets_.size() || scope >= FlatAst::MAX_SCOPES) {
+                    throw FormatException("Invalid index", position);
+                }
+                uint64_t semantics = readByte(position);
+                if(semantics > static_cast<uint8_t>(FloatSemantics::Fast)) {
+                    throw FormatException("Invalid float semantics", position - 1);
+                }
+                node.payload = semantics << 56 | scope << 32 | name;
+                break;
+            }
+            case NodeKind::Switch: {
+                uint64_t count = readVarint(position);
+                //Every case value and child occupies at least one byte.
+                if(count > size_ - position) {
+                    throw FormatException("Invalid case count", position);
+                }
+                node.payload = position;
+                for(uint64_t i = 0; i < count; ++i) {
+                    if(readVarint(position) > UINT32_MAX) {
+                        throw FormatException("Invalid case value", position);
+                    }
+                }
+                node.childCount = static_cast<uint32_t>(count + 2);
+                break;
+            }
+            default:
+                break;
+        }
+
+        if(node.kind == NodeKind::Invoke || node.kind == NodeKind::Block || node.kind == NodeKind::Module) {
+            uint64_t count = readVarint(position);
+            //Every child occupies at least one byte.
+            if(count > size_ - position) {
+                throw FormatException("Invalid child count", position);
+            }
+            node.childCount = static_cast<uint32_t>(count);
+        } else if(node.kind != NodeKind::Switch) {
+            node.childCount = fixedChildCount(node.kind, offset);
+        }
+        node.childrenOffset = position;
+        return node;
+    }
+
+    size_t BinaryAstView::childOffset(const Node &node, size_t &position) const {
+        uint64_t distance = readVarint(position);
+        if(distance == 0) {
+            if(node.kind != NodeKind::Conditional && node.kind != NodeKind::For && node.kind != NodeKind::Switch) {
+                throw FormatException("Missing child", position);
+            }
+            return 0;
+        }
+        //Children always precede their parent, which also guarantees that decoding terminates.
+        if(distance > node.offset - nodesOffset_) {
+            throw FormatException("Child offset is out of range", position);
+        }
+        return node.offset - distance;
+    }
+
+    std::string_view BinaryAstView::string(uint32_t index) const {
+        if(index >= strings_.size()) {
+            throw FormatException("Invalid string index", 0);
+        }
+        return strings_[index];
+    }
+
+    const BinaryAstView::VariableEntry &BinaryAstView::variable(uint32_t index) const {
+        if(index >= variables_.size()) {
+            throw FormatException("Invalid variable index", 0);
+        }
+        return variables_[index];
+    }
+
+    size_t BinaryAstView::scopeOffset(uint32_t scope) const {
+        if(scope >= scopeOffsets_.size()) {
+            throw FormatException("Invalid scope index", 0);
+        }
+        return scopeOffsets_[scope];
+    }
+
+    std::vector<size_t> BinaryAstView::functionOffsets() const {
+        Node module = root();
+        if(module.kind != NodeKind::Module) {
+            throw FormatException("The root node is not a Module", module.offset);
+        }
+
+        std::vector<size_t> offsets;
+        offsets.reserve(module.childCount);
+        forEachChild(module, [&](size_t offset) { offsets.push_back(offset); });
+        return offsets;
+    }
+
+    BinaryAstLoader::BinaryAstLoader(const BinaryAstView &view, AstContext *context)
+        : view_{view}, context_{context}, variables_(view.variableCount()), names_(view.strings_.size()) { }
+
+    Symbol BinaryAstLoader::name(uint64_t index) {
+        std::optional<Symbol> &name = names_[index];
+        if(!name) {
+            std::string_view text = view_.string(static_cast<uint32_t>(index));
+            name = context_ ? context_->intern(text) : SymbolTable::global().intern(text);
+        }
+        return *name;
+    }
+
+    const shared_ptr<const Variable> &BinaryAstLoader::variable(uint64_t index) {
+        shared_ptr<const Variable> &variable = variables_[index];
+        if(!variable) {
+            const BinaryAstView::VariableEntry &entry = view_.variable(static_cast<uint32_t>(index));
+            if(context_) {
+                variable = context_->makeVariable(view_.string(entry.name), entry.dataType, entry.noAlias);
+            } else {
+                variable = make_shared<const Variable>(name(entry.name), entry.dataType, entry.noAlias);
+            }
+        }
+        return variable;
+    }
+
+    unique_ptr<const Scope> BinaryAstLoader::loadScope(uint32_t scope) {
+        ScopeBuilder sb = context_ ? ScopeBuilder{*context_} : ScopeBuilder{};
+        view_.forEachScopeVariable(scope, [&](uint32_t index) { sb.addVariable(variable(index)); });
+        return sb.build();
+    }
+
+    unique_ptr<const Module> BinaryAstLoader::loadModule() {
+        BinaryAstView::Node root = view_.root();
+        if(root.kind != NodeKind::Module) {
+            throw FormatException("The root node is not a Module", root.offset);
+        }
+        return unique_ptr<const Module>(static_cast<const Module*>(load(root.offset).release()));
+    }
+
+    unique_ptr<const Expr> BinaryAstLoader::loadExpr() {
+        BinaryAstView::Node root = view_.root();
+        if(root.kind == NodeKind::Module || root.kind == NodeKind::Function) {
+            throw FormatException("The root node is not an Expr", root.offset);
+        }
+        return unique_ptr<const Expr>(static_cast<const Expr*>(load(root.offset).release()));
+    }
+
+    unique_ptr<const Function> BinaryAstLoader::loadFunction(size_t offset) {
+        if(view_.node(offset).kind != NodeKind::Function) {
+            throw FormatException("Node is not a Function", offset);
+        }
+        return unique_ptr<const Function>(static_cast<const Function*>(load(offset).release()));
+    }
+
+    unique_ptr<const Node> BinaryAstLoader::load(size_t offset) {
+        //Uses an explicit stack so that loading a deep tree does not recurse.  The writer stores each subtree
+        //contiguously in post-order, so the subtrees of the children of a node must exactly fill the bytes before
+        //it:  the last child ends where its parent starts and each other child ends where the subtree of the next
+        //one starts.  Checking this ensures that no node is the child of more than one node, which would otherwise
+        //make loading a few hundred bytes create an exponential number of nodes.
+        struct Frame {
+            BinaryAstView::Node node;
+            uint32_t next;
+            size_t position;
+            size_t firstChild;
+            size_t subtreeStart;
+            size_t childrenEnd;
+        };
+        std::vector<Frame> frames;
+        std::vector<unique_ptr<const Node>> results;
+
+        auto push = [&](size_t nodeOffset) {
+            BinaryAstView::Node node = view_.node(nodeOffset);
+            frames.push_back(Frame{node, 0, node.childrenOffset, results.size(), node.offset, 0});
+        };
+
+        push(offset);
+        while(!frames.empty()) {
+            Frame &frame = frames.back();
+            if(frame.next < frame.node.childCount) {
+                frame.next++;
+                size_t child = view_.childOffset(frame.node, frame.position);
+                if(child == 0) {
+                    results.emplace_back(nullptr);
+                } else {
+                    push(child);
+                }
+            } else {
+                if(frame.childrenEnd != 0 && frame.childrenEnd != frame.node.offset) {
+                    throw FormatException("Children are not stored before their parent", frame.node.offset);
+                }
+                size_t firstChild = frame.firstChild;
+                size_t subtreeStart = frame.subtreeStart;
+                size_t end = frame.position;
+                unique_ptr<const Node> node = makeNode(frame.node, results.begin() + firstChild);
+                frames.pop_back();
+                results.resize(firstChild);
+                results.push_back(move(node));
+
+                if(!frames.empty()) {
+                    Frame &parent = frames.back();
+                    if(parent.childrenEnd == 0) {
+                        parent.subtreeStart = subtreeStart;
+                    } else if(parent.childrenEnd != subtreeStart) {
+                        throw FormatException("Child is not stored after the previous one", parent.node.offset);
+                    }
+                    parent.childrenEnd = end;
+                }
+            }
+        }
+
+        return move(results.back());
+    }
+
+    unique_ptr<const Node> BinaryAstLoader::makeNode(const BinaryAstView::Node &node,
+                                                     std::vector<unique_ptr<const Node>>::iterator children) {
+        auto takeExpr = [&](uint32_t i, bool required) -> unique_ptr<const Expr> {
+            unique_ptr<const Node> &child = children[i];
+            if(!child) {
+                if(required) {
+                    throw FormatException("Missing child", node.offset);
+                }
+                return nullptr;
+            }
+            if(child->nodeKind() == NodeKind::Function || child->nodeKind() == NodeKind::Module) {
+                throw FormatException("Child is not an expression", node.offset);
+            }
+            return unique_ptr<const Expr>(static_cast<const Expr*>(child.release()));
+        };
+
+        switch(node.kind) {
+            case NodeKind::LiteralInt32:
+                return makeIn<const LiteralInt32>(context_, static_cast<int32_t>(static_cast<uint32_t>(node.payload)));
+            case NodeKind::LiteralFloat: {
+                uint32_t bits = static_cast<uint32_t>(node.payload);
+                float value;
+                std::memcpy(&value, &bits, sizeof(value));
+                return makeIn<const LiteralFloat>(context_, value);
+            }
+            case NodeKind::LiteralInt64:
+                return makeIn<const LiteralInt64>(context_, static_cast<int64_t>(node.payload));
+            case NodeKind::LiteralDouble: {
+                double value;
+                std::memcpy(&value, &node.payload, sizeof(value));
+                return makeIn<const LiteralDouble>(context_, value);
+            }
+            case NodeKind::Binary:
+                return makeIn<const Binary>(context_,
+                                            takeExpr(0, true),
+                                            static_cast<OperationKind>(node.payload),
+                                            takeExpr(1, true));
+            case NodeKind::VariableRef:
+                return makeIn<const VariableRef>(context_, variable(node.payload));
+            case NodeKind::AssignVariable:
+                return makeIn<const AssignVariable>(context_, variable(node.payload), takeExpr(0, true));
+            case NodeKind::Return:
+                return makeIn<const Return>(context_, takeExpr(0, true));
+            case NodeKind::Not:
+                return makeIn<const Not>(context_, takeExpr(0, true));
+            case NodeKind::Convert:
+                return makeIn<const Convert>(context_, takeExpr(0, true), node.dataType);
+            case NodeKind::CheckedBinary:
+                return makeIn<const CheckedBinary>(context_,
+                                                   takeExpr(0, true),
+                                                   static_cast<OperationKind>(node.payload),
+                                                   takeExpr(1, true),
+                                                   takeExpr(2, true));
+            case NodeKind::Invoke: {
+                std::pmr::vector<ChildPtr<const Expr>> arguments{
+                    context_ ? context_->resource() : std::pmr::get_default_resource()};
+                for(uint32_t i = 0; i < node.childCount; ++i) {
+                    arguments.emplace_back(takeExpr(i, true));
+                }
+                return makeIn<const Invoke>(context_, name(node.payload), node.dataType, move(arguments));
+            }
+            case NodeKind::Load:
+                return makeIn<const Load>(context_, node.dataType, takeExpr(0, true),
+                                          static_cast<unsigned>(node.payload));
+            case NodeKind::Store:
+                return makeIn<const Store>(context_, takeExpr(0, true), takeExpr(1, true),
+                                           static_cast<unsigned>(node.payload));
+            case NodeKind::Index:
+                return makeIn<const Index>(context_, static_cast<DataType>(node.payload), takeExpr(0, true),
+                                           takeExpr(1, true));
+            case NodeKind::Splat:
+                return makeIn<const Splat>(context_, node.dataType, takeExpr(0, true));
+            case NodeKind::ExtractLane:
+                return makeIn<const ExtractLane>(context_, takeExpr(0, true), static_cast<unsigned>(node.payload));
+            case NodeKind::InsertLane:
+                return makeIn<const InsertLane>(context_, takeExpr(0, true), static_cast<unsigned>(node.payload),
+                                                takeExpr(1, true));
+            case NodeKind::Shuffle:
+                return makeIn<const Shuffle>(context_, takeExpr(0, true), takeExpr(1, true),
+                                             FlatAst::unpackMask(node.payload, context_
+                                                                               ? context_->resource()
+                                                                               : std::pmr::get_default_resource()));
+            case NodeKind::Reduce:
+                return makeIn<const Reduce>(context_, static_cast<OperationKind>(node.payload), takeExpr(0, true));
+            case NodeKind::Block: {
+                std::pmr::vector<ChildPtr<const Expr>> expressions{
+                    context_ ? context_->resource() : std::pmr::get_default_resource()};
+                for(uint32_t i = 0; i < node.childCount; ++i) {
+                    expressions.emplace_back(takeExpr(i, true));
+                }
+                return makeIn<const Block>(context_, loadScope(static_cast<uint32_t>(node.payload)), move(expressions));
+            }
+            case NodeKind::Conditional:
+                return makeIn<const Conditional>(context_, takeExpr(0, true), takeExpr(1, false), takeExpr(2, false),
+                                                 static_cast<BranchHint>(node.payload));
+            case NodeKind::Switch: {
+                std::pmr::memory_resource *resource = context_ ? context_->resource()
+                                                               : std::pmr::get_default_resource();
+                std::pmr::vector<int32_t> values{resource};
+                view_.forEachCaseValue(node, [&](int32_t value) { values.push_back(value); });
+                std::vector<int32_t> sorted{values.begin(), values.end()};
+                std::sort(sorted.begin(), sorted.end());
+                if(std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) {
+                    throw FormatException("Duplicate case value", node.offset);
+                }
+                std::pmr::vector<ChildPtr<const Expr>> cases{resource};
+                for(uint32_t i = 0; i < values.size(); ++i) {
+                    cases.emplace_back(takeExpr(i + 1, true));
+                }
+                return makeIn<const Switch>(context_, takeExpr(0, true), move(values), move(cases),
+                                            takeExpr(node.childCount - 1, false));
+            }
+            case NodeKind::While:
+                return makeIn<const While>(context_, takeExpr(0, true), takeExpr(1, true));
+            case NodeKind::For:
+                //Children are in walk order:  init, condition, body, update.
+                return makeIn<const For>(context_, takeExpr(0, false), takeExpr(1, false), takeExpr(3, false),
+                                         takeExpr(2, true));
+            case NodeKind::Map:
+                return makeIn<const Map>(context_, variable(node.payload), takeExpr(0, true), takeExpr(1, true),
+                                         takeExpr(2, true));
+            case NodeKind::Fold:
+                return makeIn<const Fold>(context_, static_cast<OperationKind>(node.payload >> 32),
+                                          variable(static_cast<uint32_t>(node.payload)), takeExpr(0, true),
+                                          takeExpr(1, true));
+            case NodeKind::Break:
+                return makeIn<const Break>(context_);
+            case NodeKind::Continue:
+                return makeIn<const Continue>(context_);
+            case NodeKind::Function: {
+                uint32_t scope = static_cast<uint32_t>(node.payload >> 32) & (FlatAst::MAX_SCOPES - 1);
+                return makeIn<const Function>(context_,
+                                              name(static_cast<uint32_t>(node.payload)),
+                                              node.dataType,
+                                              loadScope(scope),
+                                              takeExpr(0, true),
+                                              static_cast<FloatSemantics>(node.payload >> 56));
+            }
+            case NodeKind::Module: {
+                std::pmr::vector<ChildPtr<const Function>> functions{
+                    context_ ? context_->resource() : std::pmr::get_default_resource()};
+                for(uint32_t i = 0; i < node.childCount; ++i) {
+                    if(children[i]->nodeKind() != NodeKind::Function) {
+                        throw FormatException("Child of a Module is not a Function", node.offset);
+                    }
+                    functions.emplace_back(static_cast<const Function*>(children[i].release()));
+                }
+                return makeIn<const Module>(context_, name(node.payload), move(functions));
+            }
+            default:
+                throw UnhandledSwitchCase();
+        }
+    }
+
+    MappedFile::MappedFile(const std::string &path) : data_{nullptr}, size_{0} {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0) {
+            throw Exception("Unable to open " + path + ": " + std::strerror(errno));
+        }
+
+        struct stat status;
+        if(::fstat(fd, &status) != 0) {
+            int error = errno;
+            ::close(fd);
+            throw Exception("Unable to stat " + path + ": " + std::strerror(error));
+        }
+
+        size_ = static_cast<size_t>(status.st_size);
+        if(size_ > 0) {
+            void *mapped = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(mapped == MAP_FAILED) {
+                int error = errno;
+                ::close(fd);
+                throw Exception("Unable to map " + path + ": " + std::strerror(error));
+            }
+            data_ = static_cast<const uint8_t*>(mapped);
+        }
+        ::close(fd);
+    }
+
+    MappedFile::~MappedFile() {
+        if(data_) {
+            ::munmap(const_cast<uint8_t*>(data_), size_);
+        }
+    }
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include "FlatAst.hpp"
+
+#include <cstdint>
+#include <optional>
+
+namespace llast {
+
+    /** Writes trees in the llast binary format, which BinaryAstView reads.
+     *
+     * The format is little-endian and starts with a fixed 32 byte header:  the magic "LLAB", a 16 bit version, 16
+     * reserved bits and six 32 bit offsets, to the string table, the variable table, the scope table, the first node,
+     * the root node and the end of the data.  Each table is a varint count followed by its entries:  a string is a
+     * varint length and its bytes, a variable is the varint index of its name and a data type byte, whose high bit is
+     * set if the variable is noAlias, and a scope is a varint count of variable indexes.
+     *
+     * Nodes are stored in post-order as a kind byte and a data type byte followed by a payload and the node's children.
+     * Payloads are the zigzag varint value of a LiteralInt32 or LiteralInt64, the 4 bytes of a LiteralFloat, the 8
+     * bytes of a LiteralDouble, the operation byte of a Binary, CheckedBinary or Reduce, the varint variable index of a
+     * VariableRef, AssignVariable or Map, the operation byte and varint variable index of a Fold, the varint scope
+     * index of a Block, the varint name and scope indexes and the float semantics byte of a Function, the varint name
+     * index of an Invoke or a Module, the varint alignment of a Load or Store, the element data type byte of an Index,
+     * the branch hint byte of a Conditional, the varint lane of an ExtractLane or InsertLane and the varint packed mask
+     * of a Shuffle (see FlatAst::packMask()).  A Switch has a varint case count followed by the zigzag varint case
+     * values, and then its discriminant, its cases and its default case as children.  Invokes, Blocks and Modules then
+     * have a varint child count;  other kinds have a fixed number of children.  Each child is the varint distance back
+     * from its parent's offset to its own, with 0 for an absent part of a Conditional, For or Switch.  The children of
+     * a For are in walk order:  init, condition, body and update, and those of a Map are output, count and body.
+     */
+    class BinaryAstWriter {
+    public:
+        static std::vector<uint8_t> write(const Module *module);
+        static std::vector<uint8_t> write(const Expr *expr);
+        static std::vector<uint8_t> write(const FlatAst &ast);
+    };
+
+    /** Reads the llast binary format in place, without copying the data or allocating anything per node.  The data
+     * must outlive the view, and so must any MappedFile it came from.  The header and tables are validated when the
+     * view is created;  nodes are validated as they are decoded.  Either throws FormatException.  A child may still be
+     * referenced by more than one node;  BinaryAstLoader rejects that, but other walks of a view of untrusted data
+     * must check it themselves. */
+    class BinaryAstView {
+    public:
+        static constexpr uint16_t VERSION = 3;
+
+        /** A decoded node.  payload is interpreted as documented for FlatAst, except that of a Switch, which is the
+         * offset of its case values (see forEachCaseValue()). */
+        struct Node {
+            size_t offset;
+            NodeKind kind;
+            DataType dataType;
+            uint64_t payload;
+            uint32_t childCount;
+            size_t childrenOffset;
+        };
+
+        struct VariableEntry {
+            uint32_t name;
+            DataType dataType;
+            bool noAlias;
+        };
+
+    private:
+        const uint8_t *data_;
+        size_t size_;
+        size_t nodesOffset_;
+        size_t rootOffset_;
+        std::vector<std::string_view> strings_;
+        std::vector<VariableEntry> variables_;
+        std::vector<size_t> scopeOffsets_;
+
+    public:
+        BinaryAstView(const uint8_t *data, size_t size);
+
+        BinaryAstView(const std::vector<uint8_t> &data) : BinaryAstView(data.data(), data.size()) { }
+
+        Node root() const { return node(rootOffset_); }
+
+        Node node(size_t offset) const;
+
+        /** Invokes func with the offset of each child of node, or 0 for an absent part of a Conditional, For or
+         * Switch. */
+        template<typename TFunc>
+        void forEachChild(const Node &node, TFunc func) const {
+            size_t position = node.childrenOffset;
+            for(uint32_t i = 0; i < node.childCount; ++i) {
+                func(childOffset(node, position));
+            }
+        }
+
+        /** Invokes func with each case value of a Switch node, in order. */
+        template<typename TFunc>
+        void forEachCaseValue(const Node &node, TFunc func) const {
+            size_t position = static_cast<size_t>(node.payload);
+            for(uint32_t i = 2; i < node.childCount; ++i) {
+                uint32_t zigzag = static_cast<uint32_t>(readVarint(position));
+                func(static_cast<int32_t>((zigzag >> 1) ^ (0u - (zigzag & 1))));
+            }
+        }
+
+        std::string_view string(uint32_t index) const;
+
+        size_t variableCount() const { return variables_.size(); }
+        const VariableEntry &variable(uint32_t index) const;
+
+        size_t scopeCount() const { return scopeOffsets_.size(); }
+
+        /** Invokes func with the index of each variable of scope, in slot order. */
+        template<typename TFunc>
+        void forEachScopeVariable(uint32_t scope, TFunc func) const {
+            size_t position = scopeOffset(scope);
+            uint64_t count = readVarint(position);
+            for(uint64_t i = 0; i < count; ++i) {
+                func(static_cast<uint32_t>(readVarint(position)));
+            }
+        }
+
+        /** The name of a Function or Module node. */
+        std::string_view name(const Node &node) const {
+            return string(static_cast<uint32_t>(node.payload));
+        }
+
+        /** The offsets of the functions of the root Module, in order. */
+        std::vector<size_t> functionOffsets() const;
+
+    private:
+        friend class BinaryAstLoader;
+
+        size_t scopeOffset(uint32_t scope) const;
+        size_t childOffset(const Node &node, size_t &position) const;
+        uint64_t readVarint(size_t &position) const;
+        uint8_t readByte(size_t &position) const;
+    };
+
+    /** Materializes nodes from a BinaryAstView on demand, i.e. a single function of a large module.  Variables and
+     * names are created once per loader, so nodes loaded by the same loader share them.  Nodes are allocated in
+     * context if it is not null;  names are interned in context or else in SymbolTable::global().  Throws
+     * FormatException unless the subtrees of the children of each node are stored one after the other right before
+     * it, as BinaryAstWriter stores them, so that every node is loaded at most once. */
+    class BinaryAstLoader {
+        const BinaryAstView &view_;
+        AstContext *context_;
+        std::vector<shared_ptr<const Variable>> variables_;
+        std::vector<std::optional<Symbol>> names_;
+
+    public:
+        BinaryAstLoader(const BinaryAstView &view, AstContext *context = nullptr);
+
+        unique_ptr<const Module> loadModule();
+        unique_ptr<const Expr> loadExpr();
+        unique_ptr<const Function> loadFunction(size_t offset);
+
+    private:
+        unique_ptr<const llast::Node> load(size_t offset);
+        unique_ptr<const llast::Node> makeNode(const BinaryAstView::Node &node,
+                                               std::vector<unique_ptr<const llast::Node>>::iterator children);
+        unique_ptr<const Scope> loadScope(uint32_t scope);
+        const shared_ptr<const Variable> &variable(uint64_t index);
+        Symbol name(uint64_t index);
+    };
+
+    /** A read-only memory mapping of a whole file, i.e. to create a BinaryAstView over a file without reading it. */
+    class MappedFile {
+        const uint8_t *data_;
+        size_t size_;
+    public:
+        MappedFile(const std::string &path);
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+        ~MappedFile();
+
+        const uint8_t *data() const { return data_; }
+        size_t size() const { return size_; }
+    };
+}
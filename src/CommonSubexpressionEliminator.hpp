@@ -0,0 +1,514 @@
+#pragma once
+
+#include "ExpressionTreeTransformer.hpp"
+#include "StaticExpressionTreeWalker.hpp"
+
+#include <unordered_set>
+#include <algorithm>
+#include <cstring>
+
+namespace llast {
+
+    /** Collects the names of all variables assigned anywhere within a tree, including the indexes of Maps and
+     * Folds. */
+    class AssignedVariableCollector : public StaticExpressionTreeWalker<AssignedVariableCollector> {
+        std::unordered_set<Symbol> names_;
+    public:
+        void visitingAssignVariable(const AssignVariable *expr) {
+            names_.insert(expr->symbol());
+        }
+
+        void visitingMap(const Map *expr) {
+            names_.insert(expr->indexSymbol());
+        }
+
+        void visitingFold(const Fold *expr) {
+            names_.insert(expr->indexSymbol());
+        }
+
+        const std::unordered_set<Symbol> &names() const { return names_; }
+    };
+
+    /** Eliminates common subexpressions within the expressions of each Block.
+     *
+     * Only side-effect free Binary expressions (those made of Binary, Not and Convert expressions whose leaves are
+     * literals and variable references) are considered.  When such an expression is evaluated more than once within a
+     * block and no AssignVariable to one of its variables occurs between the evaluations, a temporary variable is added
+     * to the block's scope, the first evaluation is replaced with an assignment to the temporary and all later
+     * evaluations are replaced with references to it.  Expressions which are evaluated conditionally (the arms of a
+     * Conditional, the cases of a Switch, the rValue of an And or Or or the overflow part of a CheckedBinary) may reuse
+     * a temporary defined before them, but never define one which is used after them.  Nested Blocks are handled as
+     * separate regions and the parts of loops, which may be evaluated any number of times, are left as they are.
+     *
+     * Neither the analysis nor the transformation recurses, so the depth of a tree is limited only by available
+     * memory.  An eliminator may transform any number of trees, one after the other.
+     */
+    class CommonSubexpressionEliminator : public ExpressionTreeTransformer {
+        /** What is known about an expression:  whether it is side-effect free and if so, its structural hash and the
+         * variables it reads. */
+        struct Analysis {
+            bool pure;
+            size_t hash;
+            std::vector<Symbol> reads;
+        };
+
+        struct Candidate {
+            const Binary *expr;
+            const Analysis *analysis;
+            /** The occurrence of the innermost Block containing expr, to whose scope its temporary is added. */
+            size_t block;
+            unsigned evaluations;
+            shared_ptr<const Variable> temporary;
+        };
+
+        /** Maps the structural hash of each available expression to the index of its candidate. */
+        typedef std::unordered_multimap<size_t, size_t> AvailableSet;
+
+        struct Frame {
+            const Expr *expr;
+            /** The index of the next child to number, as passed to childAt(). */
+            size_t next;
+            /** The expressions available where expr is evaluated, or null if expr is not numbered, i.e. in a loop. */
+            AvailableSet *available;
+            /** The expressions available to the children of a Block or to the conditionally evaluated part being
+             * numbered, i.e. an arm of a Conditional. */
+            unique_ptr<AvailableSet> partAvailable;
+            /** The index of the frame of the innermost Block containing expr, or of expr itself if it is a Block. */
+            size_t blockFrame;
+            /** The candidates whose innermost Block is expr, whose occurrence is known only once it is left. */
+            std::vector<size_t> blockCandidates;
+            /** True if expr reuses the value of candidate, so its children are not numbered. */
+            bool reused;
+            size_t candidate;
+        };
+
+        std::vector<Candidate> candidates_;
+        /** The candidates defined and reused by each occurrence of a Binary expression. */
+        std::unordered_map<size_t, size_t> defines_;
+        std::unordered_map<size_t, size_t> reuses_;
+        /** The temporaries added to each occurrence of a Block. */
+        std::unordered_map<size_t, std::vector<shared_ptr<const Variable>>> temporaries_;
+        std::unordered_map<const Expr*, Analysis> analyses_;
+        /** The occurrences of Binary expressions and of Blocks seen so far, counted in post-order. */
+        size_t binaryCount_ = 0;
+        size_t blockCount_ = 0;
+
+        /** Returns the analysis of expr, or null if it is not side-effect free.  The operands of an expression are
+         * analyzed before it, with an explicit stack, and each expression is analyzed only once. */
+        const Analysis *analyze(const Expr *expr) {
+            std::vector<const Expr*> pending{expr};
+            while(!pending.empty()) {
+                const Expr *next = pending.back();
+                if(analyses_.count(next)) {
+                    pending.pop_back();
+                    continue;
+                }
+
+                const Expr *operand;
+                bool ready = true;
+                for(size_t i = 0; isOperation(next) && childAt(next, i, operand); ++i) {
+                    if(!analyses_.count(operand)) {
+                        pending.push_back(operand);
+                        ready = false;
+                    }
+                }
+                if(ready) {
+                    pending.pop_back();
+                    analyses_.emplace(next, analyzeOperation(next));
+                }
+            }
+
+            const Analysis &analysis = analyses_.at(expr);
+            return analysis.pure ? &analysis : nullptr;
+        }
+
+        static bool isOperation(const Expr *expr) {
+            return expr->nodeKind() == NodeKind::Binary
+                   || expr->nodeKind() == NodeKind::Not
+                   || expr->nodeKind() == NodeKind::Convert;
+        }
+
+        /** Analyzes expr, whose operands must have been analyzed already. */
+        Analysis analyzeOperation(const Expr *expr) const {
+            Analysis analysis{true, std::hash<int>()(static_cast<int>(expr->nodeKind())), { }};
+            auto addOperand = [&](const Expr *operand) {
+                const Analysis &operandAnalysis = analyses_.at(operand);
+                analysis.pure = analysis.pure && operandAnalysis.pure;
+                if(analysis.pure) {
+                    analysis.hash = combine(analysis.hash, operandAnalysis.hash);
+                    for(Symbol name : operandAnalysis.reads) {
+                        if(std::find(analysis.reads.begin(), analysis.reads.end(), name) == analysis.reads.end()) {
+                            analysis.reads.push_back(name);
+                        }
+                    }
+                }
+            };
+
+            switch(expr->nodeKind()) {
+                case NodeKind::LiteralInt32:
+                    analysis.hash = combine(analysis.hash,
+                                            std::hash<int>()(static_cast<const LiteralInt32*>(expr)->value()));
+                    break;
+                case NodeKind::LiteralFloat:
+                    analysis.hash = combine(analysis.hash, bitsOf(static_cast<const LiteralFloat*>(expr)->value()));
+                    break;
+                case NodeKind::LiteralInt64:
+                    analysis.hash = combine(analysis.hash,
+                                            std::hash<int64_t>()(static_cast<const LiteralInt64*>(expr)->value()));
+                    break;
+                case NodeKind::LiteralDouble:
+                    analysis.hash = combine(analysis.hash, bitsOf(static_cast<const LiteralDouble*>(expr)->value()));
+                    break;
+                case NodeKind::VariableRef: {
+                    Symbol name = static_cast<const VariableRef*>(expr)->symbol();
+                    analysis.hash = combine(analysis.hash, name.hash());
+                    analysis.reads.push_back(name);
+                    break;
+                }
+                case NodeKind::Binary: {
+                    auto binary = static_cast<const Binary*>(expr);
+                    analysis.hash = combine(analysis.hash, std::hash<int>()(static_cast<int>(binary->operation())));
+                    addOperand(binary->lValue());
+                    addOperand(binary->rValue());
+                    break;
+                }
+                case NodeKind::Not:
+                    addOperand(static_cast<const Not*>(expr)->operand());
+                    break;
+                case NodeKind::Convert:
+                    analysis.hash = combine(analysis.hash, std::hash<int>()(static_cast<int>(expr->dataType())));
+                    addOperand(static_cast<const Convert*>(expr)->operand());
+                    break;
+                default:
+                    analysis.pure = false;
+                    break;
+            }
+            return analysis;
+        }
+
+        /** The bits of a floating point literal, which tell apart 0.0 and -0.0 and make a NaN equal to itself. */
+        static uint32_t bitsOf(float value) {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            return bits;
+        }
+
+        static uint64_t bitsOf(double value) {
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            return bits;
+        }
+
+        static size_t combine(size_t seed, size_t value) {
+            return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+        }
+
+        /** Compares two side-effect free expressions, with an explicit stack. */
+        static bool equal(const Expr *first, const Expr *second) {
+            std::vector<std::pair<const Expr*, const Expr*>> pending{{first, second}};
+            while(!pending.empty()) {
+                const Expr *a = pending.back().first;
+                const Expr *b = pending.back().second;
+                pending.pop_back();
+                if(a == b) {
+                    continue;
+                }
+                if(a->nodeKind() != b->nodeKind() || a->dataType() != b->dataType()) {
+                    return false;
+                }
+
+                bool same;
+                switch(a->nodeKind()) {
+                    case NodeKind::LiteralInt32:
+                        same = static_cast<const LiteralInt32*>(a)->value()
+                               == static_cast<const LiteralInt32*>(b)->value();
+                        break;
+                    case NodeKind::LiteralFloat:
+                        same = bitsOf(static_cast<const LiteralFloat*>(a)->value())
+                               == bitsOf(static_cast<const LiteralFloat*>(b)->value());
+                        break;
+                    case NodeKind::LiteralInt64:
+                        same = static_cast<const LiteralInt64*>(a)->value()
+                               == static_cast<const LiteralInt64*>(b)->value();
+                        break;
+                    case NodeKind::LiteralDouble:
+                        same = bitsOf(static_cast<const LiteralDouble*>(a)->value())
+                               == bitsOf(static_cast<const LiteralDouble*>(b)->value());
+                        break;
+                    case NodeKind::VariableRef:
+                        same = static_cast<const VariableRef*>(a)->symbol()
+                               == static_cast<const VariableRef*>(b)->symbol();
+                        break;
+                    case NodeKind::Binary: {
+                        auto binaryA = static_cast<const Binary*>(a);
+                        auto binaryB = static_cast<const Binary*>(b);
+                        same = binaryA->operation() == binaryB->operation();
+                        pending.emplace_back(binaryA->lValue(), binaryB->lValue());
+                        pending.emplace_back(binaryA->rValue(), binaryB->rValue());
+                        break;
+                    }
+                    case NodeKind::Not:
+                        same = true;
+                        pending.emplace_back(static_cast<const Not*>(a)->operand(),
+                                             static_cast<const Not*>(b)->operand());
+                        break;
+                    case NodeKind::Convert:
+                        same = true;
+                        pending.emplace_back(static_cast<const Convert*>(a)->operand(),
+                                             static_cast<const Convert*>(b)->operand());
+                        break;
+                    default:
+                        throw UnhandledSwitchCase();
+                }
+                if(!same) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void kill(AvailableSet &available, Symbol name) {
+            for(auto itr = available.begin(); itr != available.end();) {
+                const std::vector<Symbol> &reads = candidates_[itr->second].analysis->reads;
+                if(std::find(reads.begin(), reads.end(), name) != reads.end()) {
+                    itr = available.erase(itr);
+                } else {
+                    ++itr;
+                }
+            }
+        }
+
+        void killAssignedWithin(AvailableSet &available, const Expr *expr) {
+            AssignedVariableCollector collector;
+            collector.walkTree(expr);
+            for(Symbol name : collector.names()) {
+                kill(available, name);
+            }
+        }
+
+        /** Records, in evaluation order, every evaluation of a side-effect free Binary expression within the Blocks
+         * of the tree rooted at root.  Each Block is a separate region, whose expressions are numbered with an explicit
+         * stack. */
+        void number(const Expr *root) {
+            std::vector<Frame> frames;
+            enter(frames, root, nullptr, 0);
+            while(!frames.empty()) {
+                Frame &frame = frames.back();
+                const Expr *child;
+                if(childAt(frame.expr, frame.next, child)) {
+                    size_t index = frame.next++;
+                    if(child) {
+                        AvailableSet *available = partAvailable(frame, index);
+                        enter(frames, child, available, frame.blockFrame);
+                    }
+                } else {
+                    leave(frames);
+                    frames.pop_back();
+                }
+            }
+        }
+
+        void enter(std::vector<Frame> &frames, const Expr *expr, AvailableSet *available, size_t blockFrame) {
+            Frame frame{expr, 0, available, nullptr, blockFrame, { }, false, 0};
+            if(expr->nodeKind() == NodeKind::Block) {
+                frame.blockFrame = frames.size();
+                frame.partAvailable = make_unique<AvailableSet>();
+            } else if(expr->nodeKind() == NodeKind::Binary && available) {
+                if(const Analysis *analysis = analyze(expr)) {
+                    auto range = available->equal_range(analysis->hash);
+                    for(auto itr = range.first; itr != range.second; ++itr) {
+                        Candidate &candidate = candidates_[itr->second];
+                        if(equal(candidate.expr, expr)) {
+                            candidate.evaluations++;
+                            frame.reused = true;
+                            frame.candidate = itr->second;
+                            break;
+                        }
+                    }
+                }
+            }
+            frames.push_back(move(frame));
+        }
+
+        /** Returns the expressions available to the child of frame.expr at index. */
+        AvailableSet *partAvailable(Frame &frame, size_t index) {
+            bool conditional = false;
+            switch(frame.expr->nodeKind()) {
+                case NodeKind::Block:
+                    return frame.partAvailable.get();
+                case NodeKind::While:
+                case NodeKind::For:
+                case NodeKind::Map:
+                case NodeKind::Fold:
+                    return nullptr;
+                case NodeKind::Binary:
+                    conditional = index == 1 && isLogical(static_cast<const Binary*>(frame.expr)->operation());
+                    break;
+                case NodeKind::CheckedBinary:
+                    conditional = index == 2;
+                    break;
+                case NodeKind::Conditional:
+                case NodeKind::Switch:
+                    conditional = index > 0;
+                    break;
+                default:
+                    break;
+            }
+
+            if(!frame.available || frame.reused) {
+                return nullptr;
+            }
+            if(!conditional) {
+                return frame.available;
+            }
+            //A conditionally evaluated part may use the expressions available before it, but not make any available
+            //after it.
+            frame.partAvailable = make_unique<AvailableSet>(*frame.available);
+            return frame.partAvailable.get();
+        }
+
+        void leave(std::vector<Frame> &frames) {
+            Frame &frame = frames.back();
+            if(frame.expr->nodeKind() == NodeKind::Binary) {
+                leaveBinary(frames, binaryCount_++);
+                return;
+            }
+            if(frame.expr->nodeKind() == NodeKind::Block) {
+                size_t occurrence = blockCount_++;
+                for(size_t index : frame.blockCandidates) {
+                    candidates_[index].block = occurrence;
+                }
+            }
+
+            if(!frame.available) {
+                return;
+            }
+            AvailableSet &available = *frame.available;
+            switch(frame.expr->nodeKind()) {
+                case NodeKind::AssignVariable:
+                    kill(available, static_cast<const AssignVariable*>(frame.expr)->symbol());
+                    break;
+                case NodeKind::CheckedBinary:
+                    killAssignedWithin(available, static_cast<const CheckedBinary*>(frame.expr)->overflow());
+                    break;
+                case NodeKind::Conditional:
+                case NodeKind::Switch:
+                case NodeKind::Block:
+                case NodeKind::While:
+                case NodeKind::For:
+                case NodeKind::Map:
+                case NodeKind::Fold:
+                    killAssignedWithin(available, frame.expr);
+                    break;
+                default:
+                    //Arguments are passed by value, so the callee of an Invoke cannot assign any of our variables.
+                    //Loads are never candidates, so Stores cannot invalidate any, and neither assigns a variable.
+                    break;
+            }
+        }
+
+        void leaveBinary(std::vector<Frame> &frames, size_t occurrence) {
+            Frame &frame = frames.back();
+            if(frame.reused) {
+                reuses_[occurrence] = frame.candidate;
+                return;
+            }
+            if(!frame.available) {
+                return;
+            }
+
+            auto binary = static_cast<const Binary*>(frame.expr);
+            if(isLogical(binary->operation())) {
+                killAssignedWithin(*frame.available, binary->rValue());
+            }
+            if(const Analysis *analysis = analyze(binary)) {
+                size_t index = candidates_.size();
+                candidates_.push_back(Candidate{ binary, analysis, 0, 1, nullptr });
+                frames[frame.blockFrame].blockCandidates.push_back(index);
+                defines_[occurrence] = index;
+                frame.available->emplace(analysis->hash, index);
+            }
+        }
+
+        const Candidate *findCandidate(const std::unordered_map<size_t, size_t> &map, size_t occurrence) const {
+            auto found = map.find(occurrence);
+            if(found == map.end() || candidates_[found->second].temporary == nullptr) {
+                return nullptr;
+            }
+            return &candidates_[found->second];
+        }
+
+    public:
+        CommonSubexpressionEliminator() { }
+
+        /** New nodes and temporaries are allocated in context and unchanged subtrees are shared with the original
+         * tree. */
+        CommonSubexpressionEliminator(AstContext &context) : ExpressionTreeTransformer{context} { }
+
+    protected:
+        /** Numbers the whole tree before any of it is transformed, since children are transformed before their
+         * parents.  Binary expressions and Blocks are identified by their occurrence, i.e. their position in the
+         * post-order in which both the numbering and the transformation visit them, rather than by address, so that a
+         * node which is the child of several nodes is eliminated separately wherever it occurs.  Nothing is kept from
+         * one tree to the next. */
+        void initialize(const Node *root) override {
+            candidates_.clear();
+            defines_.clear();
+            reuses_.clear();
+            temporaries_.clear();
+            analyses_.clear();
+            binaryCount_ = 0;
+            blockCount_ = 0;
+
+            if(root->nodeKind() == NodeKind::Module) {
+                static_cast<const Module*>(root)->forEachFunction([&](const Function *func) { number(func->body()); });
+            } else if(root->nodeKind() == NodeKind::Function) {
+                number(static_cast<const Function*>(root)->body());
+            } else {
+                number(static_cast<const Expr*>(root));
+            }
+
+            unsigned temporaryCount = 0;
+            for(Candidate &candidate : candidates_) {
+                if(candidate.evaluations > 1) {
+                    string name = "$cse" + std::to_string(temporaryCount++);
+                    DataType dataType = candidate.expr->dataType();
+                    candidate.temporary = context() ? context()->makeVariable(name, dataType)
+                                                    : make_shared<const Variable>(name, dataType);
+                    temporaries_[candidate.block].push_back(candidate.temporary);
+                }
+            }
+            binaryCount_ = 0;
+            blockCount_ = 0;
+        }
+
+        ChildPtr<const Expr> transformBlock(const Block *expr) override {
+            BlockBuilder bb = context() ? BlockBuilder{*context()} : BlockBuilder{};
+            expr->scope()->forEachVariable([&](const shared_ptr<const Variable> &var) { bb.addVariable(var); });
+            auto temporaries = temporaries_.find(blockCount_++);
+            if(temporaries != temporaries_.end()) {
+                for(const shared_ptr<const Variable> &temporary : temporaries->second) {
+                    bb.addVariable(temporary);
+                }
+            }
+
+            expr->forEach([&](const Expr *childExpr) { bb.addExpression(transform(childExpr)); });
+            return bb.build();
+        }
+
+        ChildPtr<const Expr> transformBinary(const Binary *expr) override {
+            size_t occurrence = binaryCount_++;
+            if(const Candidate *reused = findCandidate(reuses_, occurrence)) {
+                return makeIn<const VariableRef>(context(), reused->temporary);
+            }
+
+            ChildPtr<const Expr> copy = ExpressionTreeTransformer::transformBinary(expr);
+
+            if(const Candidate *defined = findCandidate(defines_, occurrence)) {
+                return makeIn<const AssignVariable>(context(), defined->temporary, move(copy));
+            }
+
+            return copy;
+        }
+    };
+}
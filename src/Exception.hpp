@@ -80,9 +80,49 @@ namespace llast {
 
     };
 
+    /** Thrown when serialized input is malformed.  offset is the position in the input at which the problem was
+     * detected. */
+    class FormatException : public Exception {
+        const size_t offset_;
+    public:
+        FormatException(const std::string &message, size_t offset)
+                : Exception(message + " (at offset " + std::to_string(offset) + ")"), offset_{offset} {
+
+        }
+
+        size_t offset() const { return offset_; }
+    };
+
+    /** Thrown when source text cannot be parsed.  line and column are 1-based. */
+    class ParseException : public Exception {
+        const size_t line_;
+        const size_t column_;
+    public:
+        ParseException(const std::string &message, size_t line, size_t column)
+                : Exception(std::to_string(line) + ":" + std::to_string(column) + ": " + message),
+                  line_{line}, column_{column} {
+
+        }
+
+        size_t line() const { return line_; }
+        size_t column() const { return column_; }
+    };
+
     enum class CompileError {
         NoError,
-        BinaryExprDataTypeMismatch
+        BinaryExprDataTypeMismatch,
+        UndefinedVariable,
+        DuplicateFunctionName,
+        LoopControlOutsideLoop,
+        UndefinedFunction,
+        InvokeSignatureMismatch,
+        FunctionInUse,
+        InvalidHostFunction,
+        InvalidMemoryAccess,
+        InvalidVectorOperation,
+        InvalidRangeOperation,
+        InvalidDiscriminant,
+        InvalidOperandType
     };
 
     class CompileException : public Exception {
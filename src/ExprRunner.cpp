@@ -1,17 +1,35 @@
 #include "ExprRunner.hpp"
 #include "ExpressionTreeVisitor.hpp"
 #include "ExpressionTreeWalker.hpp"
+#include "IterativeExpressionTreeWalker.hpp"
 #include "PrettyPrinter.hpp"
+#include "NameResolver.hpp"
+#include "FlatAst.hpp"
+#include "FunctionSpecializer.hpp"
 
 #include <map>
+#include <unordered_set>
 #include <stack>
+#include <algorithm>
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-variable"
 #pragma GCC diagnostic ignored "-Wunused-parameter"
 
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Intrinsics.h"
 #include "llvm/IR/Mangler.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/LegacyPassManager.h"
+
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Linker/Linker.h"
 
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/DynamicLibrary.h"
@@ -28,6 +46,91 @@
 #pragma GCC diagnostic pop
 
 namespace llast {
+    inline llvm::StringRef toStringRef(string_view str) {
+        return llvm::StringRef(str.data(), str.size());
+    }
+
+    llvm::Type *getLlvmType(llvm::LLVMContext &context, DataType type) {
+        switch(type) {
+            case DataType::Void:
+                return llvm::Type::getVoidTy(context);
+            case DataType::Bool:
+                return llvm::Type::getInt1Ty(context);
+            case DataType::Int32:
+            case DataType::UInt32:
+                return llvm::Type::getInt32Ty(context);
+            case DataType::Int64:
+            case DataType::UInt64:
+                return llvm::Type::getInt64Ty(context);
+            case DataType::Float:
+                return llvm::Type::getFloatTy(context);
+            case DataType::Double:
+                return llvm::Type::getDoubleTy(context);
+            case DataType::Pointer:
+                //Pointers are untyped;  Load, Store and Index cast them to a pointer to their element type.
+                return llvm::Type::getInt8PtrTy(context);
+            case DataType::Float32x4:
+            case DataType::Float32x8:
+            case DataType::Int32x4:
+            case DataType::Int32x8:
+                return llvm::VectorType::get(getLlvmType(context, laneType(type)), laneCount(type));
+            default:
+                throw UnhandledSwitchCase();
+        }
+    }
+
+    /** The types of a function's return value and parameters, which an Invoke of it must agree with. */
+    struct FunctionSignature {
+        DataType returnType;
+        std::vector<DataType> parameterTypes;
+
+        static FunctionSignature of(const Function *func) {
+            FunctionSignature signature{ func->returnType(), { } };
+            for(size_t slot = 0; slot < func->parameterScope()->size(); ++slot) {
+                signature.parameterTypes.push_back(func->parameterScope()->variable(slot)->dataType());
+            }
+            return signature;
+        }
+
+        bool operator==(const FunctionSignature &other) const {
+            return returnType == other.returnType && parameterTypes == other.parameterTypes;
+        }
+
+        bool operator!=(const FunctionSignature &other) const { return !(*this == other); }
+
+        llvm::FunctionType *getLlvmType(llvm::LLVMContext &context) const {
+            std::vector<llvm::Type*> argTypes;
+            for(DataType type : parameterTypes) {
+                argTypes.push_back(llast::getLlvmType(context, type));
+            }
+            return llvm::FunctionType::get(llast::getLlvmType(context, returnType), argTypes, false);
+        }
+
+        /** Bools are i1, which are passed and returned zero extended so that they agree with C++ bools. */
+        llvm::AttributeList getAttributes(llvm::LLVMContext &context) const {
+            llvm::AttributeList attributes;
+            if(returnType == DataType::Bool) {
+                attributes = attributes.addAttribute(context, llvm::AttributeList::ReturnIndex, llvm::Attribute::ZExt);
+            }
+            for(unsigned i = 0; i < parameterTypes.size(); ++i) {
+                if(parameterTypes[i] == DataType::Bool) {
+                    attributes = attributes.addParamAttribute(context, i, llvm::Attribute::ZExt);
+                }
+            }
+            return attributes;
+        }
+    };
+
+    /** How the code generated for an Invoke reaches its callee:  directly by name, which the JIT resolves when the
+     * code is linked, at a fixed address, or through a slot holding the address of the callee's current code. */
+    struct CalleeBinding {
+        FunctionSignature signature;
+        void *const *slot;
+        void *address;
+    };
+
+    typedef std::map<string, CalleeBinding, std::less<>> CalleeBindings;
+
     class CodeGenVisitor : public ExpressionTreeVisitor {
         llvm::LLVMContext &context_;
         llvm::TargetMachine &targetMachine_;
@@ -36,19 +139,93 @@ namespace llast {
         llvm::Function* function_;
         llvm::BasicBlock *block_;
 
-        typedef std::unordered_map<std::string, llvm::AllocaInst*> AllocaScope;
-
-        //this is a deque and not an actual std::stack because we need the ability to iterate over it's contents
-        std::deque<AllocaScope> allocaScopeStack_;
+        /** Holds the current SSA value of each variable in a scope, indexed by slot.  Variables are never given stack
+         * slots:  an assignment simply replaces the variable's current value and phi nodes are inserted where
+         * control flow merges.  (No node exists which can take the address of a variable, so memory is never
+         * required.) */
+        typedef std::vector<llvm::Value*> ValueScope;
+        typedef std::deque<ValueScope> ValueScopeStack;
+
+        /** The state of one arm of a Conditional or Switch at the point control leaves it for the merge block. */
+        struct ArmExit {
+            llvm::BasicBlock *block;
+            llvm::Value *value;
+            ValueScopeStack variables;
+        };
+
+        struct ConditionalState {
+            llvm::BasicBlock *falseBlock;
+            llvm::BasicBlock *mergeBlock;
+            size_t valueStackDepth;
+            ValueScopeStack variablesAtBranch;
+            std::vector<ArmExit> exits;
+            //Non-null if both arms are evaluated in the current block and one of their values is selected by it.
+            llvm::Value *selectCondition = nullptr;
+        };
+
+        /** The arms of a Switch are its cases followed by its default case, which is arms.falseBlock. */
+        struct SwitchState {
+            ConditionalState arms;
+            std::vector<llvm::BasicBlock*> caseBlocks;
+        };
+
+        /** The state of a loop whose body is being emitted.  Edges to continueBlock and exitBlock carry only the
+         * variables of the scopes enclosing the loop, i.e. those of the first scopeDepth scopes. */
+        struct LoopState {
+            llvm::BasicBlock *headerBlock;
+            //The target of a Continue:  the update block of a For which has an update, otherwise headerBlock.
+            llvm::BasicBlock *continueBlock;
+            llvm::BasicBlock *exitBlock;
+            size_t scopeDepth;
+            size_t valueStackDepth;
+            //The phi node at the start of headerBlock which is each variable's value on entry to an iteration.
+            ValueScopeStack headerPhis;
+            std::vector<ArmExit> continues;
+            std::vector<ArmExit> breaks;
+            //False for the loop of a Map or Fold, whose body may not be left by a Break or Continue.
+            bool allowsLoopControl = true;
+        };
+
+        /** The state of a Map or Fold whose body is being emitted, which is also the innermost loop.  counter is the
+         * header phi node of the index variable and accumulator, which only a Fold has, is the value combined from
+         * the iterations before the current one. */
+        struct RangeState {
+            llvm::Value *counter;
+            llvm::Value *output;
+            llvm::PHINode *accumulator;
+        };
+
+        const VariableBindings &bindings_;
+        const CalleeBindings &callees_;
+
+        //These are indexed by VariableSlot::depth.
+        ValueScopeStack scopeStack_;
+        std::vector<const Scope*> lexicalScopes_;
+
+        //Every expression leaves exactly one entry on valueStack_, which is nullptr if it has no value.
         std::stack<llvm::Value*> valueStack_;
-        std::stack<const Node*> ancestryStack_;
+        std::stack<size_t> blockValueStackDepths_;
+        std::stack<ConditionalState> conditionalStack_;
+        std::stack<SwitchState> switchStack_;
+        std::stack<LoopState> loopStack_;
+        std::stack<RangeState> rangeStack_;
 
     public:
-        CodeGenVisitor(llvm::LLVMContext &context, llvm::TargetMachine &targetMachine)
-                : context_{context}, targetMachine_{targetMachine}, irBuilder_{context} { }
+        CodeGenVisitor(llvm::LLVMContext &context,
+                       llvm::TargetMachine &targetMachine,
+                       const VariableBindings &bindings,
+                       const CalleeBindings &callees)
+                : context_{context}, targetMachine_{targetMachine}, irBuilder_{context}, bindings_{bindings},
+                  callees_{callees} { }
 
         virtual void visitingModule(const Module *module) override {
-            module_ = llvm::make_unique<llvm::Module>(module->name(), context_);
+            startModule(module->name());
+        }
+
+        /** Creates the llvm::Module into which functions are emitted.  Invoked by visitingModule, or directly when
+         * a Function is walked by itself. */
+        void startModule(string_view name) {
+            module_ = llvm::make_unique<llvm::Module>(toStringRef(name), context_);
             module_->setDataLayout(targetMachine_.createDataLayout());
         }
 
@@ -57,14 +234,77 @@ namespace llast {
         }
 
         virtual void visitingFunction(const Function *func) override {
-            std::vector<llvm::Type*> argTypes;
-
-            function_ = llvm::cast<llvm::Function>(
-                    module_->getOrInsertFunction(func->name(),
-                                                 getType(func->returnType())));
+            const Scope *parameterScope = func->parameterScope();
+
+            //The function has already been declared if a function emitted before it invokes it.
+            function_ = declareFunction(func->name(), FunctionSignature::of(func));
+
+            //The initial value of each parameter is its argument.
+            scopeStack_.emplace_back();
+            lexicalScopes_.push_back(parameterScope);
+            for(auto &arg : function_->args()) {
+                const Variable *parameter = parameterScope->variable(scopeStack_.back().size());
+                arg.setName(toStringRef(parameter->name()));
+                if(parameter->dataType() == DataType::Pointer && parameter->noAlias()) {
+                    function_->addParamAttr(arg.getArgNo(), llvm::Attribute::NoAlias);
+                }
+                scopeStack_.back().push_back(&arg);
+            }
 
             block_ = llvm::BasicBlock::Create(context_, "functionBody", function_);
             irBuilder_.SetInsertPoint(block_);
+            irBuilder_.setFastMathFlags(getFastMathFlags(func->floatSemantics()));
+        }
+
+        /** The fast-math flags of the floating point operations of a function with the given semantics.  LLVM 5 has no
+         * flag allowing only reassociation, so Reassociate gets the same flags as Fast. */
+        static llvm::FastMathFlags getFastMathFlags(FloatSemantics semantics) {
+            llvm::FastMathFlags flags;
+            switch(semantics) {
+                case FloatSemantics::Strict:
+                    break;
+                case FloatSemantics::Contract:
+                    flags.setAllowContract(true);
+                    break;
+                case FloatSemantics::Reassociate:
+                case FloatSemantics::Fast:
+                    flags.setAllowContract(true);
+                    flags.setUnsafeAlgebra();
+                    break;
+                default:
+                    throw UnhandledSwitchCase();
+            }
+            return flags;
+        }
+
+        virtual void visitedFunction(const Function *func) override {
+            DEBUG_ASSERT(valueStack_.size() == 1, "Only the value of the function body should remain.");
+            valueStack_.pop();
+            scopeStack_.pop_back();
+            lexicalScopes_.pop_back();
+
+            //Control may fall off the end of the body, i.e. when it does not end with a Return.
+            if(!irBuilder_.GetInsertBlock()->getTerminator()) {
+                if(func->returnType() == DataType::Void) {
+                    irBuilder_.CreateRetVoid();
+                } else {
+                    irBuilder_.CreateUnreachable();
+                }
+            }
+        }
+
+        llvm::Function *declareFunction(string_view name, const FunctionSignature &signature) {
+            llvm::Function *function = module_->getFunction(toStringRef(name));
+            if(!function) {
+                function = llvm::Function::Create(getFunctionType(signature), llvm::Function::ExternalLinkage,
+                                                  toStringRef(name), module_.get());
+                function->setAttributes(signature.getAttributes(context_));
+            }
+            return function;
+        }
+
+        llvm::FunctionType *getFunctionType(const FunctionSignature &signature) {
+            return signature.getLlvmType(context_);
         }
 
         void dumpIR() {
@@ -78,117 +318,312 @@ namespace llast {
             return std::move(module_);
         }
 
-        virtual void visitingNode(const Node *expr) override {
-            ancestryStack_.push(expr);
+        llvm::Value *&lookupVariable(const VariableSlot &slot) {
+            return scopeStack_[slot.depth][slot.index];
         }
 
-        virtual void visitedNode(const Node *expr) override {
-            DEBUG_ASSERT(ancestryStack_.top() == expr, "Top node of ancestryStack_ should be the current node.");
-            ancestryStack_.pop();
+        virtual void visitingBlock(const Block *expr) override {
+            scopeStack_.emplace_back();
+            lexicalScopes_.push_back(expr->scope());
 
-            //If the parent node of expr is a BlockExpr, the value left behind on valueStack_ is extraneous and
-            //should be removed.  (This is a consequence of "everything is an expression.")
-            if(ancestryStack_.size() >= 1
-               && expr->nodeKind() == NodeKind::Block
-               && valueStack_.size() > 0) {
-                valueStack_.pop();
+            //The value of a variable which is read before it is assigned is undefined.
+            for(auto var : expr->scope()->variables()) {
+                scopeStack_.back().push_back(llvm::UndefValue::get(getType(var->dataType())));
             }
+
+            blockValueStackDepths_.push(valueStack_.size());
         }
 
-        llvm::Value *lookupVariable(const std::string &name) {
-            for(auto scope = allocaScopeStack_.rbegin(); scope != allocaScopeStack_.rend(); ++scope) {
-                auto foundValue = scope->find(name);
-                if(foundValue != scope->end()) {
-                    return foundValue->second;
-                }
-            }
+        llvm::Type *getType(DataType type) {
+            return getLlvmType(context_, type);
+        }
 
-            throw InvalidStateException(std::string("Variable '") + name + std::string("' was not defined."));
+        virtual void visitedBlock(const Block *) override {
+            scopeStack_.pop_back();
+            lexicalScopes_.pop_back();
+
+            //The value of a block is the value of its last expression.
+            size_t depth = blockValueStackDepths_.top();
+            blockValueStackDepths_.pop();
+
+            llvm::Value *value = valueStack_.size() > depth ? valueStack_.top() : nullptr;
+            popValuesTo(depth);
+            valueStack_.push(value);
         }
 
-        virtual void visitingBlock(const Block *expr) override {
-            allocaScopeStack_.emplace_back();
-            AllocaScope &topScope = allocaScopeStack_.back();
+        void popValuesTo(size_t depth) {
+            while(valueStack_.size() > depth) {
+                valueStack_.pop();
+            }
+        }
 
-            for(auto var : expr->scope()->variables()) {
-                if(topScope.find(var->name()) != topScope.end()) {
-                    throw InvalidStateException("More than one variable named '" + var->name() +
-                                                "' was defined in the current scope.");
-                }
+        virtual void visitedAssignVariable(const AssignVariable *expr) override {
+            llvm::Value *value = valueStack_.top();
+
+            //The value of an assignment is the value assigned, so it is left on valueStack_.
+            lookupVariable(bindings_.slotOf(expr)) = value;
+        }
+
+        /** Throws CompileException unless the operands of expr suit its operation. */
+        static void checkOperands(const Binary *expr) {
+            DataType operandType = expr->lValue()->dataType();
+            if(operandType != expr->rValue()->dataType()) {
+                throw CompileException(CompileError::BinaryExprDataTypeMismatch,
+                                       "Data types of lvalue and rvalue in binary expression do not match");
+            }
 
-                llvm::Type *type{getType(var->dataType())};
-                llvm::AllocaInst *allocaInst = irBuilder_.CreateAlloca(type, nullptr, var->name());
-                topScope [var->name()] = allocaInst;
+            OperationKind op = expr->operation();
+            if((isComparison(op) || isLogical(op)) && laneCount(operandType) > 1) {
+                throw CompileException(CompileError::InvalidVectorOperation,
+                                       "Comparisons and logical operations cannot be applied to vectors");
+            }
+            bool isEquality = op == OperationKind::Eq || op == OperationKind::Ne;
+            if(isLogical(op) && operandType != DataType::Bool) {
+                throw CompileException(CompileError::InvalidOperandType, "The operands of And and Or must be Bools");
+            }
+            if(operandType == DataType::Bool && !isLogical(op) && !isEquality) {
+                throw CompileException(CompileError::InvalidOperandType,
+                                       "Only And, Or, Eq and Ne can be applied to Bools");
+            }
+            if(operandType == DataType::Pointer && !isEquality) {
+                throw CompileException(CompileError::InvalidOperandType,
+                                       "Pointers can only be compared for equality");
             }
         }
 
-        llvm::Type *getType(DataType type)
-        {
-            switch(type) {
-                case DataType::Void:
-                    return llvm::Type::getVoidTy(context_);
-                case DataType::Bool:
-                    return llvm::Type::getInt8Ty(context_);
-                case DataType::Int32:
-                    return llvm::Type::getInt32Ty(context_);
-                case DataType::Float:
-                    return llvm::Type::getFloatTy(context_);
-                case DataType::Double:
-                    return llvm::Type::getDoubleTy(context_);
-                default:
-                    throw UnhandledSwitchCase();
+        /** Whether the rValue of an And or Or is cheap enough, and free of side effects, to be evaluated even when
+         * the lValue determines the result, so that no branch is needed. */
+        static bool isBranchless(const Binary *expr) {
+            size_t budget = SPECULATED_NODES;
+            return isSpeculatable(expr->rValue(), budget);
+        }
+
+        /** Short-circuits an And or Or whose rValue is not branchless:  the rValue is only evaluated if the lValue
+         * does not determine the result, and the result is merged like the value of a Conditional. */
+        void visitingRValue(const Binary *expr) override {
+            checkOperands(expr);
+            if(isBranchless(expr)) {
+                return;
             }
+            bool isAnd = expr->operation() == OperationKind::And;
+            llvm::Value *lValue = popValue(DataType::Bool);
+            llvm::BasicBlock *lValueBlock = irBuilder_.GetInsertBlock();
+            llvm::BasicBlock *rValueBlock = llvm::BasicBlock::Create(context_, "rValueBlock", function_);
+            llvm::BasicBlock *mergeBlock = llvm::BasicBlock::Create(context_, "mergeBlock", function_);
+            irBuilder_.CreateCondBr(lValue, isAnd ? rValueBlock : mergeBlock, isAnd ? mergeBlock : rValueBlock);
+
+            //On the edge skipping the rValue the result is the lValue's, i.e. false for an And.
+            ArmExit skipped{ lValueBlock, irBuilder_.getInt1(!isAnd), scopeStack_ };
+            conditionalStack_.push(ConditionalState{ nullptr, mergeBlock, valueStack_.size(), scopeStack_,
+                                                     { skipped } });
+            irBuilder_.SetInsertPoint(rValueBlock);
         }
 
-        virtual void visitedBlock(const Block *) override {
-            allocaScopeStack_.pop_back();
+        virtual void visitedBinary(const Binary *expr) override {
+            checkOperands(expr);
+            if(isLogical(expr->operation()) && !isBranchless(expr)) {
+                ConditionalState &state = conditionalStack_.top();
+                exitArm(state);
+                mergeArms(state, DataType::Bool);
+                conditionalStack_.pop();
+                return;
+            }
+
+            DataType operandType = expr->rValue()->dataType();
+            llvm::Value *rValue = popValue(operandType);
+            llvm::Value *lValue = popValue(operandType);
+
+            llvm::Value *result = createOperation(lValue, rValue, expr->operation(), operandType);
+            valueStack_.push(result);
         }
 
-        virtual void visitedAssignVariable(const AssignVariable *expr) override {
-            llvm::Value *inst = lookupVariable(expr->name());
+        virtual void visitedNot(const Not *expr) override {
+            if(expr->operand()->dataType() != DataType::Bool) {
+                throw CompileException(CompileError::InvalidOperandType, "The operand of a Not must be a Bool");
+            }
+            valueStack_.push(irBuilder_.CreateNot(popValue(DataType::Bool)));
+        }
 
-            llvm::Value *value = valueStack_.top();
-            valueStack_.pop();
+        /** Whether a Convert can convert to or from dataType, i.e. it is a scalar integer or floating point type. */
+        static bool isConvertible(DataType dataType) {
+            return laneCount(dataType) == 1 && (isInteger(dataType) || isFloatingPoint(dataType));
+        }
 
-            value = irBuilder_.CreateStore(value, inst);
+        virtual void visitedConvert(const Convert *expr) override {
+            DataType from = expr->operand()->dataType();
+            DataType to = expr->dataType();
+            if((!isConvertible(from) && from != DataType::Bool) || !isConvertible(to)) {
+                throw CompileException(CompileError::InvalidOperandType,
+                                       "Cannot convert " + to_string(from) + " to " + to_string(to));
+            }
+            llvm::Value *value = popValue(from);
+            llvm::Type *type = getType(to);
+            bool isSigned = isInteger(from) && !isUnsigned(from);
+            if(isFloatingPoint(from)) {
+                if(isFloatingPoint(to)) {
+                    value = irBuilder_.CreateFPCast(value, type);
+                } else {
+                    value = isUnsigned(to) ? irBuilder_.CreateFPToUI(value, type)
+                                           : irBuilder_.CreateFPToSI(value, type);
+                }
+            } else if(isFloatingPoint(to)) {
+                value = isSigned ? irBuilder_.CreateSIToFP(value, type) : irBuilder_.CreateUIToFP(value, type);
+            } else {
+                value = irBuilder_.CreateIntCast(value, type, isSigned);
+            }
             valueStack_.push(value);
         }
 
-        virtual void visitedBinary(const Binary *expr) override {
-
-            if(expr->lValue()->dataType() != expr->rValue()->dataType()) {
-                //throw std::runtime_error("Crapola");
+        /** Throws CompileException unless expr is an Add, Sub or Mul of two scalar integers of the same type. */
+        static void checkOperands(const CheckedBinary *expr) {
+            DataType operandType = expr->lValue()->dataType();
+            if(operandType != expr->rValue()->dataType()) {
                 throw CompileException(CompileError::BinaryExprDataTypeMismatch,
                                        "Data types of lvalue and rvalue in binary expression do not match");
             }
+            if(!isInteger(operandType) || laneCount(operandType) > 1) {
+                throw CompileException(CompileError::InvalidOperandType,
+                                       "Only scalar integers can be checked for overflow");
+            }
+            OperationKind op = expr->operation();
+            if(op != OperationKind::Add && op != OperationKind::Sub && op != OperationKind::Mul) {
+                throw CompileException(CompileError::InvalidOperandType,
+                                       "Only Add, Sub and Mul can be checked for overflow");
+            }
+        }
 
-            llvm::Value *rValue = valueStack_.top();
-            valueStack_.pop();
+        static llvm::Intrinsic::ID getOverflowIntrinsic(OperationKind op, DataType dataType) {
+            bool isSigned = !isUnsigned(dataType);
+            switch(op) {
+                case OperationKind::Add:
+                    return isSigned ? llvm::Intrinsic::sadd_with_overflow : llvm::Intrinsic::uadd_with_overflow;
+                case OperationKind::Sub:
+                    return isSigned ? llvm::Intrinsic::ssub_with_overflow : llvm::Intrinsic::usub_with_overflow;
+                case OperationKind::Mul:
+                    return isSigned ? llvm::Intrinsic::smul_with_overflow : llvm::Intrinsic::umul_with_overflow;
+                default:
+                    throw UnhandledSwitchCase();
+            }
+        }
 
-            llvm::Value *lValue = valueStack_.top();
-            valueStack_.pop();
+        /** Computes the operation with an overflow intrinsic, which also gives a flag that is set on overflow, and
+         * branches on the flag to the overflow part.  The result and the value of the overflow part are merged like
+         * the values of the arms of a Conditional. */
+        void visitingOverflow(const CheckedBinary *expr) override {
+            checkOperands(expr);
+            DataType dataType = expr->dataType();
+            llvm::Value *rValue = popValue(dataType);
+            llvm::Value *lValue = popValue(dataType);
+            llvm::Intrinsic::ID id = getOverflowIntrinsic(expr->operation(), dataType);
+            llvm::Function *intrinsic = llvm::Intrinsic::getDeclaration(module_.get(), id, { getType(dataType) });
+            llvm::Value *resultAndFlag = irBuilder_.CreateCall(intrinsic, { lValue, rValue });
+            llvm::Value *result = irBuilder_.CreateExtractValue(resultAndFlag, 0);
+            llvm::Value *overflowed = irBuilder_.CreateExtractValue(resultAndFlag, 1);
+
+            llvm::BasicBlock *overflowBlock = llvm::BasicBlock::Create(context_, "overflowBlock", function_);
+            llvm::BasicBlock *mergeBlock = llvm::BasicBlock::Create(context_, "mergeBlock", function_);
+            irBuilder_.CreateCondBr(overflowed, overflowBlock, mergeBlock,
+                                    llvm::MDBuilder(context_).createBranchWeights(1, LIKELY_BRANCH_WEIGHT));
+
+            ArmExit completed{ irBuilder_.GetInsertBlock(), result, scopeStack_ };
+            conditionalStack_.push(ConditionalState{ nullptr, mergeBlock, valueStack_.size(), scopeStack_,
+                                                     { completed } });
+            irBuilder_.SetInsertPoint(overflowBlock);
+        }
 
-            llvm::Value *result = createOperation(lValue, rValue, expr->operation(), expr->dataType());
-            valueStack_.push(result);
+        virtual void visitedCheckedBinary(const CheckedBinary *expr) override {
+            ConditionalState &state = conditionalStack_.top();
+            exitArm(state);
+            mergeArms(state, expr->dataType());
+            conditionalStack_.pop();
         }
 
+        /** Integers are compared as signed unless dataType is unsigned.  Comparisons of floating point values are
+         * ordered, except that Ne is unordered so that it is always the opposite of Eq. */
+        llvm::Value *createComparison(llvm::Value *lValue, llvm::Value *rValue, OperationKind op, DataType dataType) {
+            if(isFloatingPoint(dataType)) {
+                switch(op) {
+                    case OperationKind::Eq: return irBuilder_.CreateFCmpOEQ(lValue, rValue);
+                    case OperationKind::Ne: return irBuilder_.CreateFCmpUNE(lValue, rValue);
+                    case OperationKind::Lt: return irBuilder_.CreateFCmpOLT(lValue, rValue);
+                    case OperationKind::Le: return irBuilder_.CreateFCmpOLE(lValue, rValue);
+                    case OperationKind::Gt: return irBuilder_.CreateFCmpOGT(lValue, rValue);
+                    case OperationKind::Ge: return irBuilder_.CreateFCmpOGE(lValue, rValue);
+                    default:
+                        throw UnhandledSwitchCase();
+                }
+            }
+            if(isUnsigned(dataType)) {
+                switch(op) {
+                    case OperationKind::Eq: return irBuilder_.CreateICmpEQ(lValue, rValue);
+                    case OperationKind::Ne: return irBuilder_.CreateICmpNE(lValue, rValue);
+                    case OperationKind::Lt: return irBuilder_.CreateICmpULT(lValue, rValue);
+                    case OperationKind::Le: return irBuilder_.CreateICmpULE(lValue, rValue);
+                    case OperationKind::Gt: return irBuilder_.CreateICmpUGT(lValue, rValue);
+                    case OperationKind::Ge: return irBuilder_.CreateICmpUGE(lValue, rValue);
+                    default:
+                        throw UnhandledSwitchCase();
+                }
+            }
+            switch(op) {
+                case OperationKind::Eq: return irBuilder_.CreateICmpEQ(lValue, rValue);
+                case OperationKind::Ne: return irBuilder_.CreateICmpNE(lValue, rValue);
+                case OperationKind::Lt: return irBuilder_.CreateICmpSLT(lValue, rValue);
+                case OperationKind::Le: return irBuilder_.CreateICmpSLE(lValue, rValue);
+                case OperationKind::Gt: return irBuilder_.CreateICmpSGT(lValue, rValue);
+                case OperationKind::Ge: return irBuilder_.CreateICmpSGE(lValue, rValue);
+                default:
+                    throw UnhandledSwitchCase();
+            }
+        }
+
+        /** The operation of a vector dataType is applied to each pair of lanes.  dataType is that of the operands,
+         * which differs from that of the result for a comparison. */
         llvm::Value *createOperation(llvm::Value *lValue, llvm::Value *rValue, OperationKind op, DataType dataType) {
-            switch(dataType) {
+            if(isComparison(op)) {
+                return createComparison(lValue, rValue, op, dataType);
+            }
+            switch(laneType(dataType)) {
+                case DataType::Bool:
+                    switch(op) {
+                        case OperationKind::And: return irBuilder_.CreateAnd(lValue, rValue);
+                        case OperationKind::Or: return irBuilder_.CreateOr(lValue, rValue);
+                        default:
+                            throw UnhandledSwitchCase();
+                    }
                 case DataType::Int32:
+                case DataType::Int64:
+                case DataType::UInt32:
+                case DataType::UInt64:
                     switch(op) {
                         case OperationKind::Add: return irBuilder_.CreateAdd(lValue, rValue);
                         case OperationKind::Sub: return irBuilder_.CreateSub(lValue, rValue);
                         case OperationKind::Mul: return irBuilder_.CreateMul(lValue, rValue);
-                        case OperationKind::Div: return irBuilder_.CreateSDiv(lValue, rValue);
+                        case OperationKind::Div:
+                            return isUnsigned(dataType) ? irBuilder_.CreateUDiv(lValue, rValue)
+                                                        : irBuilder_.CreateSDiv(lValue, rValue);
+                        case OperationKind::Min: {
+                            llvm::Value *isLess = createComparison(lValue, rValue, OperationKind::Lt, dataType);
+                            return irBuilder_.CreateSelect(isLess, lValue, rValue);
+                        }
+                        case OperationKind::Max: {
+                            llvm::Value *isGreater = createComparison(lValue, rValue, OperationKind::Gt, dataType);
+                            return irBuilder_.CreateSelect(isGreater, lValue, rValue);
+                        }
                         default:
                             throw UnhandledSwitchCase();
                     }
                 case DataType::Float:
+                case DataType::Double:
                     switch(op) {
                         case OperationKind::Add: return irBuilder_.CreateFAdd(lValue, rValue);
                         case OperationKind::Sub: return irBuilder_.CreateFSub(lValue, rValue);
                         case OperationKind::Mul: return irBuilder_.CreateFMul(lValue, rValue);
                         case OperationKind::Div: return irBuilder_.CreateFDiv(lValue, rValue);
+                        case OperationKind::Min:
+                            return irBuilder_.CreateSelect(irBuilder_.CreateFCmpOLT(lValue, rValue), lValue, rValue);
+                        case OperationKind::Max:
+                            return irBuilder_.CreateSelect(irBuilder_.CreateFCmpOGT(lValue, rValue), lValue, rValue);
                         default:
                             throw UnhandledSwitchCase();
                     }
@@ -205,6 +640,14 @@ namespace llast {
             valueStack_.push(getConstantFloat(expr->value()));
         }
 
+        virtual void visitLiteralInt64(const LiteralInt64 *expr) override {
+            valueStack_.push(irBuilder_.getInt64(static_cast<uint64_t>(expr->value())));
+        }
+
+        virtual void visitLiteralDouble(const LiteralDouble *expr) override {
+            valueStack_.push(llvm::ConstantFP::get(context_, llvm::APFloat(expr->value())));
+        }
+
         llvm::Value *getConstantInt32(int value) {
             llvm::ConstantInt *constantInt = llvm::ConstantInt::get(context_, llvm::APInt(32, value, true));
             return constantInt;
@@ -215,15 +658,843 @@ namespace llast {
         }
 
         virtual void visitVariableRef(const VariableRef *expr) override {
-            llvm::Value *allocaInst = lookupVariable(expr->name());
-            valueStack_.push(irBuilder_.CreateLoad(allocaInst));
+            valueStack_.push(lookupVariable(bindings_.slotOf(expr)));
         }
 
         void visitedReturn(const Return *) override {
             DEBUG_ASSERT(valueStack_.size() > 0, "")
             llvm::Value* retValue = valueStack_.top();
             valueStack_.pop();
-            irBuilder_.CreateRet(retValue);
+
+            llvm::Type *returnType = function_->getReturnType();
+            if(returnType->isVoidTy()) {
+                irBuilder_.CreateRetVoid();
+            } else {
+                //The value expression has no value when it is itself a return, i.e. return (return 1).
+                irBuilder_.CreateRet(retValue ? retValue : llvm::UndefValue::get(returnType));
+            }
+            valueStack_.push(nullptr);
+
+            //Anything following a return is unreachable but must still be emitted into a basic block.
+            irBuilder_.SetInsertPoint(llvm::BasicBlock::Create(context_, "afterReturn", function_));
+        }
+
+        void visitedInvoke(const Invoke *expr) override {
+            auto found = callees_.find(expr->functionName());
+            if(found == callees_.end()) {
+                throw CompileException(CompileError::UndefinedFunction,
+                                       "Function '" + string(expr->functionName()) + "' is not defined");
+            }
+            const CalleeBinding &callee = found->second;
+            checkSignature(expr, callee.signature);
+
+            llvm::FunctionType *functionType = getFunctionType(callee.signature);
+            std::vector<llvm::Value*> args(expr->argumentCount());
+            for(size_t i = args.size(); i > 0; --i) {
+                //An argument has no value when it is itself a return, i.e. (call f Int32 (return 1)).
+                llvm::Value *value = valueStack_.top();
+                args[i - 1] = value ? value : llvm::UndefValue::get(functionType->getParamType(i - 1));
+                valueStack_.pop();
+            }
+
+            llvm::Value *target;
+            if(callee.address) {
+                target = llvm::ConstantExpr::getIntToPtr(
+                        llvm::ConstantInt::get(llvm::Type::getInt64Ty(context_), reinterpret_cast<uint64_t>(callee.address)),
+                        functionType->getPointerTo());
+            } else if(callee.slot) {
+                //The slot's address is fixed for the lifetime of the ExecutionContext;  its contents are not.
+                llvm::Type *targetPtrType = functionType->getPointerTo();
+                llvm::Constant *slot = llvm::ConstantExpr::getIntToPtr(
+                        llvm::ConstantInt::get(llvm::Type::getInt64Ty(context_), reinterpret_cast<uint64_t>(callee.slot)),
+                        targetPtrType->getPointerTo());
+                target = irBuilder_.CreateLoad(targetPtrType, slot);
+            } else {
+                target = declareFunction(expr->functionName(), callee.signature);
+            }
+
+            llvm::CallInst *result = irBuilder_.CreateCall(functionType, target, args);
+            result->setAttributes(callee.signature.getAttributes(context_));
+            valueStack_.push(callee.signature.returnType == DataType::Void ? nullptr : result);
+        }
+
+        virtual void visitedLoad(const Load *expr) override {
+            checkMemoryAccess(expr->pointer(), expr->dataType());
+            llvm::Type *elementType = getType(expr->dataType());
+            llvm::Value *pointer = popValue(DataType::Pointer);
+
+            llvm::LoadInst *load = irBuilder_.CreateLoad(elementType, castPointer(pointer, elementType));
+            load->setAlignment(getAlignment(expr->alignment(), elementType));
+            valueStack_.push(load);
+        }
+
+        virtual void visitedStore(const Store *expr) override {
+            checkMemoryAccess(expr->pointer(), expr->dataType());
+            llvm::Type *elementType = getType(expr->dataType());
+            llvm::Value *value = popValue(expr->dataType());
+            llvm::Value *pointer = popValue(DataType::Pointer);
+
+            llvm::StoreInst *store = irBuilder_.CreateStore(value, castPointer(pointer, elementType));
+            store->setAlignment(getAlignment(expr->alignment(), elementType));
+            valueStack_.push(value);
+        }
+
+        virtual void visitedIndex(const Index *expr) override {
+            checkMemoryAccess(expr->pointer(), expr->elementType());
+            if(expr->index()->dataType() != DataType::Int32) {
+                throw CompileException(CompileError::InvalidMemoryAccess, "The index of an Index must be an Int32");
+            }
+            llvm::Type *elementType = getType(expr->elementType());
+            llvm::Value *index = popValue(DataType::Int32);
+            llvm::Value *pointer = popValue(DataType::Pointer);
+
+            llvm::Value *element = irBuilder_.CreateInBoundsGEP(elementType, castPointer(pointer, elementType), index);
+            valueStack_.push(irBuilder_.CreateBitCast(element, getType(DataType::Pointer)));
+        }
+
+        virtual void visitedSplat(const Splat *expr) override {
+            checkVector(expr->dataType());
+            checkLane(expr->scalar(), expr->dataType());
+            llvm::Value *scalar = popValue(expr->scalar()->dataType());
+            valueStack_.push(irBuilder_.CreateVectorSplat(laneCount(expr->dataType()), scalar));
+        }
+
+        virtual void visitedExtractLane(const ExtractLane *expr) override {
+            checkLaneNumber(expr->vector(), expr->lane());
+            llvm::Value *vector = popValue(expr->vector()->dataType());
+            valueStack_.push(irBuilder_.CreateExtractElement(vector, irBuilder_.getInt32(expr->lane())));
+        }
+
+        virtual void visitedInsertLane(const InsertLane *expr) override {
+            checkLaneNumber(expr->vector(), expr->lane());
+            checkLane(expr->scalar(), expr->dataType());
+            llvm::Value *scalar = popValue(expr->scalar()->dataType());
+            llvm::Value *vector = popValue(expr->dataType());
+            valueStack_.push(irBuilder_.CreateInsertElement(vector, scalar, irBuilder_.getInt32(expr->lane())));
+        }
+
+        virtual void visitedShuffle(const Shuffle *expr) override {
+            DataType operandType = expr->first()->dataType();
+            checkVector(operandType);
+            if(expr->second()->dataType() != operandType) {
+                throw CompileException(CompileError::InvalidVectorOperation,
+                                       "The operands of a Shuffle must have the same type");
+            }
+            if(expr->dataType() == DataType::Void) {
+                throw CompileException(CompileError::InvalidVectorOperation,
+                                       "There is no vector type with as many lanes as the mask of a Shuffle");
+            }
+            std::vector<uint32_t> mask{expr->mask().begin(), expr->mask().end()};
+            for(uint32_t lane : mask) {
+                if(lane >= 2 * laneCount(operandType)) {
+                    throw CompileException(CompileError::InvalidVectorOperation,
+                                           "A lane of the mask of a Shuffle is out of range");
+                }
+            }
+            llvm::Value *second = popValue(operandType);
+            llvm::Value *first = popValue(operandType);
+            valueStack_.push(irBuilder_.CreateShuffleVector(first, second,
+                                                            llvm::ConstantDataVector::get(context_, mask)));
+        }
+
+        virtual void visitedReduce(const Reduce *expr) override {
+            DataType vectorType = expr->vector()->dataType();
+            checkVector(vectorType);
+            OperationKind op = expr->operation();
+            if(op != OperationKind::Add && op != OperationKind::Mul && op != OperationKind::Min
+               && op != OperationKind::Max) {
+                throw CompileException(CompileError::InvalidVectorOperation,
+                                       "Only Add, Mul, Min and Max can be used to reduce a vector");
+            }
+            llvm::Value *vector = popValue(vectorType);
+
+            //Combines the upper half of the lanes still in use with the lower half until only lane 0 remains.
+            unsigned count = laneCount(vectorType);
+            llvm::Value *undef = llvm::UndefValue::get(vector->getType());
+            for(unsigned width = count / 2; width > 0; width /= 2) {
+                std::vector<uint32_t> mask(count);
+                for(unsigned i = 0; i < count; ++i) {
+                    mask[i] = i + width;
+                }
+                llvm::Value *upper = irBuilder_.CreateShuffleVector(vector, undef,
+                                                                    llvm::ConstantDataVector::get(context_, mask));
+                vector = createOperation(vector, upper, expr->operation(), vectorType);
+            }
+            valueStack_.push(irBuilder_.CreateExtractElement(vector, irBuilder_.getInt32(0)));
+        }
+
+        static void checkVector(DataType dataType) {
+            if(laneCount(dataType) == 1) {
+                throw CompileException(CompileError::InvalidVectorOperation,
+                                       "Expected a vector but found " + to_string(dataType));
+            }
+        }
+
+        static void checkLane(const Expr *scalar, DataType vectorType) {
+            if(scalar->dataType() != laneType(vectorType)) {
+                throw CompileException(CompileError::InvalidVectorOperation,
+                                       "A lane of " + to_string(vectorType) + " cannot hold a "
+                                       + to_string(scalar->dataType()));
+            }
+        }
+
+        static void checkLaneNumber(const Expr *vector, unsigned lane) {
+            checkVector(vector->dataType());
+            if(lane >= laneCount(vector->dataType())) {
+                throw CompileException(CompileError::InvalidVectorOperation,
+                                       to_string(vector->dataType()) + " has no lane " + std::to_string(lane));
+            }
+        }
+
+        static void checkMemoryAccess(const Expr *pointer, DataType elementType) {
+            if(pointer->dataType() != DataType::Pointer) {
+                throw CompileException(CompileError::InvalidMemoryAccess,
+                                       "Memory may only be accessed through a Pointer");
+            }
+            if(elementType == DataType::Void) {
+                throw CompileException(CompileError::InvalidMemoryAccess, "Memory cannot hold a value of type void");
+            }
+        }
+
+        /** Pops the value of an operand, which has none if it is a Return, i.e. (store 0 p (return 1)). */
+        llvm::Value *popValue(DataType dataType) {
+            llvm::Value *value = valueStack_.top();
+            valueStack_.pop();
+            return value ? value : llvm::UndefValue::get(getType(dataType));
+        }
+
+        llvm::Value *castPointer(llvm::Value *pointer, llvm::Type *elementType) {
+            return irBuilder_.CreateBitCast(pointer, elementType->getPointerTo());
+        }
+
+        unsigned getAlignment(unsigned alignment, llvm::Type *elementType) {
+            if(alignment == 0) {
+                return module_->getDataLayout().getABITypeAlignment(elementType);
+            }
+            if((alignment & (alignment - 1)) != 0) {
+                throw CompileException(CompileError::InvalidMemoryAccess, "An alignment must be a power of 2");
+            }
+            return alignment;
+        }
+
+        static void checkSignature(const Invoke *expr, const FunctionSignature &signature) {
+            bool matches = expr->dataType() == signature.returnType
+                           && expr->argumentCount() == signature.parameterTypes.size();
+            for(size_t i = 0; matches && i < expr->argumentCount(); ++i) {
+                matches = expr->argument(i)->dataType() == signature.parameterTypes[i];
+            }
+            if(!matches) {
+                throw CompileException(CompileError::InvokeSignatureMismatch,
+                                       "The return type or arguments of an Invoke do not match function '"
+                                       + string(expr->functionName()) + "'");
+            }
+        }
+
+        /** Converts the value of a condition to an i1, i.e. non-zero is true. */
+        llvm::Value *createCondition(llvm::Value *value) {
+            llvm::Type *type = value->getType();
+            if(type->isVectorTy()) {
+                throw CompileException(CompileError::InvalidVectorOperation, "A condition cannot be a vector");
+            }
+            if(type->isIntegerTy(1)) {
+                return value;
+            } else if(type->isFloatingPointTy()) {
+                return irBuilder_.CreateFCmpONE(value, llvm::ConstantFP::get(type, 0.0));
+            } else {
+                return irBuilder_.CreateICmpNE(value, llvm::ConstantInt::get(type, 0));
+            }
+        }
+
+        /** The arms of a Conditional and the rValue of an And or Or may be evaluated unconditionally if they have at
+         * most this many nodes, see isSpeculatable(). */
+        static constexpr size_t SPECULATED_NODES = 4;
+
+        /** The branch weight of the expected outcome of a Conditional with a hint, relative to 1 for the other
+         * outcome.  This is the weight clang gives __builtin_expect. */
+        static constexpr uint32_t LIKELY_BRANCH_WEIGHT = 2000;
+
+        /** Whether expr is cheap enough to evaluate even when its value is not used and has no side effects, so
+         * that it can be evaluated before it is known whether it is needed.  Div is excluded:  integer division may
+         * trap and neither kind is cheap.  budget is the number of nodes remaining. */
+        static bool isSpeculatable(const Expr *expr, size_t &budget) {
+            if(budget == 0) {
+                return false;
+            }
+            --budget;
+            switch(expr->nodeKind()) {
+                case NodeKind::LiteralInt32:
+                case NodeKind::LiteralFloat:
+                case NodeKind::LiteralInt64:
+                case NodeKind::LiteralDouble:
+                case NodeKind::VariableRef:
+                    return true;
+                case NodeKind::Binary: {
+                    auto binary = static_cast<const Binary*>(expr);
+                    return binary->operation() != OperationKind::Div
+                           && isSpeculatable(binary->lValue(), budget)
+                           && isSpeculatable(binary->rValue(), budget);
+                }
+                case NodeKind::Not:
+                    return isSpeculatable(static_cast<const Not*>(expr)->operand(), budget);
+                case NodeKind::Convert:
+                    return isSpeculatable(static_cast<const Convert*>(expr)->operand(), budget);
+                default:
+                    return false;
+            }
+        }
+
+        /** Whether expr can be compiled to a select instead of a branch:  its arms must both have a value of its type
+         * and be speculatable.  A Conditional with a hint is always compiled to a branch, since the hint says that
+         * it is predictable. */
+        static bool canSelect(const Conditional *expr) {
+            if(expr->branchHint() != BranchHint::None || expr->dataType() == DataType::Void
+               || !expr->truePart() || !expr->falsePart()
+               || expr->truePart()->dataType() != expr->falsePart()->dataType()) {
+                return false;
+            }
+            size_t trueBudget = SPECULATED_NODES;
+            size_t falseBudget = SPECULATED_NODES;
+            return isSpeculatable(expr->truePart(), trueBudget) && isSpeculatable(expr->falsePart(), falseBudget);
+        }
+
+        void visitingTruePart(const Conditional *expr) override {
+            llvm::Value *condition = createCondition(valueStack_.top());
+            valueStack_.pop();
+
+            if(canSelect(expr)) {
+                conditionalStack_.push(ConditionalState{ nullptr, nullptr, valueStack_.size(), scopeStack_, { },
+                                                         condition });
+                return;
+            }
+
+            llvm::BasicBlock *trueBlock = llvm::BasicBlock::Create(context_, "trueBlock", function_);
+            llvm::BasicBlock *falseBlock = llvm::BasicBlock::Create(context_, "falseBlock", function_);
+            llvm::BasicBlock *mergeBlock = llvm::BasicBlock::Create(context_, "mergeBlock", function_);
+            llvm::MDNode *weights = nullptr;
+            if(expr->branchHint() == BranchHint::Likely) {
+                weights = llvm::MDBuilder(context_).createBranchWeights(LIKELY_BRANCH_WEIGHT, 1);
+            } else if(expr->branchHint() == BranchHint::Unlikely) {
+                weights = llvm::MDBuilder(context_).createBranchWeights(1, LIKELY_BRANCH_WEIGHT);
+            }
+            irBuilder_.CreateCondBr(condition, trueBlock, falseBlock, weights);
+
+            conditionalStack_.push(ConditionalState{ falseBlock, mergeBlock, valueStack_.size(), scopeStack_, { } });
+            irBuilder_.SetInsertPoint(trueBlock);
+        }
+
+        void visitingFalsePart(const Conditional *) override {
+            ConditionalState &state = conditionalStack_.top();
+            if(state.selectCondition) {
+                //The value of the true part stays on the stack until visitedConditional.
+                return;
+            }
+            exitArm(state);
+
+            scopeStack_ = state.variablesAtBranch;
+            irBuilder_.SetInsertPoint(state.falseBlock);
+        }
+
+        void visitedConditional(const Conditional *expr) override {
+            ConditionalState &state = conditionalStack_.top();
+            if(state.selectCondition) {
+                llvm::Value *falseValue = popValue(expr->dataType());
+                llvm::Value *trueValue = popValue(expr->dataType());
+                valueStack_.push(irBuilder_.CreateSelect(state.selectCondition, trueValue, falseValue));
+                conditionalStack_.pop();
+                return;
+            }
+            exitArm(state);
+            mergeArms(state, expr->dataType());
+            conditionalStack_.pop();
+        }
+
+        /** Continues in the merge block of state, whose variables and value are merged from the arms which reach
+         * it. */
+        void mergeArms(ConditionalState &state, DataType dataType) {
+            irBuilder_.SetInsertPoint(state.mergeBlock);
+
+            if(state.exits.empty()) {
+                //Every arm returned.
+                scopeStack_ = state.variablesAtBranch;
+                valueStack_.push(nullptr);
+                return;
+            }
+
+            scopeStack_ = mergeVariables(state.exits);
+
+            llvm::Value *value = nullptr;
+            if(dataType != DataType::Void) {
+                value = mergeValues(state.exits, getType(dataType));
+            }
+            valueStack_.push(value);
+        }
+
+        void visitingSwitchCase(const Switch *expr, size_t index) override {
+            if(index == 0) {
+                beginSwitch(expr);
+            } else {
+                exitArm(switchStack_.top().arms);
+            }
+            SwitchState &state = switchStack_.top();
+            scopeStack_ = state.arms.variablesAtBranch;
+            irBuilder_.SetInsertPoint(state.caseBlocks[index]);
+        }
+
+        void visitingSwitchDefault(const Switch *expr) override {
+            if(expr->caseCount() == 0) {
+                beginSwitch(expr);
+            } else {
+                exitArm(switchStack_.top().arms);
+            }
+            SwitchState &state = switchStack_.top();
+            scopeStack_ = state.arms.variablesAtBranch;
+            irBuilder_.SetInsertPoint(state.arms.falseBlock);
+        }
+
+        void visitedSwitch(const Switch *expr) override {
+            SwitchState &state = switchStack_.top();
+            exitArm(state.arms);
+            mergeArms(state.arms, expr->dataType());
+            switchStack_.pop();
+        }
+
+        /** Branches to the block of each case with a switch instruction, which the code generator lowers to a jump
+         * table or a tree of comparisons as suits the case values.  The block of an absent default case is left empty,
+         * like that of an absent part of a Conditional. */
+        void beginSwitch(const Switch *expr) {
+            if(expr->discriminant()->dataType() != DataType::Int32) {
+                throw CompileException(CompileError::InvalidDiscriminant,
+                                       "The discriminant of a Switch must be an Int32");
+            }
+            llvm::Value *discriminant = popValue(DataType::Int32);
+
+            llvm::BasicBlock *defaultBlock = llvm::BasicBlock::Create(context_, "switchDefault", function_);
+            llvm::BasicBlock *mergeBlock = llvm::BasicBlock::Create(context_, "mergeBlock", function_);
+            llvm::SwitchInst *switchInst = irBuilder_.CreateSwitch(discriminant, defaultBlock,
+                                                                   static_cast<unsigned>(expr->caseCount()));
+            std::vector<llvm::BasicBlock*> caseBlocks;
+            caseBlocks.reserve(expr->caseCount());
+            for(size_t i = 0; i < expr->caseCount(); ++i) {
+                caseBlocks.push_back(llvm::BasicBlock::Create(context_, "caseBlock", function_));
+                switchInst->addCase(irBuilder_.getInt32(expr->caseValue(i)), caseBlocks.back());
+            }
+
+            switchStack_.push(SwitchState{
+                ConditionalState{ defaultBlock, mergeBlock, valueStack_.size(), scopeStack_, { } },
+                move(caseBlocks) });
+        }
+
+        /** Records the state of the arm that was just emitted and branches from it to the merge block, unless the
+         * arm returned. */
+        void exitArm(ConditionalState &state) {
+            llvm::Value *value = valueStack_.size() > state.valueStackDepth ? valueStack_.top() : nullptr;
+            popValuesTo(state.valueStackDepth);
+
+            llvm::BasicBlock *block = irBuilder_.GetInsertBlock();
+            if(block->getTerminator()) {
+                return;
+            }
+
+            if(llvm::pred_empty(block)) {
+                //The arm returned so control never reaches the merge block from here.
+                irBuilder_.CreateUnreachable();
+                return;
+            }
+
+            irBuilder_.CreateBr(state.mergeBlock);
+            state.exits.push_back(ArmExit{ block, value, scopeStack_ });
+        }
+
+        ValueScopeStack mergeVariables(const std::vector<ArmExit> &exits) {
+            ValueScopeStack merged = exits.front().variables;
+            for(size_t depth = 0; depth < merged.size(); ++depth) {
+                for(size_t index = 0; index < merged[depth].size(); ++index) {
+                    llvm::Value *&value = merged[depth][index];
+                    bool allSame = true;
+                    for(auto &exit : exits) {
+                        allSame = allSame && exit.variables[depth][index] == value;
+                    }
+                    if(allSame) {
+                        continue;
+                    }
+
+                    llvm::PHINode *phi = irBuilder_.CreatePHI(value->getType(), exits.size(),
+                                                              toStringRef(lexicalScopes_[depth]->variable(index)->name()));
+                    for(auto &exit : exits) {
+                        phi->addIncoming(exit.variables[depth][index], exit.block);
+                    }
+                    value = phi;
+                }
+            }
+            return merged;
+        }
+
+        llvm::Value *mergeValues(const std::vector<ArmExit> &exits, llvm::Type *type) {
+            llvm::PHINode *phi = irBuilder_.CreatePHI(type, exits.size());
+            for(auto &exit : exits) {
+                //An arm which is absent or whose value is void contributes an undefined value.
+                llvm::Value *value = exit.value && exit.value->getType() == type ? exit.value : llvm::UndefValue::get(type);
+                phi->addIncoming(value, exit.block);
+            }
+            return phi;
+        }
+
+        void visitingWhile(const While *) override {
+            beginLoop(false);
+        }
+
+        void visitingWhileBody(const While *) override {
+            enterBody(true);
+        }
+
+        void visitedWhile(const While *) override {
+            LoopState &loop = loopStack_.top();
+            popValuesTo(loop.valueStackDepth);
+            jump(loop.continueBlock, loop.continues);
+            endLoop();
+        }
+
+        void visitingForCondition(const For *expr) override {
+            if(expr->init()) {
+                valueStack_.pop();
+            }
+            beginLoop(expr->update() != nullptr);
+        }
+
+        void visitingForBody(const For *expr) override {
+            enterBody(expr->condition() != nullptr);
+        }
+
+        void visitingForUpdate(const For *expr) override {
+            LoopState &loop = loopStack_.top();
+            popValuesTo(loop.valueStackDepth);
+            jump(loop.continueBlock, loop.continues);
+            if(!expr->update()) {
+                return;
+            }
+
+            //Every Continue and the end of the body lead to the update, which is followed by the next iteration.
+            irBuilder_.SetInsertPoint(loop.continueBlock);
+            if(!loop.continues.empty()) {
+                ValueScopeStack merged = mergeVariables(loop.continues);
+                std::copy(merged.begin(), merged.end(), scopeStack_.begin());
+            }
+            loop.continues.clear();
+        }
+
+        void visitedFor(const For *expr) override {
+            LoopState &loop = loopStack_.top();
+            if(expr->update()) {
+                popValuesTo(loop.valueStackDepth);
+                jump(loop.headerBlock, loop.continues);
+            }
+            endLoop();
+        }
+
+        void visitBreak(const Break *) override {
+            LoopState &loop = innermostLoop("Break");
+            jump(loop.exitBlock, loop.breaks);
+            valueStack_.push(nullptr);
+
+            //Anything following a break is unreachable but must still be emitted into a basic block.
+            irBuilder_.SetInsertPoint(llvm::BasicBlock::Create(context_, "afterBreak", function_));
+        }
+
+        void visitContinue(const Continue *) override {
+            LoopState &loop = innermostLoop("Continue");
+            jump(loop.continueBlock, loop.continues);
+            valueStack_.push(nullptr);
+
+            //Anything following a continue is unreachable but must still be emitted into a basic block.
+            irBuilder_.SetInsertPoint(llvm::BasicBlock::Create(context_, "afterContinue", function_));
+        }
+
+        LoopState &innermostLoop(const char *nodeName) {
+            if(loopStack_.empty()) {
+                throw CompileException(CompileError::LoopControlOutsideLoop,
+                                       string(nodeName) + " is not within the body of a loop");
+            }
+            if(!loopStack_.top().allowsLoopControl) {
+                throw CompileException(CompileError::LoopControlOutsideLoop,
+                                       string(nodeName) + " cannot leave the body of a Map or Fold");
+            }
+            return loopStack_.top();
+        }
+
+        void visitingMapBody(const Map *expr) override {
+            checkRange(expr->index().get(), expr->count());
+            checkMemoryAccess(expr->output(), expr->body()->dataType());
+            llvm::Value *count = popValue(DataType::Int32);
+            llvm::Value *output = popValue(DataType::Pointer);
+            beginRange(bindings_.slotOf(expr), count, output, nullptr);
+        }
+
+        void visitedMap(const Map *expr) override {
+            llvm::Type *elementType = getType(expr->body()->dataType());
+            llvm::Value *value = popValue(expr->body()->dataType());
+            const RangeState &range = rangeStack_.top();
+            if(!irBuilder_.GetInsertBlock()->getTerminator()) {
+                llvm::Value *element = irBuilder_.CreateInBoundsGEP(elementType,
+                                                                    castPointer(range.output, elementType),
+                                                                    range.counter);
+                llvm::StoreInst *store = irBuilder_.CreateStore(value, element);
+                store->setAlignment(getAlignment(0, elementType));
+            }
+            endRange(bindings_.slotOf(expr), nullptr);
+        }
+
+        void visitingFoldBody(const Fold *expr) override {
+            checkRange(expr->index().get(), expr->count());
+            DataType dataType = expr->dataType();
+            if(!isConvertible(dataType)) {
+                throw CompileException(CompileError::InvalidRangeOperation,
+                                       "The body of a Fold must be a scalar integer or floating point value, not "
+                                       + to_string(dataType));
+            }
+            llvm::Value *count = popValue(DataType::Int32);
+            beginRange(bindings_.slotOf(expr), count, nullptr, getIdentity(expr->operation(), dataType));
+        }
+
+        void visitedFold(const Fold *expr) override {
+            llvm::Value *value = popValue(expr->dataType());
+            const RangeState &range = rangeStack_.top();
+            llvm::Value *combined = nullptr;
+            if(!irBuilder_.GetInsertBlock()->getTerminator()) {
+                combined = createOperation(range.accumulator, value, expr->operation(), expr->dataType());
+            }
+            llvm::Value *result = endRange(bindings_.slotOf(expr), combined);
+            valueStack_.pop();
+            valueStack_.push(result);
+        }
+
+        static void checkRange(const Variable *index, const Expr *count) {
+            if(index->dataType() != DataType::Int32 || count->dataType() != DataType::Int32) {
+                throw CompileException(CompileError::InvalidRangeOperation,
+                                       "The index and count of a Map or Fold must be Int32");
+            }
+        }
+
+        /** The value which operation leaves unchanged, i.e. the largest value of dataType for Min. */
+        llvm::Constant *getIdentity(OperationKind operation, DataType dataType) {
+            llvm::Type *type = getType(dataType);
+            bool isFloat = isFloatingPoint(dataType);
+            unsigned bits = type->getPrimitiveSizeInBits();
+            bool isSigned = !isUnsigned(dataType);
+            switch(operation) {
+                case OperationKind::Add:
+                    return isFloat ? llvm::ConstantFP::get(type, 0.0) : llvm::ConstantInt::get(type, 0);
+                case OperationKind::Mul:
+                    return isFloat ? llvm::ConstantFP::get(type, 1.0) : llvm::ConstantInt::get(type, 1);
+                case OperationKind::Min:
+                    return isFloat ? llvm::ConstantFP::getInfinity(type)
+                                   : llvm::ConstantInt::get(context_, isSigned ? llvm::APInt::getSignedMaxValue(bits)
+                                                                               : llvm::APInt::getMaxValue(bits));
+                case OperationKind::Max:
+                    return isFloat ? llvm::ConstantFP::getInfinity(type, true)
+                                   : llvm::ConstantInt::get(context_, isSigned ? llvm::APInt::getSignedMinValue(bits)
+                                                                               : llvm::APInt::getMinValue(bits));
+                default:
+                    throw CompileException(CompileError::InvalidRangeOperation,
+                                           "Only Add, Mul, Min and Max can be used by a Fold");
+            }
+        }
+
+        /** Starts the loop of a Map or Fold:  the index variable counts from 0 while it is less than count, and if
+         * identity is not null it is the initial value of the accumulator. */
+        void beginRange(const VariableSlot &slot, llvm::Value *count, llvm::Value *output, llvm::Constant *identity) {
+            llvm::BasicBlock *preheader = irBuilder_.GetInsertBlock();
+            lookupVariable(slot) = irBuilder_.getInt32(0);
+            beginLoop(false);
+            loopStack_.top().allowsLoopControl = false;
+
+            llvm::Value *counter = lookupVariable(slot);
+            llvm::PHINode *accumulator = nullptr;
+            if(identity) {
+                accumulator = irBuilder_.CreatePHI(identity->getType(), 2, "accumulator");
+                accumulator->addIncoming(identity, preheader);
+            }
+            valueStack_.push(irBuilder_.CreateICmpSLT(counter, count));
+            enterBody(true);
+            rangeStack_.push(RangeState{ counter, output, accumulator });
+        }
+
+        /** Increments the index variable, branches back to the header with a hint for the loop vectorizer and
+         * returns the final value of the accumulator, if any.  combined is the accumulator's value for the next
+         * iteration, which is only used if the end of the body is reachable. */
+        llvm::Value *endRange(const VariableSlot &slot, llvm::Value *combined) {
+            RangeState range = rangeStack_.top();
+            rangeStack_.pop();
+            LoopState &loop = loopStack_.top();
+            if(!irBuilder_.GetInsertBlock()->getTerminator()) {
+                lookupVariable(slot) = irBuilder_.CreateNSWAdd(range.counter, irBuilder_.getInt32(1));
+            }
+            popValuesTo(loop.valueStackDepth);
+
+            size_t edgeCount = loop.continues.size();
+            jump(loop.headerBlock, loop.continues);
+            if(loop.continues.size() > edgeCount) {
+                llvm::BasicBlock *latch = loop.continues.back().block;
+                if(range.accumulator) {
+                    range.accumulator->addIncoming(combined, latch);
+                }
+                latch->getTerminator()->setMetadata(llvm::LLVMContext::MD_loop,
+                                                    getVectorizeHint(range.accumulator != nullptr));
+            }
+            endLoop();
+            return range.accumulator;
+        }
+
+        /** Loop metadata which asks the loop vectorizer to vectorize a loop even if it would otherwise not, which
+         * also allows it to reorder floating point operations.  An interleaved loop keeps a separate accumulator
+         * for each of its interleaved iterations. */
+        llvm::MDNode *getVectorizeHint(bool interleave) {
+            std::vector<llvm::Metadata*> operands{ nullptr };
+            operands.push_back(llvm::MDNode::get(context_, {
+                llvm::MDString::get(context_, "llvm.loop.vectorize.enable"),
+                llvm::ConstantAsMetadata::get(irBuilder_.getTrue()) }));
+            if(interleave) {
+                operands.push_back(llvm::MDNode::get(context_, {
+                    llvm::MDString::get(context_, "llvm.loop.interleave.count"),
+                    llvm::ConstantAsMetadata::get(irBuilder_.getInt32(4)) }));
+            }
+            llvm::MDNode *loopId = llvm::MDNode::getDistinct(context_, operands);
+            loopId->replaceOperandWith(0, loopId);
+            return loopId;
+        }
+
+        /** Branches to a new header block in which the value of each variable is a phi node.  The incoming values of
+         * the phi nodes are added by endLoop, once every edge back to the header is known. */
+        void beginLoop(bool hasUpdateBlock) {
+            llvm::BasicBlock *preheader = irBuilder_.GetInsertBlock();
+            llvm::BasicBlock *header = llvm::BasicBlock::Create(context_, "loopHeader", function_);
+            irBuilder_.CreateBr(header);
+            irBuilder_.SetInsertPoint(header);
+
+            LoopState loop{ header,
+                            hasUpdateBlock ? llvm::BasicBlock::Create(context_, "loopUpdate", function_) : header,
+                            llvm::BasicBlock::Create(context_, "loopExit", function_),
+                            scopeStack_.size(),
+                            valueStack_.size(),
+                            { }, { }, { } };
+
+            for(size_t depth = 0; depth < scopeStack_.size(); ++depth) {
+                loop.headerPhis.emplace_back();
+                for(size_t index = 0; index < scopeStack_[depth].size(); ++index) {
+                    llvm::Value *&value = scopeStack_[depth][index];
+                    llvm::PHINode *phi = irBuilder_.CreatePHI(value->getType(), 2,
+                                                              toStringRef(lexicalScopes_[depth]->variable(index)->name()));
+                    phi->addIncoming(value, preheader);
+                    loop.headerPhis.back().push_back(phi);
+                    value = phi;
+                }
+            }
+            loopStack_.push(move(loop));
+        }
+
+        /** Branches to the loop's body, or out of the loop if hasCondition and the condition's value is false. */
+        void enterBody(bool hasCondition) {
+            LoopState &loop = loopStack_.top();
+            llvm::BasicBlock *body = llvm::BasicBlock::Create(context_, "loopBody", function_);
+            if(hasCondition) {
+                llvm::Value *condition = createCondition(valueStack_.top());
+                valueStack_.pop();
+                loop.breaks.push_back(ArmExit{ irBuilder_.GetInsertBlock(), nullptr, loopVariables(loop) });
+                irBuilder_.CreateCondBr(condition, body, loop.exitBlock);
+            } else {
+                irBuilder_.CreateBr(body);
+            }
+            irBuilder_.SetInsertPoint(body);
+        }
+
+        /** Branches from the current block to target and records the edge, unless control cannot reach the end of
+         * the current block, i.e. it follows a Return, Break or Continue. */
+        void jump(llvm::BasicBlock *target, std::vector<ArmExit> &edges) {
+            llvm::BasicBlock *block = irBuilder_.GetInsertBlock();
+            if(block->getTerminator()) {
+                return;
+            }
+            if(llvm::pred_empty(block)) {
+                irBuilder_.CreateUnreachable();
+                return;
+            }
+            edges.push_back(ArmExit{ block, nullptr, loopVariables(loopStack_.top()) });
+            irBuilder_.CreateBr(target);
+        }
+
+        ValueScopeStack loopVariables(const LoopState &loop) {
+            return ValueScopeStack(scopeStack_.begin(), scopeStack_.begin() + loop.scopeDepth);
+        }
+
+        /** Completes the header's phi nodes and continues in the exit block, whose variables are merged from every
+         * edge leaving the loop. */
+        void endLoop() {
+            LoopState &loop = loopStack_.top();
+            for(auto &edge : loop.continues) {
+                addIncoming(loop.headerPhis, edge);
+            }
+
+            irBuilder_.SetInsertPoint(loop.exitBlock);
+            if(loop.breaks.empty()) {
+                //The loop is never left so the code following it is unreachable;  the variables' values do not
+                //matter as long as they have the right types.
+                std::copy(loop.headerPhis.begin(), loop.headerPhis.end(), scopeStack_.begin());
+            } else {
+                ValueScopeStack merged = mergeVariables(loop.breaks);
+                std::copy(merged.begin(), merged.end(), scopeStack_.begin());
+            }
+            removeRedundantPhis(loop.headerPhis);
+
+            popValuesTo(loop.valueStackDepth);
+            valueStack_.push(nullptr);
+            loopStack_.pop();
+        }
+
+        static void addIncoming(const ValueScopeStack &phis, const ArmExit &edge) {
+            for(size_t depth = 0; depth < phis.size(); ++depth) {
+                for(size_t index = 0; index < phis[depth].size(); ++index) {
+                    llvm::cast<llvm::PHINode>(phis[depth][index])->addIncoming(edge.variables[depth][index], edge.block);
+                }
+            }
+        }
+
+        /** Removes the header phi nodes of variables which the loop does not assign, i.e. those whose incoming
+         * values are all either the same value or the phi node itself.  Removing one may make another redundant,
+         * so this repeats until none are removed. */
+        void removeRedundantPhis(ValueScopeStack &phis) {
+            bool removed = true;
+            while(removed) {
+                removed = false;
+                for(size_t depth = 0; depth < phis.size(); ++depth) {
+                    for(size_t index = 0; index < phis[depth].size(); ++index) {
+                        auto phi = llvm::cast_or_null<llvm::PHINode>(phis[depth][index]);
+                        llvm::Value *replacement = phi ? uniqueIncomingValue(phi) : nullptr;
+                        if(!replacement) {
+                            continue;
+                        }
+                        phi->replaceAllUsesWith(replacement);
+                        for(auto &scope : scopeStack_) {
+                            std::replace(scope.begin(), scope.end(), static_cast<llvm::Value*>(phi), replacement);
+                        }
+                        phi->eraseFromParent();
+                        phis[depth][index] = nullptr;
+                        removed = true;
+                    }
+                }
+            }
+        }
+
+        static llvm::Value *uniqueIncomingValue(llvm::PHINode *phi) {
+            llvm::Value *unique = nullptr;
+            for(llvm::Value *value : phi->incoming_values()) {
+                if(value == phi || value == unique) {
+                    continue;
+                }
+                if(unique) {
+                    return nullptr;
+                }
+                unique = value;
+            }
+            return unique;
         }
 
     }; // class CodeGenVisitor
@@ -293,14 +1564,100 @@ namespace llast {
         }
     }; //SimpleJIT
 
-    //TODO:  make this a PIMPL with a public interface
-    class ExecutionContext {
+    class ExecutionContext::Impl {
         //TODO:  determine if definition order (destruction order) is still significant, and if so
         //update this note to say so.
 
+        /** A function compiled into its own llvm::Module, so that it can be replaced without affecting the others. */
+        struct CompiledFunction {
+            size_t hash;
+            //The functions it was compiled from:  itself and those of the same Module it reaches, in index order.
+            //They confirm that a function whose hash is unchanged is unchanged, since different trees may collide.
+            std::vector<shared_ptr<const FlatAst>> sources;
+            SimpleJIT::ModuleHandle handle;
+            FunctionSignature signature;
+            //The functions of other modules which it invokes through their slots.
+            std::vector<string> slotCallees;
+        };
+
+        /** A function which must be (re)compiled, and its code once it has been generated. */
+        struct PendingFunction {
+            const Function *func;
+            size_t hash;
+            std::vector<shared_ptr<const FlatAst>> sources;
+            unique_ptr<llvm::Module> llvmModule;
+            std::vector<string> slotCallees;
+        };
+
+        /** Holds the address of the current code of a function which is invoked by functions of other modules, so
+         * that those need not be recompiled when it is.  Slots are never freed because their addresses are part of
+         * the generated code. */
+        struct Slot {
+            void *code;
+            FunctionSignature signature;
+            unsigned callers;
+        };
+
+        /** A function of the Module being added and the functions it invokes. */
+        struct FunctionInfo {
+            const Function *func;
+            size_t hash;
+            shared_ptr<const FlatAst> source;
+            size_t nodeCount;
+            //The indexes of the functions of the same Module which it invokes.
+            std::vector<size_t> invoked;
+            //The names it invokes which are not functions of the same Module.
+            std::vector<string_view> otherCallees;
+        };
+
+        /** A function of the host program.  One given as bitcode is compiled by the JIT and is also linked into the
+         * code of each function which invokes it, so that it can be inlined. */
+        struct HostFunction {
+            FunctionSignature signature;
+            void *address;
+            unique_ptr<llvm::Module> bitcode;
+        };
+
+        /** A variant of a function produced by specialize(), with the function and values it was produced from. */
+        struct Specialization {
+            FlatAst func;
+            //The values bound to the parameters of func, in parameter order, and the indexes of those parameters.
+            std::vector<FlatAst> values;
+            std::vector<size_t> slots;
+            string name;
+            uint64_t address;
+
+            bool sameAs(const Specialization &other) const {
+                if(slots != other.slots || !func.structurallyEqual(other.func)) {
+                    return false;
+                }
+                for(size_t i = 0; i < values.size(); ++i) {
+                    if(!values[i].structurallyEqual(other.values[i])) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+        };
+
+        typedef std::map<string, CompiledFunction, std::less<>> FunctionMap;
+
+        /** Functions of at most this many nodes are emitted, for the inliner, into the code of the functions of the
+         * same Module which invoke them. */
+        static constexpr size_t INLINE_CANDIDATE_NODES = 64;
+
         llvm::LLVMContext context_;
         std::unique_ptr<SimpleJIT> jit_ = std::make_unique<SimpleJIT>();
 
+        //The functions of each Module, by module name and then by function name.
+        std::map<string, FunctionMap> modules_;
+        std::map<string, unique_ptr<Slot>, std::less<>> slots_;
+        std::map<string, HostFunction, std::less<>> hostFunctions_;
+        //The variants produced by specialize(), by the structural hashes of their functions and values.
+        std::multimap<size_t, Specialization> specializations_;
+        //Numbers the variants, whose names are never reused even once they are released.
+        size_t variantCount_ = 0;
+
         static void prettyPrint(const Module *module) {
             llast::PrettyPrinterVisitor visitor{std::cout};
             ExpressionTreeWalker walker{&visitor};
@@ -319,18 +1676,487 @@ namespace llast {
             return retval;
         }
 
-        void addModule(const Module *module) {
+        void addHostFunction(const string &name, FunctionSignature signature, void *address) {
+            checkHostFunctionName(name);
+            hostFunctions_.emplace(name, HostFunction{ move(signature), address, nullptr });
+        }
+
+        void addHostFunctionBitcode(const string &name, FunctionSignature signature, string_view bitcode) {
+            checkHostFunctionName(name);
+            llvm::MemoryBufferRef buffer{toStringRef(bitcode), toStringRef(name)};
+            llvm::Expected<unique_ptr<llvm::Module>> parsed = llvm::parseBitcodeFile(buffer, context_);
+            if(!parsed) {
+                throw CompileException(CompileError::InvalidHostFunction,
+                                       "The bitcode of function '" + name + "' could not be read:  "
+                                       + llvm::toString(parsed.takeError()));
+            }
+            unique_ptr<llvm::Module> llvmModule = move(*parsed);
+            llvmModule->setDataLayout(jit_->getTargetMachine().createDataLayout());
+            llvmModule->setTargetTriple(jit_->getTargetMachine().getTargetTriple().str());
+
+            llvm::Function *function = llvmModule->getFunction(name);
+            if(!function || function->isDeclaration() || function->hasLocalLinkage()) {
+                throw CompileException(CompileError::InvalidHostFunction,
+                                       "The bitcode does not define function '" + name + "'");
+            }
+            if(function->getFunctionType() != signature.getLlvmType(context_)) {
+                throw CompileException(CompileError::InvalidHostFunction,
+                                       "The bitcode of function '" + name + "' does not match its signature");
+            }
+
+            unique_ptr<llvm::Module> compiled = llvm::CloneModule(llvmModule.get());
+            optimize(*compiled);
+            jit_->addModule(move(compiled));
+            void *address = reinterpret_cast<void*>(getSymbolAddress(name));
+            hostFunctions_.emplace(name, HostFunction{ move(signature), address, move(llvmModule) });
+        }
+
+        size_t addModule(const Module *module) {
             //prettyPrint(module);
-            llast::CodeGenVisitor visitor{ context_, jit_->getTargetMachine()};
-            ExpressionTreeWalker walker{&visitor};
-            walker.walkTree(module);
+            FlatAst flatAst = FlatAst::fromModule(module);
+            std::vector<size_t> hashes = flatAst.structuralHashes();
+            string moduleName{module->name()};
+
+            //Function names are global to the JIT, so each may be defined by only one Module.
+            std::map<string_view, size_t> indexes;
+            for(size_t i = 0; i < module->functionCount(); ++i) {
+                string_view name = module->function(i)->name();
+                if(!indexes.emplace(name, i).second) {
+                    throw CompileException(CompileError::DuplicateFunctionName,
+                                           "Function '" + string(name) + "' is defined more than once");
+                }
+                if(hostFunctions_.find(name) != hostFunctions_.end()) {
+                    throw CompileException(CompileError::DuplicateFunctionName,
+                                           "Function '" + string(name) + "' is already defined by the host");
+                }
+                const string *owner = findModuleOf(name);
+                if(owner && *owner != moduleName) {
+                    throw CompileException(CompileError::DuplicateFunctionName,
+                                           "Function '" + string(name) + "' is already defined by module '"
+                                           + *owner + "'");
+                }
+            }
+
+            std::vector<FunctionInfo> functions = describeFunctions(module, flatAst, hashes, indexes);
+            FunctionMap &previous = modules_[moduleName];
+
+            //Functions invoked by other modules must remain, with the same signature.
+            for(auto &compiled : previous) {
+                auto slot = slots_.find(compiled.first);
+                if(slot == slots_.end() || slot->second->callers == 0) {
+                    continue;
+                }
+                auto index = indexes.find(compiled.first);
+                if(index == indexes.end()) {
+                    throw CompileException(CompileError::FunctionInUse,
+                                           "Function '" + compiled.first + "' is invoked by another module");
+                }
+                if(FunctionSignature::of(module->function(index->second)) != slot->second->signature) {
+                    throw CompileException(CompileError::InvokeSignatureMismatch,
+                                           "Function '" + compiled.first + "' is invoked by another module with "
+                                           "its previous signature");
+                }
+            }
+
+            CalleeBindings callees = bindCallees(functions, moduleName);
+            VariableBindings bindings = NameResolver().resolve(module);
+
+            //Code is generated for every changed function before the JIT is touched, so that a CompileException
+            //leaves the previous version in place.  A function must also be recompiled when any function of the
+            //same Module it can reach through invocations is, because it is linked directly to their code and may
+            //have inlined it.
+            std::vector<PendingFunction> pending;
+            for(size_t i = 0; i < functions.size(); ++i) {
+                const Function *func = functions[i].func;
+                std::vector<size_t> reached = reachableFrom(functions, i);
+                size_t hash = 0;
+                std::vector<shared_ptr<const FlatAst>> sources;
+                for(size_t j : reached) {
+                    hash ^= functions[j].hash + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+                    sources.push_back(functions[j].source);
+                }
+
+                auto compiled = previous.find(func->name());
+                if(compiled != previous.end() && compiled->second.hash == hash
+                   && sameSources(compiled->second.sources, sources)) {
+                    continue;
+                }
+
+                std::vector<const Function*> inlineCandidates;
+                std::vector<const llvm::Module*> hostBitcode;
+                for(size_t j : reached) {
+                    if(j != i && functions[j].nodeCount <= INLINE_CANDIDATE_NODES) {
+                        inlineCandidates.push_back(functions[j].func);
+                    }
+                    if(j == i || functions[j].nodeCount <= INLINE_CANDIDATE_NODES) {
+                        for(string_view name : functions[j].otherCallees) {
+                            auto host = hostFunctions_.find(name);
+                            if(host != hostFunctions_.end() && host->second.bitcode
+                               && std::find(hostBitcode.begin(), hostBitcode.end(), host->second.bitcode.get())
+                                  == hostBitcode.end()) {
+                                hostBitcode.push_back(host->second.bitcode.get());
+                            }
+                        }
+                    }
+                }
+                std::vector<string> slotCallees;
+                for(string_view name : functions[i].otherCallees) {
+                    auto callee = callees.find(name);
+                    if(callee != callees.end() && callee->second.slot) {
+                        slotCallees.emplace_back(name);
+                    }
+                }
+                pending.push_back(PendingFunction{ func,
+                                                   hash,
+                                                   move(sources),
+                                                   generateCode(func, inlineCandidates, hostBitcode, bindings, callees),
+                                                   move(slotCallees) });
+            }
+
+            for(auto itr = previous.begin(); itr != previous.end();) {
+                if(indexes.count(itr->first) == 0) {
+                    release(itr->second);
+                    auto slot = slots_.find(itr->first);
+                    if(slot != slots_.end()) {
+                        slot->second->code = nullptr;
+                    }
+                    itr = previous.erase(itr);
+                } else {
+                    ++itr;
+                }
+            }
+
+            for(auto &func : pending) {
+                auto compiled = previous.find(func.func->name());
+                if(compiled != previous.end()) {
+                    release(compiled->second);
+                    previous.erase(compiled);
+                }
+                for(auto &callee : func.slotCallees) {
+                    slots_.find(callee)->second->callers++;
+                }
+                previous.emplace(string(func.func->name()),
+                                 CompiledFunction{ func.hash,
+                                                   move(func.sources),
+                                                   jit_->addModule(move(func.llvmModule)),
+                                                   FunctionSignature::of(func.func),
+                                                   move(func.slotCallees) });
+            }
+
+            //Other modules now reach the new code of the recompiled functions through their slots.
+            for(auto &func : pending) {
+                auto slot = slots_.find(func.func->name());
+                if(slot != slots_.end()) {
+                    slot->second->code = reinterpret_cast<void*>(getSymbolAddress(string(func.func->name())));
+                    slot->second->signature = FunctionSignature::of(func.func);
+                }
+            }
+
+            return pending.size();
+        }
+
+        uint64_t specialize(const Function *func, const std::vector<std::pair<string_view, const Expr*>> &values) {
+            FunctionSpecializer specializer;
+            for(auto &value : values) {
+                specializer.bind(value.first, value.second);
+            }
+
+            Specialization key{FlatAst::fromFunction(func), { }, { }, { }, 0};
+            size_t hash = key.func.structuralHashes().back();
+            std::vector<const Expr*> parameterValues = specializer.parameterValues(func);
+            for(size_t slot = 0; slot < parameterValues.size(); ++slot) {
+                if(parameterValues[slot]) {
+                    key.values.push_back(FlatAst::fromExpr(parameterValues[slot]));
+                    key.slots.push_back(slot);
+                    size_t valueHash = key.values.back().structuralHashes().back() + slot;
+                    hash ^= valueHash + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+                }
+            }
+
+            auto range = specializations_.equal_range(hash);
+            for(auto found = range.first; found != range.second; ++found) {
+                if(found->second.sameAs(key)) {
+                    return found->second.address;
+                }
+            }
+
+            //Variants are numbered rather than named after the hash, which another variant may share.
+            string name = string(func->name()) + "$" + std::to_string(variantCount_++);
+            unique_ptr<const Module> variant = ModuleBuilder{name}
+                    .addFunction(specializer.specialize(func, SymbolTable::global().intern(name)))
+                    .build();
+            addModule(variant.get());
+            key.name = name;
+            key.address = getSymbolAddress(name);
+            return specializations_.emplace(hash, move(key))->second.address;
+        }
+
+        bool releaseSpecialization(uint64_t address) {
+            auto variant = specializations_.begin();
+            while(variant != specializations_.end() && variant->second.address != address) {
+                ++variant;
+            }
+            if(variant == specializations_.end()) {
+                return false;
+            }
+
+            const string &name = variant->second.name;
+            auto slot = slots_.find(name);
+            if(slot != slots_.end()) {
+                if(slot->second->callers != 0) {
+                    throw CompileException(CompileError::FunctionInUse,
+                                           "Function '" + name + "' is invoked by another module");
+                }
+                slot->second->code = nullptr;
+            }
+            //Each variant is the only function of a Module of the same name.
+            auto module = modules_.find(name);
+            for(auto &compiled : module->second) {
+                release(compiled.second);
+            }
+            modules_.erase(module);
+            specializations_.erase(variant);
+            return true;
+        }
+
+    private:
+        void checkHostFunctionName(const string &name) const {
+            if(hostFunctions_.find(name) != hostFunctions_.end() || findModuleOf(name)) {
+                throw CompileException(CompileError::DuplicateFunctionName,
+                                       "Function '" + name + "' is already defined");
+            }
+        }
+
+        const string *findModuleOf(string_view functionName) const {
+            for(auto &module : modules_) {
+                if(module.second.find(functionName) != module.second.end()) {
+                    return &module.first;
+                }
+            }
+            return nullptr;
+        }
+
+        /** The nodes of each function are contiguous in flatAst, in post-order, so its invocations are found
+         * without walking the tree. */
+        static std::vector<FunctionInfo> describeFunctions(const Module *module,
+                                                           const FlatAst &flatAst,
+                                                           const std::vector<size_t> &hashes,
+                                                           const std::map<string_view, size_t> &indexes) {
+            std::vector<FunctionInfo> functions;
+            FlatAst::Index first = 0;
+            for(uint32_t i = 0; i < module->functionCount(); ++i) {
+                FlatAst::Index funcNode = flatAst.child(flatAst.root(), i);
+                FunctionInfo info{ module->function(i),
+                                   hashes[funcNode],
+                                   std::make_shared<const FlatAst>(FlatAst::fromFunction(module->function(i))),
+                                   funcNode + 1 - first,
+                                   { },
+                                   { } };
+                for(FlatAst::Index node = first; node < funcNode; ++node) {
+                    if(flatAst.kind(node) != NodeKind::Invoke) {
+                        continue;
+                    }
+                    string_view callee = flatAst.name(node).str();
+                    auto index = indexes.find(callee);
+                    if(index != indexes.end()) {
+                        info.invoked.push_back(index->second);
+                    } else {
+                        info.otherCallees.push_back(callee);
+                    }
+                }
+                std::sort(info.invoked.begin(), info.invoked.end());
+                info.invoked.erase(std::unique(info.invoked.begin(), info.invoked.end()), info.invoked.end());
+                std::sort(info.otherCallees.begin(), info.otherCallees.end());
+                info.otherCallees.erase(std::unique(info.otherCallees.begin(), info.otherCallees.end()),
+                                        info.otherCallees.end());
+                functions.push_back(move(info));
+                first = funcNode + 1;
+            }
+            return functions;
+        }
+
+        static bool sameSources(const std::vector<shared_ptr<const FlatAst>> &a,
+                                const std::vector<shared_ptr<const FlatAst>> &b) {
+            if(a.size() != b.size()) {
+                return false;
+            }
+            for(size_t i = 0; i < a.size(); ++i) {
+                if(!a[i]->structurallyEqual(*b[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /** Returns the indexes of the functions which functions[start] can reach through invocations, including
+         * itself, in ascending order. */
+        static std::vector<size_t> reachableFrom(const std::vector<FunctionInfo> &functions, size_t start) {
+            std::vector<bool> reached(functions.size());
+            std::vector<size_t> pending{ start };
+            std::vector<size_t> result;
+            reached[start] = true;
+            while(!pending.empty()) {
+                size_t i = pending.back();
+                pending.pop_back();
+                result.push_back(i);
+                for(size_t callee : functions[i].invoked) {
+                    if(!reached[callee]) {
+                        reached[callee] = true;
+                        pending.push_back(callee);
+                    }
+                }
+            }
+            std::sort(result.begin(), result.end());
+            return result;
+        }
+
+        /** Functions of the Module being added are invoked directly.  Functions of other modules are invoked through
+         * their slots, which are created as needed.  Host functions are invoked at their address, or directly when
+         * their bitcode is linked into the caller's code.  Names which are none of these are left unbound, so that
+         * code generation fails if it reaches an Invoke of one. */
+        CalleeBindings bindCallees(const std::vector<FunctionInfo> &functions, const string &moduleName) {
+            CalleeBindings callees;
+            for(auto &info : functions) {
+                callees.emplace(string(info.func->name()), CalleeBinding{ FunctionSignature::of(info.func), nullptr, nullptr });
+            }
+            for(auto &info : functions) {
+                for(string_view name : info.otherCallees) {
+                    auto host = hostFunctions_.find(name);
+                    if(host != hostFunctions_.end()) {
+                        callees.emplace(string(name),
+                                        CalleeBinding{ host->second.signature,
+                                                       nullptr,
+                                                       host->second.bitcode ? nullptr : host->second.address });
+                        continue;
+                    }
+                    const string *owner = findModuleOf(name);
+                    if(!owner || *owner == moduleName || callees.find(name) != callees.end()) {
+                        continue;
+                    }
+                    auto slot = slots_.find(name);
+                    if(slot == slots_.end()) {
+                        const CompiledFunction &compiled = modules_[*owner].find(name)->second;
+                        void *code = reinterpret_cast<void*>(getSymbolAddress(string(name)));
+                        slot = slots_.emplace(string(name),
+                                              std::make_unique<Slot>(Slot{ code, compiled.signature, 0 })).first;
+                    }
+                    callees.emplace(string(name), CalleeBinding{ slot->second->signature, &slot->second->code, nullptr });
+                }
+            }
+            return callees;
+        }
+
+        void release(CompiledFunction &compiled) {
+            for(auto &callee : compiled.slotCallees) {
+                slots_.find(callee)->second->callers--;
+            }
+            jit_->removeModule(compiled.handle);
+        }
+
+        /** The definitions of inlineCandidates and of the host functions in hostBitcode are emitted along with func's
+         * so that they can be inlined.  Their linkage keeps them from being compiled a second time:  a call which is
+         * not inlined still reaches the function's own code. */
+        unique_ptr<llvm::Module> generateCode(const Function *func,
+                                              const std::vector<const Function*> &inlineCandidates,
+                                              const std::vector<const llvm::Module*> &hostBitcode,
+                                              const VariableBindings &bindings,
+                                              const CalleeBindings &callees) {
+            llast::CodeGenVisitor visitor{ context_, jit_->getTargetMachine(), bindings, callees };
+            visitor.startModule(func->name());
+            IterativeExpressionTreeWalker walker{&visitor};
+            walker.walkTree(func);
+            for(const Function *candidate : inlineCandidates) {
+                walker.walkTree(candidate);
+            }
 
-            //visitor.dumpIR();
             unique_ptr<llvm::Module> llvmModule = visitor.releaseLlvmModuleOwnership();
-            jit_->addModule(move(llvmModule));
+            for(const Function *candidate : inlineCandidates) {
+                llvmModule->getFunction(toStringRef(candidate->name()))
+                        ->setLinkage(llvm::GlobalValue::AvailableExternallyLinkage);
+            }
+            for(const llvm::Module *bitcode : hostBitcode) {
+                unique_ptr<llvm::Module> copy = llvm::CloneModule(bitcode);
+                for(llvm::GlobalValue &global : copy->global_values()) {
+                    if(!global.isDeclaration() && !global.hasLocalLinkage() && llvm::isa<llvm::GlobalObject>(global)) {
+                        llvm::cast<llvm::GlobalObject>(global).setComdat(nullptr);
+                        global.setLinkage(llvm::GlobalValue::AvailableExternallyLinkage);
+                    }
+                }
+                if(llvm::Linker::linkModules(*llvmModule, move(copy), llvm::Linker::LinkOnlyNeeded)) {
+                    throw FatalException("Linking the bitcode of a host function failed");
+                }
+            }
+            optimize(*llvmModule);
+            //visitor.dumpIR();
+            return llvmModule;
+        }
+
+        /** Runs the -O2 pipeline, which includes inlining, loop unrolling and vectorization, with the target's cost
+         * model. */
+        void optimize(llvm::Module &llvmModule) {
+            llvm::TargetMachine &targetMachine = jit_->getTargetMachine();
+            llvm::PassManagerBuilder builder;
+            builder.OptLevel = 2;
+            builder.Inliner = llvm::createFunctionInliningPass(builder.OptLevel, builder.SizeLevel, false);
+            builder.LoopVectorize = true;
+            builder.SLPVectorize = true;
+            targetMachine.adjustPassManager(builder);
+
+            llvm::legacy::FunctionPassManager functionPasses{&llvmModule};
+            functionPasses.add(llvm::createTargetTransformInfoWrapperPass(targetMachine.getTargetIRAnalysis()));
+            builder.populateFunctionPassManager(functionPasses);
+
+            llvm::legacy::PassManager modulePasses;
+            modulePasses.add(llvm::createTargetTransformInfoWrapperPass(targetMachine.getTargetIRAnalysis()));
+            builder.populateModulePassManager(modulePasses);
+
+            functionPasses.doInitialization();
+            for(llvm::Function &function : llvmModule) {
+                functionPasses.run(function);
+            }
+            functionPasses.doFinalization();
+            modulePasses.run(llvmModule);
         }
     };
 
+    ExecutionContext::ExecutionContext() : impl_{std::make_unique<Impl>()} { }
+
+    ExecutionContext::~ExecutionContext() { }
+
+    size_t ExecutionContext::addModule(const Module *module) {
+        ARG_NOT_NULL(module);
+        return impl_->addModule(module);
+    }
+
+    void ExecutionContext::addHostFunction(const std::string &name,
+                                           DataType returnType,
+                                           std::vector<DataType> parameterTypes,
+                                           void *address) {
+        ARG_NOT_NULL(address);
+        impl_->addHostFunction(name, FunctionSignature{ returnType, move(parameterTypes) }, address);
+    }
+
+    void ExecutionContext::addHostFunctionBitcode(const std::string &name,
+                                                  DataType returnType,
+                                                  std::vector<DataType> parameterTypes,
+                                                  string_view bitcode) {
+        impl_->addHostFunctionBitcode(name, FunctionSignature{ returnType, move(parameterTypes) }, bitcode);
+    }
+
+    uint64_t ExecutionContext::specialize(const Function *func,
+                                          const std::vector<std::pair<string_view, const Expr*>> &values) {
+        ARG_NOT_NULL(func);
+        return impl_->specialize(func, values);
+    }
+
+    bool ExecutionContext::releaseSpecialization(uint64_t address) {
+        return impl_->releaseSpecialization(address);
+    }
+
+    uint64_t ExecutionContext::getSymbolAddress(const std::string &name) {
+        return impl_->getSymbolAddress(name);
+    }
+
     namespace ExprRunner {
 
         void init() {
@@ -342,7 +2168,7 @@ namespace llast {
         namespace {
             const string FUNC_NAME = "exprFunc";
 
-            std::unique_ptr<ExecutionContext> makeExecutionContext(unique_ptr<const Expr> expr) {
+            std::unique_ptr<ExecutionContext> makeExecutionContext(ChildPtr<const Expr> expr) {
                 FunctionBuilder fb{FUNC_NAME, expr->dataType()};
                 BlockBuilder &bb = fb.blockBuilder();
                 bb.addExpression(move(expr));
@@ -356,7 +2182,7 @@ namespace llast {
             }
         }
 
-        void compile(unique_ptr<const Expr> expr) {
+        void compile(ChildPtr<const Expr> expr) {
             FunctionBuilder fb{"someFunc", expr->dataType() };
             BlockBuilder &bb = fb.blockBuilder();
             bb.addExpression(move(expr));
@@ -367,12 +2193,29 @@ namespace llast {
             std::unique_ptr<const Module> m{mb.build()};
             llvm::LLVMContext ctx;
             auto tm = unique_ptr<llvm::TargetMachine>(llvm::EngineBuilder().selectTarget());
-            llast::CodeGenVisitor visitor{ctx, *tm.get()};
-            ExpressionTreeWalker walker{&visitor};
+            VariableBindings bindings = NameResolver().resolve(m.get());
+            CalleeBindings callees;
+            llast::CodeGenVisitor visitor{ctx, *tm.get(), bindings, callees};
+            IterativeExpressionTreeWalker walker{&visitor};
             walker.walkTree(m.get());
         }
 
-        float runFloatExpr(unique_ptr<const Expr> expr) {
+        string generateLlvmIr(const Module *module) {
+            llvm::LLVMContext ctx;
+            auto tm = unique_ptr<llvm::TargetMachine>(llvm::EngineBuilder().selectTarget());
+            VariableBindings bindings = NameResolver().resolve(module);
+            CalleeBindings callees;
+            llast::CodeGenVisitor visitor{ctx, *tm.get(), bindings, callees};
+            IterativeExpressionTreeWalker walker{&visitor};
+            walker.walkTree(module);
+
+            string ir;
+            llvm::raw_string_ostream stream{ir};
+            visitor.releaseLlvmModuleOwnership()->print(stream, nullptr);
+            return stream.str();
+        }
+
+        float runFloatExpr(ChildPtr<const Expr> expr) {
             typedef float (*FloatFuncPtr)(void);
 
             if(expr->dataType() != DataType::Float) {
@@ -385,7 +2228,7 @@ namespace llast {
             return retval;
         }
 
-        int runInt32Expr(unique_ptr<const Expr> expr) {
+        int runInt32Expr(ChildPtr<const Expr> expr) {
             typedef int (*IntFuncPtr)(void);
 
             if(expr->dataType() != DataType::Int32) {
@@ -5,6 +5,90 @@
 
 namespace llast {
 
+    /** Compiles Modules to machine code and looks up the addresses of their functions.
+     *
+     * Each function is compiled separately and keeps the tree it was compiled from as a FlatAst, with its structural
+     * hash (see FlatAst::structuralHashes()).  Adding a Module with the same name as one added previously replaces
+     * that version:  only functions which are new or whose tree changed are recompiled, as found by comparing hashes
+     * and then the trees whose hashes match, the machine code of unchanged functions is left in place and functions
+     * no longer present are removed.  The addresses of replaced and removed functions become invalid.
+     *
+     * Function names are unique across all of the Modules added, and an Invoke may name a function of any of them.
+     * Invocations within a Module are direct and a function is recompiled along with any function of its Module it
+     * invokes.  Invocations of another Module's functions go through the address of its current code, so they keep
+     * working when it is recompiled;  a function invoked this way may not be removed or have its signature changed.
+     *
+     * Functions of the host program may also be invoked once they are added.  Their names share the same namespace.
+     */
+    class ExecutionContext {
+        class Impl;
+        std::unique_ptr<Impl> impl_;
+    public:
+        ExecutionContext();
+        ~ExecutionContext();
+
+        /** Returns the number of functions which were compiled.  Throws CompileException, in which case the
+         * previously added version of the Module is left unchanged. */
+        size_t addModule(const Module *module);
+
+        /** Makes the host function at address invokable as name.  Its C calling convention must take and return
+         * the native types of parameterTypes and returnType.  Throws CompileException if name is already defined. */
+        void addHostFunction(const std::string &name,
+                             DataType returnType,
+                             std::vector<DataType> parameterTypes,
+                             void *address);
+
+        template<typename R, typename... Args>
+        void addHostFunction(const std::string &name, R (*function)(Args...)) {
+            addHostFunction(name, HostType<R>::dataType, { HostType<Args>::dataType... },
+                            reinterpret_cast<void*>(function));
+        }
+
+        /** Makes the function named name, defined by the LLVM bitcode module in bitcode, invokable.  The module is
+         * compiled once, and is also linked into the code of each function invoking name so that the optimizer can
+         * inline it.  Since an inlined copy does not share the module's internal globals, the function should not
+         * keep state in them.  Throws CompileException if name is already defined, the bitcode cannot be read or
+         * does not define name with the given signature. */
+        void addHostFunctionBitcode(const std::string &name,
+                                    DataType returnType,
+                                    std::vector<DataType> parameterTypes,
+                                    string_view bitcode);
+
+        /** Compiles a variant of func in which the parameters named by values have those values (see
+         * FunctionSpecializer) and returns the address of its code, which takes the remaining parameters.  Variants are
+         * cached by the structure of func and of the values, so specializing the same function with equal values again
+         * returns the code compiled the first time;  callers on a hot path should still keep the address rather than
+         * ask again.  Each variant is compiled as a Module of its own, so functions of func's Module which it invokes
+         * may not be removed until it is released.  Variants are kept until releaseSpecialization() is called, so a
+         * caller producing them from an unbounded set of values must release those it no longer needs.  Throws
+         * CompileException. */
+        uint64_t specialize(const Function *func, const std::vector<std::pair<string_view, const Expr*>> &values);
+
+        /** Frees the code of the variant at address, as returned by specialize(), which must no longer be invoked, and
+         * lets the functions it invokes be removed again.  Specializing with the same values afterwards compiles a new
+         * variant.  Returns false if address is not that of a variant.  Throws CompileException if another module
+         * invokes the variant. */
+        bool releaseSpecialization(uint64_t address);
+
+        /** Returns 0 if no function named name has been compiled. */
+        uint64_t getSymbolAddress(const std::string &name);
+
+    private:
+        /** The DataType corresponding to each C++ type which a host function may take or return. */
+        template<typename T> struct HostType;
+    };
+
+    template<> struct ExecutionContext::HostType<void> { static constexpr DataType dataType = DataType::Void; };
+    template<> struct ExecutionContext::HostType<bool> { static constexpr DataType dataType = DataType::Bool; };
+    template<> struct ExecutionContext::HostType<int32_t> { static constexpr DataType dataType = DataType::Int32; };
+    template<> struct ExecutionContext::HostType<int64_t> { static constexpr DataType dataType = DataType::Int64; };
+    template<> struct ExecutionContext::HostType<uint32_t> { static constexpr DataType dataType = DataType::UInt32; };
+    template<> struct ExecutionContext::HostType<uint64_t> { static constexpr DataType dataType = DataType::UInt64; };
+    template<> struct ExecutionContext::HostType<float> { static constexpr DataType dataType = DataType::Float; };
+    template<> struct ExecutionContext::HostType<double> { static constexpr DataType dataType = DataType::Double; };
+    template<typename T> struct ExecutionContext::HostType<T*> {
+        static constexpr DataType dataType = DataType::Pointer;
+    };
 
     namespace ExprRunner {
 
@@ -12,10 +96,14 @@ namespace llast {
 
         /** Just attempts to compile expr and discards any results. Used by to see if expr contains any
          * conditions that can throw CompileException.  TODO:  remove from public API. */
-        void compile(std::unique_ptr<const Expr> expr);
+        void compile(ChildPtr<const Expr> expr);
+
+        /** Returns the LLVM IR generated for module, before it is optimized, as text.  Lets tests check details of
+         * code generation which need not change results, such as fast-math flags.  Throws CompileException. */
+        string generateLlvmIr(const Module *module);
 
-        float runFloatExpr(std::unique_ptr<const Expr> expr);
-        int runInt32Expr(std::unique_ptr<const Expr> expr);
+        float runFloatExpr(ChildPtr<const Expr> expr);
+        int runInt32Expr(ChildPtr<const Expr> expr);
     }
 }
 
@@ -0,0 +1,684 @@
+#pragma once
+
+#include "AST.hpp"
+
+namespace llast {
+
+    /** Base class for passes which produce a new tree from an existing one.  Since AST nodes may not be modified
+     * after they are created, a transformation always builds new nodes.  The default implementation of each
+     * transform member function returns a deep copy of its argument, so subclasses need only override the member
+     * functions for the node types they actually rewrite.  Variables are shared between the original and the new
+     * tree.
+     *
+     * A transformer given an AstContext allocates the new nodes in it and shares structure with the original tree:
+     * an arena-allocated subtree which the transformation leaves unchanged is referenced by the new tree instead of
+     * being copied, so rewriting a single leaf copies only the nodes on the path to it.  Arena-allocated nodes are
+     * never destroyed individually (see ChildDeleter), which is what makes this safe;  heap-allocated nodes are
+     * always copied.  The AstContext of the original tree must then outlive the new one.  The node a transformation
+     * starts from is always copied, so the result never refers to a node of the original tree.
+     *
+     * When sharing, transform() may return a node of the original tree.  Results are therefore ChildPtrs, which never
+     * destroy arena-allocated nodes, so an override may discard the result of a transformation it does not use.
+     *
+     * A transformation does not recurse:  as in StaticExpressionTreeWalker, the path from the node it starts from to
+     * the current node is kept on an explicit stack, so the depth of a tree is limited only by available memory.  The
+     * children of a node are therefore transformed before the member function for the node is invoked, which receives
+     * their results from transform(), in any order.  Every child is transformed even if that member function never
+     * asks for its result.  Calling transform() again for the same child, or for any other node, starts a separate
+     * transformation of it.
+     */
+    class ExpressionTreeTransformer {
+        AstContext *context_;
+
+        //The number of transformations in progress and the node the first one started from, which is never shared.
+        unsigned depth_ = 0;
+        const Node *start_ = nullptr;
+
+        struct DepthGuard {
+            unsigned &depth;
+            DepthGuard(unsigned &depth) : depth{depth} { ++depth; }
+            ~DepthGuard() { --depth; }
+        };
+
+        struct Frame {
+            const Expr *expr;
+            /** The index of the next child to transform, as passed to childAt(). */
+            size_t next;
+            /** The index in results_ of the result of the first child. */
+            size_t firstResult;
+        };
+
+        struct Result {
+            /** Null once the result has been returned by transform(). */
+            const Expr *original;
+            ChildPtr<const Expr> transformed;
+        };
+
+        //The nodes being transformed, from the root down, and the results of the children of each which have been
+        //transformed.  Both are reused by subsequent transformations.
+        std::vector<Frame> frames_;
+        std::vector<Result> results_;
+
+        //The range of results_ holding the results of the children of the node whose member function is running.
+        size_t firstChildResult_ = 0;
+        size_t endChildResult_ = 0;
+
+        /** Restores the stacks, also if a member function throws, and the range of child results of the member
+         * function which started the transformation, if any. */
+        struct StackGuard {
+            ExpressionTreeTransformer &transformer;
+            size_t frames;
+            size_t results;
+            size_t firstChildResult;
+            size_t endChildResult;
+
+            StackGuard(ExpressionTreeTransformer &transformer)
+                : transformer{transformer},
+                  frames{transformer.frames_.size()},
+                  results{transformer.results_.size()},
+                  firstChildResult{transformer.firstChildResult_},
+                  endChildResult{transformer.endChildResult_} { }
+
+            ~StackGuard() {
+                transformer.frames_.resize(frames);
+                transformer.results_.resize(results);
+                transformer.firstChildResult_ = firstChildResult;
+                transformer.endChildResult_ = endChildResult;
+            }
+        };
+
+    public:
+        ExpressionTreeTransformer() : context_{nullptr} { }
+
+        /** New nodes are allocated in context and unchanged subtrees are shared with the original tree. */
+        ExpressionTreeTransformer(AstContext &context) : context_{&context} { }
+
+        virtual ~ExpressionTreeTransformer() { }
+
+        virtual unique_ptr<const Module> transformModule(const Module *module) {
+            ARG_NOT_NULL(module);
+            DepthGuard guard{depth_};
+            if(depth_ == 1) {
+                start_ = module;
+                initialize(module);
+            }
+            ModuleBuilder mb = context_ ? ModuleBuilder{*context_, module->name()} : ModuleBuilder{module->symbol()};
+            module->forEachFunction([&](const Function *func) { mb.addFunction(transformFunction(func)); });
+            return mb.build();
+        }
+
+        virtual ChildPtr<const Function> transformFunction(const Function *func) {
+            ARG_NOT_NULL(func);
+            DepthGuard guard{depth_};
+            if(depth_ == 1) {
+                start_ = func;
+                initialize(func);
+            }
+            ChildPtr<const Expr> body = transform(func->body());
+            if(canShare(func) && body.get() == func->body()) {
+                return share(func);
+            }
+            return makeIn<const Function>(context_,
+                                          func->symbol(),
+                                          func->returnType(),
+                                          copyScope(func->parameterScope()),
+                                          move(body),
+                                          func->floatSemantics());
+        }
+
+        ChildPtr<const Expr> transform(const Expr *expr) {
+            ARG_NOT_NULL(expr);
+            if(ChildPtr<const Expr> *result = childResult(expr)) {
+                return move(*result);
+            }
+
+            DepthGuard guard{depth_};
+            if(depth_ == 1) {
+                start_ = expr;
+                initialize(expr);
+            }
+            StackGuard stackGuard{*this};
+
+            //Frames below base belong to a transformation which is in progress, i.e. if a member function started
+            //another one.
+            size_t base = frames_.size();
+            frames_.push_back(Frame{expr, 0, results_.size()});
+            while(frames_.size() > base) {
+                Frame &frame = frames_.back();
+                if(const Expr *child = nextChild(frame)) {
+                    frames_.push_back(Frame{child, 0, results_.size()});
+                } else {
+                    const Expr *node = frame.expr;
+                    size_t firstResult = frame.firstResult;
+                    frames_.pop_back();
+
+                    firstChildResult_ = firstResult;
+                    endChildResult_ = results_.size();
+                    ChildPtr<const Expr> result = transformNode(node);
+                    results_.erase(results_.begin() + firstResult, results_.end());
+                    results_.push_back(Result{node, move(result)});
+                }
+            }
+
+            ChildPtr<const Expr> result = move(results_.back().transformed);
+            results_.pop_back();
+            return result;
+        }
+
+    protected:
+        AstContext *context() const { return context_; }
+
+        /** Invoked at the start of each transformation which is not part of another, with the node it starts from,
+         * i.e. to discard state kept from a previous tree. */
+        virtual void initialize(const Node *) { }
+
+        /** True if node may be referenced by the new tree as it is, provided none of its children changed. */
+        bool canShare(const Node *node) const {
+            return context_ != nullptr
+                   && node != start_
+                   && ArenaAllocatable::allocationOf(node) == ArenaAllocatable::Allocation::Arena;
+        }
+
+        /** Sets child to the child of expr at index, in the order in which the member functions transform them, or to
+         * null for an absent part of a Conditional, For or Switch.  Returns false if expr has no child at index. */
+        static bool childAt(const Expr *expr, size_t index, const Expr *&child) {
+            switch(expr->nodeKind()) {
+                case NodeKind::Binary: {
+                    auto binary = static_cast<const Binary*>(expr);
+                    return pick({ binary->lValue(), binary->rValue() }, index, child);
+                }
+                case NodeKind::Not:
+                    return pick({ static_cast<const Not*>(expr)->operand() }, index, child);
+                case NodeKind::Convert:
+                    return pick({ static_cast<const Convert*>(expr)->operand() }, index, child);
+                case NodeKind::CheckedBinary: {
+                    auto checked = static_cast<const CheckedBinary*>(expr);
+                    return pick({ checked->lValue(), checked->rValue(), checked->overflow() }, index, child);
+                }
+                case NodeKind::Invoke: {
+                    auto invoke = static_cast<const Invoke*>(expr);
+                    child = index < invoke->argumentCount() ? invoke->argument(index) : nullptr;
+                    return index < invoke->argumentCount();
+                }
+                case NodeKind::Load:
+                    return pick({ static_cast<const Load*>(expr)->pointer() }, index, child);
+                case NodeKind::Store: {
+                    auto store = static_cast<const Store*>(expr);
+                    return pick({ store->pointer(), store->valueExpr() }, index, child);
+                }
+                case NodeKind::Index: {
+                    auto indexExpr = static_cast<const Index*>(expr);
+                    return pick({ indexExpr->pointer(), indexExpr->index() }, index, child);
+                }
+                case NodeKind::Splat:
+                    return pick({ static_cast<const Splat*>(expr)->scalar() }, index, child);
+                case NodeKind::ExtractLane:
+                    return pick({ static_cast<const ExtractLane*>(expr)->vector() }, index, child);
+                case NodeKind::InsertLane: {
+                    auto insertLane = static_cast<const InsertLane*>(expr);
+                    return pick({ insertLane->vector(), insertLane->scalar() }, index, child);
+                }
+                case NodeKind::Shuffle: {
+                    auto shuffle = static_cast<const Shuffle*>(expr);
+                    return pick({ shuffle->first(), shuffle->second() }, index, child);
+                }
+                case NodeKind::Reduce:
+                    return pick({ static_cast<const Reduce*>(expr)->vector() }, index, child);
+                case NodeKind::Block: {
+                    auto block = static_cast<const Block*>(expr);
+                    child = index < block->size() ? block->expression(index) : nullptr;
+                    return index < block->size();
+                }
+                case NodeKind::Conditional: {
+                    auto conditional = static_cast<const Conditional*>(expr);
+                    return pick({ conditional->condition(), conditional->truePart(), conditional->falsePart() },
+                                index, child);
+                }
+                case NodeKind::Switch: {
+                    auto switchExpr = static_cast<const Switch*>(expr);
+                    if(index == 0) {
+                        child = switchExpr->discriminant();
+                    } else if(index <= switchExpr->caseCount()) {
+                        child = switchExpr->caseExpr(index - 1);
+                    } else {
+                        child = switchExpr->defaultCase();
+                        return index == switchExpr->caseCount() + 1;
+                    }
+                    return true;
+                }
+                case NodeKind::While: {
+                    auto loop = static_cast<const While*>(expr);
+                    return pick({ loop->condition(), loop->body() }, index, child);
+                }
+                case NodeKind::For: {
+                    auto loop = static_cast<const For*>(expr);
+                    return pick({ loop->init(), loop->condition(), loop->body(), loop->update() }, index, child);
+                }
+                case NodeKind::Map: {
+                    auto map = static_cast<const Map*>(expr);
+                    return pick({ map->output(), map->count(), map->body() }, index, child);
+                }
+                case NodeKind::Fold: {
+                    auto fold = static_cast<const Fold*>(expr);
+                    return pick({ fold->count(), fold->body() }, index, child);
+                }
+                case NodeKind::AssignVariable:
+                    return pick({ static_cast<const AssignVariable*>(expr)->valueExpr() }, index, child);
+                case NodeKind::Return:
+                    return pick({ static_cast<const Return*>(expr)->valueExpr() }, index, child);
+                default:
+                    child = nullptr;
+                    return false;
+            }
+        }
+
+        template<typename T>
+        static ChildPtr<const T> share(const T *node) {
+            return ChildPtr<const T>(node);
+        }
+
+        unique_ptr<const Scope> copyScope(const Scope *scope) const {
+            ScopeBuilder sb = context_ ? ScopeBuilder{*context_} : ScopeBuilder{};
+            scope->forEachVariable([&](const shared_ptr<const Variable> &var) { sb.addVariable(var); });
+            return sb.build();
+        }
+
+        virtual ChildPtr<const Expr> transformLiteralInt32(const LiteralInt32 *expr) {
+            if(canShare(expr)) {
+                return share(expr);
+            }
+            return makeIn<const LiteralInt32>(context_, expr->value());
+        }
+
+        virtual ChildPtr<const Expr> transformLiteralFloat(const LiteralFloat *expr) {
+            if(canShare(expr)) {
+                return share(expr);
+            }
+            return makeIn<const LiteralFloat>(context_, expr->value());
+        }
+
+        virtual ChildPtr<const Expr> transformLiteralInt64(const LiteralInt64 *expr) {
+            if(canShare(expr)) {
+                return share(expr);
+            }
+            return makeIn<const LiteralInt64>(context_, expr->value());
+        }
+
+        virtual ChildPtr<const Expr> transformLiteralDouble(const LiteralDouble *expr) {
+            if(canShare(expr)) {
+                return share(expr);
+            }
+            return makeIn<const LiteralDouble>(context_, expr->value());
+        }
+
+        virtual ChildPtr<const Expr> transformBinary(const Binary *expr) {
+            ChildPtr<const Expr> lValue = transform(expr->lValue());
+            ChildPtr<const Expr> rValue = transform(expr->rValue());
+            if(canShare(expr) && lValue.get() == expr->lValue() && rValue.get() == expr->rValue()) {
+                return share(expr);
+            }
+            return makeIn<const Binary>(context_, move(lValue), expr->operation(), move(rValue));
+        }
+
+        virtual ChildPtr<const Expr> transformNot(const Not *expr) {
+            ChildPtr<const Expr> operand = transform(expr->operand());
+            if(canShare(expr) && operand.get() == expr->operand()) {
+                return share(expr);
+            }
+            return makeIn<const Not>(context_, move(operand));
+        }
+
+        virtual ChildPtr<const Expr> transformConvert(const Convert *expr) {
+            ChildPtr<const Expr> operand = transform(expr->operand());
+            if(canShare(expr) && operand.get() == expr->operand()) {
+                return share(expr);
+            }
+            return makeIn<const Convert>(context_, move(operand), expr->dataType());
+        }
+
+        virtual ChildPtr<const Expr> transformCheckedBinary(const CheckedBinary *expr) {
+            ChildPtr<const Expr> lValue = transform(expr->lValue());
+            ChildPtr<const Expr> rValue = transform(expr->rValue());
+            ChildPtr<const Expr> overflow = transform(expr->overflow());
+            if(canShare(expr) && lValue.get() == expr->lValue() && rValue.get() == expr->rValue()
+               && overflow.get() == expr->overflow()) {
+                return share(expr);
+            }
+            return makeIn<const CheckedBinary>(context_, move(lValue), expr->operation(), move(rValue), move(overflow));
+        }
+
+        virtual ChildPtr<const Expr> transformInvoke(const Invoke *expr) {
+            std::vector<ChildPtr<const Expr>> arguments;
+            arguments.reserve(expr->argumentCount());
+            bool unchanged = true;
+            expr->forEachArgument([&](const Expr *arg) {
+                arguments.push_back(transform(arg));
+                unchanged = unchanged && arguments.back().get() == arg;
+            });
+            if(canShare(expr) && unchanged) {
+                return share(expr);
+            }
+
+            std::pmr::vector<ChildPtr<const Expr>> args{
+                context_ ? context_->resource() : std::pmr::get_default_resource()};
+            for(auto &arg : arguments) {
+                args.emplace_back(move(arg));
+            }
+            return makeIn<const Invoke>(context_, expr->functionSymbol(), expr->dataType(), move(args));
+        }
+
+        virtual ChildPtr<const Expr> transformLoad(const Load *expr) {
+            ChildPtr<const Expr> pointer = transform(expr->pointer());
+            if(canShare(expr) && pointer.get() == expr->pointer()) {
+                return share(expr);
+            }
+            return makeIn<const Load>(context_, expr->dataType(), move(pointer), expr->alignment());
+        }
+
+        virtual ChildPtr<const Expr> transformStore(const Store *expr) {
+            ChildPtr<const Expr> pointer = transform(expr->pointer());
+            ChildPtr<const Expr> valueExpr = transform(expr->valueExpr());
+            if(canShare(expr) && pointer.get() == expr->pointer() && valueExpr.get() == expr->valueExpr()) {
+                return share(expr);
+            }
+            return makeIn<const Store>(context_, move(pointer), move(valueExpr), expr->alignment());
+        }
+
+        virtual ChildPtr<const Expr> transformIndex(const Index *expr) {
+            ChildPtr<const Expr> pointer = transform(expr->pointer());
+            ChildPtr<const Expr> index = transform(expr->index());
+            if(canShare(expr) && pointer.get() == expr->pointer() && index.get() == expr->index()) {
+                return share(expr);
+            }
+            return makeIn<const Index>(context_, expr->elementType(), move(pointer), move(index));
+        }
+
+        virtual ChildPtr<const Expr> transformSplat(const Splat *expr) {
+            ChildPtr<const Expr> scalar = transform(expr->scalar());
+            if(canShare(expr) && scalar.get() == expr->scalar()) {
+                return share(expr);
+            }
+            return makeIn<const Splat>(context_, expr->dataType(), move(scalar));
+        }
+
+        virtual ChildPtr<const Expr> transformExtractLane(const ExtractLane *expr) {
+            ChildPtr<const Expr> vector = transform(expr->vector());
+            if(canShare(expr) && vector.get() == expr->vector()) {
+                return share(expr);
+            }
+            return makeIn<const ExtractLane>(context_, move(vector), expr->lane());
+        }
+
+        virtual ChildPtr<const Expr> transformInsertLane(const InsertLane *expr) {
+            ChildPtr<const Expr> vector = transform(expr->vector());
+            ChildPtr<const Expr> scalar = transform(expr->scalar());
+            if(canShare(expr) && vector.get() == expr->vector() && scalar.get() == expr->scalar()) {
+                return share(expr);
+            }
+            return makeIn<const InsertLane>(context_, move(vector), expr->lane(), move(scalar));
+        }
+
+        virtual ChildPtr<const Expr> transformShuffle(const Shuffle *expr) {
+            ChildPtr<const Expr> first = transform(expr->first());
+            ChildPtr<const Expr> second = transform(expr->second());
+            if(canShare(expr) && first.get() == expr->first() && second.get() == expr->second()) {
+                return share(expr);
+            }
+            std::pmr::vector<unsigned> mask{expr->mask().begin(), expr->mask().end(),
+                                            context_ ? context_->resource() : std::pmr::get_default_resource()};
+            return makeIn<const Shuffle>(context_, move(first), move(second), move(mask));
+        }
+
+        virtual ChildPtr<const Expr> transformReduce(const Reduce *expr) {
+            ChildPtr<const Expr> vector = transform(expr->vector());
+            if(canShare(expr) && vector.get() == expr->vector()) {
+                return share(expr);
+            }
+            return makeIn<const Reduce>(context_, expr->operation(), move(vector));
+        }
+
+        virtual ChildPtr<const Expr> transformBlock(const Block *expr) {
+            std::vector<ChildPtr<const Expr>> expressions;
+            expressions.reserve(expr->size());
+            bool unchanged = true;
+            expr->forEach([&](const Expr *childExpr) {
+                expressions.push_back(transform(childExpr));
+                unchanged = unchanged && expressions.back().get() == childExpr;
+            });
+            if(canShare(expr) && unchanged) {
+                return share(expr);
+            }
+
+            BlockBuilder bb = context_ ? BlockBuilder{*context_} : BlockBuilder{};
+            expr->scope()->forEachVariable([&](const shared_ptr<const Variable> &var) { bb.addVariable(var); });
+            for(auto &childExpr : expressions) {
+                bb.addExpression(move(childExpr));
+            }
+            return bb.build();
+        }
+
+        virtual ChildPtr<const Expr> transformConditional(const Conditional *expr) {
+            ChildPtr<const Expr> condition = transform(expr->condition());
+            ChildPtr<const Expr> truePart = expr->truePart() ? transform(expr->truePart()) : nullptr;
+            ChildPtr<const Expr> falsePart = expr->falsePart() ? transform(expr->falsePart()) : nullptr;
+            if(canShare(expr)
+               && condition.get() == expr->condition()
+               && truePart.get() == expr->truePart()
+               && falsePart.get() == expr->falsePart()) {
+                return share(expr);
+            }
+            return makeIn<const Conditional>(context_, move(condition), move(truePart), move(falsePart),
+                                             expr->branchHint());
+        }
+
+        virtual ChildPtr<const Expr> transformSwitch(const Switch *expr) {
+            ChildPtr<const Expr> discriminant = transform(expr->discriminant());
+            std::vector<ChildPtr<const Expr>> cases;
+            cases.reserve(expr->caseCount());
+            bool unchanged = discriminant.get() == expr->discriminant();
+            for(size_t i = 0; i < expr->caseCount(); ++i) {
+                cases.push_back(transform(expr->caseExpr(i)));
+                unchanged = unchanged && cases.back().get() == expr->caseExpr(i);
+            }
+            ChildPtr<const Expr> defaultCase = expr->defaultCase() ? transform(expr->defaultCase()) : nullptr;
+            if(canShare(expr) && unchanged && defaultCase.get() == expr->defaultCase()) {
+                return share(expr);
+            }
+
+            std::pmr::memory_resource *resource = context_ ? context_->resource() : std::pmr::get_default_resource();
+            std::pmr::vector<ChildPtr<const Expr>> caseExprs{resource};
+            for(auto &caseExpr : cases) {
+                caseExprs.emplace_back(move(caseExpr));
+            }
+            return makeIn<const Switch>(context_,
+                                        move(discriminant),
+                                        std::pmr::vector<int32_t>{expr->caseValues().begin(),
+                                                                  expr->caseValues().end(),
+                                                                  resource},
+                                        move(caseExprs),
+                                        move(defaultCase));
+        }
+
+        virtual ChildPtr<const Expr> transformWhile(const While *expr) {
+            ChildPtr<const Expr> condition = transform(expr->condition());
+            ChildPtr<const Expr> body = transform(expr->body());
+            if(canShare(expr) && condition.get() == expr->condition() && body.get() == expr->body()) {
+                return share(expr);
+            }
+            return makeIn<const While>(context_, move(condition), move(body));
+        }
+
+        virtual ChildPtr<const Expr> transformFor(const For *expr) {
+            ChildPtr<const Expr> init = expr->init() ? transform(expr->init()) : nullptr;
+            ChildPtr<const Expr> condition = expr->condition() ? transform(expr->condition()) : nullptr;
+            ChildPtr<const Expr> body = transform(expr->body());
+            ChildPtr<const Expr> update = expr->update() ? transform(expr->update()) : nullptr;
+            if(canShare(expr)
+               && init.get() == expr->init()
+               && condition.get() == expr->condition()
+               && body.get() == expr->body()
+               && update.get() == expr->update()) {
+                return share(expr);
+            }
+            return makeIn<const For>(context_, move(init), move(condition), move(update), move(body));
+        }
+
+        virtual ChildPtr<const Expr> transformMap(const Map *expr) {
+            ChildPtr<const Expr> output = transform(expr->output());
+            ChildPtr<const Expr> count = transform(expr->count());
+            ChildPtr<const Expr> body = transform(expr->body());
+            if(canShare(expr)
+               && output.get() == expr->output()
+               && count.get() == expr->count()
+               && body.get() == expr->body()) {
+                return share(expr);
+            }
+            return makeIn<const Map>(context_, expr->index(), move(output), move(count), move(body));
+        }
+
+        virtual ChildPtr<const Expr> transformFold(const Fold *expr) {
+            ChildPtr<const Expr> count = transform(expr->count());
+            ChildPtr<const Expr> body = transform(expr->body());
+            if(canShare(expr) && count.get() == expr->count() && body.get() == expr->body()) {
+                return share(expr);
+            }
+            return makeIn<const Fold>(context_, expr->operation(), expr->index(), move(count), move(body));
+        }
+
+        virtual ChildPtr<const Expr> transformBreak(const Break *expr) {
+            if(canShare(expr)) {
+                return share(expr);
+            }
+            return makeIn<const Break>(context_);
+        }
+
+        virtual ChildPtr<const Expr> transformContinue(const Continue *expr) {
+            if(canShare(expr)) {
+                return share(expr);
+            }
+            return makeIn<const Continue>(context_);
+        }
+
+        virtual ChildPtr<const Expr> transformVariableRef(const VariableRef *expr) {
+            if(canShare(expr)) {
+                return share(expr);
+            }
+            return makeIn<const VariableRef>(context_, expr->variable());
+        }
+
+        virtual ChildPtr<const Expr> transformAssignVariable(const AssignVariable *expr) {
+            ChildPtr<const Expr> valueExpr = transform(expr->valueExpr());
+            if(canShare(expr) && valueExpr.get() == expr->valueExpr()) {
+                return share(expr);
+            }
+            return makeIn<const AssignVariable>(context_, expr->variable(), move(valueExpr));
+        }
+
+        virtual ChildPtr<const Expr> transformReturn(const Return *expr) {
+            ChildPtr<const Expr> valueExpr = transform(expr->valueExpr());
+            if(canShare(expr) && valueExpr.get() == expr->valueExpr()) {
+                return share(expr);
+            }
+            return makeIn<const Return>(context_, move(valueExpr));
+        }
+
+    private:
+        /** Returns the result of transforming expr if it is a child of the node being transformed by a member function
+         * and has not been returned before, or null. */
+        ChildPtr<const Expr> *childResult(const Expr *expr) {
+            for(size_t i = firstChildResult_; i < endChildResult_; ++i) {
+                Result &result = results_[i];
+                if(result.original == expr) {
+                    result.original = nullptr;
+                    //Member functions normally take the results in order, so those already taken are skipped.
+                    while(firstChildResult_ < endChildResult_ && results_[firstChildResult_].original == nullptr) {
+                        ++firstChildResult_;
+                    }
+                    return &result.transformed;
+                }
+            }
+            return nullptr;
+        }
+
+        /** Returns the next child of frame.expr which is present, or null after the last. */
+        static const Expr *nextChild(Frame &frame) {
+            const Expr *child;
+            while(childAt(frame.expr, frame.next++, child)) {
+                if(child) {
+                    return child;
+                }
+            }
+            return nullptr;
+        }
+
+        static bool pick(std::initializer_list<const Expr*> parts, size_t index, const Expr *&child) {
+            child = index < parts.size() ? parts.begin()[index] : nullptr;
+            return index < parts.size();
+        }
+
+        ChildPtr<const Expr> transformNode(const Expr *expr) {
+            switch (expr->nodeKind()) {
+                case NodeKind::LiteralInt32:
+                    return transformLiteralInt32(static_cast<const LiteralInt32*>(expr));
+                case NodeKind::LiteralFloat:
+                    return transformLiteralFloat(static_cast<const LiteralFloat*>(expr));
+                case NodeKind::LiteralInt64:
+                    return transformLiteralInt64(static_cast<const LiteralInt64*>(expr));
+                case NodeKind::LiteralDouble:
+                    return transformLiteralDouble(static_cast<const LiteralDouble*>(expr));
+                case NodeKind::Binary:
+                    return transformBinary(static_cast<const Binary*>(expr));
+                case NodeKind::Not:
+                    return transformNot(static_cast<const Not*>(expr));
+                case NodeKind::Convert:
+                    return transformConvert(static_cast<const Convert*>(expr));
+                case NodeKind::CheckedBinary:
+                    return transformCheckedBinary(static_cast<const CheckedBinary*>(expr));
+                case NodeKind::Invoke:
+                    return transformInvoke(static_cast<const Invoke*>(expr));
+                case NodeKind::Load:
+                    return transformLoad(static_cast<const Load*>(expr));
+                case NodeKind::Store:
+                    return transformStore(static_cast<const Store*>(expr));
+                case NodeKind::Index:
+                    return transformIndex(static_cast<const Index*>(expr));
+                case NodeKind::Splat:
+                    return transformSplat(static_cast<const Splat*>(expr));
+                case NodeKind::ExtractLane:
+                    return transformExtractLane(static_cast<const ExtractLane*>(expr));
+                case NodeKind::InsertLane:
+                    return transformInsertLane(static_cast<const InsertLane*>(expr));
+                case NodeKind::Shuffle:
+                    return transformShuffle(static_cast<const Shuffle*>(expr));
+                case NodeKind::Reduce:
+                    return transformReduce(static_cast<const Reduce*>(expr));
+                case NodeKind::Block:
+                    return transformBlock(static_cast<const Block*>(expr));
+                case NodeKind::Conditional:
+                    return transformConditional(static_cast<const Conditional*>(expr));
+                case NodeKind::Switch:
+                    return transformSwitch(static_cast<const Switch*>(expr));
+                case NodeKind::VariableRef:
+                    return transformVariableRef(static_cast<const VariableRef*>(expr));
+                case NodeKind::AssignVariable:
+                    return transformAssignVariable(static_cast<const AssignVariable*>(expr));
+                case NodeKind::Return:
+                    return transformReturn(static_cast<const Return*>(expr));
+                case NodeKind::While:
+                    return transformWhile(static_cast<const While*>(expr));
+                case NodeKind::For:
+                    return transformFor(static_cast<const For*>(expr));
+                case NodeKind::Map:
+                    return transformMap(static_cast<const Map*>(expr));
+                case NodeKind::Fold:
+                    return transformFold(static_cast<const Fold*>(expr));
+                case NodeKind::Break:
+                    return transformBreak(static_cast<const Break*>(expr));
+                case NodeKind::Continue:
+                    return transformContinue(static_cast<const Continue*>(expr));
+                default:
+                    throw UnhandledSwitchCase();
+            }
+        }
+    };
+}
@@ -28,14 +28,126 @@ namespace llast {
 
         virtual void visitingConditional(const Conditional *) {}
 
+        /** Executes after the condition has been visited and before the true part (if any) is visited. */
+        virtual void visitingTruePart(const Conditional *) {}
+
+        /** Executes after the true part (if any) has been visited and before the false part (if any) is visited. */
+        virtual void visitingFalsePart(const Conditional *) {}
+
         virtual void visitedConditional(const Conditional *) {}
 
+        virtual void visitingSwitch(const Switch *) {}
+
+        /** Executes before the case with the specified index is visited, after the discriminant and all earlier
+         * cases. */
+        virtual void visitingSwitchCase(const Switch *, size_t) {}
+
+        /** Executes after the last case has been visited and before the default case (if any) is visited. */
+        virtual void visitingSwitchDefault(const Switch *) {}
+
+        virtual void visitedSwitch(const Switch *) {}
+
+        virtual void visitingWhile(const While *) {}
+
+        /** Executes after the condition has been visited and before the body is visited. */
+        virtual void visitingWhileBody(const While *) {}
+
+        virtual void visitedWhile(const While *) {}
+
+        virtual void visitingFor(const For *) {}
+
+        /** Executes after the init part (if any) has been visited and before the condition (if any) is visited. */
+        virtual void visitingForCondition(const For *) {}
+
+        /** Executes after the condition (if any) has been visited and before the body is visited. */
+        virtual void visitingForBody(const For *) {}
+
+        /** Executes after the body has been visited and before the update part (if any) is visited. */
+        virtual void visitingForUpdate(const For *) {}
+
+        virtual void visitedFor(const For *) {}
+
+        virtual void visitingMap(const Map *) {}
+
+        /** Executes after the output and count have been visited and before the body is visited. */
+        virtual void visitingMapBody(const Map *) {}
+
+        virtual void visitedMap(const Map *) {}
+
+        virtual void visitingFold(const Fold *) {}
+
+        /** Executes after the count has been visited and before the body is visited. */
+        virtual void visitingFoldBody(const Fold *) {}
+
+        virtual void visitedFold(const Fold *) {}
+
+        virtual void visitBreak(const Break *) {}
+        virtual void visitContinue(const Continue *) {}
+
         virtual void visitingBinary(const Binary *) {}
 
+        /** Executes after the lValue of an And or Or has been visited and before its rValue, which is only evaluated
+         * if the lValue does not determine the result.  Not invoked for other operations. */
+        virtual void visitingRValue(const Binary *) {}
+
         virtual void visitedBinary(const Binary *) {}
 
+        virtual void visitingNot(const Not *) {}
+
+        virtual void visitedNot(const Not *) {}
+
+        virtual void visitingConvert(const Convert *) {}
+
+        virtual void visitedConvert(const Convert *) {}
+
+        virtual void visitingCheckedBinary(const CheckedBinary *) {}
+
+        /** Executes after the lValue and rValue have been visited and before the overflow part, which is only
+         * evaluated if the operation overflows. */
+        virtual void visitingOverflow(const CheckedBinary *) {}
+
+        virtual void visitedCheckedBinary(const CheckedBinary *) {}
+
+        virtual void visitingInvoke(const Invoke *) {}
+
+        virtual void visitedInvoke(const Invoke *) {}
+
+        virtual void visitingLoad(const Load *) {}
+
+        virtual void visitedLoad(const Load *) {}
+
+        virtual void visitingStore(const Store *) {}
+
+        virtual void visitedStore(const Store *) {}
+
+        virtual void visitingIndex(const Index *) {}
+
+        virtual void visitedIndex(const Index *) {}
+
+        virtual void visitingSplat(const Splat *) {}
+
+        virtual void visitedSplat(const Splat *) {}
+
+        virtual void visitingExtractLane(const ExtractLane *) {}
+
+        virtual void visitedExtractLane(const ExtractLane *) {}
+
+        virtual void visitingInsertLane(const InsertLane *) {}
+
+        virtual void visitedInsertLane(const InsertLane *) {}
+
+        virtual void visitingShuffle(const Shuffle *) {}
+
+        virtual void visitedShuffle(const Shuffle *) {}
+
+        virtual void visitingReduce(const Reduce *) {}
+
+        virtual void visitedReduce(const Reduce *) {}
+
         virtual void visitLiteralInt32(const LiteralInt32 *) {}
         virtual void visitLiteralFloat(const LiteralFloat *) {}
+        virtual void visitLiteralInt64(const LiteralInt64 *) {}
+        virtual void visitLiteralDouble(const LiteralDouble *) {}
 
         virtual void visitingReturn(const Return *) {}
         virtual void visitedReturn(const Return *) {}
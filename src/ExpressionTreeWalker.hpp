@@ -24,6 +24,15 @@ namespace llast {
             visitor_->cleanUp();
         }
 
+        /** Walks a tree which is not rooted at a Module, i.e. a function body or a lone expression. */
+        void walkTree(const Expr *expr) {
+            visitor_->initialize();
+
+            this->walk(expr);
+
+            visitor_->cleanUp();
+        }
+
     protected:
 
         virtual void walk(const Node *node) const  {
@@ -36,15 +45,78 @@ namespace llast {
                 case NodeKind::LiteralFloat:
                     walkLiteralFloat(static_cast<const LiteralFloat*>(node));
                     break;
+                case NodeKind::LiteralInt64:
+                    walkLiteralInt64(static_cast<const LiteralInt64*>(node));
+                    break;
+                case NodeKind::LiteralDouble:
+                    walkLiteralDouble(static_cast<const LiteralDouble*>(node));
+                    break;
                 case NodeKind::Binary:
                     walkBinary(static_cast<const Binary*>(node));
                     break;
+                case NodeKind::Not:
+                    walkNot(static_cast<const Not*>(node));
+                    break;
+                case NodeKind::Convert:
+                    walkConvert(static_cast<const Convert*>(node));
+                    break;
+                case NodeKind::CheckedBinary:
+                    walkCheckedBinary(static_cast<const CheckedBinary*>(node));
+                    break;
+                case NodeKind::Invoke:
+                    walkInvoke(static_cast<const Invoke*>(node));
+                    break;
+                case NodeKind::Load:
+                    walkLoad(static_cast<const Load*>(node));
+                    break;
+                case NodeKind::Store:
+                    walkStore(static_cast<const Store*>(node));
+                    break;
+                case NodeKind::Index:
+                    walkIndex(static_cast<const Index*>(node));
+                    break;
+                case NodeKind::Splat:
+                    walkSplat(static_cast<const Splat*>(node));
+                    break;
+                case NodeKind::ExtractLane:
+                    walkExtractLane(static_cast<const ExtractLane*>(node));
+                    break;
+                case NodeKind::InsertLane:
+                    walkInsertLane(static_cast<const InsertLane*>(node));
+                    break;
+                case NodeKind::Shuffle:
+                    walkShuffle(static_cast<const Shuffle*>(node));
+                    break;
+                case NodeKind::Reduce:
+                    walkReduce(static_cast<const Reduce*>(node));
+                    break;
                 case NodeKind::Block:
                     walkBlock(static_cast<const Block*>(node));
                     break;
                 case NodeKind::Conditional:
                     walkConditional(static_cast<const Conditional*>(node));
                     break;
+                case NodeKind::Switch:
+                    walkSwitch(static_cast<const Switch*>(node));
+                    break;
+                case NodeKind::While:
+                    walkWhile(static_cast<const While*>(node));
+                    break;
+                case NodeKind::For:
+                    walkFor(static_cast<const For*>(node));
+                    break;
+                case NodeKind::Map:
+                    walkMap(static_cast<const Map*>(node));
+                    break;
+                case NodeKind::Fold:
+                    walkFold(static_cast<const Fold*>(node));
+                    break;
+                case NodeKind::Break:
+                    walkBreak(static_cast<const Break*>(node));
+                    break;
+                case NodeKind::Continue:
+                    walkContinue(static_cast<const Continue*>(node));
+                    break;
                 case NodeKind::VariableRef:
                     walkVariableRef(static_cast<const VariableRef*>(node));
                     break;
@@ -114,22 +186,167 @@ namespace llast {
             visitor_->visitingBinary(binaryExpr);
 
             walk(binaryExpr->lValue());
+            if(isLogical(binaryExpr->operation())) {
+                visitor_->visitingRValue(binaryExpr);
+            }
             walk(binaryExpr->rValue());
 
             visitor_->visitedBinary(binaryExpr);
             visitor_->visitedNode(binaryExpr);
         }
 
+        void walkNot(const Not *notExpr) const {
+            ARG_NOT_NULL(notExpr);
+            visitor_->visitingNode(notExpr);
+            visitor_->visitingNot(notExpr);
+
+            walk(notExpr->operand());
+
+            visitor_->visitedNot(notExpr);
+            visitor_->visitedNode(notExpr);
+        }
+
+        void walkConvert(const Convert *expr) const {
+            ARG_NOT_NULL(expr);
+            visitor_->visitingNode(expr);
+            visitor_->visitingConvert(expr);
+
+            walk(expr->operand());
+
+            visitor_->visitedConvert(expr);
+            visitor_->visitedNode(expr);
+        }
+
+        void walkCheckedBinary(const CheckedBinary *expr) const {
+            ARG_NOT_NULL(expr);
+            visitor_->visitingNode(expr);
+            visitor_->visitingCheckedBinary(expr);
+
+            walk(expr->lValue());
+            walk(expr->rValue());
+            visitor_->visitingOverflow(expr);
+            walk(expr->overflow());
+
+            visitor_->visitedCheckedBinary(expr);
+            visitor_->visitedNode(expr);
+        }
+
+        void walkInvoke(const Invoke *invokeExpr) const {
+            ARG_NOT_NULL(invokeExpr);
+            visitor_->visitingNode(invokeExpr);
+            visitor_->visitingInvoke(invokeExpr);
+
+            invokeExpr->forEachArgument([this](const Expr *arg) { walk(arg); });
+
+            visitor_->visitedInvoke(invokeExpr);
+            visitor_->visitedNode(invokeExpr);
+        }
+
+        void walkLoad(const Load *loadExpr) const {
+            ARG_NOT_NULL(loadExpr);
+            visitor_->visitingNode(loadExpr);
+            visitor_->visitingLoad(loadExpr);
+
+            walk(loadExpr->pointer());
+
+            visitor_->visitedLoad(loadExpr);
+            visitor_->visitedNode(loadExpr);
+        }
+
+        void walkStore(const Store *storeExpr) const {
+            ARG_NOT_NULL(storeExpr);
+            visitor_->visitingNode(storeExpr);
+            visitor_->visitingStore(storeExpr);
+
+            walk(storeExpr->pointer());
+            walk(storeExpr->valueExpr());
+
+            visitor_->visitedStore(storeExpr);
+            visitor_->visitedNode(storeExpr);
+        }
+
+        void walkIndex(const Index *indexExpr) const {
+            ARG_NOT_NULL(indexExpr);
+            visitor_->visitingNode(indexExpr);
+            visitor_->visitingIndex(indexExpr);
+
+            walk(indexExpr->pointer());
+            walk(indexExpr->index());
+
+            visitor_->visitedIndex(indexExpr);
+            visitor_->visitedNode(indexExpr);
+        }
+
+        void walkSplat(const Splat *splat) const {
+            ARG_NOT_NULL(splat);
+            visitor_->visitingNode(splat);
+            visitor_->visitingSplat(splat);
+
+            walk(splat->scalar());
+
+            visitor_->visitedSplat(splat);
+            visitor_->visitedNode(splat);
+        }
+
+        void walkExtractLane(const ExtractLane *extractLane) const {
+            ARG_NOT_NULL(extractLane);
+            visitor_->visitingNode(extractLane);
+            visitor_->visitingExtractLane(extractLane);
+
+            walk(extractLane->vector());
+
+            visitor_->visitedExtractLane(extractLane);
+            visitor_->visitedNode(extractLane);
+        }
+
+        void walkInsertLane(const InsertLane *insertLane) const {
+            ARG_NOT_NULL(insertLane);
+            visitor_->visitingNode(insertLane);
+            visitor_->visitingInsertLane(insertLane);
+
+            walk(insertLane->vector());
+            walk(insertLane->scalar());
+
+            visitor_->visitedInsertLane(insertLane);
+            visitor_->visitedNode(insertLane);
+        }
+
+        void walkShuffle(const Shuffle *shuffle) const {
+            ARG_NOT_NULL(shuffle);
+            visitor_->visitingNode(shuffle);
+            visitor_->visitingShuffle(shuffle);
+
+            walk(shuffle->first());
+            walk(shuffle->second());
+
+            visitor_->visitedShuffle(shuffle);
+            visitor_->visitedNode(shuffle);
+        }
+
+        void walkReduce(const Reduce *reduce) const {
+            ARG_NOT_NULL(reduce);
+            visitor_->visitingNode(reduce);
+            visitor_->visitingReduce(reduce);
+
+            walk(reduce->vector());
+
+            visitor_->visitedReduce(reduce);
+            visitor_->visitedNode(reduce);
+        }
+
         void walkConditional(const Conditional *conditionalExpr) const {
             ARG_NOT_NULL(conditionalExpr);
             visitor_->visitingNode(conditionalExpr);
             visitor_->visitingConditional(conditionalExpr);
 
             walk(conditionalExpr->condition());
+
+            visitor_->visitingTruePart(conditionalExpr);
             if (conditionalExpr->truePart()) {
                 walk(conditionalExpr->truePart());
             }
 
+            visitor_->visitingFalsePart(conditionalExpr);
             if (conditionalExpr->falsePart()) {
                 walk(conditionalExpr->falsePart());
             }
@@ -138,6 +355,110 @@ namespace llast {
             visitor_->visitedNode(conditionalExpr);
         }
 
+        void walkSwitch(const Switch *switchExpr) const {
+            ARG_NOT_NULL(switchExpr);
+            visitor_->visitingNode(switchExpr);
+            visitor_->visitingSwitch(switchExpr);
+
+            walk(switchExpr->discriminant());
+
+            for(size_t i = 0; i < switchExpr->caseCount(); ++i) {
+                visitor_->visitingSwitchCase(switchExpr, i);
+                walk(switchExpr->caseExpr(i));
+            }
+
+            visitor_->visitingSwitchDefault(switchExpr);
+            if (switchExpr->defaultCase()) {
+                walk(switchExpr->defaultCase());
+            }
+
+            visitor_->visitedSwitch(switchExpr);
+            visitor_->visitedNode(switchExpr);
+        }
+
+        void walkWhile(const While *whileExpr) const {
+            ARG_NOT_NULL(whileExpr);
+            visitor_->visitingNode(whileExpr);
+            visitor_->visitingWhile(whileExpr);
+
+            walk(whileExpr->condition());
+
+            visitor_->visitingWhileBody(whileExpr);
+            walk(whileExpr->body());
+
+            visitor_->visitedWhile(whileExpr);
+            visitor_->visitedNode(whileExpr);
+        }
+
+        void walkFor(const For *forExpr) const {
+            ARG_NOT_NULL(forExpr);
+            visitor_->visitingNode(forExpr);
+            visitor_->visitingFor(forExpr);
+
+            if (forExpr->init()) {
+                walk(forExpr->init());
+            }
+
+            visitor_->visitingForCondition(forExpr);
+            if (forExpr->condition()) {
+                walk(forExpr->condition());
+            }
+
+            visitor_->visitingForBody(forExpr);
+            walk(forExpr->body());
+
+            visitor_->visitingForUpdate(forExpr);
+            if (forExpr->update()) {
+                walk(forExpr->update());
+            }
+
+            visitor_->visitedFor(forExpr);
+            visitor_->visitedNode(forExpr);
+        }
+
+        void walkMap(const Map *mapExpr) const {
+            ARG_NOT_NULL(mapExpr);
+            visitor_->visitingNode(mapExpr);
+            visitor_->visitingMap(mapExpr);
+
+            walk(mapExpr->output());
+            walk(mapExpr->count());
+
+            visitor_->visitingMapBody(mapExpr);
+            walk(mapExpr->body());
+
+            visitor_->visitedMap(mapExpr);
+            visitor_->visitedNode(mapExpr);
+        }
+
+        void walkFold(const Fold *foldExpr) const {
+            ARG_NOT_NULL(foldExpr);
+            visitor_->visitingNode(foldExpr);
+            visitor_->visitingFold(foldExpr);
+
+            walk(foldExpr->count());
+
+            visitor_->visitingFoldBody(foldExpr);
+            walk(foldExpr->body());
+
+            visitor_->visitedFold(foldExpr);
+            visitor_->visitedNode(foldExpr);
+        }
+
+        void walkBreak(const Break *expr) const {
+            ARG_NOT_NULL(expr);
+            visitor_->visitingNode(expr);
+            visitor_->visitBreak(expr);
+            visitor_->visitedNode(expr);
+        }
+
+        void walkContinue(const Continue *expr) const {
+            ARG_NOT_NULL(expr);
+            visitor_->visitingNode(expr);
+            visitor_->visitContinue(expr);
+            visitor_->visitedNode(expr);
+        }
+
         void walkLiteralInt32(const LiteralInt32 *expr) const {
             ARG_NOT_NULL(expr);
             visitor_->visitingNode(expr);
@@ -152,6 +473,20 @@ namespace llast {
             visitor_->visitedNode(expr);
         }
 
+        void walkLiteralInt64(const LiteralInt64 *expr) const {
+            ARG_NOT_NULL(expr);
+            visitor_->visitingNode(expr);
+            visitor_->visitLiteralInt64(expr);
+            visitor_->visitedNode(expr);
+        }
+
+        void walkLiteralDouble(const LiteralDouble *expr) const {
+            ARG_NOT_NULL(expr);
+            visitor_->visitingNode(expr);
+            visitor_->visitLiteralDouble(expr);
+            visitor_->visitedNode(expr);
+        }
+
         void walkFunction(const Function *func) const {
             ARG_NOT_NULL(func);
             visitor_->visitingNode(func);
@@ -0,0 +1,618 @@
+
+#include "FlatAst.hpp"
+#include "StaticExpressionTreeWalker.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace llast {
+
+    /** Appends the nodes of a tree to a FlatAst in post-order.  The index of each node appended is pushed on
+     * pending_ until its parent is appended. */
+    class FlatAstBuilder : public StaticExpressionTreeWalker<FlatAstBuilder> {
+        FlatAst &ast_;
+        std::vector<FlatAst::Index> pending_;
+        std::vector<size_t> pendingMarks_;
+        std::unordered_map<const Variable*, uint32_t> variableIndexes_;
+        std::unordered_map<Symbol, uint32_t> nameIndexes_;
+
+        uint32_t variableIndex(const shared_ptr<const Variable> &variable) {
+            auto inserted = variableIndexes_.emplace(variable.get(), static_cast<uint32_t>(ast_.variables_.size()));
+            if(inserted.second) {
+                ast_.variables_.push_back(variable);
+            }
+            return inserted.first->second;
+        }
+
+        uint32_t nameIndex(Symbol name) {
+            auto inserted = nameIndexes_.emplace(name, static_cast<uint32_t>(ast_.names_.size()));
+            if(inserted.second) {
+                ast_.names_.push_back(name);
+            }
+            return inserted.first->second;
+        }
+
+        uint32_t scopeIndex(const Scope *scope) {
+            if(ast_.scopeVariableCounts_.size() >= FlatAst::MAX_SCOPES) {
+                throw InvalidStateException("Tree has too many scopes to be flattened.");
+            }
+            ast_.scopeFirstVariables_.push_back(static_cast<uint32_t>(ast_.scopeVariables_.size()));
+            ast_.scopeVariableCounts_.push_back(static_cast<uint32_t>(scope->size()));
+            scope->forEachVariable([&](const shared_ptr<const Variable> &var) {
+                ast_.scopeVariables_.push_back(variableIndex(var));
+            });
+            return static_cast<uint32_t>(ast_.scopeFirstVariables_.size() - 1);
+        }
+
+        /** Appends a node whose children are the last childCount entries of pending_. */
+        void append(NodeKind kind, DataType dataType, uint64_t payload, size_t childCount) {
+            ast_.appendNode(kind, dataType, payload, childCount, pending_);
+        }
+
+        /** Appends a node with a fixed number of children, some of which may be absent:  present[i] is whether its
+         * i'th child was walked.  Absent children become NONE. */
+        void appendWithOptional(NodeKind kind, DataType dataType, uint64_t payload,
+                                std::initializer_list<bool> present) {
+            DEBUG_ASSERT(present.size() <= 4, "Too many optional children.");
+            FlatAst::Index children[4];
+            size_t walked = static_cast<size_t>(std::count(present.begin(), present.end(), true));
+            std::copy(pending_.end() - walked, pending_.end(), children);
+            pending_.resize(pending_.size() - walked);
+            const FlatAst::Index *next = children;
+            for(bool isPresent : present) {
+                pending_.push_back(isPresent ? *next++ : FlatAst::NONE);
+            }
+            append(kind, dataType, payload, present.size());
+        }
+
+        size_t childrenSinceMark() {
+            size_t mark = pendingMarks_.back();
+            pendingMarks_.pop_back();
+            return pending_.size() - mark;
+        }
+
+    public:
+        FlatAstBuilder(FlatAst &ast) : ast_{ast} { }
+
+        void visitLiteralInt32(const LiteralInt32 *expr) {
+            append(NodeKind::LiteralInt32, DataType::Int32, static_cast<uint32_t>(expr->value()), 0);
+        }
+
+        void visitLiteralFloat(const LiteralFloat *expr) {
+            float value = expr->value();
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            append(NodeKind::LiteralFloat, DataType::Float, bits, 0);
+        }
+
+        void visitLiteralInt64(const LiteralInt64 *expr) {
+            append(NodeKind::LiteralInt64, DataType::Int64, static_cast<uint64_t>(expr->value()), 0);
+        }
+
+        void visitLiteralDouble(const LiteralDouble *expr) {
+            double value = expr->value();
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            append(NodeKind::LiteralDouble, DataType::Double, bits, 0);
+        }
+
+        void visitedBinary(const Binary *expr) {
+            append(NodeKind::Binary, expr->dataType(), static_cast<uint64_t>(expr->operation()), 2);
+        }
+
+        void visitedNot(const Not *) {
+            append(NodeKind::Not, DataType::Bool, 0, 1);
+        }
+
+        void visitedConvert(const Convert *expr) {
+            append(NodeKind::Convert, expr->dataType(), 0, 1);
+        }
+
+        void visitedCheckedBinary(const CheckedBinary *expr) {
+            append(NodeKind::CheckedBinary, expr->dataType(), static_cast<uint64_t>(expr->operation()), 3);
+        }
+
+        void visitVariableRef(const VariableRef *expr) {
+            append(NodeKind::VariableRef, expr->dataType(), variableIndex(expr->variable()), 0);
+        }
+
+        void visitedAssignVariable(const AssignVariable *expr) {
+            append(NodeKind::AssignVariable, expr->dataType(), variableIndex(expr->variable()), 1);
+        }
+
+        void visitedReturn(const Return *expr) {
+            append(NodeKind::Return, expr->dataType(), 0, 1);
+        }
+
+        void visitingInvoke(const Invoke *) {
+            pendingMarks_.push_back(pending_.size());
+        }
+
+        void visitedInvoke(const Invoke *expr) {
+            append(NodeKind::Invoke, expr->dataType(), nameIndex(expr->functionSymbol()), childrenSinceMark());
+        }
+
+        void visitedLoad(const Load *expr) {
+            append(NodeKind::Load, expr->dataType(), expr->alignment(), 1);
+        }
+
+        void visitedStore(const Store *expr) {
+            append(NodeKind::Store, expr->dataType(), expr->alignment(), 2);
+        }
+
+        void visitedIndex(const Index *expr) {
+            append(NodeKind::Index, expr->dataType(), static_cast<uint64_t>(expr->elementType()), 2);
+        }
+
+        void visitedSplat(const Splat *expr) {
+            append(NodeKind::Splat, expr->dataType(), 0, 1);
+        }
+
+        void visitedExtractLane(const ExtractLane *expr) {
+            append(NodeKind::ExtractLane, expr->dataType(), expr->lane(), 1);
+        }
+
+        void visitedInsertLane(const InsertLane *expr) {
+            append(NodeKind::InsertLane, expr->dataType(), expr->lane(), 2);
+        }
+
+        void visitedShuffle(const Shuffle *expr) {
+            append(NodeKind::Shuffle, expr->dataType(), FlatAst::packMask(expr->mask()), 2);
+        }
+
+        void visitedReduce(const Reduce *expr) {
+            append(NodeKind::Reduce, expr->dataType(), static_cast<uint64_t>(expr->operation()), 1);
+        }
+
+        void visitingBlock(const Block *) {
+            pendingMarks_.push_back(pending_.size());
+        }
+
+        void visitedBlock(const Block *expr) {
+            append(NodeKind::Block, expr->dataType(), scopeIndex(expr->scope()), childrenSinceMark());
+        }
+
+        void visitedConditional(const Conditional *expr) {
+            appendWithOptional(NodeKind::Conditional, expr->dataType(), static_cast<uint64_t>(expr->branchHint()),
+                               { true, expr->truePart() != nullptr, expr->falsePart() != nullptr });
+        }
+
+        void visitedSwitch(const Switch *expr) {
+            if(!expr->defaultCase()) {
+                pending_.push_back(FlatAst::NONE);
+            }
+            uint64_t firstValue = ast_.caseValues_.size();
+            ast_.caseValues_.insert(ast_.caseValues_.end(), expr->caseValues().begin(), expr->caseValues().end());
+            append(NodeKind::Switch, expr->dataType(), firstValue, expr->caseCount() + 2);
+        }
+
+        void visitedWhile(const While *expr) {
+            append(NodeKind::While, expr->dataType(), 0, 2);
+        }
+
+        void visitedFor(const For *expr) {
+            appendWithOptional(NodeKind::For, expr->dataType(), 0,
+                               { expr->init() != nullptr, expr->condition() != nullptr, true, expr->update() != nullptr });
+        }
+
+        void visitedMap(const Map *expr) {
+            append(NodeKind::Map, expr->dataType(), variableIndex(expr->index()), 3);
+        }
+
+        void visitedFold(const Fold *expr) {
+            uint64_t payload = (static_cast<uint64_t>(expr->operation()) << 32) | variableIndex(expr->index());
+            append(NodeKind::Fold, expr->dataType(), payload, 2);
+        }
+
+        void visitBreak(const Break *expr) {
+            append(NodeKind::Break, expr->dataType(), 0, 0);
+        }
+
+        void visitContinue(const Continue *expr) {
+            append(NodeKind::Continue, expr->dataType(), 0, 0);
+        }
+
+        void visitedFunction(const Function *func) {
+            uint64_t payload = (static_cast<uint64_t>(func->floatSemantics()) << 56)
+                               | (static_cast<uint64_t>(scopeIndex(func->parameterScope())) << 32)
+                               | nameIndex(func->symbol());
+            append(NodeKind::Function, func->returnType(), payload, 1);
+        }
+
+        void visitingModule(const Module *) {
+            pendingMarks_.push_back(pending_.size());
+        }
+
+        void visitedModule(const Module *module) {
+            append(NodeKind::Module, DataType::Void, nameIndex(module->symbol()), childrenSinceMark());
+        }
+    };
+
+    FlatAst FlatAst::fromModule(const Module *module) {
+        ARG_NOT_NULL(module);
+        FlatAst ast;
+        FlatAstBuilder builder{ast};
+        builder.walkTree(module);
+        return ast;
+    }
+
+    FlatAst FlatAst::fromExpr(const Expr *expr) {
+        ARG_NOT_NULL(expr);
+        FlatAst ast;
+        FlatAstBuilder builder{ast};
+        builder.walkTree(expr);
+        return ast;
+    }
+
+    FlatAst FlatAst::fromFunction(const Function *func) {
+        ARG_NOT_NULL(func);
+        FlatAst ast;
+        FlatAstBuilder builder{ast};
+        builder.walkTree(func);
+        return ast;
+    }
+
+    float FlatAst::floatValue(Index node) const {
+        uint32_t bits = static_cast<uint32_t>(payloads_[node]);
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    double FlatAst::doubleValue(Index node) const {
+        double value;
+        std::memcpy(&value, &payloads_[node], sizeof(value));
+        return value;
+    }
+
+    uint64_t FlatAst::packMask(const std::pmr::vector<unsigned> &mask) {
+        uint64_t packed = mask.size();
+        for(size_t i = 0; i < mask.size(); ++i) {
+            packed |= static_cast<uint64_t>(mask[i]) << (4 * (i + 1));
+        }
+        return packed;
+    }
+
+    std::pmr::vector<unsigned> FlatAst::unpackMask(uint64_t packed, std::pmr::memory_resource *resource) {
+        std::pmr::vector<unsigned> mask{resource};
+        for(uint64_t i = 0; i < (packed & 0xf); ++i) {
+            mask.push_back(static_cast<unsigned>(packed >> (4 * (i + 1))) & 0xf);
+        }
+        return mask;
+    }
+
+    uint32_t FlatAst::scopeOf(Index node) const {
+        switch(kind(node)) {
+            case NodeKind::Block:
+                return static_cast<uint32_t>(payloads_[node]);
+            case NodeKind::Function:
+                return static_cast<uint32_t>(payloads_[node] >> 32) & (MAX_SCOPES - 1);
+            default:
+                throw InvalidStateException("Only Block and Function nodes have a scope.");
+        }
+    }
+
+    unique_ptr<const Scope> FlatAst::toScope(uint32_t scope, AstContext *context) const {
+        ScopeBuilder sb = context ? ScopeBuilder{*context} : ScopeBuilder{};
+        uint32_t first = scopeFirstVariables_[scope];
+        for(uint32_t i = 0; i < scopeVariableCounts_[scope]; ++i) {
+            sb.addVariable(variables_[scopeVariables_[first + i]]);
+        }
+        return sb.build();
+    }
+
+    unique_ptr<const Node> FlatAst::toNodes(AstContext *context) const {
+        //Children precede their parents, so every node can be created in index order from nodes already created.
+        std::vector<unique_ptr<const Node>> nodes(size());
+        auto takeExpr = [&](Index child) -> unique_ptr<const Expr> {
+            if(child == NONE) {
+                return nullptr;
+            }
+            return unique_ptr<const Expr>(static_cast<const Expr*>(nodes[child].release()));
+        };
+
+        for(Index node = 0; node < size(); ++node) {
+            uint32_t first = firstChildren_[node];
+            switch(kind(node)) {
+                case NodeKind::LiteralInt32:
+                    nodes[node] = makeIn<const LiteralInt32>(context, int32Value(node));
+                    break;
+                case NodeKind::LiteralFloat:
+                    nodes[node] = makeIn<const LiteralFloat>(context, floatValue(node));
+                    break;
+                case NodeKind::LiteralInt64:
+                    nodes[node] = makeIn<const LiteralInt64>(context, int64Value(node));
+                    break;
+                case NodeKind::LiteralDouble:
+                    nodes[node] = makeIn<const LiteralDouble>(context, doubleValue(node));
+                    break;
+                case NodeKind::Binary:
+                    nodes[node] = makeIn<const Binary>(context,
+                                                       takeExpr(children_[first]),
+                                                       operation(node),
+                                                       takeExpr(children_[first + 1]));
+                    break;
+                case NodeKind::VariableRef:
+                    nodes[node] = makeIn<const VariableRef>(context, variables_[payloads_[node]]);
+                    break;
+                case NodeKind::AssignVariable:
+                    nodes[node] = makeIn<const AssignVariable>(context,
+                                                               variables_[payloads_[node]],
+                                                               takeExpr(children_[first]));
+                    break;
+                case NodeKind::Return:
+                    nodes[node] = makeIn<const Return>(context, takeExpr(children_[first]));
+                    break;
+                case NodeKind::Not:
+                    nodes[node] = makeIn<const Not>(context, takeExpr(children_[first]));
+                    break;
+                case NodeKind::Convert:
+                    nodes[node] = makeIn<const Convert>(context, takeExpr(children_[first]), dataType(node));
+                    break;
+                case NodeKind::CheckedBinary:
+                    nodes[node] = makeIn<const CheckedBinary>(context,
+                                                              takeExpr(children_[first]),
+                                                              operation(node),
+                                                              takeExpr(children_[first + 1]),
+                                                              takeExpr(children_[first + 2]));
+                    break;
+                case NodeKind::Invoke: {
+                    std::pmr::vector<ChildPtr<const Expr>> arguments{
+                        context ? context->resource() : std::pmr::get_default_resource()};
+                    for(uint32_t i = 0; i < childCounts_[node]; ++i) {
+                        arguments.emplace_back(takeExpr(children_[first + i]));
+                    }
+                    nodes[node] = makeIn<const Invoke>(context, name(node), dataType(node), move(arguments));
+                    break;
+                }
+                case NodeKind::Load:
+                    nodes[node] = makeIn<const Load>(context,
+                                                     dataType(node),
+                                                     takeExpr(children_[first]),
+                                                     static_cast<unsigned>(payloads_[node]));
+                    break;
+                case NodeKind::Store:
+                    nodes[node] = makeIn<const Store>(context,
+                                                      takeExpr(children_[first]),
+                                                      takeExpr(children_[first + 1]),
+                                                      static_cast<unsigned>(payloads_[node]));
+                    break;
+                case NodeKind::Index:
+                    nodes[node] = makeIn<const llast::Index>(context,
+                                                             static_cast<DataType>(payloads_[node]),
+                                                             takeExpr(children_[first]),
+                                                             takeExpr(children_[first + 1]));
+                    break;
+                case NodeKind::Splat:
+                    nodes[node] = makeIn<const Splat>(context, dataType(node), takeExpr(children_[first]));
+                    break;
+                case NodeKind::ExtractLane:
+                    nodes[node] = makeIn<const ExtractLane>(context,
+                                                            takeExpr(children_[first]),
+                                                            static_cast<unsigned>(payloads_[node]));
+                    break;
+                case NodeKind::InsertLane:
+                    nodes[node] = makeIn<const InsertLane>(context,
+                                                           takeExpr(children_[first]),
+                                                           static_cast<unsigned>(payloads_[node]),
+                                                           takeExpr(children_[first + 1]));
+                    break;
+                case NodeKind::Shuffle: {
+                    std::pmr::memory_resource *resource =
+                        context ? context->resource() : std::pmr::get_default_resource();
+                    nodes[node] = makeIn<const Shuffle>(context,
+                                                        takeExpr(children_[first]),
+                                                        takeExpr(children_[first + 1]),
+                                                        unpackMask(payloads_[node], resource));
+                    break;
+                }
+                case NodeKind::Reduce:
+                    nodes[node] = makeIn<const Reduce>(context, operation(node), takeExpr(children_[first]));
+                    break;
+                case NodeKind::Block: {
+                    std::pmr::vector<ChildPtr<const Expr>> expressions{
+                        context ? context->resource() : std::pmr::get_default_resource()};
+                    for(uint32_t i = 0; i < childCounts_[node]; ++i) {
+                        expressions.emplace_back(takeExpr(children_[first + i]));
+                    }
+                    nodes[node] = makeIn<const Block>(context, toScope(scopeOf(node), context), move(expressions));
+                    break;
+                }
+                case NodeKind::Conditional:
+                    nodes[node] = makeIn<const Conditional>(context,
+                                                            takeExpr(children_[first]),
+                                                            takeExpr(children_[first + 1]),
+                                                            takeExpr(children_[first + 2]),
+                                                            branchHint(node));
+                    break;
+                case NodeKind::Switch: {
+                    std::pmr::memory_resource *resource = context ? context->resource()
+                                                                  : std::pmr::get_default_resource();
+                    std::pmr::vector<int32_t> values{resource};
+                    std::pmr::vector<ChildPtr<const Expr>> cases{resource};
+                    for(uint32_t i = 0; i < caseCount(node); ++i) {
+                        values.push_back(caseValue(node, i));
+                        cases.emplace_back(takeExpr(children_[first + 1 + i]));
+                    }
+                    nodes[node] = makeIn<const Switch>(context,
+                                                       takeExpr(children_[first]),
+                                                       move(values),
+                                                       move(cases),
+                                                       takeExpr(children_[first + 1 + caseCount(node)]));
+                    break;
+                }
+                case NodeKind::While:
+                    nodes[node] = makeIn<const While>(context,
+                                                      takeExpr(children_[first]),
+                                                      takeExpr(children_[first + 1]));
+                    break;
+                case NodeKind::For:
+                    //Children are in walk order:  init, condition, body, update.
+                    nodes[node] = makeIn<const For>(context,
+                                                    takeExpr(children_[first]),
+                                                    takeExpr(children_[first + 1]),
+                                                    takeExpr(children_[first + 3]),
+                                                    takeExpr(children_[first + 2]));
+                    break;
+                case NodeKind::Map:
+                    nodes[node] = makeIn<const Map>(context,
+                                                    variables_[static_cast<uint32_t>(payloads_[node])],
+                                                    takeExpr(children_[first]),
+                                                    takeExpr(children_[first + 1]),
+                                                    takeExpr(children_[first + 2]));
+                    break;
+                case NodeKind::Fold:
+                    nodes[node] = makeIn<const Fold>(context,
+                                                     operation(node),
+                                                     variables_[static_cast<uint32_t>(payloads_[node])],
+                                                     takeExpr(children_[first]),
+                                                     takeExpr(children_[first + 1]));
+                    break;
+                case NodeKind::Break:
+                    nodes[node] = makeIn<const Break>(context);
+                    break;
+                case NodeKind::Continue:
+                    nodes[node] = makeIn<const Continue>(context);
+                    break;
+                case NodeKind::Function:
+                    nodes[node] = makeIn<const Function>(context,
+                                                         name(node),
+                                                         dataType(node),
+                                                         toScope(scopeOf(node), context),
+                                                         takeExpr(children_[first]),
+                                                         floatSemantics(node));
+                    break;
+                case NodeKind::Module: {
+                    std::pmr::vector<ChildPtr<const Function>> functions{
+                        context ? context->resource() : std::pmr::get_default_resource()};
+                    for(uint32_t i = 0; i < childCounts_[node]; ++i) {
+                        functions.emplace_back(static_cast<const Function*>(nodes[children_[first + i]].release()));
+                    }
+                    nodes[node] = makeIn<const Module>(context, name(node), move(functions));
+                    break;
+                }
+                default:
+                    throw UnhandledSwitchCase();
+            }
+        }
+
+        return move(nodes[root()]);
+    }
+
+    unique_ptr<const Module> FlatAst::toModule(AstContext *context) const {
+        if(size() == 0 || kind(root()) != NodeKind::Module) {
+            throw InvalidStateException("The root of the FlatAst is not a Module.");
+        }
+        return unique_ptr<const Module>(static_cast<const Module*>(toNodes(context).release()));
+    }
+
+    unique_ptr<const Expr> FlatAst::toExpr(AstContext *context) const {
+        if(size() == 0 || kind(root()) == NodeKind::Module || kind(root()) == NodeKind::Function) {
+            throw InvalidStateException("The root of the FlatAst is not an Expr.");
+        }
+        return unique_ptr<const Expr>(static_cast<const Expr*>(toNodes(context).release()));
+    }
+
+    static size_t combineHash(size_t seed, size_t value) {
+        return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+    }
+
+    std::vector<size_t> FlatAst::structuralHashes() const {
+        std::vector<size_t> hashes(size());
+        std::hash<string_view> hashText;
+
+        //Each variable is hashed once rather than at every reference to it.
+        std::vector<size_t> variableHashes;
+        variableHashes.reserve(variables_.size());
+        for(const shared_ptr<const Variable> &variable : variables_) {
+            variableHashes.push_back(combineHash(combineHash(hashText(variable->name()),
+                                                             static_cast<size_t>(variable->dataType())),
+                                                 variable->noAlias()));
+        }
+        auto hashVariable = [&](Index node) {
+            return variableHashes[static_cast<uint32_t>(payloads_[node])];
+        };
+        auto hashScope = [&](size_t seed, uint32_t scope) {
+            for(uint32_t slot = 0; slot < scopeSize(scope); ++slot) {
+                seed = combineHash(seed, variableHashes[scopeVariables_[scopeFirstVariables_[scope] + slot]]);
+            }
+            return seed;
+        };
+
+        for(Index node = 0; node < size(); ++node) {
+            size_t hash = combineHash(kinds_[node], dataTypes_[node]);
+            switch(kind(node)) {
+                case NodeKind::VariableRef:
+                case NodeKind::AssignVariable:
+                case NodeKind::Map:
+                    hash = combineHash(hash, hashVariable(node));
+                    break;
+                case NodeKind::Fold:
+                    hash = combineHash(hash, static_cast<size_t>(operation(node)));
+                    hash = combineHash(hash, hashVariable(node));
+                    break;
+                case NodeKind::Switch:
+                    for(uint32_t i = 0; i < caseCount(node); ++i) {
+                        hash = combineHash(hash, static_cast<uint32_t>(caseValue(node, i)));
+                    }
+                    break;
+                case NodeKind::Block:
+                    hash = hashScope(hash, scopeOf(node));
+                    break;
+                case NodeKind::Function:
+                    hash = combineHash(hash, static_cast<size_t>(floatSemantics(node)));
+                    hash = hashScope(combineHash(hash, hashText(name(node).str())), scopeOf(node));
+                    break;
+                case NodeKind::Invoke:
+                case NodeKind::Module:
+                    hash = combineHash(hash, hashText(name(node).str()));
+                    break;
+                default:
+                    hash = combineHash(hash, static_cast<size_t>(payloads_[node]));
+                    break;
+            }
+
+            for(uint32_t i = 0; i < childCounts_[node]; ++i) {
+                Index c = child(node, i);
+                hash = combineHash(hash, c == NONE ? 0 : hashes[c]);
+            }
+            hashes[node] = hash;
+        }
+
+        return hashes;
+    }
+
+    bool FlatAst::structurallyEqual(const FlatAst &other) const {
+        //Tables are filled in the order in which the builder meets their entries, so equal trees have equal arrays.
+        if(kinds_ != other.kinds_
+           || dataTypes_ != other.dataTypes_
+           || payloads_ != other.payloads_
+           || firstChildren_ != other.firstChildren_
+           || childCounts_ != other.childCounts_
+           || children_ != other.children_
+           || scopeFirstVariables_ != other.scopeFirstVariables_
+           || scopeVariableCounts_ != other.scopeVariableCounts_
+           || scopeVariables_ != other.scopeVariables_
+           || caseValues_ != other.caseValues_
+           || variables_.size() != other.variables_.size()
+           || names_.size() != other.names_.size()) {
+            return false;
+        }
+        for(size_t i = 0; i < variables_.size(); ++i) {
+            const Variable *variable = variables_[i].get();
+            const Variable *otherVariable = other.variables_[i].get();
+            if(variable->name() != otherVariable->name()
+               || variable->dataType() != otherVariable->dataType()
+               || variable->noAlias() != otherVariable->noAlias()) {
+                return false;
+            }
+        }
+        for(size_t i = 0; i < names_.size(); ++i) {
+            if(names_[i].str() != other.names_[i].str()) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include "AST.hpp"
+
+#include <cstdint>
+
+namespace llast {
+
+    /** A compact, index-based encoding of a tree of llast nodes.
+     *
+     * Each node is identified by a 32 bit index and its attributes are stored in parallel arrays (struct of arrays):
+     * its kind, its data type, a 64 bit payload and the range of its children within a shared array of child
+     * indexes.  Literal values are stored inline in the payload; the payload of other nodes is an OperationKind or an
+     * index into one of the tables of variables, scopes, names or case values.  Nodes are stored in post-order, so
+     * the children of a node always have lower indexes than the node itself and the root is the last node.  This
+     * allows many analyses (i.e. structuralHashes()) to be a single loop over the arrays instead of a walk of the
+     * tree.
+     *
+     * Payloads by node kind:
+     *      - LiteralInt32, LiteralFloat, LiteralInt64, LiteralDouble:  the bits of the value.
+     *      - Binary, CheckedBinary:  the OperationKind.
+     *      - VariableRef, AssignVariable:  index into variables().
+     *      - Block:  scope index.
+     *      - Function:  name index in the low 32 bits, parameter scope index in the next 24 bits and the
+     *        FloatSemantics in the high 8 bits.
+     *      - Invoke, Module:  name index.
+     *      - Load, Store:  the alignment.
+     *      - Index:  the element DataType.
+     *      - ExtractLane, InsertLane:  the lane.
+     *      - Shuffle:  the mask, as packed by packMask().
+     *      - Reduce:  the OperationKind.
+     *      - Map:  index into variables() of the index variable.
+     *      - Fold:  index into variables() of the index variable in the low 32 bits and the OperationKind in the high
+     *        32 bits.
+     *      - Conditional:  the BranchHint.
+     *      - Switch:  index of its first case value in the table of case values (see caseValue()).
+     *
+     * A Conditional always has three children and a For always has four, in walk order (init, condition, body,
+     * update).  A Switch has its discriminant, its cases and its default case;  absent parts are NONE.
+     */
+    class FlatAst {
+    public:
+        typedef uint32_t Index;
+        static constexpr Index NONE = UINT32_MAX;
+
+    private:
+        std::vector<uint8_t> kinds_;
+        std::vector<uint8_t> dataTypes_;
+        std::vector<uint64_t> payloads_;
+        std::vector<uint32_t> firstChildren_;
+        std::vector<uint32_t> childCounts_;
+        std::vector<Index> children_;
+
+        std::vector<shared_ptr<const Variable>> variables_;
+        std::vector<uint32_t> scopeFirstVariables_;
+        std::vector<uint32_t> scopeVariableCounts_;
+        std::vector<uint32_t> scopeVariables_;
+        std::vector<Symbol> names_;
+        std::vector<int32_t> caseValues_;
+
+        friend class FlatAstBuilder;
+        friend class SExprParser;
+
+    public:
+        static FlatAst fromModule(const Module *module);
+        static FlatAst fromExpr(const Expr *expr);
+        /** The root of the result is a Function, so it cannot be converted back to nodes. */
+        static FlatAst fromFunction(const Function *func);
+
+        size_t size() const { return kinds_.size(); }
+        Index root() const { return static_cast<Index>(kinds_.size() - 1); }
+
+        NodeKind kind(Index node) const { return static_cast<NodeKind>(kinds_[node]); }
+        DataType dataType(Index node) const { return static_cast<DataType>(dataTypes_[node]); }
+        uint64_t payload(Index node) const { return payloads_[node]; }
+
+        uint32_t childCount(Index node) const { return childCounts_[node]; }
+        Index child(Index node, uint32_t i) const { return children_[firstChildren_[node] + i]; }
+
+        int32_t int32Value(Index node) const { return static_cast<int32_t>(static_cast<uint32_t>(payloads_[node])); }
+        float floatValue(Index node) const;
+        int64_t int64Value(Index node) const { return static_cast<int64_t>(payloads_[node]); }
+        double doubleValue(Index node) const;
+        OperationKind operation(Index node) const {
+            return static_cast<OperationKind>(kind(node) == NodeKind::Fold ? payloads_[node] >> 32 : payloads_[node]);
+        }
+        const Variable *variable(Index node) const { return variables_[static_cast<uint32_t>(payloads_[node])].get(); }
+        Symbol name(Index node) const { return names_[static_cast<uint32_t>(payloads_[node])]; }
+        BranchHint branchHint(Index node) const { return static_cast<BranchHint>(payloads_[node]); }
+        FloatSemantics floatSemantics(Index node) const { return static_cast<FloatSemantics>(payloads_[node] >> 56); }
+
+        /** The number of scopes a FlatAst may have, since a Function has 24 bits for its parameter scope index. */
+        static constexpr uint32_t MAX_SCOPES = 1u << 24;
+
+        /** The values of the cases of a Switch, which has two more children than it has cases. */
+        uint32_t caseCount(Index node) const { return childCounts_[node] - 2; }
+        int32_t caseValue(Index node, uint32_t i) const { return caseValues_[payloads_[node] + i]; }
+
+        /** Packs the mask of a Shuffle into 64 bits:  the number of lanes in the low 4 bits, followed by 4 bits for
+         * each lane.  This relies on the limits on masks enforced by Shuffle. */
+        static uint64_t packMask(const std::pmr::vector<unsigned> &mask);
+        static std::pmr::vector<unsigned> unpackMask(uint64_t packed, std::pmr::memory_resource *resource);
+
+        /** The scope of a Block or the parameter scope of a Function, as indexes into variables(). */
+        uint32_t scopeOf(Index node) const;
+        uint32_t scopeCount() const { return static_cast<uint32_t>(scopeVariableCounts_.size()); }
+        uint32_t scopeSize(uint32_t scope) const { return scopeVariableCounts_[scope]; }
+        const Variable *scopeVariable(uint32_t scope, uint32_t slot) const {
+            return variables_[scopeVariables_[scopeFirstVariables_[scope] + slot]].get();
+        }
+
+        const std::vector<shared_ptr<const Variable>> &variables() const { return variables_; }
+
+        /** Converts back to nodes, allocated in context if it is not null.  Does not recurse. */
+        unique_ptr<const Module> toModule(AstContext *context = nullptr) const;
+        unique_ptr<const Expr> toExpr(AstContext *context = nullptr) const;
+
+        /** Computes a hash of each node's subtree which depends only on its structure, the names and types of its
+         * variables and its literal values, in one pass over the nodes. */
+        std::vector<size_t> structuralHashes() const;
+
+        /** True if other encodes a tree with the same structure, variable names and types and literal values, i.e.
+         * one which structuralHashes() hashes the same way without relying on the hashes being unique. */
+        bool structurallyEqual(const FlatAst &other) const;
+
+    private:
+        /** Appends a node whose children are the last childCount entries of pending, and replaces them with its
+         * index. */
+        void appendNode(NodeKind kind, DataType dataType, uint64_t payload, size_t childCount,
+                        std::vector<Index> &pending) {
+            if(kinds_.size() >= NONE) {
+                throw InvalidStateException("Tree has too many nodes to be flattened.");
+            }
+
+            kinds_.push_back(static_cast<uint8_t>(kind));
+            dataTypes_.push_back(static_cast<uint8_t>(dataType));
+            payloads_.push_back(payload);
+            firstChildren_.push_back(static_cast<uint32_t>(children_.size()));
+            childCounts_.push_back(static_cast<uint32_t>(childCount));
+
+            //Nodes have few children, for which a loop is cheaper than the call to memmove that insert() makes.
+            for(size_t i = pending.size() - childCount; i < pending.size(); ++i) {
+                children_.push_back(pending[i]);
+            }
+            pending.resize(pending.size() - childCount);
+            pending.push_back(static_cast<Index>(kinds_.size() - 1));
+        }
+        unique_ptr<const Node> toNodes(AstContext *context) const;
+        unique_ptr<const Scope> toScope(uint32_t scope, AstContext *context) const;
+    };
+
+    /** Receives the nodes of a FlatAst from FlatAstWalker. */
+    class FlatAstVisitor {
+    public:
+        virtual ~FlatAstVisitor() { }
+
+        /** Executes before the children of node are visited. */
+        virtual void visitingNode(const FlatAst &, FlatAst::Index) { }
+
+        /** Executes after the children of node are visited. */
+        virtual void visitedNode(const FlatAst &, FlatAst::Index) { }
+    };
+
+    /** Walks a FlatAst depth first, in the same order as ExpressionTreeWalker.  Uses an explicit stack so the depth of
+     * the tree is not limited by the size of the native stack. */
+    class FlatAstWalker {
+        FlatAstVisitor *visitor_;
+        std::vector<std::pair<FlatAst::Index, uint32_t>> stack_;
+    public:
+        FlatAstWalker(FlatAstVisitor *visitor) : visitor_{visitor} { }
+
+        void walk(const FlatAst &ast) {
+            walk(ast, ast.root());
+        }
+
+        void walk(const FlatAst &ast, FlatAst::Index node) {
+            stack_.clear();
+            visitor_->visitingNode(ast, node);
+            stack_.emplace_back(node, 0);
+
+            while(!stack_.empty()) {
+                auto &top = stack_.back();
+                if(top.second == ast.childCount(top.first)) {
+                    visitor_->visitedNode(ast, top.first);
+                    stack_.pop_back();
+                    continue;
+                }
+
+                FlatAst::Index child = ast.child(top.first, top.second++);
+                if(child != FlatAst::NONE) {
+                    visitor_->visitingNode(ast, child);
+                    stack_.emplace_back(child, 0);
+                }
+            }
+        }
+    };
+}
@@ -0,0 +1,172 @@
+#include "FlatAst.hpp"
+#include "SExpr.hpp"
+#include "StaticExpressionTreeWalker.hpp"
+#include "IterativeExpressionTreeWalker.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace llast;
+
+namespace {
+    /** Generates a module of about size bytes of text whose functions mix arithmetic, conditionals and loops. */
+    string generateModule(size_t size) {
+        string text = "(module benchmark\n";
+        for(unsigned i = 0; text.size() < size; ++i) {
+            string n = std::to_string(i);
+            text += "  (function rule" + n + " Int32 (params (input Int32) (weight Float) (limit Int32))\n"
+                    "    (block ((score Int32) (scaled Float) (i Int32))\n"
+                    "      (set score (add (mul input " + n + ") (sub limit (div input 3))))\n"
+                    "      (set scaled (mul (convert Float score) (add weight 0.25)))\n"
+                    "      (if (and (gt score limit) (lt scaled 1024.5))\n"
+                    "          (set score (max limit (min score (add limit " + n + "))))\n"
+                    "          nil)\n"
+                    "      (for (set i 0) (lt i limit) (set score (add score (mul i 7))) (set i (add i 1)))\n"
+                    "      (return (add score (convert Int32 scaled)))))\n";
+        }
+        text += ")\n";
+        return text;
+    }
+
+    size_t combine(size_t seed, size_t value) {
+        return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+    }
+
+    /** Computes a hash of each node's subtree from its kind, data type, literal value or variable name and the
+     * hashes of its children, as FlatAst::structuralHashes() does, in post-order. */
+    class NodeHasher : public StaticExpressionTreeWalker<NodeHasher> {
+        friend class StaticExpressionTreeWalker<NodeHasher>;
+        //The hashes of the children of the nodes on the path to the current node, and where each node's begin.
+        std::vector<size_t> pending_;
+        std::vector<size_t> firstChildren_;
+        std::vector<size_t> hashes_;
+
+    public:
+        const std::vector<size_t> &hashes() const { return hashes_; }
+
+    private:
+        void initialize() {
+            hashes_.clear();
+        }
+
+        void visitingNode(const Node *) {
+            firstChildren_.push_back(pending_.size());
+        }
+
+        void visitedNode(const Node *node) {
+            size_t hash = static_cast<size_t>(node->nodeKind());
+            switch(node->nodeKind()) {
+                case NodeKind::Module:
+                case NodeKind::Function:
+                    break;
+                case NodeKind::LiteralInt32:
+                    hash = combine(hash, static_cast<uint32_t>(static_cast<const LiteralInt32*>(node)->value()));
+                    break;
+                case NodeKind::VariableRef:
+                    hash = combine(hash, static_cast<const VariableRef*>(node)->symbol().hash());
+                    break;
+                default:
+                    hash = combine(hash, static_cast<size_t>(static_cast<const Expr*>(node)->dataType()));
+                    break;
+            }
+            for(size_t i = firstChildren_.back(); i < pending_.size(); ++i) {
+                hash = combine(hash, pending_[i]);
+            }
+            pending_.resize(firstChildren_.back());
+            firstChildren_.pop_back();
+            pending_.push_back(hash);
+            hashes_.push_back(hash);
+        }
+    };
+
+    /** Counts the nodes and sums the Int32 literals of a Node tree, through virtual callbacks. */
+    class NodeCounter : public ExpressionTreeVisitor {
+    public:
+        size_t nodes = 0;
+        int64_t sum = 0;
+
+        void visitingNode(const Node *) override {
+            ++nodes;
+        }
+
+        void visitLiteralInt32(const LiteralInt32 *expr) override {
+            sum += expr->value();
+        }
+    };
+
+    /** Counts the nodes and sums the Int32 literals of a FlatAst, through virtual callbacks. */
+    class FlatCounter : public FlatAstVisitor {
+    public:
+        size_t nodes = 0;
+        int64_t sum = 0;
+
+        void visitingNode(const FlatAst &ast, FlatAst::Index node) override {
+            ++nodes;
+            if(ast.kind(node) == NodeKind::LiteralInt32) {
+                sum += ast.int32Value(node);
+            }
+        }
+    };
+
+    /** Runs pass repeatedly for at least half a second and returns the duration of the fastest run in
+     * milliseconds, which is the least disturbed by other activity on the machine. */
+    template<typename TPass>
+    double measure(TPass pass) {
+        using Clock = std::chrono::steady_clock;
+        std::chrono::duration<double> fastest{0};
+        std::chrono::duration<double> total{0};
+        for(unsigned iteration = 0; iteration < 3 || total.count() < 0.5; ++iteration) {
+            Clock::time_point start = Clock::now();
+            pass();
+            std::chrono::duration<double> elapsed = Clock::now() - start;
+            if(iteration == 0 || elapsed < fastest) {
+                fastest = elapsed;
+            }
+            total += elapsed;
+        }
+        return fastest.count() * 1000;
+    }
+
+    void report(const char *pass, double nodeTree, double flat) {
+        std::printf("  %-18s Node tree %8.2f ms   FlatAst %8.2f ms   %5.1fx\n", pass, nodeTree, flat, nodeTree / flat);
+    }
+}
+
+/** Compares structural hashing and a walk over a generated module, optionally of the size in MB of text given as
+ * argument, as a Node tree and as a FlatAst.  Build with optimizations for meaningful results. */
+int main(int argc, char **argv) {
+    size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16;
+    unique_ptr<const Module> module = SExprParser{}.parseModule(generateModule(megabytes * 1000000));
+    FlatAst flat = FlatAst::fromModule(module.get());
+    std::printf("A module of %zu nodes\n", flat.size());
+
+    //The results are accumulated and printed so that the passes cannot be optimized away.
+    size_t checksum = 0;
+    double conversion = measure([&]() { checksum += FlatAst::fromModule(module.get()).size(); });
+    std::printf("  %-18s %8.2f ms\n", "FlatAst::fromModule", conversion);
+
+    NodeHasher hasher;
+    double nodeHashes = measure([&]() {
+        hasher.walkTree(module.get());
+        checksum += hasher.hashes().back();
+    });
+    double flatHashes = measure([&]() { checksum += flat.structuralHashes().back(); });
+    report("structural hashes", nodeHashes, flatHashes);
+
+    double nodeWalk = measure([&]() {
+        NodeCounter counter;
+        IterativeExpressionTreeWalker{&counter}.walkTree(module.get());
+        checksum += counter.nodes + counter.sum;
+    });
+    double flatWalk = measure([&]() {
+        FlatCounter counter;
+        FlatAstWalker{&counter}.walk(flat);
+        checksum += counter.nodes + counter.sum;
+    });
+    report("walk", nodeWalk, flatWalk);
+
+    std::printf("(checksum %zx)\n", checksum);
+    return 0;
+}
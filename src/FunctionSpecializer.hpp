@@ -0,0 +1,93 @@
+#pragma once
+
+#include "ExpressionTreeTransformer.hpp"
+#include "FlatAst.hpp"
+
+namespace llast {
+
+    /** Produces variants of a Function in which some of its parameters have known values (partial evaluation).
+     *
+     * The bound parameters are removed from the parameters of the variant and become variables of a Block enclosing
+     * its body, which assigns them their values before the body is evaluated.  Code generation keeps variables in SSA
+     * form, so a parameter whose value is a literal is a constant wherever the body reads it and the operations and
+     * branches depending on it are folded away.  A body which assigns one of the bound parameters simply assigns the
+     * variable.
+     */
+    class FunctionSpecializer : public ExpressionTreeTransformer {
+        std::vector<std::pair<string, const Expr*>> values_;
+
+    public:
+        FunctionSpecializer() { }
+
+        /** New nodes are allocated in context and unchanged subtrees are shared with the original tree. */
+        FunctionSpecializer(AstContext &context) : ExpressionTreeTransformer{context} { }
+
+        /** Gives the parameter named parameter the value of value, which is normally a literal and may not refer to
+         * variables.  value is copied in full into each variant, even when unchanged subtrees are shared, so it need
+         * only outlive the calls to specialize(). */
+        FunctionSpecializer &bind(string_view parameter, const Expr *value) {
+            ARG_NOT_NULL(value);
+            values_.emplace_back(string(parameter), value);
+            return *this;
+        }
+
+        /** Returns the value bound to each parameter of func, in order, or null for a parameter which is not bound.
+         * Throws CompileException if a bound parameter is not a parameter of func, is bound more than once or has a
+         * value of another data type. */
+        std::vector<const Expr*> parameterValues(const Function *func) const {
+            ARG_NOT_NULL(func);
+            const Scope *parameters = func->parameterScope();
+            std::vector<const Expr*> values(parameters->size());
+            for(auto &value : values_) {
+                size_t slot = 0;
+                while(slot < parameters->size() && parameters->variable(slot)->name() != value.first) {
+                    ++slot;
+                }
+                if(slot == parameters->size()) {
+                    throw CompileException(CompileError::UndefinedVariable,
+                                           "Function '" + string(func->name()) + "' has no parameter '"
+                                           + value.first + "'");
+                }
+                if(values[slot]) {
+                    throw CompileException(CompileError::InvalidOperandType,
+                                           "Parameter '" + value.first + "' is bound more than once");
+                }
+                DataType dataType = parameters->variable(slot)->dataType();
+                if(value.second->dataType() != dataType) {
+                    throw CompileException(CompileError::InvalidOperandType,
+                                           "The value of parameter '" + value.first + "' must be a "
+                                           + to_string(dataType));
+                }
+                values[slot] = value.second;
+            }
+            return values;
+        }
+
+        /** Returns the variant of func named name.  Throws CompileException as parameterValues() does. */
+        unique_ptr<const Function> specialize(const Function *func, Symbol name) {
+            std::vector<const Expr*> values = parameterValues(func);
+            const Scope *parameters = func->parameterScope();
+            ScopeBuilder remaining = context() ? ScopeBuilder{*context()} : ScopeBuilder{};
+            BlockBuilder body = context() ? BlockBuilder{*context()} : BlockBuilder{};
+            size_t slot = 0;
+            parameters->forEachVariable([&](const shared_ptr<const Variable> &parameter) {
+                if(const Expr *value = values[slot++]) {
+                    body.addVariable(parameter);
+                    body.addExpression(makeIn<const AssignVariable>(context(),
+                                                                    parameter,
+                                                                    FlatAst::fromExpr(value).toExpr(context())));
+                } else {
+                    remaining.addVariable(parameter);
+                }
+            });
+            body.addExpression(transform(func->body()));
+
+            return makeIn<const Function>(context(),
+                                          name,
+                                          func->returnType(),
+                                          remaining.build(),
+                                          body.build(),
+                                          func->floatSemantics());
+        }
+    };
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "ExpressionTreeVisitor.hpp"
+#include "StaticExpressionTreeWalker.hpp"
+
+namespace llast {
+
+    /** Walks a tree for an ExpressionTreeVisitor without recursing, so that very deep trees (i.e. long machine
+     * generated chains of Binary expressions) do not overflow the native stack.  The visitor sees exactly the same
+     * sequence of callbacks as with ExpressionTreeWalker.  The stack is reused by subsequent walks.
+     */
+    class IterativeExpressionTreeWalker : public StaticExpressionTreeWalker<IterativeExpressionTreeWalker> {
+        friend class StaticExpressionTreeWalker<IterativeExpressionTreeWalker>;
+        ExpressionTreeVisitor *visitor_;
+
+    public:
+        IterativeExpressionTreeWalker(ExpressionTreeVisitor *visitor) : visitor_{visitor} {
+            ARG_NOT_NULL(visitor);
+        }
+
+    private:
+        void initialize() { visitor_->initialize(); }
+        void cleanUp() { visitor_->cleanUp(); }
+        void visitingNode(const Node *node) { visitor_->visitingNode(node); }
+        void visitedNode(const Node *node) { visitor_->visitedNode(node); }
+        void visitingBlock(const Block *expr) { visitor_->visitingBlock(expr); }
+        void visitedBlock(const Block *expr) { visitor_->visitedBlock(expr); }
+        void visitingConditional(const Conditional *expr) { visitor_->visitingConditional(expr); }
+        void visitingTruePart(const Conditional *expr) { visitor_->visitingTruePart(expr); }
+        void visitingFalsePart(const Conditional *expr) { visitor_->visitingFalsePart(expr); }
+        void visitedConditional(const Conditional *expr) { visitor_->visitedConditional(expr); }
+        void visitingSwitch(const Switch *expr) { visitor_->visitingSwitch(expr); }
+        void visitingSwitchCase(const Switch *expr, size_t index) { visitor_->visitingSwitchCase(expr, index); }
+        void visitingSwitchDefault(const Switch *expr) { visitor_->visitingSwitchDefault(expr); }
+        void visitedSwitch(const Switch *expr) { visitor_->visitedSwitch(expr); }
+        void visitingWhile(const While *expr) { visitor_->visitingWhile(expr); }
+        void visitingWhileBody(const While *expr) { visitor_->visitingWhileBody(expr); }
+        void visitedWhile(const While *expr) { visitor_->visitedWhile(expr); }
+        void visitingFor(const For *expr) { visitor_->visitingFor(expr); }
+        void visitingForCondition(const For *expr) { visitor_->visitingForCondition(expr); }
+        void visitingForBody(const For *expr) { visitor_->visitingForBody(expr); }
+        void visitingForUpdate(const For *expr) { visitor_->visitingForUpdate(expr); }
+        void visitedFor(const For *expr) { visitor_->visitedFor(expr); }
+        void visitingMap(const Map *expr) { visitor_->visitingMap(expr); }
+        void visitingMapBody(const Map *expr) { visitor_->visitingMapBody(expr); }
+        void visitedMap(const Map *expr) { visitor_->visitedMap(expr); }
+        void visitingFold(const Fold *expr) { visitor_->visitingFold(expr); }
+        void visitingFoldBody(const Fold *expr) { visitor_->visitingFoldBody(expr); }
+        void visitedFold(const Fold *expr) { visitor_->visitedFold(expr); }
+        void visitBreak(const Break *expr) { visitor_->visitBreak(expr); }
+        void visitContinue(const Continue *expr) { visitor_->visitContinue(expr); }
+        void visitingBinary(const Binary *expr) { visitor_->visitingBinary(expr); }
+        void visitingRValue(const Binary *expr) { visitor_->visitingRValue(expr); }
+        void visitedBinary(const Binary *expr) { visitor_->visitedBinary(expr); }
+        void visitingNot(const Not *expr) { visitor_->visitingNot(expr); }
+        void visitedNot(const Not *expr) { visitor_->visitedNot(expr); }
+        void visitingConvert(const Convert *expr) { visitor_->visitingConvert(expr); }
+        void visitedConvert(const Convert *expr) { visitor_->visitedConvert(expr); }
+        void visitingCheckedBinary(const CheckedBinary *expr) { visitor_->visitingCheckedBinary(expr); }
+        void visitingOverflow(const CheckedBinary *expr) { visitor_->visitingOverflow(expr); }
+        void visitedCheckedBinary(const CheckedBinary *expr) { visitor_->visitedCheckedBinary(expr); }
+        void visitingInvoke(const Invoke *expr) { visitor_->visitingInvoke(expr); }
+        void visitedInvoke(const Invoke *expr) { visitor_->visitedInvoke(expr); }
+        void visitingLoad(const Load *expr) { visitor_->visitingLoad(expr); }
+        void visitedLoad(const Load *expr) { visitor_->visitedLoad(expr); }
+        void visitingStore(const Store *expr) { visitor_->visitingStore(expr); }
+        void visitedStore(const Store *expr) { visitor_->visitedStore(expr); }
+        void visitingIndex(const Index *expr) { visitor_->visitingIndex(expr); }
+        void visitedIndex(const Index *expr) { visitor_->visitedIndex(expr); }
+        void visitingSplat(const Splat *expr) { visitor_->visitingSplat(expr); }
+        void visitedSplat(const Splat *expr) { visitor_->visitedSplat(expr); }
+        void visitingExtractLane(const ExtractLane *expr) { visitor_->visitingExtractLane(expr); }
+        void visitedExtractLane(const ExtractLane *expr) { visitor_->visitedExtractLane(expr); }
+        void visitingInsertLane(const InsertLane *expr) { visitor_->visitingInsertLane(expr); }
+        void visitedInsertLane(const InsertLane *expr) { visitor_->visitedInsertLane(expr); }
+        void visitingShuffle(const Shuffle *expr) { visitor_->visitingShuffle(expr); }
+        void visitedShuffle(const Shuffle *expr) { visitor_->visitedShuffle(expr); }
+        void visitingReduce(const Reduce *expr) { visitor_->visitingReduce(expr); }
+        void visitedReduce(const Reduce *expr) { visitor_->visitedReduce(expr); }
+        void visitLiteralInt32(const LiteralInt32 *expr) { visitor_->visitLiteralInt32(expr); }
+        void visitLiteralFloat(const LiteralFloat *expr) { visitor_->visitLiteralFloat(expr); }
+        void visitLiteralInt64(const LiteralInt64 *expr) { visitor_->visitLiteralInt64(expr); }
+        void visitLiteralDouble(const LiteralDouble *expr) { visitor_->visitLiteralDouble(expr); }
+        void visitingReturn(const Return *expr) { visitor_->visitingReturn(expr); }
+        void visitedReturn(const Return *expr) { visitor_->visitedReturn(expr); }
+        void visitVariableRef(const VariableRef *expr) { visitor_->visitVariableRef(expr); }
+        void visitingAssignVariable(const AssignVariable *expr) { visitor_->visitingAssignVariable(expr); }
+        void visitedAssignVariable(const AssignVariable *expr) { visitor_->visitedAssignVariable(expr); }
+        void visitingFunction(const Function *func) { visitor_->visitingFunction(func); }
+        void visitedFunction(const Function *func) { visitor_->visitedFunction(func); }
+        void visitingModule(const Module *module) { visitor_->visitingModule(module); }
+        void visitedModule(const Module *module) { visitor_->visitedModule(module); }
+    };
+}
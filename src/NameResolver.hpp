@@ -0,0 +1,122 @@
+#pragma once
+
+#include "StaticExpressionTreeWalker.hpp"
+
+namespace llast {
+
+    /** Identifies the storage of a variable:  depth is the number of scopes between the root of the tree and the
+     * scope declaring the variable (the parameter scope of a function has depth 0 and the function's body has depth
+     * 1) and index is the variable's slot within that scope. */
+    struct VariableSlot {
+        unsigned depth;
+        unsigned index;
+    };
+
+    /** The result of name resolution:  the slot referenced by each VariableRef and AssignVariable of a tree and the
+     * slot of the index of each Map and Fold. */
+    class VariableBindings {
+        std::unordered_map<const Node*, VariableSlot> slots_;
+    public:
+        void bind(const Node *node, VariableSlot slot) {
+            slots_[node] = slot;
+        }
+
+        const VariableSlot &slotOf(const VariableRef *expr) const { return find(expr); }
+        const VariableSlot &slotOf(const AssignVariable *expr) const { return find(expr); }
+        const VariableSlot &slotOf(const Map *expr) const { return find(expr); }
+        const VariableSlot &slotOf(const Fold *expr) const { return find(expr); }
+
+    private:
+        const VariableSlot &find(const Node *node) const {
+            auto found = slots_.find(node);
+            if(found == slots_.end()) {
+                throw InvalidStateException("Node was not bound by NameResolver.");
+            }
+            return found->second;
+        }
+    };
+
+    /** Binds each VariableRef, AssignVariable, Map and Fold to the slot of the variable it names.  This is the only
+     * place names are looked up; later passes use the resulting VariableBindings.  All undefined variables are
+     * reported at once with a CompileException. */
+    class NameResolver : public StaticExpressionTreeWalker<NameResolver> {
+        std::vector<const Scope*> scopes_;
+        std::vector<Symbol> undefinedNames_;
+        VariableBindings bindings_;
+
+    public:
+        VariableBindings resolve(const Module *module) {
+            walkTree(module);
+            return finish();
+        }
+
+        VariableBindings resolve(const Function *func) {
+            walkTree(func);
+            return finish();
+        }
+
+        VariableBindings resolve(const Expr *expr) {
+            walkTree(expr);
+            return finish();
+        }
+
+    private:
+        friend class StaticExpressionTreeWalker<NameResolver>;
+
+        VariableBindings finish() {
+            if(!undefinedNames_.empty()) {
+                string message = "Undefined variable(s):";
+                for(Symbol name : undefinedNames_) {
+                    message += " '" + string(name.str()) + "'";
+                }
+                throw CompileException(CompileError::UndefinedVariable, message);
+            }
+
+            return move(bindings_);
+        }
+
+        void bind(const Node *node, Symbol name) {
+            for(size_t depth = scopes_.size(); depth > 0; --depth) {
+                int index = scopes_[depth - 1]->findSlot(name);
+                if(index >= 0) {
+                    bindings_.bind(node, VariableSlot{ static_cast<unsigned>(depth - 1), static_cast<unsigned>(index) });
+                    return;
+                }
+            }
+
+            undefinedNames_.push_back(name);
+        }
+
+        void visitingFunction(const Function *func) {
+            scopes_.push_back(func->parameterScope());
+        }
+
+        void visitedFunction(const Function *) {
+            scopes_.pop_back();
+        }
+
+        void visitingBlock(const Block *expr) {
+            scopes_.push_back(expr->scope());
+        }
+
+        void visitedBlock(const Block *) {
+            scopes_.pop_back();
+        }
+
+        void visitVariableRef(const VariableRef *expr) {
+            bind(expr, expr->symbol());
+        }
+
+        void visitingAssignVariable(const AssignVariable *expr) {
+            bind(expr, expr->symbol());
+        }
+
+        void visitingMap(const Map *expr) {
+            bind(expr, expr->indexSymbol());
+        }
+
+        void visitingFold(const Fold *expr) {
+            bind(expr, expr->indexSymbol());
+        }
+    };
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "IterativeExpressionTreeWalker.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+
+namespace llast {
+
+    /** Runs a read-only analysis over the functions of a Module on several threads.
+     *
+     * Functions are independent and immutable, so each worker thread walks whole functions with its own instance of
+     * TVisitor, taking the next function not yet claimed by any worker until none are left.  Once every worker has
+     * finished, the visitors are handed one at a time to a merge callback on the calling thread.  Which functions a
+     * given visitor saw is not deterministic, so merging must not depend on it.
+     *
+     * TVisitor is either an ExpressionTreeVisitor or a StaticExpressionTreeWalker<TVisitor>.  Its initialize() and
+     * cleanUp() are invoked before and after each function.  The visiting/visited callbacks for the Module are not
+     * invoked.  If a visitor throws, the remaining functions are abandoned and the first exception is rethrown
+     * from walk().  If fewer threads than requested can be started, walk() proceeds with those that were.
+     */
+    template<typename TVisitor>
+    class ParallelFunctionWalker {
+        unsigned threadCount_;
+    public:
+        /** threadCount includes the calling thread, which also walks functions. */
+        ParallelFunctionWalker(unsigned threadCount = std::thread::hardware_concurrency())
+            : threadCount_{threadCount > 0 ? threadCount : 1} { }
+
+        /** makeVisitor is invoked once per worker, on that worker's thread, and returns a std::unique_ptr<TVisitor>.
+         * merge is invoked with a TVisitor & for each worker, in order, after all workers have finished. */
+        template<typename TMakeVisitor, typename TMerge>
+        void walk(const Module *module, TMakeVisitor makeVisitor, TMerge merge) {
+            ARG_NOT_NULL(module);
+
+            size_t functionCount = module->functionCount();
+            unsigned workerCount = static_cast<unsigned>(std::min<size_t>(threadCount_, functionCount));
+            if(workerCount == 0) {
+                return;
+            }
+
+            std::atomic<size_t> nextFunction{0};
+            std::vector<std::unique_ptr<TVisitor>> visitors(workerCount);
+            std::vector<std::exception_ptr> errors(workerCount);
+
+            auto work = [&](unsigned worker) {
+                try {
+                    visitors[worker] = makeVisitor();
+                    for(size_t i = nextFunction++; i < functionCount; i = nextFunction++) {
+                        walkFunction(*visitors[worker], module->function(i));
+                    }
+                } catch(...) {
+                    errors[worker] = std::current_exception();
+                    nextFunction = functionCount;
+                }
+            };
+
+            // If a thread cannot be started, the workers already running and the calling thread share the remaining
+            // functions; the threads must be joined regardless, since they refer to the locals above.
+            std::vector<std::thread> threads;
+            threads.reserve(workerCount - 1);
+            for(unsigned worker = 1; worker < workerCount; ++worker) {
+                try {
+                    threads.emplace_back(work, worker);
+                } catch(const std::system_error &) {
+                    workerCount = worker;
+                    break;
+                }
+            }
+            work(0);
+            for(auto &thread : threads) {
+                thread.join();
+            }
+
+            for(unsigned worker = 0; worker < workerCount; ++worker) {
+                if(errors[worker]) {
+                    std::rethrow_exception(errors[worker]);
+                }
+            }
+
+            for(unsigned worker = 0; worker < workerCount; ++worker) {
+                merge(*visitors[worker]);
+            }
+        }
+
+    private:
+        static void walkFunction(TVisitor &visitor, const Function *func) {
+            if constexpr (std::is_base_of_v<ExpressionTreeVisitor, TVisitor>) {
+                IterativeExpressionTreeWalker walker{&visitor};
+                walker.walkTree(func);
+            } else {
+                visitor.walkTree(func);
+            }
+        }
+    };
+}
@@ -67,19 +67,110 @@ namespace llast {
             out_ << "Binary: " << to_string(expr->operation());
         }
 
+        void visitingNot(const Not *) override {
+            out_ << "Not";
+        }
+
+        void visitingConvert(const Convert *expr) override {
+            out_ << "Convert: " << to_string(expr->dataType());
+        }
+
+        void visitingCheckedBinary(const CheckedBinary *expr) override {
+            out_ << "CheckedBinary: " << to_string(expr->operation());
+        }
+
+        void visitingInvoke(const Invoke *expr) override {
+            out_ << "Invoke: " << expr->functionName();
+        }
+
+        void visitingLoad(const Load *expr) override {
+            out_ << "Load: " << to_string(expr->dataType()) << " align " << expr->alignment();
+        }
+
+        void visitingStore(const Store *expr) override {
+            out_ << "Store: align " << expr->alignment();
+        }
+
+        void visitingIndex(const Index *expr) override {
+            out_ << "Index: " << to_string(expr->elementType());
+        }
+
+        void visitingSplat(const Splat *expr) override {
+            out_ << "Splat: " << to_string(expr->dataType());
+        }
+
+        void visitingExtractLane(const ExtractLane *expr) override {
+            out_ << "ExtractLane: " << expr->lane();
+        }
+
+        void visitingInsertLane(const InsertLane *expr) override {
+            out_ << "InsertLane: " << expr->lane();
+        }
+
+        void visitingShuffle(const Shuffle *expr) override {
+            out_ << "Shuffle:";
+            for(unsigned lane : expr->mask()) {
+                out_ << " " << lane;
+            }
+        }
+
+        void visitingReduce(const Reduce *expr) override {
+            out_ << "Reduce: " << to_string(expr->operation());
+        }
+
         void visitLiteralInt32(const LiteralInt32 *expr) override {
             out_ << "LiteralInt32: " << std::to_string(expr->value());
         }
         void visitLiteralFloat(const LiteralFloat *expr) override {
             out_ << "LiteralFloat: " << std::to_string(expr->value());
         }
+        void visitLiteralInt64(const LiteralInt64 *expr) override {
+            out_ << "LiteralInt64: " << std::to_string(expr->value());
+        }
+        void visitLiteralDouble(const LiteralDouble *expr) override {
+            out_ << "LiteralDouble: " << std::to_string(expr->value());
+        }
 
         void visitVariableRef(const VariableRef *expr) override {
             out_ << "VariableRef: " << expr->name();
         }
 
-        void visitingConditional(const Conditional *) override {
+        void visitingConditional(const Conditional *expr) override {
             out_ << "Conditional: ";
+            if(expr->branchHint() != BranchHint::None) {
+                out_ << to_string(expr->branchHint());
+            }
+        }
+
+        void visitingSwitch(const Switch *expr) override {
+            out_ << "Switch:";
+            for(int32_t value : expr->caseValues()) {
+                out_ << " " << value;
+            }
+        }
+
+        void visitingWhile(const While *) override {
+            out_ << "While: ";
+        }
+
+        void visitingFor(const For *) override {
+            out_ << "For: ";
+        }
+
+        void visitingMap(const Map *expr) override {
+            out_ << "Map: " << expr->index()->name();
+        }
+
+        void visitingFold(const Fold *expr) override {
+            out_ << "Fold: " << to_string(expr->operation()) << " " << expr->index()->name();
+        }
+
+        void visitBreak(const Break *) override {
+            out_ << "Break";
+        }
+
+        void visitContinue(const Continue *) override {
+            out_ << "Continue";
         }
 
         virtual void visitingAssignVariable(const AssignVariable *expr) override {
@@ -92,6 +183,9 @@ namespace llast {
 
         virtual void visitingFunction(const Function *func) override {
             out_ << "Function: " << func->name();
+            if(func->floatSemantics() != FloatSemantics::Strict) {
+                out_ << " " << to_string(func->floatSemantics());
+            }
         }
 
         virtual void visitingModule(const Module *module) override {
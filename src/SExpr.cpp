@@ -0,0 +1,1327 @@
+
+#include "SExpr.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+namespace llast {
+
+    namespace {
+        /** Whether each character may start a name (bit 0) or continue one (bit 1), so that the parser's loop
+         * reading names tests one table entry per character. */
+        constexpr std::array<uint8_t, 256> NAME_CHARACTERS = [] {
+            std::array<uint8_t, 256> classes{};
+            for(int c = 0; c < 256; ++c) {
+                bool start = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '$';
+                bool digit = c >= '0' && c <= '9';
+                classes[c] = static_cast<uint8_t>((start ? 1 : 0) | (start || digit || c == '.' ? 2 : 0));
+            }
+            return classes;
+        }();
+
+        bool isNameStart(char c) {
+            return NAME_CHARACTERS[static_cast<unsigned char>(c)] & 1;
+        }
+
+        bool isNameChar(char c) {
+            return NAME_CHARACTERS[static_cast<unsigned char>(c)] & 2;
+        }
+
+        /** Packs a name of up to 8 characters into an integer, so that it is compared in one instruction rather than
+         * a call to memcmp and can be the label of a case.  Longer names are 0, which no name packs to. */
+        constexpr uint64_t packName(string_view name) {
+            uint64_t packed = 0;
+            for(size_t i = 0; i < name.size() && i < 8; ++i) {
+                packed |= static_cast<uint64_t>(static_cast<unsigned char>(name[i])) << (8 * i);
+            }
+            return name.size() <= 8 ? packed : 0;
+        }
+
+        /** Names which are atoms of their own rather than references to variables. */
+        bool isKeyword(string_view name) {
+            switch(packName(name)) {
+                case packName("nil"):
+                case packName("break"):
+                case packName("continue"):
+                case packName("likely"):
+                case packName("unlikely"):
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        bool isDigit(char c) {
+            return c >= '0' && c <= '9';
+        }
+
+        const char *operationName(OperationKind operation) {
+            switch(operation) {
+                case OperationKind::Add:
+                    return "add";
+                case OperationKind::Sub:
+                    return "sub";
+                case OperationKind::Mul:
+                    return "mul";
+                case OperationKind::Div:
+                    return "div";
+                case OperationKind::Min:
+                    return "min";
+                case OperationKind::Max:
+                    return "max";
+                case OperationKind::Eq:
+                    return "eq";
+                case OperationKind::Ne:
+                    return "ne";
+                case OperationKind::Lt:
+                    return "lt";
+                case OperationKind::Le:
+                    return "le";
+                case OperationKind::Gt:
+                    return "gt";
+                case OperationKind::Ge:
+                    return "ge";
+                case OperationKind::And:
+                    return "and";
+                case OperationKind::Or:
+                    return "or";
+                default:
+                    throw UnhandledSwitchCase();
+            }
+        }
+
+        /** The operation whose name packs to packedName, if any.  Binary forms are the most frequent, so this is on
+         * the parser's hot path. */
+        std::optional<OperationKind> findOperation(uint64_t packedName) {
+            switch(packedName) {
+                case packName("add"):
+                    return OperationKind::Add;
+                case packName("sub"):
+                    return OperationKind::Sub;
+                case packName("mul"):
+                    return OperationKind::Mul;
+                case packName("div"):
+                    return OperationKind::Div;
+                case packName("min"):
+                    return OperationKind::Min;
+                case packName("max"):
+                    return OperationKind::Max;
+                case packName("eq"):
+                    return OperationKind::Eq;
+                case packName("ne"):
+                    return OperationKind::Ne;
+                case packName("lt"):
+                    return OperationKind::Lt;
+                case packName("le"):
+                    return OperationKind::Le;
+                case packName("gt"):
+                    return OperationKind::Gt;
+                case packName("ge"):
+                    return OperationKind::Ge;
+                case packName("and"):
+                    return OperationKind::And;
+                case packName("or"):
+                    return OperationKind::Or;
+                default:
+                    return std::nullopt;
+            }
+        }
+    }
+
+    string SExprWriter::toString(const Module *module) {
+        std::ostringstream out;
+        SExprWriter writer{out};
+        writer.walkTree(module);
+        return out.str();
+    }
+
+    string SExprWriter::toString(const Expr *expr) {
+        std::ostringstream out;
+        SExprWriter writer{out};
+        writer.walkTree(expr);
+        return out.str();
+    }
+
+    void SExprWriter::open(const char *head) {
+        if(needSpace_) {
+            out_ << ' ';
+        }
+        out_ << '(' << head;
+        needSpace_ = true;
+    }
+
+    void SExprWriter::close() {
+        out_ << ')';
+        needSpace_ = true;
+    }
+
+    void SExprWriter::atom(string_view text) {
+        if(needSpace_) {
+            out_ << ' ';
+        }
+        out_ << text;
+        needSpace_ = true;
+    }
+
+    void SExprWriter::name(string_view name) {
+        if(name.empty() || !isNameStart(name.front())
+           || !std::all_of(name.begin(), name.end(), isNameChar) || isKeyword(name)) {
+            throw InvalidStateException("'" + string(name) + "' cannot be written as an s-expression name.");
+        }
+        atom(name);
+    }
+
+    void SExprWriter::declaration(const Variable *variable) {
+        if(needSpace_) {
+            out_ << ' ';
+        }
+        out_ << '(';
+        needSpace_ = false;
+        name(variable->name());
+        atom(to_string(variable->dataType()));
+        if(variable->noAlias()) {
+            atom("noalias");
+        }
+        close();
+    }
+
+    void SExprWriter::visitingModule(const Module *module) {
+        open("module");
+        name(module->name());
+    }
+
+    void SExprWriter::visitingFunction(const Function *func) {
+        out_ << "\n ";
+        open("function");
+        name(func->name());
+        atom(to_string(func->returnType()));
+        switch(func->floatSemantics()) {
+            case FloatSemantics::Strict:
+                break;
+            case FloatSemantics::Contract:
+                atom("contract");
+                break;
+            case FloatSemantics::Reassociate:
+                atom("reassoc");
+                break;
+            case FloatSemantics::Fast:
+                atom("fast");
+                break;
+            default:
+                throw UnhandledSwitchCase();
+        }
+        open("params");
+        for(size_t slot = 0; slot < func->parameterScope()->size(); ++slot) {
+            declaration(func->parameterScope()->variable(slot));
+        }
+        close();
+    }
+
+    void SExprWriter::visitingBlock(const Block *expr) {
+        open("block");
+        out_ << " (";
+        needSpace_ = false;
+        for(size_t slot = 0; slot < expr->scope()->size(); ++slot) {
+            declaration(expr->scope()->variable(slot));
+        }
+        close();
+    }
+
+    void SExprWriter::visitingBinary(const Binary *expr) {
+        open(operationName(expr->operation()));
+    }
+
+    void SExprWriter::visitingConvert(const Convert *expr) {
+        open("convert");
+        atom(to_string(expr->dataType()));
+    }
+
+    void SExprWriter::visitingCheckedBinary(const CheckedBinary *expr) {
+        open("checked");
+        atom(operationName(expr->operation()));
+    }
+
+    void SExprWriter::visitingAssignVariable(const AssignVariable *expr) {
+        open("set");
+        name(expr->name());
+    }
+
+    void SExprWriter::visitingInvoke(const Invoke *expr) {
+        open("call");
+        name(expr->functionName());
+        atom(to_string(expr->dataType()));
+    }
+
+    void SExprWriter::visitingLoad(const Load *expr) {
+        open("load");
+        atom(to_string(expr->dataType()));
+        atom(std::to_string(expr->alignment()));
+    }
+
+    void SExprWriter::visitingStore(const Store *expr) {
+        open("store");
+        atom(std::to_string(expr->alignment()));
+    }
+
+    void SExprWriter::visitingIndex(const Index *expr) {
+        open("index");
+        atom(to_string(expr->elementType()));
+    }
+
+    void SExprWriter::visitingSplat(const Splat *expr) {
+        open("splat");
+        atom(to_string(expr->dataType()));
+    }
+
+    void SExprWriter::visitingExtractLane(const ExtractLane *expr) {
+        open("extract");
+        atom(std::to_string(expr->lane()));
+    }
+
+    void SExprWriter::visitingInsertLane(const InsertLane *expr) {
+        open("insert");
+        atom(std::to_string(expr->lane()));
+    }
+
+    void SExprWriter::visitingShuffle(const Shuffle *expr) {
+        open("shuffle");
+        out_ << " (";
+        needSpace_ = false;
+        for(unsigned lane : expr->mask()) {
+            atom(std::to_string(lane));
+        }
+        close();
+    }
+
+    void SExprWriter::visitingReduce(const Reduce *expr) {
+        open("reduce");
+        atom(operationName(expr->operation()));
+    }
+
+    void SExprWriter::visitingConditional(const Conditional *expr) {
+        open("if");
+        if(expr->branchHint() == BranchHint::Likely) {
+            atom("likely");
+        } else if(expr->branchHint() == BranchHint::Unlikely) {
+            atom("unlikely");
+        }
+    }
+
+    void SExprWriter::visitingSwitch(const Switch *expr) {
+        open("switch");
+        out_ << " (";
+        needSpace_ = false;
+        for(int32_t value : expr->caseValues()) {
+            atom(std::to_string(value));
+        }
+        close();
+    }
+
+    void SExprWriter::visitingMap(const Map *expr) {
+        open("map");
+        name(expr->index()->name());
+    }
+
+    void SExprWriter::visitingFold(const Fold *expr) {
+        open("fold");
+        atom(operationName(expr->operation()));
+        name(expr->index()->name());
+    }
+
+    void SExprWriter::visitLiteralInt32(const LiteralInt32 *expr) {
+        atom(std::to_string(expr->value()));
+    }
+
+    void SExprWriter::visitLiteralFloat(const LiteralFloat *expr) {
+        if(!std::isfinite(expr->value())) {
+            throw InvalidStateException("Non-finite floats cannot be written as s-expressions.");
+        }
+
+        //9 significant digits are enough for any float to be read back exactly.
+        char buffer[32];
+        int length = std::snprintf(buffer, sizeof(buffer), "%.9g", expr->value());
+        string_view text{buffer, static_cast<size_t>(length)};
+        if(text.find_first_of(".e") == string_view::npos) {
+            atom(string(text) + ".0");
+        } else {
+            atom(text);
+        }
+    }
+
+    void SExprWriter::visitLiteralInt64(const LiteralInt64 *expr) {
+        atom(std::to_string(expr->value()) + "L");
+    }
+
+    void SExprWriter::visitLiteralDouble(const LiteralDouble *expr) {
+        if(!std::isfinite(expr->value())) {
+            throw InvalidStateException("Non-finite doubles cannot be written as s-expressions.");
+        }
+
+        //As for floats, but a double needs 17 significant digits.
+        char buffer[40];
+        int length = std::snprintf(buffer, sizeof(buffer), "%.17g", expr->value());
+        string text{buffer, static_cast<size_t>(length)};
+        if(text.find_first_of(".e") == string::npos) {
+            text += ".0";
+        }
+        atom(text + "d");
+    }
+
+    unique_ptr<const Module> SExprParser::parseModule(string_view text) {
+        parse(text, true);
+        return move(module_);
+    }
+
+    unique_ptr<const Expr> SExprParser::parseExpr(string_view text) {
+        parse(text, false);
+        unique_ptr<const Expr> expr = move(values_.back());
+        values_.clear();
+        return expr;
+    }
+
+    FlatAst SExprParser::parseFlatModule(string_view text) {
+        return parseFlat(text, true);
+    }
+
+    FlatAst SExprParser::parseFlatExpr(string_view text) {
+        return parseFlat(text, false);
+    }
+
+    FlatAst SExprParser::parseFlat(string_view text, bool module) {
+        //There is a node for every few bytes of text, so reserving for one every 8 bytes saves most of the copying
+        //and zeroing of new memory as the arrays grow, for at most half again the memory they need.
+        FlatAst ast;
+        size_t nodes = text.size() / 8;
+        ast.kinds_.reserve(nodes);
+        ast.dataTypes_.reserve(nodes);
+        ast.payloads_.reserve(nodes);
+        ast.firstChildren_.reserve(nodes);
+        ast.childCounts_.reserve(nodes);
+        ast.children_.reserve(nodes);
+        flat_ = &ast;
+        try {
+            parse(text, module);
+        } catch(...) {
+            flat_ = nullptr;
+            throw;
+        }
+        flat_ = nullptr;
+        return ast;
+    }
+
+    void SExprParser::reset(string_view text) {
+        begin_ = text.data();
+        pos_ = begin_;
+        end_ = begin_ + text.size();
+        frames_.clear();
+        values_.clear();
+        functions_.clear();
+        visible_.clear();
+        caseValues_.clear();
+        module_.reset();
+        parsedModule_ = false;
+        flatValues_.clear();
+        flatNames_.clear();
+        variableBlock_.reset();
+    }
+
+    void SExprParser::fail(const string &message, const char *at) const {
+        size_t line = 1;
+        const char *lineStart = begin_;
+        for(const char *c = begin_; c < at; ++c) {
+            if(*c == '\n') {
+                ++line;
+                lineStart = c + 1;
+            }
+        }
+        throw ParseException(message, line, static_cast<size_t>(at - lineStart) + 1);
+    }
+
+    void SExprParser::parse(string_view text, bool module) {
+        reset(text);
+        try {
+            skipSpace();
+            if(module) {
+                if(pos_ == end_ || *pos_ != '(') {
+                    fail("Expected (module", pos_);
+                }
+            }
+
+            //Every iteration consumes one token; the text is complete when the outermost form or atom is.
+            do {
+                if(pos_ == end_) {
+                    fail("Unexpected end of input", pos_);
+                }
+                if(*pos_ == '(') {
+                    openForm();
+                } else if(*pos_ == ')') {
+                    if(frames_.empty()) {
+                        fail("Unexpected ')'", pos_);
+                    }
+                    closeForm();
+                } else {
+                    if(!frames_.empty() && frames_.back().form == Form::Module) {
+                        fail("Expected (function", pos_);
+                    }
+                    parseAtom();
+                }
+                skipSpace();
+            } while(!frames_.empty());
+
+            if(pos_ != end_) {
+                fail("Unexpected input after the end of the " + string(module ? "module" : "expression"), pos_);
+            }
+            if(module != parsedModule_) {
+                fail(module ? "Expected (module" : "Expected an expression", begin_);
+            }
+        } catch(...) {
+            //Release partially built trees now rather than at the next parse.
+            frames_.clear();
+            values_.clear();
+            functions_.clear();
+            visible_.clear();
+            module_.reset();
+            flatValues_.clear();
+            throw;
+        }
+    }
+
+    void SExprParser::skipSpace() {
+        while(pos_ != end_) {
+            char c = *pos_;
+            if(c == ' ' || c == '\n' || c == '\t' || c == '\r') {
+                ++pos_;
+            } else if(c == ';') {
+                //Comments extend to the end of the line.
+                while(pos_ != end_ && *pos_ != '\n') {
+                    ++pos_;
+                }
+            } else {
+                return;
+            }
+        }
+    }
+
+    string_view SExprParser::readName() {
+        skipSpace();
+        if(pos_ == end_ || !isNameStart(*pos_)) {
+            fail("Expected a name", pos_);
+        }
+        const char *start = pos_;
+        while(pos_ != end_ && isNameChar(*pos_)) {
+            ++pos_;
+        }
+        return string_view{start, static_cast<size_t>(pos_ - start)};
+    }
+
+    Symbol SExprParser::intern(string_view text) {
+        uint32_t hash = 2166136261u;
+        for(char c : text) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+        }
+        std::optional<Symbol> &recent = recentSymbols_[hash % recentSymbols_.size()];
+        if(!recent || recent->str() != text) {
+            recent = context_ ? context_->intern(text) : SymbolTable::global().intern(text);
+        }
+        return *recent;
+    }
+
+    Symbol SExprParser::readSymbol() {
+        return intern(readName());
+    }
+
+    DataType SExprParser::readType() {
+        //The names are computed once rather than by to_string for each type read.
+        static const std::pair<string, DataType> TYPES[] = {
+            { to_string(DataType::Void), DataType::Void }, { to_string(DataType::Bool), DataType::Bool },
+            { to_string(DataType::Int32), DataType::Int32 }, { to_string(DataType::Pointer), DataType::Pointer },
+            { to_string(DataType::Float), DataType::Float }, { to_string(DataType::Double), DataType::Double },
+            { to_string(DataType::Float32x4), DataType::Float32x4 },
+            { to_string(DataType::Float32x8), DataType::Float32x8 },
+            { to_string(DataType::Int32x4), DataType::Int32x4 }, { to_string(DataType::Int32x8), DataType::Int32x8 },
+            { to_string(DataType::Int64), DataType::Int64 }, { to_string(DataType::UInt32), DataType::UInt32 },
+            { to_string(DataType::UInt64), DataType::UInt64 }
+        };
+        const char *start = pos_;
+        string_view name = readName();
+        for(auto &type : TYPES) {
+            if(name == type.first) {
+                return type.second;
+            }
+        }
+        fail("Unknown type '" + string(name) + "'", start);
+    }
+
+    unsigned SExprParser::readUnsigned(const char *expected) {
+        skipSpace();
+        const char *start = pos_;
+        unsigned long value = 0;
+        while(pos_ != end_ && isDigit(*pos_)) {
+            value = value * 10 + static_cast<unsigned long>(*pos_ - '0');
+            if(value > UINT32_MAX) {
+                fail("Number is too large", start);
+            }
+            ++pos_;
+        }
+        if(pos_ == start || (pos_ != end_ && isNameChar(*pos_))) {
+            fail(string("Expected ") + expected, start);
+        }
+        return static_cast<unsigned>(value);
+    }
+
+    int32_t SExprParser::readInt32(const char *expected) {
+        skipSpace();
+        const char *start = pos_;
+        bool negative = pos_ != end_ && *pos_ == '-';
+        if(negative) {
+            ++pos_;
+            if(pos_ == end_ || !isDigit(*pos_)) {
+                fail(string("Expected ") + expected, start);
+            }
+        }
+        unsigned value = readUnsigned(expected);
+        if(value > (negative ? 0x80000000u : static_cast<unsigned>(INT32_MAX))) {
+            fail("Number is too large", start);
+        }
+        return negative ? static_cast<int32_t>(0u - value) : static_cast<int32_t>(value);
+    }
+
+    OperationKind SExprParser::readOperation() {
+        const char *start = pos_;
+        string_view name = readName();
+        if(std::optional<OperationKind> operation = findOperation(packName(name))) {
+            return *operation;
+        }
+        fail("Unknown operation '" + string(name) + "'", start);
+    }
+
+    void SExprParser::expect(char c) {
+        skipSpace();
+        if(pos_ == end_ || *pos_ != c) {
+            fail(string("Expected '") + c + "'", pos_);
+        }
+        ++pos_;
+    }
+
+    SExprParser::Frame &SExprParser::pushFrame(Form form, const char *start) {
+        frames_.push_back(Frame{form, OperationKind::Add, DataType::Void, BranchHint::None, FloatSemantics::Strict,
+                                static_cast<size_t>(start - begin_), valueCount(), visible_.size(), 0, std::nullopt});
+        return frames_.back();
+    }
+
+    void SExprParser::parseAtom() {
+        char c = *pos_;
+        if(isDigit(c) || c == '-') {
+            parseNumber();
+            return;
+        }
+
+        const char *start = pos_;
+        string_view name = readName();
+        switch(packName(name)) {
+            case packName("nil"):
+                if(!nilAllowed()) {
+                    fail("nil may only be an optional part of an if, for or switch", start);
+                }
+                if(flat_) {
+                    flatValues_.push_back(FlatAst::NONE);
+                } else {
+                    values_.emplace_back(nullptr);
+                }
+                return;
+            case packName("break"):
+                if(flat_) {
+                    appendFlat(NodeKind::Break, DataType::Void, 0, 0);
+                } else {
+                    values_.emplace_back(makeIn<const Break>(context_));
+                }
+                return;
+            case packName("continue"):
+                if(flat_) {
+                    appendFlat(NodeKind::Continue, DataType::Void, 0, 0);
+                } else {
+                    values_.emplace_back(makeIn<const Continue>(context_));
+                }
+                return;
+            case packName("likely"):
+            case packName("unlikely"):
+                fail(string(name) + " may only precede the condition of an if", start);
+            default:
+                break;
+        }
+
+        size_t declaration = lookup(name);
+        const shared_ptr<const Variable> &variable = visible_[declaration].variable;
+        if(flat_) {
+            appendFlat(NodeKind::VariableRef, variable->dataType(), flatVariable(declaration), 0);
+        } else {
+            values_.emplace_back(makeIn<const VariableRef>(context_, variable));
+        }
+    }
+
+    size_t SExprParser::lookup(string_view name) const {
+        uint64_t packedName = packName(name);
+        for(size_t i = visible_.size(); i-- > 0;) {
+            if(visible_[i].packedName == packedName && (packedName != 0 || visible_[i].variable->name() == name)) {
+                return i;
+            }
+        }
+        fail("Undefined variable '" + string(name) + "'", name.data());
+    }
+
+    bool SExprParser::nilAllowed() const {
+        if(frames_.empty()) {
+            return false;
+        }
+        const Frame &frame = frames_.back();
+        size_t index = valueCount() - frame.firstValue;
+        switch(frame.form) {
+            case Form::If:
+                return index == 1 || index == 2;
+            case Form::Switch:
+                //The case values of enclosing switches precede this one's.
+                return index == caseValues_.size() - frame.number + 1;
+            case Form::For:
+                return index == 0 || index == 1 || index == 3;
+            default:
+                return false;
+        }
+    }
+
+    void SExprParser::parseNumber() {
+        const char *start = pos_;
+        if(*pos_ == '-') {
+            ++pos_;
+        }
+        bool isFloat = false;
+        while(pos_ != end_ && (isDigit(*pos_) || *pos_ == '.' || *pos_ == 'e' || *pos_ == 'E'
+                               || ((*pos_ == '-' || *pos_ == '+') && (pos_[-1] == 'e' || pos_[-1] == 'E')))) {
+            isFloat |= !isDigit(*pos_);
+            ++pos_;
+        }
+
+        //An Int64 has the suffix L and a Double the suffix d.
+        size_t length = static_cast<size_t>(pos_ - start);
+        bool isWide = pos_ != end_ && *pos_ == (isFloat ? 'd' : 'L');
+        if(isWide) {
+            ++pos_;
+        }
+
+        //Numbers are short, so a copy provides the terminator that the strto* functions require.
+        char buffer[64];
+        if(length >= sizeof(buffer) || (pos_ != end_ && isNameChar(*pos_))) {
+            fail("Invalid number", start);
+        }
+        std::memcpy(buffer, start, length);
+        buffer[length] = '\0';
+
+        //strto* also report ERANGE for subnormal results, which are valid and which SExprWriter writes, so only
+        //overflow is rejected.
+        char *parsedEnd;
+        errno = 0;
+        if(isFloat && isWide) {
+            double value = std::strtod(buffer, &parsedEnd);
+            if(parsedEnd != buffer + length || (errno == ERANGE && std::fabs(value) == HUGE_VAL)) {
+                fail("Invalid double", start);
+            }
+            if(flat_) {
+                uint64_t bits;
+                std::memcpy(&bits, &value, sizeof(bits));
+                appendFlat(NodeKind::LiteralDouble, DataType::Double, bits, 0);
+            } else {
+                values_.emplace_back(makeIn<const LiteralDouble>(context_, value));
+            }
+        } else if(isWide) {
+            long long value = std::strtoll(buffer, &parsedEnd, 10);
+            if(parsedEnd != buffer + length || errno == ERANGE) {
+                fail("Invalid integer", start);
+            }
+            if(flat_) {
+                appendFlat(NodeKind::LiteralInt64, DataType::Int64, static_cast<uint64_t>(value), 0);
+            } else {
+                values_.emplace_back(makeIn<const LiteralInt64>(context_, static_cast<int64_t>(value)));
+            }
+        } else if(isFloat) {
+            float value = std::strtof(buffer, &parsedEnd);
+            if(parsedEnd != buffer + length || (errno == ERANGE && std::fabs(value) == HUGE_VALF)) {
+                fail("Invalid float", start);
+            }
+            if(flat_) {
+                uint32_t bits;
+                std::memcpy(&bits, &value, sizeof(bits));
+                appendFlat(NodeKind::LiteralFloat, DataType::Float, bits, 0);
+            } else {
+                values_.emplace_back(makeIn<const LiteralFloat>(context_, value));
+            }
+        } else {
+            //Int32 literals are the most frequent numbers, so they are converted here rather than by strtol.
+            bool negative = *start == '-';
+            if(length == (negative ? 1u : 0u)) {
+                fail("Invalid integer", start);
+            }
+            uint64_t magnitude = 0;
+            for(const char *digit = start + negative; digit != start + length; ++digit) {
+                magnitude = magnitude * 10 + static_cast<uint64_t>(*digit - '0');
+                if(magnitude > (negative ? 0x80000000u : static_cast<uint64_t>(INT32_MAX))) {
+                    fail("Invalid integer", start);
+                }
+            }
+            int32_t value = static_cast<int32_t>(negative ? 0u - static_cast<uint32_t>(magnitude)
+                                                          : static_cast<uint32_t>(magnitude));
+            if(flat_) {
+                appendFlat(NodeKind::LiteralInt32, DataType::Int32, static_cast<uint32_t>(value), 0);
+            } else {
+                values_.emplace_back(makeIn<const LiteralInt32>(context_, value));
+            }
+        }
+    }
+
+    void SExprParser::parseDeclarations() {
+        size_t firstVisible = visible_.size();
+        skipSpace();
+        while(pos_ != end_ && *pos_ == '(') {
+            ++pos_;
+            const char *start = pos_;
+            Symbol name = readSymbol();
+            DataType dataType = readType();
+            skipSpace();
+            bool noAlias = false;
+            if(pos_ != end_ && isNameStart(*pos_)) {
+                const char *attributeStart = pos_;
+                if(readName() != "noalias") {
+                    fail("Expected noalias", attributeStart);
+                }
+                noAlias = true;
+            }
+            expect(')');
+            skipSpace();
+
+            if(isKeyword(name.str())) {
+                fail("'" + string(name.str()) + "' cannot be the name of a variable", start);
+            }
+            for(size_t i = firstVisible; i < visible_.size(); ++i) {
+                if(visible_[i].variable->symbol() == name) {
+                    fail("Duplicate variable '" + string(name.str()) + "'", start);
+                }
+            }
+            visible_.push_back(Declaration{makeVariable(name, dataType, noAlias), packName(name.str()),
+                                           FlatAst::NONE});
+        }
+    }
+
+    shared_ptr<const Variable> SExprParser::makeVariable(Symbol name, DataType dataType, bool noAlias) {
+        if(context_) {
+            return context_->makeVariable(name, dataType, noAlias);
+        }
+        //The block never reallocates, since it is replaced once it is full.
+        if(!variableBlock_ || variableBlock_->size() == VARIABLE_BLOCK_SIZE) {
+            variableBlock_ = std::make_shared<std::vector<Variable>>();
+            variableBlock_->reserve(VARIABLE_BLOCK_SIZE);
+        }
+        variableBlock_->emplace_back(name, dataType, noAlias);
+        return shared_ptr<const Variable>(variableBlock_, &variableBlock_->back());
+    }
+
+    unique_ptr<const Scope> SExprParser::buildScope(const Frame &frame) const {
+        //Nested blocks have closed, so the variables after the frame's mark are those it declared.
+        ScopeBuilder sb = context_ ? ScopeBuilder{*context_} : ScopeBuilder{};
+        for(size_t i = frame.visibleMark; i < visible_.size(); ++i) {
+            sb.addVariable(visible_[i].variable);
+        }
+        return sb.build();
+    }
+
+    void SExprParser::openForm() {
+        const char *start = pos_++;
+        Form parent = frames_.empty() ? Form::Block : frames_.back().form;
+        bool inModule = !frames_.empty() && parent == Form::Module;
+
+        const char *headStart = pos_;
+        string_view head = readName();
+        uint64_t packedHead = packName(head);
+        if(packedHead == packName("function")) {
+            if(!inModule) {
+                fail("A function may only appear in a module", start);
+            }
+            Frame &frame = pushFrame(Form::Function, start);
+            frame.name = readSymbol();
+            frame.dataType = readType();
+            skipSpace();
+            if(pos_ != end_ && isNameStart(*pos_)) {
+                const char *semanticsStart = pos_;
+                string_view semantics = readName();
+                if(semantics == "contract") {
+                    frame.floatSemantics = FloatSemantics::Contract;
+                } else if(semantics == "reassoc") {
+                    frame.floatSemantics = FloatSemantics::Reassociate;
+                } else if(semantics == "fast") {
+                    frame.floatSemantics = FloatSemantics::Fast;
+                } else {
+                    fail("Unknown float semantics '" + string(semantics) + "'", semanticsStart);
+                }
+            }
+            expect('(');
+            const char *paramsStart = pos_;
+            if(readName() != "params") {
+                fail("Expected params", paramsStart);
+            }
+            parseDeclarations();
+            expect(')');
+            return;
+        }
+        if(inModule) {
+            fail("Expected (function", start);
+        }
+        if(std::optional<OperationKind> operation = findOperation(packedHead)) {
+            pushFrame(Form::Binary, start).operation = *operation;
+            return;
+        }
+
+        switch(packedHead) {
+            case packName("module"):
+                if(!frames_.empty() || valueCount() != 0) {
+                    fail("A module may only appear at the top level", start);
+                }
+                pushFrame(Form::Module, start).name = readSymbol();
+                break;
+            case packName("block"):
+                pushFrame(Form::Block, start);
+                expect('(');
+                parseDeclarations();
+                expect(')');
+                break;
+            case packName("set"):
+                pushFrame(Form::Set, start).number = lookup(readName());
+                break;
+            case packName("return"):
+                pushFrame(Form::Return, start);
+                break;
+            case packName("not"):
+                pushFrame(Form::Not, start);
+                break;
+            case packName("convert"):
+                pushFrame(Form::Convert, start).dataType = readType();
+                break;
+            case packName("checked"):
+                pushFrame(Form::Checked, start).operation = readOperation();
+                break;
+            case packName("call"): {
+                Frame &frame = pushFrame(Form::Call, start);
+                frame.name = readSymbol();
+                frame.dataType = readType();
+                break;
+            }
+            case packName("load"): {
+                Frame &frame = pushFrame(Form::Load, start);
+                frame.dataType = readType();
+                frame.number = readUnsigned("an alignment");
+                break;
+            }
+            case packName("store"):
+                pushFrame(Form::Store, start).number = readUnsigned("an alignment");
+                break;
+            case packName("index"):
+                pushFrame(Form::Index, start).dataType = readType();
+                break;
+            case packName("splat"):
+                pushFrame(Form::Splat, start).dataType = readType();
+                break;
+            case packName("extract"):
+                pushFrame(Form::ExtractLane, start).number = readUnsigned("a lane");
+                break;
+            case packName("insert"):
+                pushFrame(Form::InsertLane, start).number = readUnsigned("a lane");
+                break;
+            case packName("shuffle"): {
+                //The mask is packed as FlatAst::packMask() does, which the limits on its lanes allow.
+                Frame &frame = pushFrame(Form::Shuffle, start);
+                expect('(');
+                skipSpace();
+                unsigned lanes = 0;
+                while(pos_ != end_ && *pos_ != ')') {
+                    const char *laneStart = pos_;
+                    unsigned lane = readUnsigned("a lane");
+                    if(lanes == MAX_LANES || lane >= 2 * MAX_LANES) {
+                        fail("A mask may have at most " + std::to_string(MAX_LANES) + " lanes, each less than "
+                             + std::to_string(2 * MAX_LANES), laneStart);
+                    }
+                    frame.number |= static_cast<uint64_t>(lane) << (4 * ++lanes);
+                    skipSpace();
+                }
+                frame.number |= lanes;
+                expect(')');
+                break;
+            }
+            case packName("reduce"):
+                pushFrame(Form::Reduce, start).operation = readOperation();
+                break;
+            case packName("map"):
+                pushFrame(Form::Map, start).number = lookup(readName());
+                break;
+            case packName("fold"): {
+                Frame &frame = pushFrame(Form::Fold, start);
+                frame.operation = readOperation();
+                frame.number = lookup(readName());
+                break;
+            }
+            case packName("if"): {
+                Frame &frame = pushFrame(Form::If, start);
+                skipSpace();
+                const char *hintStart = pos_;
+                if(pos_ != end_ && isNameStart(*pos_)) {
+                    string_view hint = readName();
+                    if(hint == "likely") {
+                        frame.branchHint = BranchHint::Likely;
+                    } else if(hint == "unlikely") {
+                        frame.branchHint = BranchHint::Unlikely;
+                    } else {
+                        pos_ = hintStart;
+                    }
+                }
+                break;
+            }
+            case packName("switch"): {
+                Frame &frame = pushFrame(Form::Switch, start);
+                frame.number = caseValues_.size();
+                expect('(');
+                skipSpace();
+                while(pos_ != end_ && *pos_ != ')') {
+                    const char *valueStart = pos_;
+                    int32_t value = readInt32("a case value");
+                    if(std::find(caseValues_.begin() + frame.number, caseValues_.end(), value)
+                       != caseValues_.end()) {
+                        fail("Duplicate case value " + std::to_string(value), valueStart);
+                    }
+                    caseValues_.push_back(value);
+                    skipSpace();
+                }
+                expect(')');
+                break;
+            }
+            case packName("while"):
+                pushFrame(Form::While, start);
+                break;
+            case packName("for"):
+                pushFrame(Form::For, start);
+                break;
+            default:
+                fail("Unknown form '" + string(head) + "'", headStart);
+        }
+    }
+
+    unique_ptr<const Expr> SExprParser::takeValue(const Frame &frame, size_t index, bool optional) {
+        unique_ptr<const Expr> &value = values_[frame.firstValue + index];
+        if(!value && !optional) {
+            fail("nil may only be an optional part of an if, for or switch", begin_ + frame.start);
+        }
+        return move(value);
+    }
+
+    void SExprParser::closeForm() {
+        Frame &frame = frames_.back();
+        size_t count = valueCount() - frame.firstValue;
+        size_t expected;
+        switch(frame.form) {
+            case Form::Call:
+            case Form::Block:
+            case Form::Module:
+                expected = count;
+                break;
+            case Form::Binary:
+            case Form::Store:
+            case Form::Index:
+            case Form::InsertLane:
+            case Form::Shuffle:
+            case Form::While:
+            case Form::Fold:
+                expected = 2;
+                break;
+            case Form::Checked:
+            case Form::If:
+            case Form::Map:
+                expected = 3;
+                break;
+            case Form::For:
+                expected = 4;
+                break;
+            case Form::Switch:
+                expected = caseValues_.size() - frame.number + 2;
+                break;
+            default:
+                expected = 1;
+                break;
+        }
+        if(count != expected) {
+            fail("Expected " + std::to_string(expected) + " operand(s) but found " + std::to_string(count),
+                 begin_ + frame.start);
+        }
+
+        if(flat_) {
+            appendFlatNode(frame, count);
+        } else {
+            unique_ptr<const Expr> result = buildNode(frame, count);
+            values_.resize(frame.firstValue);
+            if(result) {
+                values_.push_back(move(result));
+            }
+        }
+
+        if(frame.form == Form::Module) {
+            parsedModule_ = true;
+        } else if(frame.form == Form::Switch) {
+            caseValues_.resize(frame.number);
+        }
+        visible_.erase(visible_.begin() + frame.visibleMark, visible_.end());
+        frames_.pop_back();
+        ++pos_;
+    }
+
+    unique_ptr<const Expr> SExprParser::buildNode(Frame &frame, size_t count) {
+        std::pmr::memory_resource *resource = context_ ? context_->resource() : std::pmr::get_default_resource();
+        switch(frame.form) {
+            case Form::Binary:
+                return makeIn<const Binary>(context_, takeValue(frame, 0, false), frame.operation,
+                                            takeValue(frame, 1, false));
+            case Form::Set:
+                return makeIn<const AssignVariable>(context_, visible_[frame.number].variable,
+                                                    takeValue(frame, 0, false));
+            case Form::Return:
+                return makeIn<const Return>(context_, takeValue(frame, 0, false));
+            case Form::Not:
+                return makeIn<const Not>(context_, takeValue(frame, 0, false));
+            case Form::Convert:
+                return makeIn<const Convert>(context_, takeValue(frame, 0, false), frame.dataType);
+            case Form::Checked:
+                return makeIn<const CheckedBinary>(context_, takeValue(frame, 0, false), frame.operation,
+                                                   takeValue(frame, 1, false), takeValue(frame, 2, false));
+            case Form::Call: {
+                std::pmr::vector<ChildPtr<const Expr>> arguments{resource};
+                arguments.reserve(count);
+                for(size_t i = 0; i < count; ++i) {
+                    arguments.emplace_back(takeValue(frame, i, false));
+                }
+                return makeIn<const Invoke>(context_, *frame.name, frame.dataType, move(arguments));
+            }
+            case Form::Load:
+                return makeIn<const Load>(context_, frame.dataType, takeValue(frame, 0, false),
+                                          static_cast<unsigned>(frame.number));
+            case Form::Store:
+                return makeIn<const Store>(context_, takeValue(frame, 0, false), takeValue(frame, 1, false),
+                                           static_cast<unsigned>(frame.number));
+            case Form::Index:
+                return makeIn<const Index>(context_, frame.dataType, takeValue(frame, 0, false),
+                                           takeValue(frame, 1, false));
+            case Form::Splat:
+                return makeIn<const Splat>(context_, frame.dataType, takeValue(frame, 0, false));
+            case Form::ExtractLane:
+                return makeIn<const ExtractLane>(context_, takeValue(frame, 0, false),
+                                                 static_cast<unsigned>(frame.number));
+            case Form::InsertLane:
+                return makeIn<const InsertLane>(context_, takeValue(frame, 0, false),
+                                                static_cast<unsigned>(frame.number), takeValue(frame, 1, false));
+            case Form::Shuffle:
+                return makeIn<const Shuffle>(context_, takeValue(frame, 0, false), takeValue(frame, 1, false),
+                                             FlatAst::unpackMask(frame.number, resource));
+            case Form::Reduce:
+                return makeIn<const Reduce>(context_, frame.operation, takeValue(frame, 0, false));
+            case Form::If:
+                return makeIn<const Conditional>(context_,
+                                                 takeValue(frame, 0, false),
+                                                 takeValue(frame, 1, true),
+                                                 takeValue(frame, 2, true),
+                                                 frame.branchHint);
+            case Form::Switch: {
+                std::pmr::vector<ChildPtr<const Expr>> cases{resource};
+                cases.reserve(count - 2);
+                for(size_t i = 0; i < count - 2; ++i) {
+                    cases.emplace_back(takeValue(frame, i + 1, false));
+                }
+                return makeIn<const Switch>(context_,
+                                            takeValue(frame, 0, false),
+                                            std::pmr::vector<int32_t>{caseValues_.begin() + frame.number,
+                                                                      caseValues_.end(), resource},
+                                            move(cases),
+                                            takeValue(frame, count - 1, true));
+            }
+            case Form::While:
+                return makeIn<const While>(context_, takeValue(frame, 0, false), takeValue(frame, 1, false));
+            case Form::For:
+                return makeIn<const For>(context_,
+                                         takeValue(frame, 0, true),
+                                         takeValue(frame, 1, true),
+                                         takeValue(frame, 3, true),
+                                         takeValue(frame, 2, false));
+            case Form::Map:
+                return makeIn<const Map>(context_, visible_[frame.number].variable, takeValue(frame, 0, false),
+                                         takeValue(frame, 1, false), takeValue(frame, 2, false));
+            case Form::Fold:
+                return makeIn<const Fold>(context_, frame.operation, visible_[frame.number].variable,
+                                          takeValue(frame, 0, false), takeValue(frame, 1, false));
+            case Form::Block: {
+                std::pmr::vector<ChildPtr<const Expr>> expressions{resource};
+                expressions.reserve(count);
+                for(size_t i = 0; i < count; ++i) {
+                    expressions.emplace_back(takeValue(frame, i, false));
+                }
+                return makeIn<const Block>(context_, buildScope(frame), move(expressions));
+            }
+            case Form::Function:
+                functions_.push_back(makeIn<const Function>(context_, *frame.name, frame.dataType, buildScope(frame),
+                                                            takeValue(frame, 0, false), frame.floatSemantics));
+                return nullptr;
+            case Form::Module: {
+                std::pmr::vector<ChildPtr<const Function>> functions{resource};
+                functions.reserve(functions_.size());
+                for(auto &function : functions_) {
+                    functions.emplace_back(move(function));
+                }
+                functions_.clear();
+                module_ = makeIn<const Module>(context_, *frame.name, move(functions));
+                return nullptr;
+            }
+            default:
+                throw UnhandledSwitchCase();
+        }
+    }
+
+    void SExprParser::appendFlatNode(const Frame &frame, size_t count) {
+        //Each node gets the data type its class's dataType() would return, from the data types of its children.
+        auto child = [&](size_t index) { return flatValues_[frame.firstValue + index]; };
+        auto childType = [&](size_t index) { return flat_->dataType(child(index)); };
+        uint64_t operation = static_cast<uint64_t>(frame.operation);
+
+        switch(frame.form) {
+            case Form::Binary:
+                appendFlat(NodeKind::Binary, isComparison(frame.operation) ? DataType::Bool : childType(1),
+                           operation, 2);
+                break;
+            case Form::Set:
+                appendFlat(NodeKind::AssignVariable, visible_[frame.number].variable->dataType(),
+                           flatVariable(frame.number), 1);
+                break;
+            case Form::Return:
+                appendFlat(NodeKind::Return, childType(0), 0, 1);
+                break;
+            case Form::Not:
+                appendFlat(NodeKind::Not, DataType::Bool, 0, 1);
+                break;
+            case Form::Convert:
+                appendFlat(NodeKind::Convert, frame.dataType, 0, 1);
+                break;
+            case Form::Checked:
+                appendFlat(NodeKind::CheckedBinary, childType(1), operation, 3);
+                break;
+            case Form::Call:
+                appendFlat(NodeKind::Invoke, frame.dataType, flatName(*frame.name), count);
+                break;
+            case Form::Load:
+                appendFlat(NodeKind::Load, frame.dataType, frame.number, 1);
+                break;
+            case Form::Store:
+                appendFlat(NodeKind::Store, childType(1), frame.number, 2);
+                break;
+            case Form::Index:
+                appendFlat(NodeKind::Index, DataType::Pointer, static_cast<uint64_t>(frame.dataType), 2);
+                break;
+            case Form::Splat:
+                appendFlat(NodeKind::Splat, frame.dataType, 0, 1);
+                break;
+            case Form::ExtractLane:
+                appendFlat(NodeKind::ExtractLane, laneType(childType(0)), frame.number, 1);
+                break;
+            case Form::InsertLane:
+                appendFlat(NodeKind::InsertLane, childType(0), frame.number, 2);
+                break;
+            case Form::Shuffle:
+                appendFlat(NodeKind::Shuffle,
+                           vectorType(laneType(childType(0)), static_cast<unsigned>(frame.number & 0xf)),
+                           frame.number, 2);
+                break;
+            case Form::Reduce:
+                appendFlat(NodeKind::Reduce, laneType(childType(0)), operation, 1);
+                break;
+            case Form::If: {
+                DataType dataType = child(1) != FlatAst::NONE ? childType(1)
+                                    : child(2) != FlatAst::NONE ? childType(2) : DataType::Void;
+                appendFlat(NodeKind::Conditional, dataType, static_cast<uint64_t>(frame.branchHint), 3);
+                break;
+            }
+            case Form::Switch: {
+                DataType dataType = count > 2 ? childType(1)
+                                    : child(1) != FlatAst::NONE ? childType(1) : DataType::Void;
+                uint64_t firstValue = flat_->caseValues_.size();
+                flat_->caseValues_.insert(flat_->caseValues_.end(), caseValues_.begin() + frame.number,
+                                          caseValues_.end());
+                appendFlat(NodeKind::Switch, dataType, firstValue, count);
+                break;
+            }
+            case Form::While:
+                appendFlat(NodeKind::While, DataType::Void, 0, 2);
+                break;
+            case Form::For:
+                appendFlat(NodeKind::For, DataType::Void, 0, 4);
+                break;
+            case Form::Map:
+                appendFlat(NodeKind::Map, DataType::Void, flatVariable(frame.number), 3);
+                break;
+            case Form::Fold:
+                appendFlat(NodeKind::Fold, childType(1), (operation << 32) | flatVariable(frame.number), 2);
+                break;
+            case Form::Block:
+                appendFlat(NodeKind::Block, count > 0 ? childType(count - 1) : DataType::Void, flatScope(frame),
+                           count);
+                break;
+            case Form::Function: {
+                uint64_t payload = (static_cast<uint64_t>(frame.floatSemantics) << 56)
+                                   | (static_cast<uint64_t>(flatScope(frame)) << 32)
+                                   | flatName(*frame.name);
+                appendFlat(NodeKind::Function, frame.dataType, payload, 1);
+                break;
+            }
+            case Form::Module:
+                appendFlat(NodeKind::Module, DataType::Void, flatName(*frame.name), count);
+                break;
+            default:
+                throw UnhandledSwitchCase();
+        }
+    }
+
+    void SExprParser::appendFlat(NodeKind kind, DataType dataType, uint64_t payload, size_t childCount) {
+        flat_->appendNode(kind, dataType, payload, childCount, flatValues_);
+    }
+
+    uint32_t SExprParser::flatVariable(size_t declaration) {
+        Declaration &entry = visible_[declaration];
+        if(entry.flatIndex == FlatAst::NONE) {
+            entry.flatIndex = static_cast<uint32_t>(flat_->variables_.size());
+            flat_->variables_.push_back(entry.variable);
+        }
+        return entry.flatIndex;
+    }
+
+    uint32_t SExprParser::flatName(Symbol name) {
+        auto inserted = flatNames_.try_emplace(name, static_cast<uint32_t>(flat_->names_.size()));
+        if(inserted.second) {
+            flat_->names_.push_back(name);
+        }
+        return inserted.first->second;
+    }
+
+    uint32_t SExprParser::flatScope(const Frame &frame) {
+        if(flat_->scopeVariableCounts_.size() >= FlatAst::MAX_SCOPES) {
+            throw InvalidStateException("Tree has too many scopes to be flattened.");
+        }
+        flat_->scopeFirstVariables_.push_back(static_cast<uint32_t>(flat_->scopeVariables_.size()));
+        flat_->scopeVariableCounts_.push_back(static_cast<uint32_t>(visible_.size() - frame.visibleMark));
+        for(size_t i = frame.visibleMark; i < visible_.size(); ++i) {
+            flat_->scopeVariables_.push_back(flatVariable(i));
+        }
+        return static_cast<uint32_t>(flat_->scopeFirstVariables_.size() - 1);
+    }
+}
@@ -0,0 +1,266 @@
+#pragma once
+
+#include "StaticExpressionTreeWalker.hpp"
+#include "FlatAst.hpp"
+
+#include <array>
+#include <iostream>
+#include <optional>
+
+namespace llast {
+
+    /** Writes trees as s-expressions, which SExprParser reads back into an equivalent tree.
+     *
+     *      (module NAME FUNCTION...)
+     *      (function NAME TYPE (params DECLARATION...) EXPR), (function NAME TYPE SEMANTICS (params ...) EXPR)
+     *      (block (DECLARATION...) EXPR...)
+     *      (add EXPR EXPR), (sub EXPR EXPR), (mul EXPR EXPR), (div EXPR EXPR), (min EXPR EXPR), (max EXPR EXPR)
+     *      (eq EXPR EXPR), (ne EXPR EXPR), (lt EXPR EXPR), (le EXPR EXPR), (gt EXPR EXPR), (ge EXPR EXPR)
+     *      (and EXPR EXPR), (or EXPR EXPR), (not EXPR)
+     *      (convert TYPE EXPR), (checked OPERATION EXPR EXPR EXPR)
+     *      (set NAME EXPR)
+     *      (return EXPR)
+     *      (call NAME TYPE EXPR...)
+     *      (load TYPE ALIGNMENT EXPR), (store ALIGNMENT EXPR EXPR), (index TYPE EXPR EXPR)
+     *      (splat TYPE EXPR), (extract LANE EXPR), (insert LANE EXPR EXPR), (shuffle (LANE...) EXPR EXPR)
+     *      (reduce OPERATION EXPR)
+     *      (if EXPR EXPR-OR-nil EXPR-OR-nil), (if likely EXPR ...), (if unlikely EXPR ...)
+     *      (switch (INTEGER...) EXPR EXPR... EXPR-OR-nil)
+     *      (while EXPR EXPR)
+     *      (for INIT-OR-nil CONDITION-OR-nil BODY UPDATE-OR-nil)
+     *      (map NAME OUTPUT COUNT BODY), (fold OPERATION NAME COUNT BODY)
+     *      break, continue, INTEGER, FLOAT, NAME
+     *
+     * A DECLARATION is (NAME TYPE) or (NAME TYPE noalias).  ALIGNMENT is a non-negative integer, 0 for the natural
+     * alignment, and so is a LANE.  OPERATION is the head of any of the binary forms.  A FLOAT always contains a '.' or
+     * an exponent.  An INTEGER is an Int32 and a FLOAT a Float, unless immediately followed by L, making it an Int64,
+     * or d, making it a Double.  The last EXPR of checked is evaluated if the operation overflows.  TYPE is the
+     * DataType's name as returned by to_string.  A NAME refers to the innermost variable of that name declared by an
+     * enclosing block or function, except in a call, where it names the function called and TYPE is its return type,
+     * and the NAME of a map or fold is its index variable.  The parts of a for are written in the order they are
+     * walked, so the body precedes the update.  A switch lists its case values, then has its discriminant, one case for
+     * each value and its default case.  The likely or unlikely of an if is its BranchHint.  SEMANTICS is contract,
+     * reassoc or fast, the FloatSemantics of a function that is not Strict.
+     */
+    class SExprWriter : public StaticExpressionTreeWalker<SExprWriter> {
+        friend class StaticExpressionTreeWalker<SExprWriter>;
+        std::ostream &out_;
+        bool needSpace_ = false;
+
+    public:
+        SExprWriter(std::ostream &out) : out_(out) { }
+
+        static string toString(const Module *module);
+        static string toString(const Expr *expr);
+
+    private:
+        void open(const char *head);
+        void close();
+        void atom(string_view text);
+        void name(string_view name);
+        void declaration(const Variable *variable);
+
+        void visitingModule(const Module *module);
+        void visitedModule(const Module *) { close(); }
+        void visitingFunction(const Function *func);
+        void visitedFunction(const Function *) { close(); }
+        void visitingBlock(const Block *expr);
+        void visitedBlock(const Block *) { close(); }
+        void visitingBinary(const Binary *expr);
+        void visitedBinary(const Binary *) { close(); }
+        void visitingAssignVariable(const AssignVariable *expr);
+        void visitedAssignVariable(const AssignVariable *) { close(); }
+        void visitingReturn(const Return *) { open("return"); }
+        void visitedReturn(const Return *) { close(); }
+        void visitingNot(const Not *) { open("not"); }
+        void visitedNot(const Not *) { close(); }
+        void visitingConvert(const Convert *expr);
+        void visitedConvert(const Convert *) { close(); }
+        void visitingCheckedBinary(const CheckedBinary *expr);
+        void visitedCheckedBinary(const CheckedBinary *) { close(); }
+        void visitingInvoke(const Invoke *expr);
+        void visitedInvoke(const Invoke *) { close(); }
+        void visitingLoad(const Load *expr);
+        void visitedLoad(const Load *) { close(); }
+        void visitingStore(const Store *expr);
+        void visitedStore(const Store *) { close(); }
+        void visitingIndex(const Index *expr);
+        void visitedIndex(const Index *) { close(); }
+        void visitingSplat(const Splat *expr);
+        void visitedSplat(const Splat *) { close(); }
+        void visitingExtractLane(const ExtractLane *expr);
+        void visitedExtractLane(const ExtractLane *) { close(); }
+        void visitingInsertLane(const InsertLane *expr);
+        void visitedInsertLane(const InsertLane *) { close(); }
+        void visitingShuffle(const Shuffle *expr);
+        void visitedShuffle(const Shuffle *) { close(); }
+        void visitingReduce(const Reduce *expr);
+        void visitedReduce(const Reduce *) { close(); }
+        void visitingConditional(const Conditional *expr);
+        void visitingTruePart(const Conditional *expr) { if(!expr->truePart()) atom("nil"); }
+        void visitingFalsePart(const Conditional *expr) { if(!expr->falsePart()) atom("nil"); }
+        void visitedConditional(const Conditional *) { close(); }
+        void visitingSwitch(const Switch *expr);
+        void visitingSwitchDefault(const Switch *expr) { if(!expr->defaultCase()) atom("nil"); }
+        void visitedSwitch(const Switch *) { close(); }
+        void visitingWhile(const While *) { open("while"); }
+        void visitedWhile(const While *) { close(); }
+        void visitingFor(const For *expr) { open("for"); if(!expr->init()) atom("nil"); }
+        void visitingForCondition(const For *expr) { if(!expr->condition()) atom("nil"); }
+        void visitingForUpdate(const For *expr) { if(!expr->update()) atom("nil"); }
+        void visitedFor(const For *) { close(); }
+        void visitingMap(const Map *expr);
+        void visitedMap(const Map *) { close(); }
+        void visitingFold(const Fold *expr);
+        void visitedFold(const Fold *) { close(); }
+        void visitBreak(const Break *) { atom("break"); }
+        void visitContinue(const Continue *) { atom("continue"); }
+        void visitLiteralInt32(const LiteralInt32 *expr);
+        void visitLiteralFloat(const LiteralFloat *expr);
+        void visitLiteralInt64(const LiteralInt64 *expr);
+        void visitLiteralDouble(const LiteralDouble *expr);
+        void visitVariableRef(const VariableRef *expr) { name(expr->name()); }
+    };
+
+    /** Parses the s-expressions written by SExprWriter directly into trees, in a single pass over the text and
+     * without recursion.  The only allocations are those of the nodes, which are made in context if it is not null,
+     * and of the parser's own stacks, which are reused by later calls.  Names are interned in context or else in
+     * SymbolTable::global().  Malformed text and undefined variables cause a ParseException giving the line and
+     * column of the problem.
+     *
+     * Building nodes costs more than reading the text, since there is a node for every few bytes of text and every
+     * Block and Function builds a Scope with a table of its variables.  parseFlatModule() and parseFlatExpr() instead
+     * append to the arrays of a FlatAst, which is about twice as fast as building heap-allocated nodes and no slower
+     * than building them in an AstContext;  the sexpr-benchmark target measures each.
+     */
+    class SExprParser {
+        enum class Form {
+            Module,
+            Function,
+            Block,
+            Binary,
+            Set,
+            Return,
+            Not,
+            Convert,
+            Checked,
+            Call,
+            Load,
+            Store,
+            Index,
+            Splat,
+            ExtractLane,
+            InsertLane,
+            Shuffle,
+            Reduce,
+            If,
+            Switch,
+            While,
+            For,
+            Map,
+            Fold
+        };
+
+        struct Frame {
+            Form form;
+            OperationKind operation;
+            DataType dataType;
+            BranchHint branchHint;
+            FloatSemantics floatSemantics;
+            size_t start;
+            size_t firstValue;
+            size_t visibleMark;
+            //The alignment of a load or store, the lane of an extract or insert, the mask of a shuffle as packed by
+            //FlatAst::packMask(), the index of a switch's first value in caseValues_ or the index in visible_ of the
+            //variable of a set, map or fold.
+            uint64_t number;
+            //The name of a module, function or call.
+            std::optional<Symbol> name;
+        };
+
+        /** A variable declared by an enclosing block or function. */
+        struct Declaration {
+            shared_ptr<const Variable> variable;
+            //The variable's name packed into an integer if it has at most 8 characters, which is quicker to compare.
+            uint64_t packedName;
+            //The variable's index in the FlatAst being built, assigned where FlatAstBuilder would first meet it so
+            //that the tables come out the same.
+            uint32_t flatIndex;
+        };
+
+        AstContext *context_;
+        const char *begin_ = nullptr;
+        const char *pos_ = nullptr;
+        const char *end_ = nullptr;
+
+        std::vector<Frame> frames_;
+        std::vector<unique_ptr<const Expr>> values_;
+        std::vector<unique_ptr<const Function>> functions_;
+        std::vector<Declaration> visible_;
+        std::vector<int32_t> caseValues_;
+        unique_ptr<const Module> module_;
+        bool parsedModule_ = false;
+
+        //The FlatAst being built, with the indexes of its nodes in place of values_ and functions_, or null when
+        //building nodes.
+        FlatAst *flat_ = nullptr;
+        std::vector<FlatAst::Index> flatValues_;
+        std::unordered_map<Symbol, uint32_t> flatNames_;
+
+        //The symbols of recently interned names, by a hash of their text, which saves locking and searching the
+        //SymbolTable for names which recur, such as those of variables.
+        std::array<std::optional<Symbol>, 256> recentSymbols_;
+
+        //Without an AstContext, variables are allocated a block at a time and share its ownership, which saves a
+        //call to malloc for each declaration.
+        static constexpr size_t VARIABLE_BLOCK_SIZE = 256;
+        shared_ptr<std::vector<Variable>> variableBlock_;
+
+    public:
+        SExprParser(AstContext *context = nullptr) : context_{context} { }
+
+        unique_ptr<const Module> parseModule(string_view text);
+        unique_ptr<const Expr> parseExpr(string_view text);
+
+        /** Parse text as parseModule() and parseExpr() do, but directly into a FlatAst which is structurally equal to
+         * the one FlatAst::fromModule() or FlatAst::fromExpr() makes of their result, without creating any nodes.
+         * Only the variables are allocated, in context if it is not null. */
+        FlatAst parseFlatModule(string_view text);
+        FlatAst parseFlatExpr(string_view text);
+
+    private:
+        void parse(string_view text, bool module);
+        FlatAst parseFlat(string_view text, bool module);
+        void reset(string_view text);
+        [[noreturn]] void fail(const string &message, const char *at) const;
+
+        void skipSpace();
+        string_view readName();
+        Symbol readSymbol();
+        DataType readType();
+        unsigned readUnsigned(const char *expected);
+        int32_t readInt32(const char *expected);
+        OperationKind readOperation();
+        size_t lookup(string_view name) const;
+        void expect(char c);
+        void parseAtom();
+        void parseNumber();
+        bool nilAllowed() const;
+        size_t valueCount() const { return flat_ ? flatValues_.size() : values_.size(); }
+
+        void openForm();
+        void closeForm();
+        void parseDeclarations();
+        shared_ptr<const Variable> makeVariable(Symbol name, DataType dataType, bool noAlias);
+        unique_ptr<const Scope> buildScope(const Frame &frame) const;
+        unique_ptr<const Expr> takeValue(const Frame &frame, size_t index, bool optional);
+        unique_ptr<const Expr> buildNode(Frame &frame, size_t count);
+        void appendFlatNode(const Frame &frame, size_t count);
+        void appendFlat(NodeKind kind, DataType dataType, uint64_t payload, size_t childCount);
+        uint32_t flatVariable(size_t declaration);
+        uint32_t flatName(Symbol name);
+        uint32_t flatScope(const Frame &frame);
+        Frame &pushFrame(Form form, const char *start);
+        Symbol intern(string_view text);
+    };
+}
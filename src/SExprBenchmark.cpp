@@ -0,0 +1,73 @@
+#include "SExpr.hpp"
+#include "FlatAst.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace llast;
+
+namespace {
+    /** Generates a module of about size bytes whose functions resemble the expressions loaded in bulk at startup:
+     * a few variables, arithmetic on them and literals, comparisons and conditionals. */
+    string generateModule(size_t size) {
+        string text = "(module benchmark\n";
+        for(unsigned i = 0; text.size() < size; ++i) {
+            string n = std::to_string(i);
+            text += "  (function rule" + n + " Int32 (params (input Int32) (weight Float) (limit Int32))\n"
+                    "    (block ((score Int32) (scaled Float))\n"
+                    "      (set score (add (mul input " + n + ") (sub limit (div input 3))))\n"
+                    "      (set scaled (mul (convert Float score) (add weight 0.25)))\n"
+                    "      (if (and (gt score limit) (lt scaled 1024.5))\n"
+                    "          (set score (max limit (min score (add limit " + n + "))))\n"
+                    "          nil)\n"
+                    "      (return (add score (convert Int32 scaled)))))\n";
+        }
+        text += ")\n";
+        return text;
+    }
+
+    /** Parses text repeatedly for at least a second and returns the throughput of the fastest parse in MB/s, which
+     * is the least disturbed by other activity on the machine. */
+    template<typename TParse>
+    double measure(const string &text, TParse parse) {
+        using Clock = std::chrono::steady_clock;
+        std::chrono::duration<double> fastest{0};
+        std::chrono::duration<double> total{0};
+        for(unsigned iteration = 0; iteration < 3 || total.count() < 1.0; ++iteration) {
+            Clock::time_point start = Clock::now();
+            parse();
+            std::chrono::duration<double> elapsed = Clock::now() - start;
+            if(iteration == 0 || elapsed < fastest) {
+                fastest = elapsed;
+            }
+            total += elapsed;
+        }
+        return static_cast<double>(text.size()) / fastest.count() / 1e6;
+    }
+}
+
+/** Reports how fast SExprParser parses a generated module, optionally of the size in MB given as argument, into nodes
+ * with and without an AstContext and into a FlatAst.  Build with optimizations for meaningful results. */
+int main(int argc, char **argv) {
+    size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16;
+    string text = generateModule(megabytes * 1000000);
+    std::printf("Parsing a module of %.1f MB\n", text.size() / 1e6);
+
+    SExprParser heapParser;
+    double heap = measure(text, [&]() { heapParser.parseModule(text); });
+    std::printf("  heap-allocated nodes:   %8.1f MB/s\n", heap);
+
+    double arena = measure(text, [&]() {
+        AstContext context;
+        SExprParser parser{&context};
+        parser.parseModule(text);
+    });
+    std::printf("  nodes in an AstContext: %8.1f MB/s\n", arena);
+
+    SExprParser flatParser;
+    double flat = measure(text, [&]() { flatParser.parseFlatModule(text); });
+    std::printf("  FlatAst:                %8.1f MB/s\n", flat);
+    return 0;
+}
@@ -0,0 +1,530 @@
+#pragma once
+
+#include "AST.hpp"
+
+namespace llast {
+
+    /** A tree walker whose callbacks are bound at compile time (CRTP).
+     *
+     * A visitor derives from StaticExpressionTreeWalker<itself> and declares only the callbacks it needs, with the
+     * same names and signatures as those of ExpressionTreeVisitor but without virtual or override.  Every other
+     * callback resolves to an empty inline member of this class which the compiler removes entirely, and dispatch on
+     * the kind of a node is a switch on its stored NodeKind, so walking a tree makes no virtual calls.  A visitor
+     * which declares its callbacks private must be friends with StaticExpressionTreeWalker<itself>.
+     *
+     * The walk does not recurse:  the path from the root to the current node is kept on an explicit stack which is
+     * reused by subsequent walks, so the depth of a tree is limited only by available memory.  Callbacks are invoked
+     * in exactly the same order as by ExpressionTreeWalker.
+     *
+     * ExpressionTreeVisitor and ExpressionTreeWalker remain the interface for visitors which are chosen at run time.
+     */
+    template<typename TDerived>
+    class StaticExpressionTreeWalker {
+        struct Frame {
+            const Node *node;
+            /** The index of the next child to walk. */
+            size_t next;
+        };
+        std::vector<Frame> stack_;
+
+    public:
+        void walkTree(const Module *module) {
+            derived().initialize();
+            walk(module);
+            derived().cleanUp();
+        }
+
+        /** Walks a tree which is not rooted at a Module, i.e. a function body or a lone expression. */
+        void walkTree(const Expr *expr) {
+            derived().initialize();
+            walk(expr);
+            derived().cleanUp();
+        }
+
+        void walkTree(const Function *func) {
+            derived().initialize();
+            walk(func);
+            derived().cleanUp();
+        }
+
+    protected:
+        void initialize() { }
+        void cleanUp() { }
+        void visitingNode(const Node *) { }
+        void visitedNode(const Node *) { }
+        void visitingBlock(const Block *) { }
+        void visitedBlock(const Block *) { }
+        void visitingConditional(const Conditional *) { }
+        void visitingTruePart(const Conditional *) { }
+        void visitingFalsePart(const Conditional *) { }
+        void visitedConditional(const Conditional *) { }
+        void visitingSwitch(const Switch *) { }
+        void visitingSwitchCase(const Switch *, size_t) { }
+        void visitingSwitchDefault(const Switch *) { }
+        void visitedSwitch(const Switch *) { }
+        void visitingWhile(const While *) { }
+        void visitingWhileBody(const While *) { }
+        void visitedWhile(const While *) { }
+        void visitingFor(const For *) { }
+        void visitingForCondition(const For *) { }
+        void visitingForBody(const For *) { }
+        void visitingForUpdate(const For *) { }
+        void visitedFor(const For *) { }
+        void visitingMap(const Map *) { }
+        void visitingMapBody(const Map *) { }
+        void visitedMap(const Map *) { }
+        void visitingFold(const Fold *) { }
+        void visitingFoldBody(const Fold *) { }
+        void visitedFold(const Fold *) { }
+        void visitBreak(const Break *) { }
+        void visitContinue(const Continue *) { }
+        void visitingBinary(const Binary *) { }
+        void visitingRValue(const Binary *) { }
+        void visitedBinary(const Binary *) { }
+        void visitingNot(const Not *) { }
+        void visitedNot(const Not *) { }
+        void visitingConvert(const Convert *) { }
+        void visitedConvert(const Convert *) { }
+        void visitingCheckedBinary(const CheckedBinary *) { }
+        void visitingOverflow(const CheckedBinary *) { }
+        void visitedCheckedBinary(const CheckedBinary *) { }
+        void visitingInvoke(const Invoke *) { }
+        void visitedInvoke(const Invoke *) { }
+        void visitingLoad(const Load *) { }
+        void visitedLoad(const Load *) { }
+        void visitingStore(const Store *) { }
+        void visitedStore(const Store *) { }
+        void visitingIndex(const Index *) { }
+        void visitedIndex(const Index *) { }
+        void visitingSplat(const Splat *) { }
+        void visitedSplat(const Splat *) { }
+        void visitingExtractLane(const ExtractLane *) { }
+        void visitedExtractLane(const ExtractLane *) { }
+        void visitingInsertLane(const InsertLane *) { }
+        void visitedInsertLane(const InsertLane *) { }
+        void visitingShuffle(const Shuffle *) { }
+        void visitedShuffle(const Shuffle *) { }
+        void visitingReduce(const Reduce *) { }
+        void visitedReduce(const Reduce *) { }
+        void visitLiteralInt32(const LiteralInt32 *) { }
+        void visitLiteralFloat(const LiteralFloat *) { }
+        void visitLiteralInt64(const LiteralInt64 *) { }
+        void visitLiteralDouble(const LiteralDouble *) { }
+        void visitingReturn(const Return *) { }
+        void visitedReturn(const Return *) { }
+        void visitVariableRef(const VariableRef *) { }
+        void visitingAssignVariable(const AssignVariable *) { }
+        void visitedAssignVariable(const AssignVariable *) { }
+        void visitingFunction(const Function *) { }
+        void visitedFunction(const Function *) { }
+        void visitingModule(const Module *) { }
+        void visitedModule(const Module *) { }
+
+        void walk(const Node *root) {
+            ARG_NOT_NULL(root);
+
+            //Frames below base belong to a walk which is in progress, i.e. if a callback started another walk.
+            size_t base = stack_.size();
+            enter(root);
+            while(stack_.size() > base) {
+                const Node *child = nextChild(stack_.back());
+                if(child) {
+                    enter(child);
+                } else {
+                    const Node *node = stack_.back().node;
+                    stack_.pop_back();
+                    leave(node);
+                }
+            }
+        }
+
+    private:
+        TDerived &derived() { return *static_cast<TDerived*>(this); }
+
+        /** Invokes the callbacks preceding the children of node and, unless node is a leaf, pushes it. */
+        void enter(const Node *node) {
+            TDerived &visitor = derived();
+            visitor.visitingNode(node);
+
+            switch (node->nodeKind()) {
+                case NodeKind::LiteralInt32:
+                    visitor.visitLiteralInt32(static_cast<const LiteralInt32*>(node));
+                    visitor.visitedNode(node);
+                    return;
+                case NodeKind::LiteralFloat:
+                    visitor.visitLiteralFloat(static_cast<const LiteralFloat*>(node));
+                    visitor.visitedNode(node);
+                    return;
+                case NodeKind::LiteralInt64:
+                    visitor.visitLiteralInt64(static_cast<const LiteralInt64*>(node));
+                    visitor.visitedNode(node);
+                    return;
+                case NodeKind::LiteralDouble:
+                    visitor.visitLiteralDouble(static_cast<const LiteralDouble*>(node));
+                    visitor.visitedNode(node);
+                    return;
+                case NodeKind::VariableRef:
+                    visitor.visitVariableRef(static_cast<const VariableRef*>(node));
+                    visitor.visitedNode(node);
+                    return;
+                case NodeKind::Break:
+                    visitor.visitBreak(static_cast<const Break*>(node));
+                    visitor.visitedNode(node);
+                    return;
+                case NodeKind::Continue:
+                    visitor.visitContinue(static_cast<const Continue*>(node));
+                    visitor.visitedNode(node);
+                    return;
+                case NodeKind::Binary:
+                    visitor.visitingBinary(static_cast<const Binary*>(node));
+                    break;
+                case NodeKind::Not:
+                    visitor.visitingNot(static_cast<const Not*>(node));
+                    break;
+                case NodeKind::Convert:
+                    visitor.visitingConvert(static_cast<const Convert*>(node));
+                    break;
+                case NodeKind::CheckedBinary:
+                    visitor.visitingCheckedBinary(static_cast<const CheckedBinary*>(node));
+                    break;
+                case NodeKind::Invoke:
+                    visitor.visitingInvoke(static_cast<const Invoke*>(node));
+                    break;
+                case NodeKind::Load:
+                    visitor.visitingLoad(static_cast<const Load*>(node));
+                    break;
+                case NodeKind::Store:
+                    visitor.visitingStore(static_cast<const Store*>(node));
+                    break;
+                case NodeKind::Index:
+                    visitor.visitingIndex(static_cast<const Index*>(node));
+                    break;
+                case NodeKind::Splat:
+                    visitor.visitingSplat(static_cast<const Splat*>(node));
+                    break;
+                case NodeKind::ExtractLane:
+                    visitor.visitingExtractLane(static_cast<const ExtractLane*>(node));
+                    break;
+                case NodeKind::InsertLane:
+                    visitor.visitingInsertLane(static_cast<const InsertLane*>(node));
+                    break;
+                case NodeKind::Shuffle:
+                    visitor.visitingShuffle(static_cast<const Shuffle*>(node));
+                    break;
+                case NodeKind::Reduce:
+                    visitor.visitingReduce(static_cast<const Reduce*>(node));
+                    break;
+                case NodeKind::AssignVariable:
+                    visitor.visitingAssignVariable(static_cast<const AssignVariable*>(node));
+                    break;
+                case NodeKind::Return:
+                    visitor.visitingReturn(static_cast<const Return*>(node));
+                    break;
+                case NodeKind::Block:
+                    visitor.visitingBlock(static_cast<const Block*>(node));
+                    break;
+                case NodeKind::Conditional:
+                    visitor.visitingConditional(static_cast<const Conditional*>(node));
+                    break;
+                case NodeKind::Switch:
+                    visitor.visitingSwitch(static_cast<const Switch*>(node));
+                    break;
+                case NodeKind::While:
+                    visitor.visitingWhile(static_cast<const While*>(node));
+                    break;
+                case NodeKind::For:
+                    visitor.visitingFor(static_cast<const For*>(node));
+                    break;
+                case NodeKind::Map:
+                    visitor.visitingMap(static_cast<const Map*>(node));
+                    break;
+                case NodeKind::Fold:
+                    visitor.visitingFold(static_cast<const Fold*>(node));
+                    break;
+                case NodeKind::Function:
+                    visitor.visitingFunction(static_cast<const Function*>(node));
+                    break;
+                case NodeKind::Module:
+                    visitor.visitingModule(static_cast<const Module*>(node));
+                    break;
+                default:
+                    throw UnhandledSwitchCase();
+            }
+
+            stack_.push_back(Frame{node, 0});
+        }
+
+        /** Returns the next child of frame's node to walk, or null when all of them have been walked. */
+        const Node *nextChild(Frame &frame) {
+            size_t index = frame.next++;
+            switch (frame.node->nodeKind()) {
+                case NodeKind::Binary: {
+                    auto binary = static_cast<const Binary*>(frame.node);
+                    switch (index) {
+                        case 0:
+                            return binary->lValue();
+                        case 1:
+                            if (isLogical(binary->operation())) {
+                                derived().visitingRValue(binary);
+                            }
+                            return binary->rValue();
+                        default:
+                            return nullptr;
+                    }
+                }
+                case NodeKind::Not:
+                    return index == 0 ? static_cast<const Not*>(frame.node)->operand() : nullptr;
+                case NodeKind::Convert:
+                    return index == 0 ? static_cast<const Convert*>(frame.node)->operand() : nullptr;
+                case NodeKind::CheckedBinary: {
+                    auto checked = static_cast<const CheckedBinary*>(frame.node);
+                    switch (index) {
+                        case 0:
+                            return checked->lValue();
+                        case 1:
+                            return checked->rValue();
+                        case 2:
+                            derived().visitingOverflow(checked);
+                            return checked->overflow();
+                        default:
+                            return nullptr;
+                    }
+                }
+                case NodeKind::Invoke: {
+                    auto invoke = static_cast<const Invoke*>(frame.node);
+                    return index < invoke->argumentCount() ? invoke->argument(index) : nullptr;
+                }
+                case NodeKind::Load:
+                    return index == 0 ? static_cast<const Load*>(frame.node)->pointer() : nullptr;
+                case NodeKind::Store: {
+                    auto store = static_cast<const Store*>(frame.node);
+                    return index == 0 ? store->pointer() : index == 1 ? store->valueExpr() : nullptr;
+                }
+                case NodeKind::Index: {
+                    auto indexExpr = static_cast<const Index*>(frame.node);
+                    return index == 0 ? indexExpr->pointer() : index == 1 ? indexExpr->index() : nullptr;
+                }
+                case NodeKind::Splat:
+                    return index == 0 ? static_cast<const Splat*>(frame.node)->scalar() : nullptr;
+                case NodeKind::ExtractLane:
+                    return index == 0 ? static_cast<const ExtractLane*>(frame.node)->vector() : nullptr;
+                case NodeKind::InsertLane: {
+                    auto insertLane = static_cast<const InsertLane*>(frame.node);
+                    return index == 0 ? insertLane->vector() : index == 1 ? insertLane->scalar() : nullptr;
+                }
+                case NodeKind::Shuffle: {
+                    auto shuffle = static_cast<const Shuffle*>(frame.node);
+                    return index == 0 ? shuffle->first() : index == 1 ? shuffle->second() : nullptr;
+                }
+                case NodeKind::Reduce:
+                    return index == 0 ? static_cast<const Reduce*>(frame.node)->vector() : nullptr;
+                case NodeKind::AssignVariable:
+                    return index == 0 ? static_cast<const AssignVariable*>(frame.node)->valueExpr() : nullptr;
+                case NodeKind::Return:
+                    return index == 0 ? static_cast<const Return*>(frame.node)->valueExpr() : nullptr;
+                case NodeKind::Block: {
+                    auto block = static_cast<const Block*>(frame.node);
+                    return index < block->size() ? block->expression(index) : nullptr;
+                }
+                case NodeKind::Conditional: {
+                    auto conditional = static_cast<const Conditional*>(frame.node);
+                    switch (index) {
+                        case 0:
+                            return conditional->condition();
+                        case 1:
+                            //frame may not be used after a callback, which could start another walk.
+                            if (!conditional->truePart()) {
+                                frame.next = 3;
+                                derived().visitingTruePart(conditional);
+                                derived().visitingFalsePart(conditional);
+                                return conditional->falsePart();
+                            }
+                            derived().visitingTruePart(conditional);
+                            return conditional->truePart();
+                        case 2:
+                            derived().visitingFalsePart(conditional);
+                            return conditional->falsePart();
+                        default:
+                            return nullptr;
+                    }
+                }
+                case NodeKind::Switch: {
+                    auto switchExpr = static_cast<const Switch*>(frame.node);
+                    if (index == 0) {
+                        return switchExpr->discriminant();
+                    }
+                    if (index <= switchExpr->caseCount()) {
+                        derived().visitingSwitchCase(switchExpr, index - 1);
+                        return switchExpr->caseExpr(index - 1);
+                    }
+                    if (index == switchExpr->caseCount() + 1) {
+                        //An absent default case ends the children.
+                        derived().visitingSwitchDefault(switchExpr);
+                        return switchExpr->defaultCase();
+                    }
+                    return nullptr;
+                }
+                case NodeKind::While: {
+                    auto loop = static_cast<const While*>(frame.node);
+                    switch (index) {
+                        case 0:
+                            return loop->condition();
+                        case 1:
+                            derived().visitingWhileBody(loop);
+                            return loop->body();
+                        default:
+                            return nullptr;
+                    }
+                }
+                case NodeKind::Map: {
+                    auto map = static_cast<const Map*>(frame.node);
+                    switch (index) {
+                        case 0:
+                            return map->output();
+                        case 1:
+                            return map->count();
+                        case 2:
+                            derived().visitingMapBody(map);
+                            return map->body();
+                        default:
+                            return nullptr;
+                    }
+                }
+                case NodeKind::Fold: {
+                    auto fold = static_cast<const Fold*>(frame.node);
+                    switch (index) {
+                        case 0:
+                            return fold->count();
+                        case 1:
+                            derived().visitingFoldBody(fold);
+                            return fold->body();
+                        default:
+                            return nullptr;
+                    }
+                }
+                case NodeKind::For: {
+                    //Absent parts are skipped, but the callbacks preceding them are still invoked.
+                    auto loop = static_cast<const For*>(frame.node);
+                    const Expr *parts[] = { loop->init(), loop->condition(), loop->body(), loop->update() };
+                    size_t part = index;
+                    while(part < 4 && !parts[part]) {
+                        ++part;
+                    }
+                    //frame may not be used after a callback, which could start another walk.
+                    frame.next = part + 1;
+                    for(size_t i = index; i <= part && i < 4; ++i) {
+                        visitingForPart(loop, i);
+                    }
+                    return part < 4 ? parts[part] : nullptr;
+                }
+                case NodeKind::Function:
+                    return index == 0 ? static_cast<const Function*>(frame.node)->body() : nullptr;
+                case NodeKind::Module: {
+                    auto module = static_cast<const Module*>(frame.node);
+                    return index < module->functionCount() ? module->function(index) : nullptr;
+                }
+                default:
+                    throw UnhandledSwitchCase();
+            }
+        }
+
+        /** Invokes the callback which precedes the part of loop with the specified index, if any. */
+        void visitingForPart(const For *loop, size_t part) {
+            switch (part) {
+                case 1:
+                    derived().visitingForCondition(loop);
+                    break;
+                case 2:
+                    derived().visitingForBody(loop);
+                    break;
+                case 3:
+                    derived().visitingForUpdate(loop);
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        /** Invokes the callbacks following the children of node. */
+        void leave(const Node *node) {
+            TDerived &visitor = derived();
+            switch (node->nodeKind()) {
+                case NodeKind::Binary:
+                    visitor.visitedBinary(static_cast<const Binary*>(node));
+                    break;
+                case NodeKind::Not:
+                    visitor.visitedNot(static_cast<const Not*>(node));
+                    break;
+                case NodeKind::Convert:
+                    visitor.visitedConvert(static_cast<const Convert*>(node));
+                    break;
+                case NodeKind::CheckedBinary:
+                    visitor.visitedCheckedBinary(static_cast<const CheckedBinary*>(node));
+                    break;
+                case NodeKind::Invoke:
+                    visitor.visitedInvoke(static_cast<const Invoke*>(node));
+                    break;
+                case NodeKind::Load:
+                    visitor.visitedLoad(static_cast<const Load*>(node));
+                    break;
+                case NodeKind::Store:
+                    visitor.visitedStore(static_cast<const Store*>(node));
+                    break;
+                case NodeKind::Index:
+                    visitor.visitedIndex(static_cast<const Index*>(node));
+                    break;
+                case NodeKind::Splat:
+                    visitor.visitedSplat(static_cast<const Splat*>(node));
+                    break;
+                case NodeKind::ExtractLane:
+                    visitor.visitedExtractLane(static_cast<const ExtractLane*>(node));
+                    break;
+                case NodeKind::InsertLane:
+                    visitor.visitedInsertLane(static_cast<const InsertLane*>(node));
+                    break;
+                case NodeKind::Shuffle:
+                    visitor.visitedShuffle(static_cast<const Shuffle*>(node));
+                    break;
+                case NodeKind::Reduce:
+                    visitor.visitedReduce(static_cast<const Reduce*>(node));
+                    break;
+                case NodeKind::AssignVariable:
+                    visitor.visitedAssignVariable(static_cast<const AssignVariable*>(node));
+                    break;
+                case NodeKind::Return:
+                    visitor.visitedReturn(static_cast<const Return*>(node));
+                    break;
+                case NodeKind::Block:
+                    visitor.visitedBlock(static_cast<const Block*>(node));
+                    break;
+                case NodeKind::Conditional:
+                    visitor.visitedConditional(static_cast<const Conditional*>(node));
+                    break;
+                case NodeKind::Switch:
+                    visitor.visitedSwitch(static_cast<const Switch*>(node));
+                    break;
+                case NodeKind::While:
+                    visitor.visitedWhile(static_cast<const While*>(node));
+                    break;
+                case NodeKind::For:
+                    visitor.visitedFor(static_cast<const For*>(node));
+                    break;
+                case NodeKind::Map:
+                    visitor.visitedMap(static_cast<const Map*>(node));
+                    break;
+                case NodeKind::Fold:
+                    visitor.visitedFold(static_cast<const Fold*>(node));
+                    break;
+                case NodeKind::Function:
+                    visitor.visitedFunction(static_cast<const Function*>(node));
+                    break;
+                case NodeKind::Module:
+                    visitor.visitedModule(static_cast<const Module*>(node));
+                    break;
+                default:
+                    throw UnhandledSwitchCase();
+            }
+            visitor.visitedNode(node);
+        }
+    };
+}
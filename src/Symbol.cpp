@@ -0,0 +1,25 @@
+
+#include "Symbol.hpp"
+
+namespace llast {
+
+    Symbol SymbolTable::intern(std::string_view text) {
+        std::lock_guard<std::mutex> lock{mutex_};
+
+        auto found = symbols_.find(text);
+        if(found != symbols_.end()) {
+            return Symbol{found->second};
+        }
+
+        //Elements of a deque are never moved by push_back, so the key may refer to the stored text.
+        texts_.emplace_back(text);
+        const std::string *stored = &texts_.back();
+        symbols_.emplace(*stored, stored);
+        return Symbol{stored};
+    }
+
+    SymbolTable &SymbolTable::global() {
+        static SymbolTable table;
+        return table;
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+
+namespace llast {
+
+    class SymbolTable;
+
+    /** An interned name.  Two symbols from the same SymbolTable are equal if and only if their text is equal, so
+     * comparing and hashing a symbol costs the same as comparing and hashing a pointer.  Symbols from different
+     * tables must not be compared. */
+    class Symbol {
+        const std::string *text_;
+
+        explicit Symbol(const std::string *text) : text_{text} { }
+        friend class SymbolTable;
+    public:
+        std::string_view str() const { return *text_; }
+
+        bool operator==(const Symbol &other) const { return text_ == other.text_; }
+        bool operator!=(const Symbol &other) const { return text_ != other.text_; }
+
+        size_t hash() const { return std::hash<const std::string*>()(text_); }
+    };
+
+    /** Owns the text of every symbol interned in it.  Interning is thread-safe. */
+    class SymbolTable {
+        std::deque<std::string> texts_;
+        std::unordered_map<std::string_view, const std::string*> symbols_;
+        std::mutex mutex_;
+    public:
+        SymbolTable() { }
+        SymbolTable(const SymbolTable &) = delete;
+        SymbolTable &operator=(const SymbolTable &) = delete;
+
+        Symbol intern(std::string_view text);
+
+        /** The table used when a node is given a name as a string rather than a symbol. */
+        static SymbolTable &global();
+    };
+}
+
+namespace std {
+    template<> struct hash<llast::Symbol> {
+        size_t operator()(const llast::Symbol &symbol) const { return symbol.hash(); }
+    };
+}
@@ -1,8 +1,25 @@
 #include <llvm/Support/ManagedStatic.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/AsmParser/Parser.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/Module.h>
 #include "AST.hpp"
 #include "ExprRunner.hpp"
+#include "CommonSubexpressionEliminator.hpp"
+#include "FunctionSpecializer.hpp"
+#include "FlatAst.hpp"
+#include "BinaryAst.hpp"
+#include "SExpr.hpp"
+#include "StaticExpressionTreeWalker.hpp"
+#include "IterativeExpressionTreeWalker.hpp"
+#include "ParallelFunctionWalker.hpp"
+#include "ExpressionTreeWalker.hpp"
+#include "PrettyPrinter.hpp"
 #include "SigHandler.hpp"
 
+#include <limits>
+#include <sstream>
+
 #define CATCH_CONFIG_RUNNER
 #include "catch.hpp"
 
@@ -105,12 +122,974 @@ TEST_CASE("Float tests") {
     }
 }
 
+TEST_CASE("Symbol interning") {
+    SymbolTable symbols;
+    Symbol foo = symbols.intern("foo");
+
+    REQUIRE(foo == symbols.intern(std::string("foo")));
+    REQUIRE(foo != symbols.intern("bar"));
+    REQUIRE(foo.str() == "foo");
+
+    Variable var1{symbols.intern("var1"), DataType::Int32};
+    REQUIRE(var1.symbol() == symbols.intern("var1"));
+    REQUIRE(var1.name() == "var1");
+}
+
+TEST_CASE("Arena allocation") {
+    SECTION("Trees built in an AstContext execute") {
+        AstContext context;
+        auto var1 = context.makeVariable("var1", DataType::Int32);
+        BlockBuilder bb{context};
+        unique_ptr<const Expr> block {
+                bb.addVariable(var1)
+                        .addExpression(AssignVariable::make(context, var1, LiteralInt32::make(context, 7)))
+                        .addExpression(Return::make(context, Binary::make(context,
+                                                                          VariableRef::make(context, var1),
+                                                                          OperationKind::Mul,
+                                                                          LiteralInt32::make(context, 6))))
+                        .build()
+        };
+        REQUIRE(ExprRunner::runInt32Expr(move(block)) == 42);
+    }
+
+    SECTION("Destroying a deep tree does not recurse") {
+        AstContext context;
+        unique_ptr<const Expr> expr = LiteralInt32::make(context, 0);
+        for(int i = 0; i < 1000000; ++i) {
+            expr = Binary::make(context, move(expr), OperationKind::Add, LiteralInt32::make(context, 1));
+        }
+        expr.reset();
+    }
+}
+
+TEST_CASE("Flat AST") {
+    auto var1 = make_shared<Variable>("var1", DataType::Int32);
+    BlockBuilder bb;
+    unique_ptr<const Expr> block {
+            bb.addVariable(var1)
+                    .addExpression(AssignVariable::make(var1, LiteralInt32::make(5)))
+                    .addExpression(Conditional::make(VariableRef::make(var1),
+                                                     Return::make(Binary::make(VariableRef::make(var1),
+                                                                               OperationKind::Mul,
+                                                                               LiteralInt32::make(3))),
+                                                     nullptr))
+                    .addExpression(Return::make(LiteralInt32::make(-1)))
+                    .build()
+    };
+
+    FlatAst flat = FlatAst::fromExpr(block.get());
+
+    SECTION("Children precede their parents") {
+        REQUIRE(flat.kind(flat.root()) == NodeKind::Block);
+        REQUIRE(flat.childCount(flat.root()) == 3);
+        for(FlatAst::Index node = 0; node < flat.size(); ++node) {
+            for(uint32_t i = 0; i < flat.childCount(node); ++i) {
+                REQUIRE((flat.child(node, i) < node || flat.child(node, i) == FlatAst::NONE));
+            }
+        }
+        FlatAst::Index conditional = flat.child(flat.root(), 1);
+        REQUIRE(flat.kind(conditional) == NodeKind::Conditional);
+        REQUIRE(flat.child(conditional, 2) == FlatAst::NONE);
+    }
+
+    SECTION("Round trip produces an equivalent tree") {
+        auto copy = flat.toExpr();
+        REQUIRE(FlatAst::fromExpr(copy.get()).structuralHashes().back() == flat.structuralHashes().back());
+        REQUIRE(FlatAst::fromExpr(copy.get()).structurallyEqual(flat));
+        REQUIRE(ExprRunner::runInt32Expr(move(copy)) == 15);
+    }
+
+    SECTION("Structural equality compares the bits of literals") {
+        REQUIRE(FlatAst::fromExpr(LiteralFloat::make(0.0f).get())
+                        .structurallyEqual(FlatAst::fromExpr(LiteralFloat::make(0.0f).get())));
+        REQUIRE_FALSE(FlatAst::fromExpr(LiteralFloat::make(0.0f).get())
+                              .structurallyEqual(FlatAst::fromExpr(LiteralFloat::make(-0.0f).get())));
+        REQUIRE_FALSE(flat.structurallyEqual(FlatAst::fromExpr(LiteralInt32::make(15).get())));
+    }
+
+    SECTION("Walker visits every node") {
+        struct CountingVisitor : public FlatAstVisitor {
+            size_t visiting = 0, visited = 0;
+            void visitingNode(const FlatAst &, FlatAst::Index) override { ++visiting; }
+            void visitedNode(const FlatAst &, FlatAst::Index) override { ++visited; }
+        } visitor;
+        FlatAstWalker{&visitor}.walk(flat);
+        REQUIRE(visitor.visiting == flat.size());
+        REQUIRE(visitor.visited == flat.size());
+    }
+}
+
+TEST_CASE("Static tree walker") {
+    struct NodeCounter : public StaticExpressionTreeWalker<NodeCounter> {
+        int nodes = 0, literals = 0;
+        void visitingNode(const Node *) { ++nodes; }
+        void visitLiteralInt32(const LiteralInt32 *) { ++literals; }
+    } counter;
+
+    unique_ptr<const Expr> expr = Conditional::make(LiteralInt32::make(1),
+                                                    Binary::make(LiteralInt32::make(2),
+                                                                 OperationKind::Add,
+                                                                 LiteralFloat::make(3)),
+                                                    nullptr);
+    counter.walkTree(expr.get());
+    REQUIRE(counter.nodes == 5);
+    REQUIRE(counter.literals == 2);
+}
+
+TEST_CASE("Deep trees") {
+    SECTION("Iterative walker invokes the same callbacks as ExpressionTreeWalker") {
+        auto var1 = make_shared<Variable>("var1", DataType::Int32);
+        BlockBuilder bb;
+        unique_ptr<const Expr> block {
+                bb.addVariable(var1)
+                        .addExpression(Conditional::make(LiteralInt32::make(1),
+                                                         nullptr,
+                                                         AssignVariable::make(var1, LiteralInt32::make(2))))
+                        .addExpression(Conditional::make(VariableRef::make(var1), LiteralFloat::make(1), nullptr))
+                        .addExpression(Return::make(VariableRef::make(var1)))
+                        .build()
+        };
+
+        std::ostringstream recursive, iterative;
+        PrettyPrinterVisitor recursivePrinter{recursive}, iterativePrinter{iterative};
+        ExpressionTreeWalker{&recursivePrinter}.walkTree(block.get());
+        IterativeExpressionTreeWalker{&iterativePrinter}.walkTree(block.get());
+        REQUIRE(iterative.str() == recursive.str());
+    }
+
+    SECTION("A deep heap-allocated tree compiles and is destroyed without recursion") {
+        auto x = make_shared<Variable>("x", DataType::Int32);
+        unique_ptr<const Expr> chain = VariableRef::make(x);
+        for(int i = 1; i < 100000; ++i) {
+            chain = Binary::make(move(chain), OperationKind::Add, VariableRef::make(x));
+        }
+        BlockBuilder bb;
+        bb.addVariable(x)
+                .addExpression(AssignVariable::make(x, LiteralInt32::make(1)))
+                .addExpression(Return::make(move(chain)));
+        REQUIRE(ExprRunner::runInt32Expr(bb.build()) == 100000);
+    }
+
+    SECTION("Deep trees are transformed without recursion") {
+        string chain;
+        for(int i = 0; i < 100000; ++i) {
+            chain += "(add ";
+        }
+        chain += "x";
+        for(int i = 0; i < 100000; ++i) {
+            chain += " x)";
+        }
+        unique_ptr<const Module> module = SExprParser{}.parseModule(
+                "(module m (function f Int32 (params (x Int32) (y Int32)) (return (sub " + chain + " y))))");
+        const Function *func = module->function(0);
+
+        ChildPtr<const Expr> copy = ExpressionTreeTransformer{}.transform(func->body());
+        REQUIRE(FlatAst::fromExpr(copy.get()).structurallyEqual(FlatAst::fromExpr(func->body())));
+
+        unique_ptr<const Expr> one = LiteralInt32::make(1);
+        unique_ptr<const Function> variant = FunctionSpecializer{}
+                .bind("y", one.get())
+                .specialize(func, SymbolTable::global().intern("f1"));
+        REQUIRE(variant->parameterScope()->size() == 1);
+
+        ChildPtr<const Expr> eliminated = CommonSubexpressionEliminator{}.transform(SExprParser{}.parseExpr(
+                "(block ((x Int32)) (set x 1) (return (sub " + chain + " " + chain + ")))").get());
+        REQUIRE(static_cast<const Block*>(eliminated.get())->scope()->size() == 2);
+        REQUIRE(ExprRunner::runInt32Expr(move(eliminated)) == 0);
+    }
+}
+
+TEST_CASE("Parallel function walker") {
+    struct NodeCounter : public ExpressionTreeVisitor {
+        int nodes = 0;
+        void visitingNode(const Node *) override { ++nodes; }
+    };
+
+    ModuleBuilder mb{"parallel"};
+    for(int f = 0; f < 20; ++f) {
+        FunctionBuilder fb{"func" + std::to_string(f), DataType::Int32};
+        unique_ptr<const Expr> expr = LiteralInt32::make(0);
+        for(int i = 0; i < f; ++i) {
+            expr = Binary::make(move(expr), OperationKind::Add, LiteralInt32::make(i));
+        }
+        fb.blockBuilder().addExpression(Return::make(move(expr)));
+        mb.addFunction(fb.build());
+    }
+    unique_ptr<const Module> module = mb.build();
+
+    NodeCounter serial;
+    ExpressionTreeWalker{&serial}.walkTree(module.get());
+
+    int parallel = 0;
+    ParallelFunctionWalker<NodeCounter>{4}.walk(module.get(),
+                                                 [] { return make_unique<NodeCounter>(); },
+                                                 [&](NodeCounter &counter) { parallel += counter.nodes; });
+    //The serial walk also visits the Module.
+    REQUIRE(parallel == serial.nodes - 1);
+}
+
+TEST_CASE("Binary serialization") {
+    auto var1 = make_shared<Variable>("var1", DataType::Int32);
+    BlockBuilder bb;
+    unique_ptr<const Expr> block {
+            bb.addVariable(var1)
+                    .addExpression(AssignVariable::make(var1, LiteralInt32::make(-300)))
+                    .addExpression(Conditional::make(VariableRef::make(var1),
+                                                     nullptr,
+                                                     AssignVariable::make(var1, LiteralInt32::make(1))))
+                    .addExpression(Return::make(Binary::make(VariableRef::make(var1),
+                                                             OperationKind::Div,
+                                                             LiteralInt32::make(3))))
+                    .build()
+    };
+    std::vector<uint8_t> bytes = BinaryAstWriter::write(block.get());
+
+    SECTION("Loaded trees are equivalent to the original") {
+        BinaryAstView view{bytes};
+        REQUIRE(view.root().kind == NodeKind::Block);
+        AstContext context;
+        unique_ptr<const Expr> loaded = BinaryAstLoader{view, &context}.loadExpr();
+        REQUIRE(FlatAst::fromExpr(loaded.get()).structuralHashes().back()
+                == FlatAst::fromExpr(block.get()).structuralHashes().back());
+        REQUIRE(ExprRunner::runInt32Expr(move(loaded)) == -100);
+    }
+
+    SECTION("Truncated data is rejected") {
+        auto load = [&](size_t size) {
+            BinaryAstView view{bytes.data(), size};
+            return BinaryAstLoader{view}.loadExpr();
+        };
+        for(size_t size = 0; size < bytes.size(); ++size) {
+            REQUIRE_THROWS_AS(load(size), const FormatException &);
+        }
+    }
+
+    SECTION("Nodes shared by several parents are rejected") {
+        //Appends 40 Binary nodes whose two children are both the previous node, which would load as 2^40 nodes.
+        std::vector<uint8_t> shared = BinaryAstWriter::write(
+                unique_ptr<const Expr>{Binary::make(LiteralInt32::make(1), OperationKind::Add,
+                                                    LiteralInt32::make(2))}.get());
+        std::vector<uint8_t> binary(shared.end() - 5, shared.end());
+        size_t root = 0;
+        for(int i = 0; i < 40; ++i) {
+            root = shared.size();
+            shared.insert(shared.end(), binary.begin(), binary.begin() + 3);
+            shared.insert(shared.end(), {5, 5});
+        }
+        for(int i = 0; i < 4; ++i) {
+            shared[24 + i] = static_cast<uint8_t>(root >> (8 * i));
+            shared[28 + i] = static_cast<uint8_t>(shared.size() >> (8 * i));
+        }
+
+        BinaryAstView view{shared};
+        REQUIRE_THROWS_AS(BinaryAstLoader{view}.loadExpr(), const FormatException &);
+    }
+}
+
+TEST_CASE("S-expression format") {
+    const char *text =
+            "(block ((a Int32))\n"
+            " (set a (mul 6 7))\n"
+            " (if a nil (set a -1))\n"
+            " (return (sub a 2)))";
+
+    SECTION("Parsed trees are written back unchanged") {
+        AstContext context;
+        unique_ptr<const Expr> expr = SExprParser{&context}.parseExpr(text);
+        string written = SExprWriter::toString(expr.get());
+        REQUIRE(SExprWriter::toString(SExprParser{}.parseExpr(written).get()) == written);
+        REQUIRE(ExprRunner::runInt32Expr(SExprParser{}.parseExpr(written)) == 40);
+    }
+
+    SECTION("Subnormal literals are written back unchanged") {
+        unique_ptr<const Expr> subnormalFloat = LiteralFloat::make(1e-40f);
+        unique_ptr<const Expr> subnormalDouble = LiteralDouble::make(1e-310);
+        unique_ptr<const Expr> parsedFloat = SExprParser{}.parseExpr(SExprWriter::toString(subnormalFloat.get()));
+        unique_ptr<const Expr> parsedDouble = SExprParser{}.parseExpr(SExprWriter::toString(subnormalDouble.get()));
+        REQUIRE(static_cast<const LiteralFloat*>(parsedFloat.get())->value() == 1e-40f);
+        REQUIRE(static_cast<const LiteralDouble*>(parsedDouble.get())->value() == 1e-310);
+        REQUIRE_THROWS_AS(SExprParser{}.parseExpr("1e39"), const ParseException &);
+        REQUIRE_THROWS_AS(SExprParser{}.parseExpr("-1e309d"), const ParseException &);
+    }
+
+    SECTION("Errors give the line and column") {
+        try {
+            SExprParser{}.parseExpr("(block ((a Int32))\n (set b 1))");
+            FAIL("expected a ParseException");
+        } catch(const ParseException &e) {
+            REQUIRE(e.line() == 2);
+            REQUIRE(e.column() == 7);
+        }
+        REQUIRE_THROWS_AS(SExprParser{}.parseExpr("(add 1"), const ParseException &);
+        REQUIRE_THROWS_AS(SExprParser{}.parseExpr("(frobnicate 1 2)"), const ParseException &);
+    }
+
+    SECTION("Parsing into a FlatAst gives the flattened tree") {
+        const char *moduleText =
+                "(module flat\n"
+                " (function half Float (params (x Float)) (return (mul x 0.5)))\n"
+                " (function twice Float (params (x Float)) (return (add (call half Float x) x))))";
+        SExprParser parser;
+        REQUIRE(parser.parseFlatExpr(text).structurallyEqual(FlatAst::fromExpr(parser.parseExpr(text).get())));
+        REQUIRE(parser.parseFlatModule(moduleText)
+                        .structurallyEqual(FlatAst::fromModule(parser.parseModule(moduleText).get())));
+        REQUIRE_THROWS_AS(parser.parseFlatExpr("(block ((a Int32))\n (set b 1))"), const ParseException &);
+    }
+}
+
+TEST_CASE("Incremental recompilation") {
+    auto makeModule = [](int bValue, bool withC) {
+        ModuleBuilder mb{"rules"};
+        auto addFunction = [&](const char *name, int value) {
+            FunctionBuilder fb{name, DataType::Int32};
+            fb.blockBuilder().addExpression(Return::make(LiteralInt32::make(value)));
+            mb.addFunction(fb.build());
+        };
+        addFunction("a", 1);
+        addFunction("b", bValue);
+        if(withC) {
+            addFunction("c", 3);
+        }
+        return mb.build();
+    };
+    auto call = [](ExecutionContext &ec, const char *name) {
+        return reinterpret_cast<int (*)()>(ec.getSymbolAddress(name))();
+    };
+
+    ExecutionContext ec;
+    REQUIRE(ec.addModule(makeModule(2, true).get()) == 3);
+    REQUIRE(call(ec, "b") == 2);
+
+    //Only b changed and c was removed.
+    REQUIRE(ec.addModule(makeModule(20, false).get()) == 1);
+    REQUIRE(call(ec, "a") == 1);
+    REQUIRE(call(ec, "b") == 20);
+    REQUIRE(ec.getSymbolAddress("c") == 0);
+
+    REQUIRE(ec.addModule(makeModule(20, false).get()) == 0);
+}
+
+TEST_CASE("Structural sharing") {
+    class ReplaceLiteral : public ExpressionTreeTransformer {
+    public:
+        ReplaceLiteral(AstContext &context) : ExpressionTreeTransformer{context} { }
+    protected:
+        ChildPtr<const Expr> transformLiteralInt32(const LiteralInt32 *expr) override {
+            if(expr->value() == 7) {
+                return makeIn<const LiteralInt32>(context(), 8);
+            }
+            return ExpressionTreeTransformer::transformLiteralInt32(expr);
+        }
+    };
+
+    AstContext context;
+    unique_ptr<const Module> module = SExprParser{&context}.parseModule(
+            "(module rules"
+            " (function a Int32 (params) (block ((x Int32)) (set x (mul 6 7)) (return (sub x 2))))"
+            " (function b Int32 (params) (return 5)))");
+    unique_ptr<const Module> variant = ReplaceLiteral{context}.transformModule(module.get());
+
+    //Only the nodes on the path to the replaced literal are new.
+    REQUIRE(variant->function(1) == module->function(1));
+    auto original = static_cast<const Block*>(module->function(0)->body());
+    auto rewritten = static_cast<const Block*>(variant->function(0)->body());
+    REQUIRE(rewritten != original);
+    REQUIRE(rewritten->expression(0) != original->expression(0));
+    REQUIRE(rewritten->expression(1) == original->expression(1));
+
+    module.reset();
+    REQUIRE(SExprWriter::toString(variant.get()) ==
+            SExprWriter::toString(SExprParser{}.parseModule(
+                    "(module rules"
+                    " (function a Int32 (params) (block ((x Int32)) (set x (mul 6 8)) (return (sub x 2))))"
+                    " (function b Int32 (params) (return 5)))").get()));
+
+    //Discarding the result of transforming a child leaves the original tree intact even if that result is shared.
+    class FoldMultiplyByZero : public ExpressionTreeTransformer {
+    public:
+        FoldMultiplyByZero(AstContext &context) : ExpressionTreeTransformer{context} { }
+    protected:
+        ChildPtr<const Expr> transformBinary(const Binary *expr) override {
+            ChildPtr<const Expr> lValue = transform(expr->lValue());
+            ChildPtr<const Expr> rValue = transform(expr->rValue());
+            if(expr->operation() == OperationKind::Mul
+               && rValue->nodeKind() == NodeKind::LiteralInt32
+               && static_cast<const LiteralInt32*>(rValue.get())->value() == 0) {
+                return makeIn<const LiteralInt32>(context(), 0);
+            }
+            return makeIn<const Binary>(context(), move(lValue), expr->operation(), move(rValue));
+        }
+    };
+
+    const char *scaledText = "(module scaled (function f Int32 (params (x Int32)) (return (add (mul x 0) x))))";
+    unique_ptr<const Module> scaled = SExprParser{&context}.parseModule(scaledText);
+    unique_ptr<const Module> folded = FoldMultiplyByZero{context}.transformModule(scaled.get());
+    REQUIRE(SExprWriter::toString(scaled.get())
+            == SExprWriter::toString(SExprParser{}.parseModule(scaledText).get()));
+    REQUIRE(SExprWriter::toString(folded.get())
+            == SExprWriter::toString(SExprParser{}.parseModule(
+                    "(module scaled (function f Int32 (params (x Int32)) (return (add 0 x))))").get()));
+}
+
+TEST_CASE("Variables assigned in conditional arms") {
+    auto var1 = make_shared<Variable>("var1", DataType::Int32);
+
+    auto makeBlock = [&](int initialValue) {
+        BlockBuilder bb;
+        return bb.addVariable(var1)
+                .addExpression(AssignVariable::make(var1, LiteralInt32::make(initialValue)))
+                .addExpression(Conditional::make(
+                        make_unique<VariableRef>(var1),
+                        AssignVariable::make(var1, Binary::make(make_unique<VariableRef>(var1),
+                                                                OperationKind::Mul,
+                                                                LiteralInt32::make(2))),
+                        AssignVariable::make(var1, LiteralInt32::make(-1))))
+                .addExpression(Return::make(make_unique<VariableRef>(var1)))
+                .build();
+    };
+
+    REQUIRE(ExprRunner::runInt32Expr(makeBlock(3)) == 6);
+    REQUIRE(ExprRunner::runInt32Expr(makeBlock(0)) == -1);
+}
+
+TEST_CASE("Branch hints and select lowering") {
+    ExecutionContext ec;
+    ec.addModule(SExprParser{}.parseModule(
+            "(module m"
+            "  (function choose Int32 (params (c Int32) (a Int32) (b Int32)) (return (if c (add a 1) (mul b 3))))"
+            "  (function expect Int32 (params (c Int32)) (return (if unlikely c (div 12 c) -1))))").get());
+
+    auto choose = reinterpret_cast<int32_t (*)(int32_t, int32_t, int32_t)>(ec.getSymbolAddress("choose"));
+    REQUIRE(choose(1, 4, 5) == 5);
+    REQUIRE(choose(0, 4, 5) == 15);
+
+    auto expect = reinterpret_cast<int32_t (*)(int32_t)>(ec.getSymbolAddress("expect"));
+    REQUIRE(expect(4) == 3);
+    REQUIRE(expect(0) == -1);
+
+    unique_ptr<const Expr> hinted = SExprParser{}.parseExpr("(if likely 1 2 3)");
+    REQUIRE(static_cast<const Conditional*>(hinted.get())->branchHint() == BranchHint::Likely);
+    std::vector<uint8_t> bytes = BinaryAstWriter::write(hinted.get());
+    BinaryAstView view{bytes};
+    REQUIRE(SExprWriter::toString(BinaryAstLoader{view}.loadExpr().get()) == "(if likely 1 2 3)");
+}
+
+TEST_CASE("Loops") {
+    SECTION("For") {
+        REQUIRE(ExprRunner::runInt32Expr(SExprParser{}.parseExpr(
+                "(block ((sum Int32) (i Int32))"
+                " (set sum 0)"
+                " (for (set i 1) (sub 11 i) (set sum (add sum i)) (set i (add i 1)))"
+                " (return sum))")) == 55);
+    }
+
+    SECTION("While with break") {
+        REQUIRE(ExprRunner::runInt32Expr(SExprParser{}.parseExpr(
+                "(block ((i Int32))"
+                " (set i 0)"
+                " (while 1 (block () (set i (add i 1)) (if (sub i 7) nil break)))"
+                " (return i))")) == 7);
+    }
+
+    SECTION("Continue skips to the update") {
+        REQUIRE(ExprRunner::runInt32Expr(SExprParser{}.parseExpr(
+                "(block ((sum Int32) (i Int32))"
+                " (set sum 0)"
+                " (for (set i 0) (sub 10 i) (block () (if (sub i 5) nil continue) (set sum (add sum i))) (set i (add i 1)))"
+                " (return sum))")) == 40);
+    }
+
+    SECTION("Nested loops left by return") {
+        REQUIRE(ExprRunner::runInt32Expr(SExprParser{}.parseExpr(
+                "(block ((i Int32) (j Int32))"
+                " (for (set i 0) nil"
+                "  (for (set j 0) (sub j 4) (if (sub (mul i j) 6) nil (return (add (mul i 10) j))) (set j (add j 1)))"
+                "  (set i (add i 1)))"
+                " (return -1))")) == 23);
+    }
+}
+
+TEST_CASE("Invoke") {
+    auto call = [](ExecutionContext &ec, const char *name, int arg) {
+        return reinterpret_cast<int (*)(int)>(ec.getSymbolAddress(name))(arg);
+    };
+    auto addModule = [](ExecutionContext &ec, const char *text) {
+        return ec.addModule(SExprParser{}.parseModule(text).get());
+    };
+
+    ExecutionContext ec;
+    SECTION("Within a module") {
+        addModule(ec, "(module m"
+                      " (function square Int32 (params (x Int32)) (return (mul x x)))"
+                      " (function f Int32 (params (y Int32)) (return (add (call square Int32 y) 1))))");
+        REQUIRE(call(ec, "f", 3) == 10);
+    }
+
+    SECTION("Between modules, across recompilation of the callee") {
+        addModule(ec, "(module lib (function scale Int32 (params (x Int32)) (return (mul x 2))))");
+        addModule(ec, "(module app (function f Int32 (params (y Int32)) (return (add (call scale Int32 y) 1))))");
+        REQUIRE(call(ec, "f", 3) == 7);
+
+        REQUIRE(addModule(ec, "(module lib (function scale Int32 (params (x Int32)) (return (mul x 3))))") == 1);
+        REQUIRE(call(ec, "f", 3) == 10);
+
+        REQUIRE_THROWS_AS(addModule(ec, "(module lib)"), const CompileException &);
+        REQUIRE_THROWS_AS(addModule(ec, "(module other (function scale Int32 (params) (return 0)))"),
+                          const CompileException &);
+    }
+}
+
+int32_t tripleHostFunction(int32_t value) {
+    return value * 3;
+}
+
+TEST_CASE("Host functions") {
+    ExecutionContext ec;
+    auto call = [&](const char *name, int arg) {
+        return reinterpret_cast<int (*)(int)>(ec.getSymbolAddress(name))(arg);
+    };
+
+    SECTION("Called at their address") {
+        ec.addHostFunction("triple", tripleHostFunction);
+        ec.addModule(SExprParser{}.parseModule(
+                "(module m (function f Int32 (params (y Int32)) (return (add (call triple Int32 y) 1))))").get());
+        REQUIRE(call("f", 4) == 13);
+        REQUIRE_THROWS_AS(ec.addHostFunction("f", tripleHostFunction), const CompileException &);
+    }
+
+    SECTION("Given as bitcode") {
+        llvm::LLVMContext context;
+        llvm::SMDiagnostic diagnostic;
+        unique_ptr<llvm::Module> module = llvm::parseAssemblyString(
+                "define i32 @addOne(i32 %x) {\n"
+                "  %r = add i32 %x, 1\n"
+                "  ret i32 %r\n"
+                "}\n", diagnostic, context);
+        string bitcode;
+        llvm::raw_string_ostream out{bitcode};
+        llvm::WriteBitcodeToFile(module.get(), out);
+        out.flush();
+
+        ec.addHostFunctionBitcode("addOne", DataType::Int32, { DataType::Int32 }, bitcode);
+        ec.addModule(SExprParser{}.parseModule(
+                "(module m (function f Int32 (params (y Int32)) (return (mul (call addOne Int32 y) 2))))").get());
+        REQUIRE(call("f", 4) == 10);
+        REQUIRE(call("addOne", 4) == 5);
+
+        REQUIRE_THROWS_AS(ec.addHostFunctionBitcode("other", DataType::Int32, { }, "not bitcode"),
+                          const CompileException &);
+    }
+}
+
+TEST_CASE("Memory access") {
+    ExecutionContext ec;
+    ec.addModule(SExprParser{}.parseModule(
+            "(module m (function accumulate Int32 (params (p Pointer noalias) (n Int32))"
+            "    (return (store 4 (index Int32 p 1) (add (load Int32 0 p) n)))))").get());
+    auto accumulate = reinterpret_cast<int (*)(int32_t*, int)>(ec.getSymbolAddress("accumulate"));
+
+    int32_t buffer[] = { 10, 0 };
+    REQUIRE(accumulate(buffer, 5) == 15);
+    REQUIRE(buffer[0] == 10);
+    REQUIRE(buffer[1] == 15);
+
+    REQUIRE(assertCompileError(CompileError::InvalidMemoryAccess, SExprParser{}.parseExpr("(load Int32 0 1)")));
+}
+
+TEST_CASE("Vector types") {
+    ExecutionContext ec;
+    ec.addModule(SExprParser{}.parseModule(
+            "(module m"
+            "  (function dot Float (params (a Pointer) (b Pointer))"
+            "    (return (reduce add (mul (load Float32x4 4 a) (load Float32x4 4 b)))))"
+            "  (function lanes Int32 (params)"
+            "    (block ((v Int32x4))"
+            "      (set v (insert 3 (splat Int32x4 2) 5))"
+            "      (return (add (reduce mul v) (extract 0 (shuffle (3 2 1 0) v v)))))))").get());
+
+    float a[] = { 1, 2, 3, 4 };
+    float b[] = { 5, 6, 7, 8 };
+    REQUIRE(reinterpret_cast<float (*)(float*, float*)>(ec.getSymbolAddress("dot"))(a, b) == 70);
+    REQUIRE(reinterpret_cast<int (*)()>(ec.getSymbolAddress("lanes"))() == 45);
+
+    REQUIRE(assertCompileError(CompileError::InvalidVectorOperation,
+                               SExprParser{}.parseExpr("(extract 4 (splat Int32x4 1))")));
+    REQUIRE(assertCompileError(CompileError::InvalidVectorOperation, SExprParser{}.parseExpr("(reduce add 1)")));
+}
+
+TEST_CASE("Map and Fold") {
+    ExecutionContext ec;
+    ec.addModule(SExprParser{}.parseModule(
+            "(module m"
+            "  (function scale Int32 (params (out Pointer noalias) (in Pointer noalias) (n Int32))"
+            "    (block ((i Int32))"
+            "      (map i out n (mul (load Float 0 (index Float in i)) 2.0))"
+            "      (return i)))"
+            "  (function sum Float (params (in Pointer) (n Int32))"
+            "    (block ((i Int32)) (return (fold add i n (load Float 0 (index Float in i))))))"
+            "  (function largest Int32 (params (in Pointer) (n Int32))"
+            "    (block ((i Int32)) (return (fold max i n (load Int32 0 (index Int32 in i)))))))").get());
+
+    float in[100], out[100];
+    int32_t values[100];
+    for(int i = 0; i < 100; ++i) {
+        in[i] = i;
+        values[i] = (i * 37) % 101;
+    }
+    auto scale = reinterpret_cast<int32_t (*)(float*, float*, int32_t)>(ec.getSymbolAddress("scale"));
+    REQUIRE(scale(out, in, 100) == 100);
+    REQUIRE(out[0] == 0);
+    REQUIRE(out[99] == 198);
+    REQUIRE(scale(out, in, -1) == 0);
+
+    auto sum = reinterpret_cast<float (*)(float*, int32_t)>(ec.getSymbolAddress("sum"));
+    REQUIRE(sum(in, 100) == 4950);
+    REQUIRE(sum(in, 0) == 0);
+
+    auto largest = reinterpret_cast<int32_t (*)(int32_t*, int32_t)>(ec.getSymbolAddress("largest"));
+    REQUIRE(largest(values, 100) == 100);
+    REQUIRE(largest(values, 0) == INT32_MIN);
+
+    REQUIRE(assertCompileError(CompileError::LoopControlOutsideLoop,
+                               SExprParser{}.parseExpr("(block ((i Int32)) (fold add i 3 (block () break 1)))")));
+    REQUIRE(assertCompileError(CompileError::InvalidRangeOperation,
+                               SExprParser{}.parseExpr("(block ((i Int32)) (fold sub i 3 1))")));
+}
+
+TEST_CASE("Switch") {
+    ExecutionContext ec;
+    ec.addModule(SExprParser{}.parseModule(
+            "(module m"
+            "  (function dense Int32 (params (x Int32)) (return (switch (0 1 2 3) x 10 11 12 13 -1)))"
+            "  (function sparse Int32 (params (x Int32))"
+            "    (block ((r Int32))"
+            "      (set r 5)"
+            "      (switch (-100 1000000) x (set r 1) (return 2) nil)"
+            "      (return r))))").get());
+
+    auto dense = reinterpret_cast<int32_t (*)(int32_t)>(ec.getSymbolAddress("dense"));
+    REQUIRE(dense(0) == 10);
+    REQUIRE(dense(3) == 13);
+    REQUIRE(dense(4) == -1);
+    REQUIRE(dense(-1) == -1);
+
+    auto sparse = reinterpret_cast<int32_t (*)(int32_t)>(ec.getSymbolAddress("sparse"));
+    REQUIRE(sparse(-100) == 1);
+    REQUIRE(sparse(1000000) == 2);
+    REQUIRE(sparse(7) == 5);
+
+    REQUIRE_THROWS_AS(SExprParser{}.parseExpr("(switch (1 1) 0 1 2 3)"), const ParseException &);
+    REQUIRE(assertCompileError(CompileError::InvalidDiscriminant, SExprParser{}.parseExpr("(switch (1) 1.0 1 2)")));
+}
+
+bool isEvenHostFunction(int32_t value) {
+    return value % 2 == 0;
+}
+
+TEST_CASE("Comparison and logical operations") {
+    ExecutionContext ec;
+    ec.addHostFunction("isEven", isEvenHostFunction);
+    ec.addModule(SExprParser{}.parseModule(
+            "(module m"
+            "  (function inRange Bool (params (x Int32) (lo Int32) (hi Int32)) (return (and (ge x lo) (lt x hi))))"
+            "  (function loadPositive Bool (params (p Pointer) (n Int32))"
+            "    (return (and (gt n 0) (gt (load Int32 0 p) 0))))"
+            "  (function oddOrNan Bool (params (x Int32) (f Float))"
+            "    (return (or (not (call isEven Bool x)) (ne f f)))))").get());
+
+    auto inRange = reinterpret_cast<bool (*)(int32_t, int32_t, int32_t)>(ec.getSymbolAddress("inRange"));
+    REQUIRE(inRange(3, 0, 5));
+    REQUIRE_FALSE(inRange(5, 0, 5));
+    REQUIRE_FALSE(inRange(-1, 0, 5));
+
+    //The load is in the short-circuited rValue, so a null pointer is never read.
+    auto loadPositive = reinterpret_cast<bool (*)(const int32_t*, int32_t)>(ec.getSymbolAddress("loadPositive"));
+    int32_t value = 7;
+    REQUIRE(loadPositive(&value, 1));
+    REQUIRE_FALSE(loadPositive(nullptr, 0));
+
+    auto oddOrNan = reinterpret_cast<bool (*)(int32_t, float)>(ec.getSymbolAddress("oddOrNan"));
+    REQUIRE(oddOrNan(3, 1.0f));
+    REQUIRE_FALSE(oddOrNan(4, 1.0f));
+    REQUIRE(oddOrNan(4, std::numeric_limits<float>::quiet_NaN()));
+
+    REQUIRE(assertCompileError(CompileError::InvalidOperandType, SExprParser{}.parseExpr("(and 1 2)")));
+    REQUIRE(assertCompileError(CompileError::InvalidOperandType, SExprParser{}.parseExpr("(not 1)")));
+    REQUIRE(assertCompileError(CompileError::InvalidOperandType,
+                               SExprParser{}.parseExpr("(add (lt 1 2) (lt 2 3))")));
+}
+
+TEST_CASE("Int64, unsigned and Double arithmetic") {
+    ExecutionContext ec;
+    ec.addModule(SExprParser{}.parseModule(
+            "(module m"
+            "  (function sum Int64 (params (in Pointer) (n Int32))"
+            "    (block ((i Int32)) (return (fold add i n (convert Int64 (load Int32 0 (index Int32 in i)))))))"
+            "  (function half UInt32 (params (x UInt32)) (return (div x (convert UInt32 2))))"
+            "  (function mean Double (params (a Double) (b Double)) (return (mul (add a b) 0.5d)))"
+            "  (function checkedAdd Int32 (params (a Int32) (b Int32)) (return (checked add a b (return -1))))"
+            "  (function checkedSub UInt64 (params (a UInt64) (b UInt64))"
+            "    (return (checked sub a b (convert UInt64 0)))))").get());
+
+    int32_t in[] = { INT32_MAX, INT32_MAX, 2 };
+    auto sum = reinterpret_cast<int64_t (*)(int32_t*, int32_t)>(ec.getSymbolAddress("sum"));
+    REQUIRE(sum(in, 3) == 2 * int64_t(INT32_MAX) + 2);
+
+    auto half = reinterpret_cast<uint32_t (*)(uint32_t)>(ec.getSymbolAddress("half"));
+    REQUIRE(half(4000000000u) == 2000000000u);
+
+    auto mean = reinterpret_cast<double (*)(double, double)>(ec.getSymbolAddress("mean"));
+    REQUIRE(mean(1e300, 1e300) == 1e300);
+
+    auto checkedAdd = reinterpret_cast<int32_t (*)(int32_t, int32_t)>(ec.getSymbolAddress("checkedAdd"));
+    REQUIRE(checkedAdd(2, 3) == 5);
+    REQUIRE(checkedAdd(INT32_MAX, 1) == -1);
+
+    auto checkedSub = reinterpret_cast<uint64_t (*)(uint64_t, uint64_t)>(ec.getSymbolAddress("checkedSub"));
+    REQUIRE(checkedSub(5, 3) == 2);
+    REQUIRE(checkedSub(3, 5) == 0);
+
+    REQUIRE(assertCompileError(CompileError::BinaryExprDataTypeMismatch, SExprParser{}.parseExpr("(add 1 1L)")));
+    REQUIRE(assertCompileError(CompileError::InvalidOperandType, SExprParser{}.parseExpr("(checked div 1 1 0)")));
+    REQUIRE(assertCompileError(CompileError::InvalidOperandType, SExprParser{}.parseExpr("(convert Bool 1)")));
+}
+
+TEST_CASE("Float semantics") {
+    auto sumModule = [](const char *semantics) {
+        return SExprParser{}.parseModule(
+                std::string("(module m (function sum Float ") + semantics + " (params (in Pointer) (n Int32))"
+                "  (block ((i Int32) (s Float))"
+                "    (set s 0.0)"
+                "    (for (set i 0) (lt i n) (set s (add s (load Float 0 (index Float in i)))) (set i (add i 1)))"
+                "    (return s))))");
+    };
+
+    unique_ptr<const Module> reassociated = sumModule("reassoc");
+    REQUIRE(reassociated->function(0)->floatSemantics() == FloatSemantics::Reassociate);
+    REQUIRE(SExprWriter::toString(SExprParser{}.parseModule(SExprWriter::toString(reassociated.get())).get())
+            == SExprWriter::toString(reassociated.get()));
+
+    ExecutionContext ec;
+    REQUIRE(ec.addModule(sumModule("").get()) == 1);
+    REQUIRE(ec.addModule(reassociated.get()) == 1);
+
+    float in[100];
+    for(int i = 0; i < 100; ++i) {
+        in[i] = i;
+    }
+    auto sum = reinterpret_cast<float (*)(float*, int32_t)>(ec.getSymbolAddress("sum"));
+    REQUIRE(sum(in, 100) == 4950);
+
+    //The semantics are carried by the fast-math flags of the generated operations, so they are checked in the IR.
+    auto fadd = [&](const char *semantics) {
+        string ir = ExprRunner::generateLlvmIr(sumModule(semantics).get());
+        size_t start = ir.find("= fadd ");
+        REQUIRE(start != string::npos);
+        return ir.substr(start, ir.find(" %", start) - start);
+    };
+    REQUIRE(fadd("") == "= fadd float");
+    REQUIRE(fadd("contract") == "= fadd contract float");
+    REQUIRE(fadd("reassoc") == "= fadd fast float");
+    REQUIRE(fadd("fast") == "= fadd fast float");
+
+    REQUIRE_THROWS_AS(SExprParser{}.parseModule("(module m (function f Int32 sloppy (params) 1))"),
+                      const ParseException &);
+}
+
+TEST_CASE("Partial evaluation") {
+    unique_ptr<const Module> module = SExprParser{}.parseModule(
+            "(module m"
+            "  (function threshold Int32 (params (x Int32) (limit Int32) (scale Float))"
+            "    (block ((r Int32))"
+            "      (set r (if (gt x limit) limit x))"
+            "      (set limit 0)"
+            "      (return (add (convert Int32 (mul (convert Float r) scale)) limit)))))");
+    const Function *threshold = module->function(0);
+    unique_ptr<const Expr> ten = LiteralInt32::make(10);
+    unique_ptr<const Expr> two = LiteralFloat::make(2.0f);
+
+    unique_ptr<const Function> variant = FunctionSpecializer{}
+            .bind("limit", ten.get())
+            .specialize(threshold, SymbolTable::global().intern("threshold10"));
+    REQUIRE(variant->parameterScope()->size() == 2);
+    REQUIRE(variant->parameterScope()->variable(1)->name() == "scale");
+
+    ExecutionContext ec;
+    ec.addModule(module.get());
+    uint64_t address = ec.specialize(threshold, { { "limit", ten.get() }, { "scale", two.get() } });
+    auto specialized = reinterpret_cast<int32_t (*)(int32_t)>(address);
+    REQUIRE(specialized(4) == 8);
+    REQUIRE(specialized(40) == 20);
+
+    //Equal values, in any order, reuse the variant compiled first.
+    unique_ptr<const Expr> otherTen = LiteralInt32::make(10);
+    REQUIRE(ec.specialize(threshold, { { "scale", two.get() }, { "limit", otherTen.get() } }) == address);
+    unique_ptr<const Expr> twenty = LiteralInt32::make(20);
+    REQUIRE(ec.specialize(threshold, { { "limit", twenty.get() }, { "scale", two.get() } }) != address);
+
+    REQUIRE_THROWS_AS(ec.specialize(threshold, { { "limit", two.get() } }), const CompileException &);
+    REQUIRE_THROWS_AS(ec.specialize(threshold, { { "x", ten.get() }, { "x", ten.get() } }), const CompileException &);
+
+    //A bound value is copied in full, so it need not outlive the variant even when structure is shared.
+    AstContext context;
+    unique_ptr<const Module> shared = SExprParser{&context}.parseModule(
+            "(module m (function pick Int32 (params (x Int32) (enabled Bool)) (if enabled x 0)))");
+    unique_ptr<const Function> picked;
+    {
+        AstContext valueContext;
+        unique_ptr<const Expr> enabled = SExprParser{&valueContext}.parseExpr("(eq (add 1 2) 3)");
+        picked = FunctionSpecializer{context}
+                .bind("enabled", enabled.get())
+                .specialize(shared->function(0), context.intern("pick3"));
+    }
+    REQUIRE(SExprWriter::toString(picked->body())
+            == "(block ((enabled Bool)) (set enabled (eq (add 1 2) 3)) (if enabled x 0))");
+
+    //A variant keeps the functions it invokes from being removed until it is released.
+    unique_ptr<const Module> rules = SExprParser{}.parseModule(
+            "(module rules"
+            "  (function helper Int32 (params (x Int32)) (return (mul x 10)))"
+            "  (function scaled Int32 (params (x Int32) (factor Int32)) (return (call helper Int32 (mul x factor)))))");
+    ec.addModule(rules.get());
+    unique_ptr<const Expr> three = LiteralInt32::make(3);
+    uint64_t tripled = ec.specialize(rules->function(1), { { "factor", three.get() } });
+    REQUIRE(reinterpret_cast<int32_t (*)(int32_t)>(tripled)(2) == 60);
+
+    unique_ptr<const Module> withoutHelper = SExprParser{}.parseModule(
+            "(module rules (function scaled Int32 (params (x Int32) (factor Int32)) (return (mul x factor))))");
+    REQUIRE_THROWS_AS(ec.addModule(withoutHelper.get()), const CompileException &);
+    REQUIRE(ec.releaseSpecialization(tripled));
+    REQUIRE_FALSE(ec.releaseSpecialization(tripled));
+    REQUIRE(ec.addModule(withoutHelper.get()) == 1);
+    uint64_t recompiled = ec.specialize(withoutHelper->function(0), { { "factor", three.get() } });
+    REQUIRE(reinterpret_cast<int32_t (*)(int32_t)>(recompiled)(2) == 6);
+}
+
+TEST_CASE("Common subexpression elimination") {
+    auto a = make_shared<Variable>("a", DataType::Int32);
+    auto b = make_shared<Variable>("b", DataType::Int32);
+    auto c = make_shared<Variable>("c", DataType::Int32);
+
+    auto aTimesB = [&]() {
+        return Binary::make(make_unique<VariableRef>(a), OperationKind::Mul, make_unique<VariableRef>(b));
+    };
+
+    SECTION("Repeated expression is evaluated once") {
+        BlockBuilder bb;
+        unique_ptr<const Block> block {
+                bb.addVariable(a)
+                        .addVariable(b)
+                        .addExpression(AssignVariable::make(a, LiteralInt32::make(3)))
+                        .addExpression(AssignVariable::make(b, LiteralInt32::make(4)))
+                        .addExpression(Return::make(Binary::make(aTimesB(), OperationKind::Add, aTimesB())))
+                        .build()
+        };
+
+        CommonSubexpressionEliminator cse;
+        ChildPtr<const Expr> eliminated = cse.transform(block.get());
+        REQUIRE(static_cast<const Block*>(eliminated.get())->scope()->variables().size() == 3);
+        REQUIRE(ExprRunner::runInt32Expr(move(eliminated)) == 24);
+    }
+
+    SECTION("Assignment invalidates an available expression") {
+        BlockBuilder bb;
+        unique_ptr<const Block> block {
+                bb.addVariable(a)
+                        .addVariable(b)
+                        .addVariable(c)
+                        .addExpression(AssignVariable::make(a, LiteralInt32::make(3)))
+                        .addExpression(AssignVariable::make(b, LiteralInt32::make(4)))
+                        .addExpression(AssignVariable::make(c, aTimesB()))
+                        .addExpression(AssignVariable::make(a, LiteralInt32::make(5)))
+                        .addExpression(Return::make(Binary::make(make_unique<VariableRef>(c), OperationKind::Add, aTimesB())))
+                        .build()
+        };
+
+        CommonSubexpressionEliminator cse;
+        ChildPtr<const Expr> eliminated = cse.transform(block.get());
+        REQUIRE(static_cast<const Block*>(eliminated.get())->scope()->variables().size() == 3);
+        REQUIRE(ExprRunner::runInt32Expr(move(eliminated)) == 32);
+    }
+
+    SECTION("Float literals are compared by their bits") {
+        auto temporaries = [](const char *text) {
+            ChildPtr<const Expr> eliminated = CommonSubexpressionEliminator{}.transform(
+                    SExprParser{}.parseExpr(text).get());
+            return static_cast<const Block*>(eliminated.get())->scope()->size() - 1;
+        };
+        REQUIRE(temporaries("(block ((x Float)) (set x 1.0) (add (mul x 0.0) (mul x 0.0)))") == 1);
+        REQUIRE(temporaries("(block ((x Float)) (set x 1.0) (add (mul x 0.0) (mul x -0.0)))") == 0);
+    }
+
+    SECTION("Nothing is kept from one transformation to the next") {
+        //Nodes of the second tree may reuse the addresses of those of the first, which is freed before it is built.
+        const char *texts[] = {
+                "(block ((x Int32)) (set x 3) (return (add (mul x x) (mul x x))))",
+                "(block ((x Int32)) (set x 3) (while (sub x 1) (set x (mul x x))) (return (mul x x)))"
+        };
+        CommonSubexpressionEliminator reused;
+        for(const char *text : texts) {
+            string expected = SExprWriter::toString(
+                    CommonSubexpressionEliminator{}.transform(SExprParser{}.parseExpr(text).get()).get());
+            REQUIRE(SExprWriter::toString(reused.transform(SExprParser{}.parseExpr(text).get()).get()) == expected);
+        }
+
+        AstContext context;
+        ChildPtr<const Expr> eliminated = CommonSubexpressionEliminator{context}.transform(
+                SExprParser{&context}.parseExpr(texts[0]).get());
+        REQUIRE(SExprWriter::toString(eliminated.get())
+                == "(block ((x Int32) ($cse0 Int32)) (set x 3) (return (add (set $cse0 (mul x x)) $cse0)))");
+        REQUIRE(ArenaAllocatable::allocationOf(eliminated.get()) == ArenaAllocatable::Allocation::Arena);
+    }
+
+    SECTION("A node with several parents is eliminated at each occurrence") {
+        //Replaces multiplying by 2 with an Add of the same node to itself.
+        class DoubleByAdding : public ExpressionTreeTransformer {
+        public:
+            DoubleByAdding(AstContext &context) : ExpressionTreeTransformer{context} { }
+        protected:
+            ChildPtr<const Expr> transformBinary(const Binary *expr) override {
+                if(expr->operation() == OperationKind::Mul
+                   && expr->rValue()->nodeKind() == NodeKind::LiteralInt32
+                   && static_cast<const LiteralInt32*>(expr->rValue())->value() == 2) {
+                    ChildPtr<const Expr> operand = transform(expr->lValue());
+                    const Expr *shared = operand.get();
+                    return makeIn<const Binary>(context(), move(operand), OperationKind::Add, share(shared));
+                }
+                return ExpressionTreeTransformer::transformBinary(expr);
+            }
+        };
+
+        AstContext context;
+        unique_ptr<const Expr> block = SExprParser{&context}.parseExpr(
+                "(block ((a Int32) (b Int32)) (set a 3) (set b 4) (return (mul (mul a b) 2)))");
+        ChildPtr<const Expr> doubled = DoubleByAdding{context}.transform(block.get());
+        auto sum = static_cast<const Binary*>(
+                static_cast<const Return*>(static_cast<const Block*>(doubled.get())->expression(2))->valueExpr());
+        REQUIRE(sum->lValue() == sum->rValue());
+
+        ChildPtr<const Expr> eliminated = CommonSubexpressionEliminator{context}.transform(doubled.get());
+        REQUIRE(SExprWriter::toString(eliminated.get())
+                == "(block ((a Int32) (b Int32) ($cse0 Int32)) (set a 3) (set b 4) "
+                   "(return (add (set $cse0 (mul a b)) $cse0)))");
+        REQUIRE(ExprRunner::runInt32Expr(move(eliminated)) == 24);
+    }
+}
+
 TEST_CASE("Error conditions") {
 
     REQUIRE(assertCompileError(
             CompileError::BinaryExprDataTypeMismatch,
             Binary::make(LiteralFloat::make(1.0f), OperationKind::Add, LiteralInt32::make(1))));
 
+    REQUIRE(assertCompileError(
+            CompileError::UndefinedVariable,
+            make_unique<VariableRef>(make_shared<Variable>("undeclared", DataType::Int32))));
+
+    REQUIRE(assertCompileError(CompileError::LoopControlOutsideLoop, Break::make()));
+
+    REQUIRE(assertCompileError(CompileError::UndefinedFunction, SExprParser{}.parseExpr("(call missing Int32)")));
+
 }
 
 int main(int argc, char **argv) {